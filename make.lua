@@ -51,6 +51,9 @@ require( "libs.zstd" )
 
 require( "source.tools.bc4" )
 require( "source.tools.dieselmap" )
+require( "source.tools.hashbench" )
+require( "source.tools.jobbench" )
+require( "source.tools.packassets" )
 
 local platform_curl_libs = {
 	{ OS ~= "macos" and "curl" or nil },
@@ -320,6 +320,7 @@ static const cgcmd_t cgcmds[] = {
 	{ "weapprev", []( const Tokenized & args ) { CG_Cmd_PrevWeapon_f(); }, false },
 	{ "weapon", CG_Cmd_Weapon_f, false },
 	{ "viewpos", []( const Tokenized & args ) { CG_Viewpos_f(); }, true },
+	{ "posebenchmark", PoseBenchmark, true },
 };
 
 static const ClientToServerCommand game_commands_no_args[] = {
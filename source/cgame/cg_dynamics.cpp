@@ -1,4 +1,5 @@
 #include "qcommon/base.h"
+#include "qcommon/hash.h"
 #include "qcommon/time.h"
 #include "cgame/cg_local.h"
 #include "client/renderer/renderer.h"
@@ -19,11 +20,6 @@ struct Decal {
 	// NOTE(msc): uvwh should all be < 1.0
 };
 
-struct PersistentDecal {
-	Decal decal;
-	Time expiration;
-};
-
 STATIC_ASSERT( sizeof( Decal ) == 2 * 4 * sizeof( float ) );
 STATIC_ASSERT( sizeof( Decal ) % alignof( Decal ) == 0 );
 
@@ -40,6 +36,165 @@ struct PersistentDynamicLight {
 	Time lifetime;
 };
 
+/*
+ * persistent decals/dlights go in a spatial hash so we only upload the ones
+ * that can touch the view frustum, and their expiration times go in a
+ * min-heap so expiring them doesn't have to look at the live ones
+ *
+ * cells hash into a fixed number of buckets, so far apart cells can share a
+ * bucket. buckets track the bounds of everything in them, which only grow
+ * until the bucket empties out
+ */
+template< typename T, u32 N >
+struct PersistentDynamics {
+	static constexpr u32 NONE = U32_MAX;
+	static constexpr u32 NUM_BUCKETS = 1024;
+	static constexpr float CELL_SIZE = 512.0f;
+
+	struct Entry {
+		T x;
+		MinMax3 bounds;
+		u32 bucket;
+		u32 prev, next;
+	};
+
+	struct Bucket {
+		MinMax3 bounds;
+		u32 head;
+		u32 count;
+	};
+
+	struct Expiration {
+		Time time;
+		u32 entry;
+	};
+
+	Entry entries[ N ];
+	u32 free_entries[ N ];
+	u32 num_free;
+
+	Expiration heap[ N ];
+	u32 heap_size;
+
+	Bucket buckets[ NUM_BUCKETS ];
+
+	void clear() {
+		for( u32 i = 0; i < N; i++ ) {
+			free_entries[ i ] = N - i - 1;
+		}
+		num_free = N;
+		heap_size = 0;
+
+		for( Bucket & bucket : buckets ) {
+			bucket = { MinMax3::Empty(), NONE, 0 };
+		}
+	}
+
+	static u32 BucketIndex( Vec3 p ) {
+		u64 x = u64( s64( floorf( p.x / CELL_SIZE ) ) );
+		u64 y = u64( s64( floorf( p.y / CELL_SIZE ) ) );
+		u64 z = u64( s64( floorf( p.z / CELL_SIZE ) ) );
+		return u32( Hash64( x ^ Hash64( y ^ Hash64( z ) ) ) % NUM_BUCKETS );
+	}
+
+	bool add( const T & x, Vec3 origin, float radius, Time expiration ) {
+		if( num_free == 0 )
+			return false;
+
+		num_free--;
+		u32 idx = free_entries[ num_free ];
+
+		Entry * entry = &entries[ idx ];
+		entry->x = x;
+		entry->bounds = MinMax3( radius ) + origin;
+		entry->bucket = BucketIndex( origin );
+
+		Bucket * bucket = &buckets[ entry->bucket ];
+		entry->prev = NONE;
+		entry->next = bucket->head;
+		if( bucket->head != NONE ) {
+			entries[ bucket->head ].prev = idx;
+		}
+		bucket->head = idx;
+		bucket->count++;
+		bucket->bounds = Union( bucket->bounds, entry->bounds );
+
+		// sift up
+		u32 i = heap_size;
+		heap_size++;
+		while( i > 0 && heap[ ( i - 1 ) / 2 ].time > expiration ) {
+			heap[ i ] = heap[ ( i - 1 ) / 2 ];
+			i = ( i - 1 ) / 2;
+		}
+		heap[ i ] = { expiration, idx };
+
+		return true;
+	}
+
+	void remove( u32 idx ) {
+		Entry * entry = &entries[ idx ];
+		Bucket * bucket = &buckets[ entry->bucket ];
+
+		if( entry->prev != NONE ) {
+			entries[ entry->prev ].next = entry->next;
+		}
+		else {
+			bucket->head = entry->next;
+		}
+		if( entry->next != NONE ) {
+			entries[ entry->next ].prev = entry->prev;
+		}
+
+		bucket->count--;
+		if( bucket->count == 0 ) {
+			bucket->bounds = MinMax3::Empty();
+		}
+
+		free_entries[ num_free ] = idx;
+		num_free++;
+	}
+
+	void expire( Time now ) {
+		while( heap_size > 0 && now > heap[ 0 ].time ) {
+			remove( heap[ 0 ].entry );
+
+			// sift the last element down from the root
+			heap_size--;
+			Expiration last = heap[ heap_size ];
+			u32 i = 0;
+			while( true ) {
+				u32 child = i * 2 + 1;
+				if( child >= heap_size )
+					break;
+				if( child + 1 < heap_size && heap[ child + 1 ].time < heap[ child ].time ) {
+					child++;
+				}
+				if( last.time <= heap[ child ].time )
+					break;
+				heap[ i ] = heap[ child ];
+				i = child;
+			}
+			heap[ i ] = last;
+		}
+	}
+
+	template< typename F >
+	void for_each_visible( const Frustum & frustum, F f ) const {
+		for( const Bucket & bucket : buckets ) {
+			if( bucket.count == 0 || !BoxInFrustum( frustum, bucket.bounds ) )
+				continue;
+
+			for( u32 i = bucket.head; i != NONE; i = entries[ i ].next ) {
+				if( BoxInFrustum( frustum, entries[ i ].bounds ) ) {
+					if( !f( entries[ i ].x ) ) {
+						return;
+					}
+				}
+			}
+		}
+	}
+};
+
 STATIC_ASSERT( sizeof( DynamicLight ) == 1 * 4 * sizeof( float ) );
 STATIC_ASSERT( sizeof( DynamicLight ) % alignof( DynamicLight ) == 0 );
 
@@ -48,8 +203,8 @@ static constexpr u32 MAX_DLIGHTS = 100000;
 
 static BoundedDynamicArray< Decal, MAX_DECALS > decals;
 static BoundedDynamicArray< DynamicLight, MAX_DLIGHTS > dlights;
-static BoundedDynamicArray< PersistentDecal, MAX_DECALS > persistent_decals;
-static BoundedDynamicArray< PersistentDynamicLight, MAX_DLIGHTS > persistent_dlights;
+static PersistentDynamics< Decal, MAX_DECALS > persistent_decals;
+static PersistentDynamics< PersistentDynamicLight, MAX_DLIGHTS > persistent_dlights;
 
 struct GPUDecalTile {
 	u32 decals[ FORWARD_PLUS_TILE_CAPACITY ];
@@ -116,31 +271,24 @@ void AddPersistentDecal( Vec3 origin, Quaternion orientation, float radius, Stri
 	Vec3 c = Floor( color.xyz() * 255.0f );
 	c.x += floorf( height ) * 256.0f;
 
-	[[maybe_unused]] bool ok = persistent_decals.add( PersistentDecal {
-		.decal = Decal {
-			.origin_orientation_xyz = Floor( origin ) + ( orientation.im() * 0.49f + 0.5f ),
-			.radius_orientation_w = floorf( radius ) + ( orientation.w * 0.49f + 0.5f ),
-			.color_uvwh_height = Vec4( uvwh.x, uvwh.y + c.x, uvwh.z + c.y, uvwh.w + c.z ),
-		},
-		.expiration = cls.game_time + lifetime,
-	} );
+	Decal decal = {
+		.origin_orientation_xyz = Floor( origin ) + ( orientation.im() * 0.49f + 0.5f ),
+		.radius_orientation_w = floorf( radius ) + ( orientation.w * 0.49f + 0.5f ),
+		.color_uvwh_height = Vec4( uvwh.x, uvwh.y + c.x, uvwh.z + c.y, uvwh.w + c.z ),
+	};
+
+	// Floor( origin ) + 1 covers the orientation packed into the origin
+	float bounds_radius = radius + Max2( height, 0.0f ) + 1.0f;
+	[[maybe_unused]] bool ok = persistent_decals.add( decal, origin, bounds_radius, cls.game_time + lifetime );
 }
 
 void DrawPersistentDecals() {
-	// remove expired decals
-	for( u32 i = 0; i < persistent_decals.size(); i++ ) {
-		if( cls.game_time > persistent_decals[ i ].expiration ) {
-			persistent_decals.remove_swap( i );
-			i--;
-		}
-	}
+	TracyZoneScoped;
 
-	// draw
-	for( const PersistentDecal & decal : persistent_decals ) {
-		if( !decals.add( decal.decal ) ) {
-			break;
-		}
-	}
+	persistent_decals.expire( cls.game_time );
+	persistent_decals.for_each_visible( frame_static.frustum, []( const Decal & decal ) {
+		return decals.add( decal );
+	} );
 }
 
 void DrawDynamicLight( Vec3 origin, Vec3 color, float intensity ) {
@@ -151,7 +299,7 @@ void DrawDynamicLight( Vec3 origin, Vec3 color, float intensity ) {
 }
 
 void AddPersistentDynamicLight( Vec3 origin, Vec3 color, float intensity, Time lifetime ) {
-	[[maybe_unused]] bool ok = persistent_dlights.add( PersistentDynamicLight {
+	PersistentDynamicLight dlight = {
 		.dlight = DynamicLight {
 			.origin_color = Floor( origin ) + color * 0.9f,
 			.radius = sqrtf( intensity / DLIGHT_CUTOFF ),
@@ -159,30 +307,25 @@ void AddPersistentDynamicLight( Vec3 origin, Vec3 color, float intensity, Time l
 		.start_intensity = intensity,
 		.spawn_time = cls.game_time,
 		.lifetime = lifetime,
-	} );
+	};
+
+	// dlights only get smaller so the spawn radius is a safe bound
+	[[maybe_unused]] bool ok = persistent_dlights.add( dlight, origin, dlight.dlight.radius + 1.0f, cls.game_time + lifetime );
 }
 
 void DrawPersistentDynamicLights() {
-	// remove expired dlights
-	for( u32 i = 0; i < persistent_dlights.size(); i++ ) {
-		if( cls.game_time > persistent_dlights[ i ].spawn_time + persistent_dlights[ i ].lifetime ) {
-			persistent_dlights.remove_swap( i );
-			i--;
-		}
-	}
+	TracyZoneScoped;
 
-	// draw
-	for( const PersistentDynamicLight & dlight : persistent_dlights ) {
+	persistent_dlights.expire( cls.game_time );
+	persistent_dlights.for_each_visible( frame_static.frustum, []( const PersistentDynamicLight & dlight ) {
 		float fract = ToSeconds( cls.game_time - dlight.spawn_time ) / ToSeconds( dlight.lifetime );
 		float intensity = Lerp( dlight.start_intensity, fract, 0.0f );
 		DynamicLight faded = {
 			.origin_color = dlight.dlight.origin_color,
 			.radius = sqrtf( intensity / DLIGHT_CUTOFF ),
 		};
-		if( !dlights.add( faded ) ) {
-			break;
-		}
-	}
+		return dlights.add( faded );
+	} );
 }
 
 static u32 PixelsToTiles( u32 pixels ) {
@@ -19,6 +19,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 */
 
 #include "cgame/cg_local.h"
+#include "qcommon/array.h"
 #include "qcommon/time.h"
 #include "client/audio/api.h"
 #include "client/renderer/renderer.h"
@@ -410,22 +411,11 @@ static void DrawEntityModel( centity_t * cent ) {
 
 	ModelRenderData model = maybe_model.value;
 
-	TempAllocator temp = cls.frame_arena.temp();
-
 	Mat3x4 transform = FromAxisAndOrigin( cent->interpolated.axis, cent->interpolated.origin ) * Mat4Scale( scale );
 
 	Vec4 color = sRGBToLinear( cent->interpolated.color );
 
-	MatrixPalettes palettes = { };
-	if( cent->interpolated.animating && model.type == ModelType_GLTF && model.gltf->animations.n > 0 ) { // TODO: this is fragile and we should do something better
-		Span< Transform > pose = SampleAnimation( &temp, model.gltf, cent->interpolated.animation_time );
-		palettes = ComputeMatrixPalettes( &temp, model.gltf, pose );
-	}
-	else if( cent->current.type == ET_MAPMODEL && model.type == ModelType_GLTF && model.gltf->animations.n > 0 ) {
-		float t = PositiveMod( ToSeconds( cls.monotonicTime ), model.gltf->animations[ 0 ].duration );
-		Span< Transform > pose = SampleAnimation( &temp, model.gltf, t );
-		palettes = ComputeMatrixPalettes( &temp, model.gltf, pose );
-	}
+	MatrixPalettes palettes = GetEntityPose( cent->current.number );
 
 	DrawModelConfig config = { };
 	config.draw_model.enabled = true;
@@ -617,6 +607,86 @@ static void DrawEntityTrail( const centity_t * cent, StringHash name ) {
 	DrawTrail( Hash64( cent->current.id.id ), cent->interpolated.origin, 16.0f, color, "simpletrail", Milliseconds( 500 ) );
 }
 
+static MatrixPalettes entity_poses[ MAX_EDICTS ];
+static MatrixPalettes view_weapon_pose;
+
+static bool EntityModelPoseRequest( const centity_t * cent, PoseRequest * request ) {
+	Optional< ModelRenderData > maybe_model = FindModelRenderData( cent->prev.model );
+	if( !maybe_model.exists || maybe_model.value.type != ModelType_GLTF )
+		return false;
+
+	const GLTFRenderData * model = maybe_model.value.gltf;
+	if( model->animations.n == 0 )
+		return false;
+
+	*request = { };
+	request->model = model;
+
+	if( cent->interpolated.animating ) { // TODO: this is fragile and we should do something better
+		request->t = cent->interpolated.animation_time;
+		return true;
+	}
+
+	if( cent->current.type == ET_MAPMODEL ) {
+		request->t = PositiveMod( ToSeconds( cls.monotonicTime ), model->animations[ 0 ].duration );
+		return true;
+	}
+
+	return false;
+}
+
+void ComputeEntityPoses( TempAllocator * temp ) {
+	TracyZoneScoped;
+
+	for( MatrixPalettes & pose : entity_poses ) {
+		pose = { };
+	}
+	view_weapon_pose = { };
+
+	DynamicArray< PoseRequest > requests( temp );
+
+	for( int pnum = 0; pnum < cg.frame.numEntities; pnum++ ) {
+		const SyncEntityState * state = &cg.frame.parsedEntities[ pnum % ARRAY_COUNT( cg.frame.parsedEntities ) ];
+		centity_t * cent = &cg_entities[ state->number ];
+
+		if( cent->current.linearMovement && !cent->linearProjectileCanDraw ) {
+			continue;
+		}
+
+		PoseRequest request;
+		bool animated;
+		if( cent->type == ET_PLAYER || cent->type == ET_CORPSE ) {
+			animated = cent->current.team != Team_None && PlayerPoseRequest( cent, &request );
+		}
+		else {
+			animated = EntityModelPoseRequest( cent, &request );
+		}
+
+		if( animated ) {
+			request.palettes = AllocMatrixPalettes( temp, request.model );
+			entity_poses[ state->number ] = request.palettes;
+			requests.add( request );
+		}
+	}
+
+	PoseRequest view_weapon;
+	if( ViewWeaponPoseRequest( &cg.weapon, &view_weapon ) ) {
+		view_weapon.palettes = AllocMatrixPalettes( temp, view_weapon.model );
+		view_weapon_pose = view_weapon.palettes;
+		requests.add( view_weapon );
+	}
+
+	EvaluatePoses( temp, requests.span() );
+}
+
+MatrixPalettes GetEntityPose( int ent_num ) {
+	return entity_poses[ ent_num ];
+}
+
+MatrixPalettes GetViewWeaponPose() {
+	return view_weapon_pose;
+}
+
 void DrawEntities() {
 	TracyZoneScoped;
 
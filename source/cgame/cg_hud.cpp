@@ -20,6 +20,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 */
 
 #include "qcommon/base.h"
+#include "qcommon/array.h"
 #include "qcommon/fpe.h"
 #include "qcommon/time.h"
 #include "client/assets.h"
@@ -35,6 +36,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "luau/lualib.h"
 #include "luau/luacode.h"
 
+#include "nanosort/nanosort.hpp"
+
 static const Vec4 light_gray = sRGBToLinear( RGBA8( 96, 96, 96, 255 ) );
 
 static lua_State * hud_L;
@@ -1344,6 +1347,496 @@ bool CG_ScoreboardShown() {
 	return cg.showScoreboard;
 }
 
+/*
+ * the state table handed to hud.lua lives as long as the lua state and gets
+ * updated in place, so building it doesn't feed the GC every frame. weapons,
+ * teams and scoreboard players are only rewritten when they differ from what
+ * we wrote last time, and each cached entry remembers the frame it was last
+ * written on. frame 0 means never, which forces a full rewrite after init
+ */
+struct HUDStateCache {
+	template< typename T >
+	struct Entry {
+		int ref;
+		u64 written_frame;
+		T last;
+	};
+
+	u64 frame;
+	u32 tables_written;
+
+	int state;
+	int weapons;
+	int teams;
+
+	Entry< WeaponSlot > weapon[ Weapon_Count - 1 ];
+	Entry< SyncTeamState > team[ Team_Count ];
+	int team_players[ Team_Count ];
+	Entry< SyncScoreboardPlayer > player[ MAX_CLIENTS ];
+};
+
+static HUDStateCache hud_state;
+
+static int NewTableRef( lua_State * L, int narr, int nrec ) {
+	lua_createtable( L, narr, nrec );
+	int ref = lua_ref( L, -1 );
+	lua_pop( L, 1 );
+	return ref;
+}
+
+static void InitHUDStateCache( lua_State * L ) {
+	hud_state = { };
+	hud_state.frame = 1;
+
+	hud_state.state = NewTableRef( L, 0, 64 );
+	hud_state.weapons = NewTableRef( L, Weapon_Count - 1, 0 );
+	hud_state.teams = NewTableRef( L, Team_Count, 0 );
+
+	lua_getref( L, hud_state.state );
+	lua_getref( L, hud_state.weapons );
+	lua_setfield( L, -2, "weapons" );
+	lua_getref( L, hud_state.teams );
+	lua_setfield( L, -2, "teams" );
+	lua_pop( L, 1 );
+
+	for( auto & weapon : hud_state.weapon ) {
+		weapon.ref = NewTableRef( L, 0, 4 );
+	}
+
+	lua_getref( L, hud_state.teams );
+	for( int i = Team_One; i < Team_Count; i++ ) {
+		hud_state.team[ i ].ref = NewTableRef( L, 0, 3 );
+		hud_state.team_players[ i ] = NewTableRef( L, MAX_CLIENTS, 0 );
+
+		lua_getref( L, hud_state.team[ i ].ref );
+		lua_getref( L, hud_state.team_players[ i ] );
+		lua_setfield( L, -2, "players" );
+		lua_rawseti( L, -2, i );
+	}
+	lua_pop( L, 1 );
+
+	for( auto & player : hud_state.player ) {
+		player.ref = NewTableRef( L, 0, 8 );
+	}
+}
+
+static void InvalidateHUDStateCache() {
+	for( auto & weapon : hud_state.weapon ) {
+		weapon.written_frame = 0;
+	}
+	for( auto & team : hud_state.team ) {
+		team.written_frame = 0;
+	}
+	for( auto & player : hud_state.player ) {
+		player.written_frame = 0;
+	}
+}
+
+template< typename T >
+static bool NeedsRewrite( const HUDStateCache::Entry< T > & entry, const T & current ) {
+	return entry.written_frame == 0 || memcmp( &entry.last, &current, sizeof( T ) ) != 0;
+}
+
+template< typename T >
+static void MarkWritten( HUDStateCache::Entry< T > * entry, const T & current ) {
+	entry->last = current;
+	entry->written_frame = hud_state.frame;
+	hud_state.tables_written++;
+}
+
+static void PushNumberOrNil( lua_State * L, bool exists, double x ) {
+	if( exists ) {
+		lua_pushnumber( L, x );
+	}
+	else {
+		lua_pushnil( L );
+	}
+}
+
+static void UpdateHUDWeapons( lua_State * L, const SyncPlayerState & ps ) {
+	lua_getref( L, hud_state.weapons );
+
+	for( size_t i = 0; i < ARRAY_COUNT( ps.weapons ); i++ ) {
+		const WeaponSlot & slot = ps.weapons[ i ];
+		HUDStateCache::Entry< WeaponSlot > * entry = &hud_state.weapon[ i ];
+		if( !NeedsRewrite( *entry, slot ) )
+			continue;
+
+		if( slot.weapon == Weapon_None ) {
+			lua_pushnil( L );
+		}
+		else {
+			const WeaponDef * def = GS_GetWeaponDef( slot.weapon );
+
+			lua_getref( L, entry->ref );
+			lua_pushnumber( L, slot.weapon );
+			lua_setfield( L, -2, "weapon" );
+			lua_pushlstring( L, def->name.ptr, def->name.n );
+			lua_setfield( L, -2, "name" );
+			lua_pushnumber( L, slot.ammo );
+			lua_setfield( L, -2, "ammo" );
+			lua_pushnumber( L, def->clip_size );
+			lua_setfield( L, -2, "max_ammo" );
+		}
+
+		lua_rawseti( L, -2, i + 1 ); // arrays start at 1 in lua
+		MarkWritten( entry, slot );
+	}
+
+	lua_pop( L, 1 );
+}
+
+static void UpdateHUDTeams( lua_State * L, const SyncGameState & gs ) {
+	for( int i = 0; i < MAX_CLIENTS; i++ ) {
+		const SyncScoreboardPlayer & player = gs.players[ i ];
+		HUDStateCache::Entry< SyncScoreboardPlayer > * entry = &hud_state.player[ i ];
+		if( !NeedsRewrite( *entry, player ) )
+			continue;
+
+		lua_getref( L, entry->ref );
+		lua_pushnumber( L, i + 1 );
+		lua_setfield( L, -2, "id" );
+		lua_pushlstring( L, player.name, strlen( player.name ) );
+		lua_setfield( L, -2, "name" );
+		lua_pushnumber( L, player.ping );
+		lua_setfield( L, -2, "ping" );
+		lua_pushnumber( L, player.score );
+		lua_setfield( L, -2, "score" );
+		lua_pushnumber( L, player.kills );
+		lua_setfield( L, -2, "kills" );
+		lua_pushboolean( L, player.ready );
+		lua_setfield( L, -2, "ready" );
+		lua_pushboolean( L, player.carrier );
+		lua_setfield( L, -2, "carrier" );
+		lua_pushboolean( L, player.alive );
+		lua_setfield( L, -2, "alive" );
+		lua_pop( L, 1 );
+
+		MarkWritten( entry, player );
+	}
+
+	for( int i = Team_One; i < Team_Count; i++ ) {
+		const SyncTeamState & team = gs.teams[ i ];
+		HUDStateCache::Entry< SyncTeamState > * entry = &hud_state.team[ i ];
+		if( !NeedsRewrite( *entry, team ) )
+			continue;
+
+		lua_getref( L, entry->ref );
+		lua_pushnumber( L, team.score );
+		lua_setfield( L, -2, "score" );
+		lua_pushnumber( L, team.num_players );
+		lua_setfield( L, -2, "num_players" );
+		lua_pop( L, 1 );
+
+		// after an invalidate we don't know what's in the table, eg hudbench leaves
+		// its fake players in there, so clear every slot
+		int old_num_players = entry->written_frame == 0 ? MAX_CLIENTS : entry->last.num_players;
+
+		lua_getref( L, hud_state.team_players[ i ] );
+		for( u8 p = 0; p < team.num_players; p++ ) {
+			lua_getref( L, hud_state.player[ team.player_indices[ p ] - 1 ].ref );
+			lua_rawseti( L, -2, p + 1 );
+		}
+		for( int p = team.num_players; p < old_num_players; p++ ) {
+			lua_pushnil( L );
+			lua_rawseti( L, -2, p + 1 );
+		}
+		lua_pop( L, 1 );
+
+		MarkWritten( entry, team );
+	}
+}
+
+static void UpdateHUDState( lua_State * L, const SyncPlayerState & ps, const SyncGameState & gs ) {
+	TracyZoneScoped;
+
+	hud_state.tables_written = 0;
+
+	lua_getref( L, hud_state.state );
+
+	lua_pushnumber( L, ps.POVnum );
+	lua_setfield( L, -2, "current_player" );
+
+	lua_pushboolean( L, ps.ready );
+	lua_setfield( L, -2, "ready" );
+
+	lua_pushnumber( L, ps.health );
+	lua_setfield( L, -2, "health" );
+
+	lua_pushnumber( L, ps.max_health );
+	lua_setfield( L, -2, "max_health" );
+
+	lua_pushboolean( L, ps.zoom_time > 0 );
+	lua_setfield( L, -2, "zooming" );
+
+	lua_pushnumber( L, ps.weapon );
+	lua_setfield( L, -2, "weapon" );
+
+	lua_pushnumber( L, ps.weapon_state );
+	lua_setfield( L, -2, "weapon_state" );
+
+	lua_pushnumber( L, ps.weapon_state_time );
+	lua_setfield( L, -2, "weapon_state_time" );
+
+	lua_pushnumber( L, ps.gadget );
+	lua_setfield( L, -2, "gadget" );
+
+	lua_pushnumber( L, ps.gadget_ammo );
+	lua_setfield( L, -2, "gadget_ammo" );
+
+	lua_pushnumber( L, ps.perk );
+	lua_setfield( L, -2, "perk" );
+
+	lua_pushnumber( L, ps.pmove.stamina );
+	lua_setfield( L, -2, "stamina" );
+
+	lua_pushnumber( L, ps.pmove.stamina_stored );
+	lua_setfield( L, -2, "stamina_stored" );
+
+	lua_pushnumber( L, ps.pmove.stamina_state );
+	lua_setfield( L, -2, "stamina_state" );
+
+	lua_pushboolean( L, ps.pmove.pm_type == PM_SPECTATOR );
+	lua_setfield( L, -2, "ghost" );
+
+	// the table is reused so optional fields have to be cleared explicitly
+	PushNumberOrNil( L, ps.team != Team_None, ps.team );
+	lua_setfield( L, -2, "team" );
+
+	PushNumberOrNil( L, ps.real_team != Team_None, ps.real_team );
+	lua_setfield( L, -2, "real_team" );
+
+	lua_pushboolean( L, ps.carrying_bomb );
+	lua_setfield( L, -2, "is_carrier" );
+
+	lua_pushboolean( L, ps.can_plant );
+	lua_setfield( L, -2, "can_plant" );
+
+	lua_pushboolean( L, ps.can_change_loadout );
+	lua_setfield( L, -2, "can_change_loadout" );
+
+	lua_pushnumber( L, ps.progress );
+	lua_setfield( L, -2, "bomb_progress" );
+
+	lua_pushnumber( L, ps.progress_type );
+	lua_setfield( L, -2, "bomb_progress_type" );
+
+	lua_pushnumber( L, gs.gametype );
+	lua_setfield( L, -2, "gametype" );
+
+	lua_pushnumber( L, gs.match_state );
+	lua_setfield( L, -2, "match_state" );
+
+	lua_pushnumber( L, gs.scorelimit );
+	lua_setfield( L, -2, "scorelimit" );
+
+	lua_pushnumber( L, gs.bomb.attacking_team );
+	lua_setfield( L, -2, "attacking_team" );
+
+	lua_pushnumber( L, gs.round_state );
+	lua_setfield( L, -2, "round_state" );
+
+	lua_pushnumber( L, gs.round_type );
+	lua_setfield( L, -2, "round_type" );
+
+	lua_pushnumber( L, gs.teams[ Team_One ].score );
+	lua_setfield( L, -2, "scoreAlpha" );
+
+	lua_pushnumber( L, gs.bomb.alpha_players_alive );
+	lua_setfield( L, -2, "aliveAlpha" );
+
+	lua_pushnumber( L, gs.bomb.alpha_players_total );
+	lua_setfield( L, -2, "totalAlpha" );
+
+	lua_pushnumber( L, gs.teams[ Team_Two ].score );
+	lua_setfield( L, -2, "scoreBeta" );
+
+	lua_pushnumber( L, gs.bomb.beta_players_alive );
+	lua_setfield( L, -2, "aliveBeta" );
+
+	lua_pushnumber( L, gs.bomb.beta_players_total );
+	lua_setfield( L, -2, "totalBeta" );
+
+	PushNumberOrNil( L, ps.POVnum != cgs.playerNum + 1, ps.POVnum );
+	lua_setfield( L, -2, "chasing" );
+
+	lua_pushstring( L, gs.callvote );
+	lua_setfield( L, -2, "vote" );
+
+	lua_pushnumber( L, gs.callvote_required_votes );
+	lua_setfield( L, -2, "votes_required" );
+
+	lua_pushnumber( L, gs.callvote_yes_votes );
+	lua_setfield( L, -2, "votes_total" );
+
+	lua_pushboolean( L, ps.voted );
+	lua_setfield( L, -2, "has_voted" );
+
+	lua_pushboolean( L, CG_IsLagging() );
+	lua_setfield( L, -2, "lagging" );
+
+	lua_pushboolean( L, Cvar_Bool( "cg_showFPS" ) );
+	lua_setfield( L, -2, "show_fps" );
+
+	lua_pushboolean( L, Cvar_Bool( "cg_showHotkeys" ) );
+	lua_setfield( L, -2, "show_hotkeys" );
+
+	lua_pushnumber( L, CG_GetFPS() );
+	lua_setfield( L, -2, "fps" );
+
+	lua_pushboolean( L, Cvar_Bool( "cg_showSpeed" ) );
+	lua_setfield( L, -2, "show_speed" );
+
+	lua_pushnumber( L, CG_GetSpeed() );
+	lua_setfield( L, -2, "speed" );
+
+	lua_pushnumber( L, frame_static.viewport_width );
+	lua_setfield( L, -2, "viewport_width" );
+
+	lua_pushnumber( L, frame_static.viewport_height );
+	lua_setfield( L, -2, "viewport_height" );
+
+	lua_pushnumber( L, gs.teams[ Team_None ].num_players );
+	lua_setfield( L, -2, "spectating" );
+
+	lua_pushboolean( L, CG_ScoreboardShown() );
+	lua_setfield( L, -2, "scoreboard" );
+
+	lua_pop( L, 1 );
+
+	UpdateHUDWeapons( L, ps );
+	UpdateHUDTeams( L, gs );
+
+	hud_state.frame++;
+
+	TracyPlotSample( "HUD tables rewritten", s64( hud_state.tables_written ) );
+}
+
+// do a fixed amount of GC work at a known point every frame so collection
+// keeps up with whatever garbage the script makes, rather than leaving it to
+// allocation assists that land in the middle of the script
+constexpr int HUD_GC_STEP_KB = 16;
+
+static void StepHUDGC( lua_State * L ) {
+	TracyZoneScoped;
+	lua_gc( L, LUA_GCSTEP, HUD_GC_STEP_KB );
+	TracyPlotSample( "HUD Luau heap KB", s64( lua_gc( L, LUA_GCCOUNT, 0 ) ) );
+}
+
+// returns false if hud.lua failed, in which case there's nothing to draw
+static bool RunHUDFrame( lua_State * L, const SyncPlayerState & ps, const SyncGameState & gs, Clay_RenderCommandArray * render_commands ) {
+	lua_pushvalue( L, -1 );
+	UpdateHUDState( L, ps, gs );
+	lua_getref( L, hud_state.state );
+
+	{
+		TracyZoneScopedN( "Clay_BeginLayout" );
+		Clay_BeginLayout();
+	}
+
+	bool hud_lua_ran_ok;
+	{
+		TracyZoneScopedN( "Luau" );
+		hud_lua_ran_ok = CallWithStackTrace( L, 1, 0 );
+	}
+
+	StepHUDGC( L );
+
+	// don't run clay layout if hud.lua failed because it might have left clay in a bad state
+	if( !hud_lua_ran_ok )
+		return false;
+
+	{
+		TracyZoneScopedN( "Clay_EndLayout" );
+		*render_commands = Clay_EndLayout();
+	}
+
+	return true;
+}
+
+// runs hud.lua against a full synthetic scoreboard with a couple of players
+// changing every frame and reports frame times and how much the heap grew
+static void HUDBenchmark_f( const Tokenized & args ) {
+	if( hud_L == NULL ) {
+		Com_Printf( "hud.lua isn't loaded\n" );
+		return;
+	}
+
+	int num_frames = args.tokens.n > 1 ? SpanToInt( args.tokens[ 1 ], 1000 ) : 1000;
+	if( num_frames <= 0 )
+		return;
+
+	static SyncGameState gs;
+	gs = client_gs.gameState;
+	SyncPlayerState ps = cg.predictedPlayerState;
+
+	RNG rng = NewRNG( 1, 0 );
+
+	for( int i = 0; i < MAX_CLIENTS; i++ ) {
+		SyncScoreboardPlayer * player = &gs.players[ i ];
+		*player = { };
+		ggformat( player->name, sizeof( player->name ), "player{}", i + 1 );
+		player->ping = RandomUniform( &rng, 5, 150 );
+		player->alive = true;
+	}
+
+	for( int i = Team_One; i < Team_Count; i++ ) {
+		gs.teams[ i ] = { };
+	}
+	for( int i = 0; i < MAX_CLIENTS; i++ ) {
+		SyncTeamState * team = &gs.teams[ Team_One + i % 2 ];
+		team->player_indices[ team->num_players ] = i + 1;
+		team->num_players++;
+	}
+
+	for( size_t i = 0; i < ARRAY_COUNT( ps.weapons ); i++ ) {
+		ps.weapons[ i ] = { };
+		if( i < 4 ) {
+			ps.weapons[ i ].weapon = WeaponType( Weapon_None + 1 + i );
+			ps.weapons[ i ].ammo = 10;
+		}
+	}
+
+	DynamicArray< float > frame_times( sys_allocator );
+	int heap_before = lua_gc( hud_L, LUA_GCCOUNT, 0 );
+	int heap_max = heap_before;
+
+	for( int frame = 0; frame < num_frames; frame++ ) {
+		SyncScoreboardPlayer * player = &gs.players[ RandomUniform( &rng, 0, MAX_CLIENTS ) ];
+		player->ping = RandomUniform( &rng, 5, 150 );
+		if( frame % 30 == 0 ) {
+			player->score++;
+			player->kills++;
+			ps.weapons[ 0 ].ammo = ps.weapons[ 0 ].ammo == 0 ? 10 : ps.weapons[ 0 ].ammo - 1;
+		}
+		ps.health = RandomUniform( &rng, 1, 100 );
+
+		Time before = Now();
+		Clay_RenderCommandArray render_commands;
+		RunHUDFrame( hud_L, ps, gs, &render_commands );
+		frame_times.add( ToSeconds( Now() - before ) * 1000.0f );
+
+		heap_max = Max2( heap_max, lua_gc( hud_L, LUA_GCCOUNT, 0 ) );
+	}
+
+	float total = 0.0f;
+	for( float t : frame_times ) {
+		total += t;
+	}
+
+	nanosort( frame_times.begin(), frame_times.end() );
+	auto percentile = [&]( float p ) {
+		return frame_times[ Min2( size_t( p * frame_times.size() ), frame_times.size() - 1 ) ];
+	};
+
+	Com_Printf( "%zu HUD frames, avg %.3fms, p50 %.3fms, p99 %.3fms, max %.3fms\n",
+		frame_times.size(), total / frame_times.size(), percentile( 0.5f ), percentile( 0.99f ), frame_times[ frame_times.size() - 1 ] );
+	Com_Printf( "Luau heap %dKB -> %dKB, peak %dKB\n", heap_before, lua_gc( hud_L, LUA_GCCOUNT, 0 ), heap_max );
+
+	// make the next real frame overwrite the synthetic state
+	InvalidateHUDStateCache();
+}
+
 void CG_InitHUD() {
 	TracyZoneScoped;
 
@@ -1354,6 +1847,7 @@ void CG_InitHUD() {
 		show_debugger = !show_debugger;
 		Clay_SetDebugModeEnabled( show_debugger );
 	} );
+	AddCommand( "hudbench", HUDBenchmark_f );
 
 	Span< const char > src = AssetString( StringHash( "hud/hud.lua" ) );
 	size_t bytecode_size;
@@ -1448,6 +1942,9 @@ void CG_InitHUD() {
 			lua_close( hud_L );
 			hud_L = NULL;
 		}
+		else {
+			InitHUDStateCache( hud_L );
+		}
 	}
 	else {
 		Com_Printf( S_COLOR_RED "Luau compilation error: %s\n", lua_tostring( hud_L, -1 ) );
@@ -1473,6 +1970,7 @@ void CG_ShutdownHUD() {
 	Free( sys_allocator, clay_arena.memory );
 
 	RemoveCommand( "toggleuidebugger" );
+	RemoveCommand( "hudbench" );
 }
 
 static Vec4 ClayToCD( Clay_Color color ) {
@@ -1548,253 +2046,9 @@ void CG_DrawHUD() {
 	if( hud_L == NULL )
 		return;
 
-	lua_pushvalue( hud_L, -1 );
-	lua_newtable( hud_L );
-
-	lua_pushnumber( hud_L, cg.predictedPlayerState.POVnum );
-	lua_setfield( hud_L, -2, "current_player" );
-
-	lua_pushboolean( hud_L, cg.predictedPlayerState.ready );
-	lua_setfield( hud_L, -2, "ready" );
-
-	lua_pushnumber( hud_L, cg.predictedPlayerState.health );
-	lua_setfield( hud_L, -2, "health" );
-
-	lua_pushnumber( hud_L, cg.predictedPlayerState.max_health );
-	lua_setfield( hud_L, -2, "max_health" );
-
-	lua_pushboolean( hud_L, cg.predictedPlayerState.zoom_time > 0 );
-	lua_setfield( hud_L, -2, "zooming" );
-
-	lua_pushnumber( hud_L, cg.predictedPlayerState.weapon );
-	lua_setfield( hud_L, -2, "weapon" );
-
-	lua_pushnumber( hud_L, cg.predictedPlayerState.weapon_state );
-	lua_setfield( hud_L, -2, "weapon_state" );
-
-	lua_pushnumber( hud_L, cg.predictedPlayerState.weapon_state_time );
-	lua_setfield( hud_L, -2, "weapon_state_time" );
-
-	lua_pushnumber( hud_L, cg.predictedPlayerState.gadget );
-	lua_setfield( hud_L, -2, "gadget" );
-
-	lua_pushnumber( hud_L, cg.predictedPlayerState.gadget_ammo );
-	lua_setfield( hud_L, -2, "gadget_ammo" );
-
-	lua_pushnumber( hud_L, cg.predictedPlayerState.perk );
-	lua_setfield( hud_L, -2, "perk" );
-
-	lua_pushnumber( hud_L, cg.predictedPlayerState.pmove.stamina );
-	lua_setfield( hud_L, -2, "stamina" );
-
-	lua_pushnumber( hud_L, cg.predictedPlayerState.pmove.stamina_stored );
-	lua_setfield( hud_L, -2, "stamina_stored" );
-
-	lua_pushnumber( hud_L, cg.predictedPlayerState.pmove.stamina_state );
-	lua_setfield( hud_L, -2, "stamina_state" );
-
-	lua_pushboolean( hud_L, cg.predictedPlayerState.pmove.pm_type == PM_SPECTATOR );
-	lua_setfield( hud_L, -2, "ghost" );
-
-	if( cg.predictedPlayerState.team != Team_None ) {
-		lua_pushnumber( hud_L, cg.predictedPlayerState.team );
-		lua_setfield( hud_L, -2, "team" );
-	}
-
-	if( cg.predictedPlayerState.real_team != Team_None ) {
-		lua_pushnumber( hud_L, cg.predictedPlayerState.real_team );
-		lua_setfield( hud_L, -2, "real_team" );
-	}
-
-	lua_pushboolean( hud_L, cg.predictedPlayerState.carrying_bomb );
-	lua_setfield( hud_L, -2, "is_carrier" );
-
-	lua_pushboolean( hud_L, cg.predictedPlayerState.can_plant );
-	lua_setfield( hud_L, -2, "can_plant" );
-
-	lua_pushboolean( hud_L, cg.predictedPlayerState.can_change_loadout );
-	lua_setfield( hud_L, -2, "can_change_loadout" );
-
-	lua_pushnumber( hud_L, cg.predictedPlayerState.progress );
-	lua_setfield( hud_L, -2, "bomb_progress" );
-
-	lua_pushnumber( hud_L, cg.predictedPlayerState.progress_type );
-	lua_setfield( hud_L, -2, "bomb_progress_type" );
-
-	lua_pushnumber( hud_L, client_gs.gameState.gametype );
-	lua_setfield( hud_L, -2, "gametype" );
-
-	lua_pushnumber( hud_L, client_gs.gameState.match_state );
-	lua_setfield( hud_L, -2, "match_state" );
-
-	lua_pushnumber( hud_L, client_gs.gameState.scorelimit );
-	lua_setfield( hud_L, -2, "scorelimit" );
-
-	lua_pushnumber( hud_L, client_gs.gameState.bomb.attacking_team );
-	lua_setfield( hud_L, -2, "attacking_team" );
-
-	lua_pushnumber( hud_L, client_gs.gameState.round_state );
-	lua_setfield( hud_L, -2, "round_state" );
-
-	lua_pushnumber( hud_L, client_gs.gameState.round_type );
-	lua_setfield( hud_L, -2, "round_type" );
-
-	lua_pushnumber( hud_L, client_gs.gameState.teams[ Team_One ].score );
-	lua_setfield( hud_L, -2, "scoreAlpha" );
-
-	lua_pushnumber( hud_L, client_gs.gameState.bomb.alpha_players_alive );
-	lua_setfield( hud_L, -2, "aliveAlpha" );
-
-	lua_pushnumber( hud_L, client_gs.gameState.bomb.alpha_players_total );
-	lua_setfield( hud_L, -2, "totalAlpha" );
-
-	lua_pushnumber( hud_L, client_gs.gameState.teams[ Team_Two ].score );
-	lua_setfield( hud_L, -2, "scoreBeta" );
-
-	lua_pushnumber( hud_L, client_gs.gameState.bomb.beta_players_alive );
-	lua_setfield( hud_L, -2, "aliveBeta" );
-
-	lua_pushnumber( hud_L, client_gs.gameState.bomb.beta_players_total );
-	lua_setfield( hud_L, -2, "totalBeta" );
-
-	if( cg.predictedPlayerState.POVnum != cgs.playerNum + 1 ) {
-		lua_pushnumber( hud_L, cg.predictedPlayerState.POVnum );
-		lua_setfield( hud_L, -2, "chasing" );
-	}
-
-	lua_pushstring( hud_L, client_gs.gameState.callvote );
-	lua_setfield( hud_L, -2, "vote" );
-
-	lua_pushnumber( hud_L, client_gs.gameState.callvote_required_votes );
-	lua_setfield( hud_L, -2, "votes_required" );
-
-	lua_pushnumber( hud_L, client_gs.gameState.callvote_yes_votes );
-	lua_setfield( hud_L, -2, "votes_total" );
-
-	lua_pushboolean( hud_L, cg.predictedPlayerState.voted );
-	lua_setfield( hud_L, -2, "has_voted" );
-
-	lua_pushboolean( hud_L, CG_IsLagging() );
-	lua_setfield( hud_L, -2, "lagging" );
-
-	lua_pushboolean( hud_L, Cvar_Bool( "cg_showFPS" ) );
-	lua_setfield( hud_L, -2, "show_fps" );
-
-	lua_pushboolean( hud_L, Cvar_Bool( "cg_showHotkeys" ) );
-	lua_setfield( hud_L, -2, "show_hotkeys" );
-
-	lua_pushnumber( hud_L, CG_GetFPS() );
-	lua_setfield( hud_L, -2, "fps" );
-
-	lua_pushboolean( hud_L, Cvar_Bool( "cg_showSpeed" ) );
-	lua_setfield( hud_L, -2, "show_speed" );
-
-	lua_pushnumber( hud_L, CG_GetSpeed() );
-	lua_setfield( hud_L, -2, "speed" );
-
-	lua_pushnumber( hud_L, frame_static.viewport_width );
-	lua_setfield( hud_L, -2, "viewport_width" );
-
-	lua_pushnumber( hud_L, frame_static.viewport_height );
-	lua_setfield( hud_L, -2, "viewport_height" );
-
-	lua_createtable( hud_L, Weapon_Count - 1, 0 );
-	for( size_t i = 0; i < ARRAY_COUNT( cg.predictedPlayerState.weapons ); i++ ) {
-		const WeaponDef * def = GS_GetWeaponDef( cg.predictedPlayerState.weapons[ i ].weapon );
-
-		if( cg.predictedPlayerState.weapons[ i ].weapon == Weapon_None )
-			continue;
-
-		lua_pushnumber( hud_L, i + 1 ); // arrays start at 1 in lua
-		lua_createtable( hud_L, 0, 4 );
-
-		lua_pushnumber( hud_L, cg.predictedPlayerState.weapons[ i ].weapon );
-		lua_setfield( hud_L, -2, "weapon" );
-		lua_pushlstring( hud_L, def->name.ptr, def->name.n );
-		lua_setfield( hud_L, -2, "name" );
-		lua_pushnumber( hud_L, cg.predictedPlayerState.weapons[ i ].ammo );
-		lua_setfield( hud_L, -2, "ammo" );
-		lua_pushnumber( hud_L, def->clip_size );
-		lua_setfield( hud_L, -2, "max_ammo" );
-
-		lua_settable( hud_L, -3 );
-
-	}
-	lua_setfield( hud_L, -2, "weapons" );
-
-	lua_createtable( hud_L, Team_Count, 0 );
-	for( int i = Team_One; i < Team_Count; i++ ) {
-		lua_pushnumber( hud_L, i );
-		lua_createtable( hud_L, 0, 3 );
-
-		const SyncTeamState & team = client_gs.gameState.teams[ i ];
-
-		lua_pushnumber( hud_L, team.score );
-		lua_setfield( hud_L, -2, "score" );
-
-		lua_pushnumber( hud_L, team.num_players );
-		lua_setfield( hud_L, -2, "num_players" );
-
-		lua_createtable( hud_L, 0, team.num_players );
-		for( u8 p = 0; p < team.num_players; p++ ) {
-			lua_pushnumber( hud_L, p + 1 );
-
-			lua_createtable( hud_L, 0, 7 );
-
-			const SyncScoreboardPlayer & player = client_gs.gameState.players[ team.player_indices[ p ] - 1 ];
-			lua_pushnumber( hud_L, team.player_indices[ p ] );
-			lua_setfield( hud_L, -2, "id" );
-			lua_pushlstring( hud_L, player.name, strlen( player.name ) );
-			lua_setfield( hud_L, -2, "name" );
-			lua_pushnumber( hud_L, player.ping );
-			lua_setfield( hud_L, -2, "ping" );
-			lua_pushnumber( hud_L, player.score );
-			lua_setfield( hud_L, -2, "score" );
-			lua_pushnumber( hud_L, player.kills );
-			lua_setfield( hud_L, -2, "kills" );
-			lua_pushboolean( hud_L, player.ready );
-			lua_setfield( hud_L, -2, "ready" );
-			lua_pushboolean( hud_L, player.carrier );
-			lua_setfield( hud_L, -2, "carrier" );
-			lua_pushboolean( hud_L, player.alive );
-			lua_setfield( hud_L, -2, "alive" );
-
-			lua_settable( hud_L, -3 );
-		}
-		lua_setfield( hud_L, -2, "players" );
-
-		lua_settable( hud_L, -3 );
-	}
-	lua_setfield( hud_L, -2, "teams" );
-
-
-	lua_pushnumber( hud_L, client_gs.gameState.teams[ Team_None ].num_players );
-	lua_setfield( hud_L, -2, "spectating" );
-
-
-	lua_pushboolean( hud_L, CG_ScoreboardShown() );
-	lua_setfield( hud_L, -2, "scoreboard" );
-
-	{
-		TracyZoneScopedN( "Clay_BeginLayout" );
-		Clay_BeginLayout();
-	}
-
-	bool hud_lua_ran_ok;
-	{
-		TracyZoneScopedN( "Luau" );
-		hud_lua_ran_ok = CallWithStackTrace( hud_L, 1, 0 );
-	}
-
-	// don't run clay layout if hud.lua failed because it might have left clay in a bad state
-	if( !hud_lua_ran_ok )
-		return;
-
 	Clay_RenderCommandArray render_commands;
-	{
-		TracyZoneScopedN( "Clay_EndLayout" );
-		render_commands = Clay_EndLayout();
-	}
+	if( !RunHUDFrame( hud_L, cg.predictedPlayerState, client_gs.gameState, &render_commands ) )
+		return;
 
 	{
 		TracyZoneScopedN( "Clay submit draw calls" );
@@ -1,6 +1,7 @@
 #include "cgame/cg_local.h"
 #include "qcommon/array.h"
 #include "qcommon/time.h"
+#include "qcommon/threadpool.h"
 #include "client/audio/api.h"
 #include "client/renderer/renderer.h"
 
@@ -14,18 +15,31 @@ void CG_GenericExplosion( Vec3 pos, Vec3 dir, float radius ) {
 	PlaySFX( "models/bomb/explode", PlaySFXConfigPosition( pos ) );
 }
 
-struct Gib {
-	Vec3 origin;
-	Vec3 velocity;
-	float scale;
-	float lifetime;
-	Vec4 color;
+// gibs are kept as SoA so the integrate and cull loops stay tight
+struct Gibs {
+	static constexpr size_t capacity = 512;
+
+	Vec3 origin[ capacity ];
+	Vec3 velocity[ capacity ];
+	float scale[ capacity ];
+	float lifetime[ capacity ];
+	Vec4 color[ capacity ];
+	size_t n;
+
+	void remove_swap( size_t i ) {
+		n--;
+		origin[ i ] = origin[ n ];
+		velocity[ i ] = velocity[ n ];
+		scale[ i ] = scale[ n ];
+		lifetime[ i ] = lifetime[ n ];
+		color[ i ] = color[ n ];
+	}
 };
 
-static BoundedDynamicArray< Gib, 512 > gibs;
+static Gibs gibs;
 
 void InitGibs() {
-	gibs.clear();
+	gibs.n = 0;
 }
 
 void SpawnGibs( Vec3 origin, Vec3 velocity, int damage, Vec4 color ) {
@@ -45,20 +59,19 @@ void SpawnGibs( Vec3 origin, Vec3 velocity, int damage, Vec4 color ) {
 	float radius = player_radius - gib_radius - epsilon;
 
 	for( int i = 0; i < count; i++ ) {
-		Optional< Gib * > gib = gibs.add();
-		if( !gib.exists )
+		if( gibs.n == Gibs::capacity )
 			break;
 
 		Vec3 dir = Vec3( UniformSampleInsideCircle( &cls.rng ), 0.0f );
 		dir.z = RandomFloat01( &cls.rng );
 
-		*gib.value = Gib {
-			.origin = origin + dir * radius,
-			.velocity = velocity * 0.5f + dir * Length( velocity ) * 0.5f,
-			.scale = RandomUniformFloat( &cls.rng, 0.5f, 1.0f ),
-			.lifetime = 10.0f,
-			.color = color,
-		};
+		size_t idx = gibs.n;
+		gibs.origin[ idx ] = origin + dir * radius;
+		gibs.velocity[ idx ] = velocity * 0.5f + dir * Length( velocity ) * 0.5f;
+		gibs.scale[ idx ] = RandomUniformFloat( &cls.rng, 0.5f, 1.0f );
+		gibs.lifetime[ idx ] = 10.0f;
+		gibs.color[ idx ] = color;
+		gibs.n++;
 	}
 }
 
@@ -86,47 +99,136 @@ static void GibImpact( Vec3 pos, Vec3 normal, Vec4 color, float scale ) {
 	}
 }
 
+struct GibSweeps {
+	Span< const int > touchlist;
+	Span< const MinMax3 > touch_bounds;
+	const Vec3 * start;
+	const Vec3 * end;
+	const MinMax3 * bounds;
+	const MinMax3 * swept_bounds;
+	trace_t * traces;
+};
+
+struct GibTraceBatch {
+	const GibSweeps * sweeps;
+	size_t first, n;
+};
+
+static void TraceGibBatch( TempAllocator * temp, void * data ) {
+	TracyZoneScoped;
+
+	const GibTraceBatch * batch = ( const GibTraceBatch * ) data;
+	const GibSweeps * sweeps = batch->sweeps;
+
+	int candidates[ MAX_EDICTS ];
+
+	for( size_t i = batch->first; i < batch->first + batch->n; i++ ) {
+		// the shared broadphase covers the whole group, so narrow it down to
+		// what this gib can actually reach. gibs in open air end up with an
+		// empty list and skip the narrowphase entirely
+		size_t num_candidates = 0;
+		for( size_t j = 0; j < sweeps->touchlist.n; j++ ) {
+			if( BoundsOverlap( sweeps->swept_bounds[ i ], sweeps->touch_bounds[ j ] ) ) {
+				candidates[ num_candidates ] = sweeps->touchlist[ j ];
+				num_candidates++;
+			}
+		}
+
+		sweeps->traces[ i ] = CG_TraceTouchlist( Span< const int >( candidates, num_candidates ), sweeps->start[ i ], sweeps->bounds[ i ], sweeps->end[ i ], -1, Solid_World );
+	}
+}
+
 void DrawGibs() {
 	TracyZoneScoped;
 
+	if( gibs.n == 0 )
+		return;
+
 	float dt = cls.frametime * 0.001f;
 
 	const GLTFRenderData * model = FindGLTFRenderData( "models/gibs/gib" );
 	Vec3 gravity = Vec3( 0, 0, -GRAVITY );
 
-	for( size_t i = 0; i < gibs.size(); i++ ) {
-		Gib * gib = &gibs[ i ];
+	TempAllocator temp = cls.frame_arena.temp();
 
-		gib->velocity += gravity * dt;
-		Vec3 next_origin = gib->origin + gib->velocity * dt;
+	Vec3 * next_origin = AllocMany< Vec3 >( &temp, gibs.n );
+	MinMax3 * bounds = AllocMany< MinMax3 >( &temp, gibs.n );
+	MinMax3 * swept_bounds = AllocMany< MinMax3 >( &temp, gibs.n );
+	trace_t * traces = AllocMany< trace_t >( &temp, gibs.n );
 
-		float size = 0.5f * gib->scale;
-		MinMax3 bounds = model->bounds * size;
+	MinMax3 group_bounds = MinMax3::Empty();
+	{
+		TracyZoneScopedN( "Integrate" );
+		for( size_t i = 0; i < gibs.n; i++ ) {
+			gibs.velocity[ i ] += gravity * dt;
+			next_origin[ i ] = gibs.origin[ i ] + gibs.velocity[ i ] * dt;
+
+			bounds[ i ] = model->bounds * ( 0.5f * gibs.scale[ i ] );
+			swept_bounds[ i ] = Union( bounds[ i ] + gibs.origin[ i ], bounds[ i ] + next_origin[ i ] );
+			group_bounds = Union( group_bounds, swept_bounds[ i ] );
+		}
+	}
+
+	int touchlist[ MAX_EDICTS ];
+	MinMax3 touch_bounds[ MAX_EDICTS ];
+	size_t num_touched = CG_TraceBroadphase( group_bounds, touchlist, touch_bounds );
+
+	GibSweeps sweeps = {
+		.touchlist = Span< const int >( touchlist, num_touched ),
+		.touch_bounds = Span< const MinMax3 >( touch_bounds, num_touched ),
+		.start = gibs.origin,
+		.end = next_origin,
+		.bounds = bounds,
+		.swept_bounds = swept_bounds,
+		.traces = traces,
+	};
+
+	// a single gib trace is cheap, so only go wide for big splatters and
+	// hand them out in batches to keep the job queue overhead down
+	constexpr size_t GIBS_PER_BATCH = 16;
+
+	if( gibs.n <= GIBS_PER_BATCH ) {
+		GibTraceBatch batch = { &sweeps, 0, gibs.n };
+		TraceGibBatch( &temp, &batch );
+	}
+	else {
+		size_t num_batches = ( gibs.n + GIBS_PER_BATCH - 1 ) / GIBS_PER_BATCH;
+		Span< GibTraceBatch > batches = AllocSpan< GibTraceBatch >( &temp, num_batches );
+		for( size_t i = 0; i < num_batches; i++ ) {
+			size_t first = i * GIBS_PER_BATCH;
+			batches[ i ] = { &sweeps, first, Min2( GIBS_PER_BATCH, gibs.n - first ) };
+		}
+
+		ParallelFor( batches, TraceGibBatch );
+	}
 
-		trace_t trace = CG_Trace( gib->origin, bounds, next_origin, -1, Solid_World );
+	// impacts spawn effects and decals and use the rng, so resolve them
+	// in order on the main thread. walk backwards so remove_swap only
+	// moves gibs we've already handled
+	for( size_t i = gibs.n; i-- > 0; ) {
+		const trace_t & trace = traces[ i ];
 
 		if( trace.GotNowhere() ) {
-			gib->lifetime = 0;
+			gibs.lifetime[ i ] = 0;
 		}
 		else if( trace.HitSomething() ) {
-			gib->lifetime = 0;
+			gibs.lifetime[ i ] = 0;
 
-			GibImpact( trace.endpos, trace.normal, gib->color, gib->scale );
+			GibImpact( trace.endpos, trace.normal, gibs.color[ i ], gibs.scale[ i ] );
 		}
 
-		gib->lifetime -= dt;
-		if( gib->lifetime <= 0 ) {
+		gibs.lifetime[ i ] -= dt;
+		if( gibs.lifetime[ i ] <= 0 ) {
 			gibs.remove_swap( i );
-			i--;
 			continue;
 		}
 
-		Mat3x4 transform = Mat4Translation( gib->origin ) * Mat4Scale( size );
+		Mat3x4 transform = Mat4Translation( gibs.origin[ i ] ) * Mat4Scale( 0.5f * gibs.scale[ i ] );
 		DrawModelConfig config = { };
 		config.draw_model.enabled = true;
 		config.draw_shadows.enabled = true;
-		DrawGLTFModel( config, model, transform, gib->color );
+		DrawGLTFModel( config, model, transform, gibs.color[ i ] );
 
-		gib->origin = next_origin;
+		gibs.origin[ i ] = next_origin[ i ];
 	}
 }
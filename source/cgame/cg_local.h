@@ -227,6 +227,9 @@ extern centity_t cg_entities[MAX_EDICTS];
 bool CG_NewFrameSnap( snapshot_t *frame, snapshot_t *lerpframe );
 
 void CG_SoundEntityNewState( centity_t *cent );
+void ComputeEntityPoses( TempAllocator * temp );
+MatrixPalettes GetEntityPose( int ent_num );
+MatrixPalettes GetViewWeaponPose();
 void DrawEntities();
 void CG_LerpEntities();
 void CG_LerpGenericEnt( centity_t *cent );
@@ -263,6 +266,14 @@ void CG_PredictMovement();
 void CG_CheckPredictionError();
 void CG_BuildSolidList( const snapshot_t * frame );
 trace_t CG_Trace( Vec3 start, MinMax3 bounds, Vec3 end, int ignore, SolidBits solid_mask );
+
+// for lots of short traces in the same area, e.g. gibs. CG_TraceBroadphase
+// finds everything touching bounds once along with its world space bounds,
+// and CG_TraceTouchlist traces against a subset of that. touchlist and
+// touch_bounds need room for MAX_EDICTS entries. CG_TraceTouchlist is safe
+// to call from the thread pool
+size_t CG_TraceBroadphase( MinMax3 bounds, int * touchlist, MinMax3 * touch_bounds );
+trace_t CG_TraceTouchlist( Span< const int > touchlist, Vec3 start, MinMax3 bounds, Vec3 end, int ignore, SolidBits solid_mask );
 void CG_Predict_TouchTriggers( const pmove_t * pm, Vec3 previous_origin );
 
 //
@@ -400,6 +411,8 @@ void DrawTrails();
 //
 void CG_AddViewWeapon( cg_viewweapon_t *viewweapon );
 void CG_CalcViewWeapon( cg_viewweapon_t *viewweapon );
+struct PoseRequest;
+bool ViewWeaponPoseRequest( cg_viewweapon_t * viewweapon, PoseRequest * request );
 void CG_ViewWeapon_AddAnimation( int ent_num, StringHash anim );
 
 void CG_AddRecoil( WeaponType weapon );
@@ -21,6 +21,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "cgame/cg_local.h"
 #include "qcommon/hash.h"
 #include "qcommon/hashtable.h"
+#include "qcommon/time.h"
 #include "client/assets.h"
 #include "client/renderer/renderer.h"
 #include "client/renderer/model.h"
@@ -661,6 +662,46 @@ static Mat3x4 InverseNodeTransform( const GLTFRenderData * model, StringHash nod
 	return FindNodeByName( model, node, &idx ) ? model->nodes[ idx ].inverse_global_transform : Mat3x4::Identity();
 }
 
+bool PlayerPoseRequest( centity_t * cent, PoseRequest * request ) {
+	pmodel_t * pmodel = &cg_entPModels[ cent->current.number ];
+	const PlayerModelMetadata * meta = GetPlayerModelMetadata( cent->current.number );
+	if( meta == NULL )
+		return false;
+
+	const GLTFRenderData * model = FindGLTFRenderData( meta->model );
+	if( model->animations.n == 0 )
+		return false;
+
+	float lower_time, upper_time;
+	CG_GetAnimationTimes( meta, pmodel, cl.serverTime, &lower_time, &upper_time );
+
+	*request = { };
+	request->model = model;
+	request->t = lower_time;
+	request->cursors = StaticSpan( pmodel->animation_cursors[ 0 ] );
+	request->merge_upper = true;
+	request->upper_root_node = meta->upper_root_node;
+	request->upper_t = upper_time;
+	request->upper_cursors = StaticSpan( pmodel->animation_cursors[ 1 ] );
+
+	if( cent->current.type != ET_CORPSE ) {
+		// apply UPPER and HEAD angles to rotator nodes
+		// also add rotations from velocity leaning
+		EulerDegrees3 upper_angles = EulerDegrees3( LerpAngles( pmodel->oldangles[ UPPER ], cg.lerpfrac, pmodel->angles[ UPPER ] ) * 0.5f );
+		Quaternion upper = EulerDegrees3ToQuaternion( upper_angles );
+
+		EulerDegrees3 head_angles = EulerDegrees3( LerpAngles( pmodel->oldangles[ HEAD ], cg.lerpfrac, pmodel->angles[ HEAD ] ) );
+		Quaternion head = EulerDegrees3ToQuaternion( head_angles );
+
+		request->rotations[ 0 ] = { meta->upper_rotator_nodes[ 0 ], upper };
+		request->rotations[ 1 ] = { meta->upper_rotator_nodes[ 1 ], upper };
+		request->rotations[ 2 ] = { meta->head_rotator_node, head };
+		request->num_rotations = 3;
+	}
+
+	return true;
+}
+
 void CG_DrawPlayer( centity_t * cent ) {
 	pmodel_t * pmodel = &cg_entPModels[ cent->current.number ];
 	const PlayerModelMetadata * meta = GetPlayerModelMetadata( cent->current.number );
@@ -688,49 +729,24 @@ void CG_DrawPlayer( centity_t * cent ) {
 		cent->interpolated.origin2 = origin;
 	}
 
-	TempAllocator temp = cls.frame_arena.temp();
-
 	const GLTFRenderData * model = FindGLTFRenderData( meta->model );
 	bool corpse = cent->current.type == ET_CORPSE;
-	MatrixPalettes pose = { };
-
-	if( model->animations.n > 0 ) {
-		float lower_time, upper_time;
-		CG_GetAnimationTimes( meta, pmodel, cl.serverTime, &lower_time, &upper_time );
-		Span< Transform > lower = SampleAnimation( &temp, model, lower_time );
-		Span< Transform > upper = SampleAnimation( &temp, model, upper_time );
-		MergeLowerUpperPoses( lower, upper, model, meta->upper_root_node );
-
-		if( !corpse ) {
-			EulerDegrees3 tmpangles;
-			// if it's our client use the predicted angles
-			if( cg.view.playerPrediction && ISVIEWERENTITY( cent->current.number ) ) {
-				tmpangles = cg.predictedPlayerState.viewangles.yaw_only();
-			}
-			else {
-				// apply interpolated LOWER angles to entity
-				tmpangles = LerpAngles( pmodel->oldangles[LOWER], cg.lerpfrac, pmodel->angles[LOWER] );
-			}
-
-			AnglesToAxis( tmpangles, cent->interpolated.axis );
 
-			// apply UPPER and HEAD angles to rotator nodes
-			// also add rotations from velocity leaning
-			{
-				EulerDegrees3 angles = EulerDegrees3( LerpAngles( pmodel->oldangles[ UPPER ], cg.lerpfrac, pmodel->angles[ UPPER ] ) * 0.5f );
+	// sampled in parallel with everything else by ComputeEntityPoses
+	MatrixPalettes pose = GetEntityPose( cent->current.number );
 
-				Quaternion q = EulerDegrees3ToQuaternion( angles );
-				lower[ meta->upper_rotator_nodes[ 0 ] ].rotation *= q;
-				lower[ meta->upper_rotator_nodes[ 1 ] ].rotation *= q;
-			}
-
-			{
-				EulerDegrees3 angles = EulerDegrees3( LerpAngles( pmodel->oldangles[ HEAD ], cg.lerpfrac, pmodel->angles[ HEAD ] ) );
-				lower[ meta->head_rotator_node ].rotation *= EulerDegrees3ToQuaternion( angles );
-			}
+	if( !corpse && model->animations.n > 0 ) {
+		EulerDegrees3 tmpangles;
+		// if it's our client use the predicted angles
+		if( cg.view.playerPrediction && ISVIEWERENTITY( cent->current.number ) ) {
+			tmpangles = cg.predictedPlayerState.viewangles.yaw_only();
+		}
+		else {
+			// apply interpolated LOWER angles to entity
+			tmpangles = LerpAngles( pmodel->oldangles[LOWER], cg.lerpfrac, pmodel->angles[LOWER] );
 		}
 
-		pose = ComputeMatrixPalettes( &temp, model, lower );
+		AnglesToAxis( tmpangles, cent->interpolated.axis );
 	}
 
 	Mat3x4 unscaled_transform = FromAxisAndOrigin( cent->interpolated.axis, cent->interpolated.origin );
@@ -833,3 +849,78 @@ void CG_DrawPlayer( centity_t * cent ) {
 		}
 	}
 }
+
+void PoseBenchmark( const Tokenized & args ) {
+	constexpr int frames = 100;
+	constexpr float dt = 1.0f / 60.0f;
+	int num_players = Clamp( 1, args.tokens.n >= 2 ? SpanToInt( args.tokens[ 1 ], 256 ) : 256, 2048 );
+
+	const PlayerModelMetadata * meta = GetPlayerModelMetadata( "players/rigg/model" );
+	const GLTFRenderData * model = meta == NULL ? NULL : FindGLTFRenderData( meta->model );
+	if( model == NULL || model->animations.n == 0 ) {
+		Com_Printf( S_COLOR_YELLOW "No player model to benchmark with\n" );
+		return;
+	}
+
+	TempAllocator temp = cls.frame_arena.temp();
+
+	float duration = model->animations[ 0 ].duration;
+	RNG rng = NewRNG( 0, 0 );
+
+	Span< PoseRequest > requests = AllocSpan< PoseRequest >( &temp, num_players );
+	Span< float > start_times = AllocSpan< float >( &temp, num_players * 2 );
+	for( int i = 0; i < num_players; i++ ) {
+		PoseRequest * request = &requests[ i ];
+		*request = { };
+		request->model = model;
+		request->merge_upper = true;
+		request->upper_root_node = meta->upper_root_node;
+		request->cursors = AllocSpan< AnimationCursor >( &temp, model->nodes.n );
+		request->upper_cursors = AllocSpan< AnimationCursor >( &temp, model->nodes.n );
+
+		EulerDegrees3 angles = EulerDegrees3( RandomFloat11( &rng ), RandomFloat11( &rng ), RandomFloat11( &rng ) ) * 45.0f;
+		request->rotations[ 0 ] = { meta->upper_rotator_nodes[ 0 ], EulerDegrees3ToQuaternion( angles * 0.5f ) };
+		request->rotations[ 1 ] = { meta->upper_rotator_nodes[ 1 ], EulerDegrees3ToQuaternion( angles * 0.5f ) };
+		request->rotations[ 2 ] = { meta->head_rotator_node, EulerDegrees3ToQuaternion( angles ) };
+		request->num_rotations = 3;
+
+		request->palettes = AllocMatrixPalettes( &temp, model );
+
+		start_times[ i * 2 + 0 ] = RandomUniformFloat( &rng, 0.0f, duration );
+		start_times[ i * 2 + 1 ] = RandomUniformFloat( &rng, 0.0f, duration );
+	}
+
+	// run the same frames serially on this thread and then through the thread pool
+	Time elapsed[ 2 ] = { };
+	for( int pass = 0; pass < 2; pass++ ) {
+		for( PoseRequest & request : requests ) {
+			memset( request.cursors.ptr, 0, request.cursors.num_bytes() );
+			memset( request.upper_cursors.ptr, 0, request.upper_cursors.num_bytes() );
+		}
+
+		for( int frame = 0; frame < frames; frame++ ) {
+			for( int i = 0; i < num_players; i++ ) {
+				requests[ i ].t = fmodf( start_times[ i * 2 + 0 ] + frame * dt, duration );
+				requests[ i ].upper_t = fmodf( start_times[ i * 2 + 1 ] + frame * dt, duration );
+			}
+
+			Time before = Now();
+			if( pass == 0 ) {
+				for( const PoseRequest & request : requests ) {
+					TempAllocator request_temp = cls.frame_arena.temp();
+					EvaluatePose( &request_temp, request );
+				}
+			}
+			else {
+				TempAllocator frame_temp = cls.frame_arena.temp();
+				EvaluatePoses( &frame_temp, requests );
+			}
+			elapsed[ pass ] += Now() - before;
+		}
+	}
+
+	float serial_ms = ToSeconds( elapsed[ 0 ] ) * 1000.0f / frames;
+	float parallel_ms = ToSeconds( elapsed[ 1 ] ) * 1000.0f / frames;
+	Com_Printf( "%d players, %zu nodes, %zu joints over %d frames\n", num_players, model->nodes.n, model->skin.n, frames );
+	Com_Printf( "Serial: %.3fms/frame, EvaluatePoses: %.3fms/frame (%.1fx)\n", serial_ms, parallel_ms, serial_ms / parallel_ms );
+}
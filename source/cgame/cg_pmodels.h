@@ -185,6 +185,9 @@ struct pmodel_t {
 	EulerDegrees3 oldangles[PMODEL_PARTS];             // for rotations
 
 	Mat3x4 muzzle_transform;
+
+	// lower and upper are sampled at different times
+	AnimationCursor animation_cursors[ 2 ][ 64 ];
 };
 
 extern pmodel_t cg_entPModels[MAX_EDICTS];      //a pmodel handle for each cg_entity
@@ -198,7 +201,10 @@ const PlayerModelMetadata * GetPlayerModelMetadata( int ent_num );
 
 void CG_ResetPModels();
 
+struct PoseRequest;
+bool PlayerPoseRequest( centity_t * cent, PoseRequest * request );
 void CG_DrawPlayer( centity_t * cent );
+void PoseBenchmark( const Tokenized & args );
 void CG_UpdatePlayerModelEnt( centity_t *cent );
 void CG_PModel_AddAnimation( int entNum, int loweranim, int upperanim, int headanim, int channel );
 void CG_PModel_ClearEventAnimations( int entNum );
@@ -228,4 +234,6 @@ struct cg_viewweapon_t {
 	int64_t eventAnimStartTime;
 
 	Mat3x4 muzzle_transform;
+
+	AnimationCursor animation_cursors[ 64 ];
 };
@@ -142,15 +142,7 @@ void CG_Predict_TouchTriggers( const pmove_t * pm, Vec3 previous_origin ) {
 	// }
 }
 
-trace_t CG_Trace( Vec3 start, MinMax3 bounds, Vec3 end, int ignore, SolidBits solid_mask ) {
-	TracyZoneScoped;
-
-	Ray ray = MakeRayStartEnd( start, end );
-
-	if( solid_mask == Solid_NotSolid ) {
-		return MakeMissedTrace( ray );
-	}
-
+static Shape TraceShape( MinMax3 bounds ) {
 	Shape shape;
 	if( bounds.mins == bounds.maxs ) {
 		Assert( bounds.mins == Vec3( 0.0f ) );
@@ -160,17 +152,14 @@ trace_t CG_Trace( Vec3 start, MinMax3 bounds, Vec3 end, int ignore, SolidBits so
 		shape.type = ShapeType_AABB;
 		shape.aabb = ToCenterExtents( bounds );
 	}
+	return shape;
+}
 
-	MinMax3 ray_bounds = Union( Union( MinMax3::Empty(), ray.origin ), ray.origin + ray.direction * ray.length );
-	MinMax3 broadphase_bounds = MinkowskiSum( ray_bounds, shape );
-
+static trace_t TraceVsTouchlist( Span< const int > touchlist, const Ray & ray, const Shape & shape, int ignore, SolidBits solid_mask ) {
 	trace_t result = MakeMissedTrace( ray );
 
-	int touchlist[ 1024 ];
-	size_t num = TraverseSpatialHashGrid( &cg_grid, broadphase_bounds, touchlist, SolidMask_AnySolid );
-
-	for( size_t i = 0; i < num; i++ ) {
-		const SyncEntityState * touch = &cg.frame.parsedEntities[ touchlist[ i ] ];
+	for( int idx : touchlist ) {
+		const SyncEntityState * touch = &cg.frame.parsedEntities[ idx ];
 		if( touch->number == ignore )
 			continue;
 
@@ -183,6 +172,50 @@ trace_t CG_Trace( Vec3 start, MinMax3 bounds, Vec3 end, int ignore, SolidBits so
 	return result;
 }
 
+trace_t CG_Trace( Vec3 start, MinMax3 bounds, Vec3 end, int ignore, SolidBits solid_mask ) {
+	TracyZoneScoped;
+
+	Ray ray = MakeRayStartEnd( start, end );
+
+	if( solid_mask == Solid_NotSolid ) {
+		return MakeMissedTrace( ray );
+	}
+
+	Shape shape = TraceShape( bounds );
+
+	MinMax3 ray_bounds = Union( Union( MinMax3::Empty(), ray.origin ), ray.origin + ray.direction * ray.length );
+	MinMax3 broadphase_bounds = MinkowskiSum( ray_bounds, shape );
+
+	int touchlist[ 1024 ];
+	size_t num = TraverseSpatialHashGrid( &cg_grid, broadphase_bounds, touchlist, SolidMask_AnySolid );
+
+	return TraceVsTouchlist( Span< const int >( touchlist, num ), ray, shape, ignore, solid_mask );
+}
+
+size_t CG_TraceBroadphase( MinMax3 bounds, int * touchlist, MinMax3 * touch_bounds ) {
+	TracyZoneScoped;
+
+	size_t num = TraverseSpatialHashGrid( &cg_grid, bounds, touchlist, SolidMask_AnySolid );
+	for( size_t i = 0; i < num; i++ ) {
+		const SyncEntityState * touch = &cg.frame.parsedEntities[ touchlist[ i ] ];
+		touch_bounds[ i ] = EntityBounds( ClientCollisionModelStorage(), touch );
+		if( touch_bounds[ i ] != MinMax3::Empty() ) {
+			touch_bounds[ i ].mins += touch->origin;
+			touch_bounds[ i ].maxs += touch->origin;
+		}
+	}
+
+	return num;
+}
+
+trace_t CG_TraceTouchlist( Span< const int > touchlist, Vec3 start, MinMax3 bounds, Vec3 end, int ignore, SolidBits solid_mask ) {
+	Ray ray = MakeRayStartEnd( start, end );
+	if( solid_mask == Solid_NotSolid ) {
+		return MakeMissedTrace( ray );
+	}
+	return TraceVsTouchlist( touchlist, ray, TraceShape( bounds ), ignore, solid_mask );
+}
+
 static float predictedSteps[CMD_BACKUP]; // for step smoothing
 static void CG_PredictAddStep( int virtualtime, int predictiontime, float stepSize ) {
 	float oldStep;
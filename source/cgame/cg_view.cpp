@@ -543,6 +543,10 @@ void CG_RenderView( unsigned extrapolationTime ) {
 
 	DoVisualEffect( "vfx/rain", cg.view.origin );
 
+	// poses have to outlive the draws that use them
+	TempAllocator pose_temp = cls.frame_arena.temp();
+	ComputeEntityPoses( &pose_temp );
+
 	DrawEntities();
 	DrawOutlines();
 	DrawSilhouettes();
@@ -192,17 +192,28 @@ void CG_AddViewWeapon( cg_viewweapon_t * viewweapon ) {
 	config.draw_model.enabled = true;
 	config.draw_model.view_weapon = true;
 
+	DrawGLTFModel( config, model, transform, CG_TeamColorVec4( ps->team ), GetViewWeaponPose() );
+}
+
+bool ViewWeaponPoseRequest( cg_viewweapon_t * viewweapon, PoseRequest * request ) {
+	if( !cg.view.drawWeapon )
+		return false;
+
+	const GLTFRenderData * model = GetEquippedItemRenderData( &cg.predictedPlayerState );
+	if( model == NULL )
+		return false;
+
 	u8 animation;
-	if( FindAnimationByName( model, viewweapon->eventAnim, &animation ) ) {
-		float t = float( cl.serverTime - viewweapon->eventAnimStartTime ) * 0.001f;
-		TempAllocator temp = cls.frame_arena.temp();
-		Span< Transform > pose = SampleAnimation( &temp, model, t, animation );
-		MatrixPalettes palettes = ComputeMatrixPalettes( &temp, model, pose );
-		DrawGLTFModel( config, model, transform, CG_TeamColorVec4( ps->team ), palettes );
-	}
-	else {
-		DrawGLTFModel( config, model, transform, CG_TeamColorVec4( ps->team ) );
-	}
+	if( !FindAnimationByName( model, viewweapon->eventAnim, &animation ) )
+		return false;
+
+	*request = { };
+	request->model = model;
+	request->animation = animation;
+	request->t = float( cl.serverTime - viewweapon->eventAnimStartTime ) * 0.001f;
+	request->cursors = StaticSpan( viewweapon->animation_cursors );
+
+	return true;
 }
 
 void CG_AddRecoil( WeaponType weapon ) {
@@ -1,5 +1,6 @@
 #include "cgame/cg_local.h"
 #include "client/assets.h"
+#include "client/audio/api.h"
 #include "client/renderer/renderer.h"
 
 static WeaponModelMetadata weapon_model_metadata[ Weapon_Count ];
@@ -70,6 +71,20 @@ void InitWeaponModels() {
 	for( u8 i = u8( Gadget_None ) + 1; i < Gadget_Count; i++ ) {
 		gadget_model_metadata[ i ] = BuildGadgetModelMetadata( GadgetType( i ) );
 	}
+
+	// don't hitch on the first shot
+	StringHash prefetch[ Weapon_Count * 3 + Gadget_Count * 2 ];
+	size_t num_prefetch = 0;
+	for( WeaponType i = WeaponType( Weapon_None + 1 ); i < Weapon_Count; i++ ) {
+		prefetch[ num_prefetch++ ] = weapon_model_metadata[ i ].fire_sound;
+		prefetch[ num_prefetch++ ] = weapon_model_metadata[ i ].reload_sound;
+		prefetch[ num_prefetch++ ] = weapon_model_metadata[ i ].switch_in_sound;
+	}
+	for( u8 i = u8( Gadget_None ) + 1; i < Gadget_Count; i++ ) {
+		prefetch[ num_prefetch++ ] = gadget_model_metadata[ i ].use_sound;
+		prefetch[ num_prefetch++ ] = gadget_model_metadata[ i ].switch_in_sound;
+	}
+	PrefetchSFX( Span< const StringHash >( prefetch, num_prefetch ) );
 }
 
 const WeaponModelMetadata * GetWeaponModelMetadata( WeaponType weapon ) {
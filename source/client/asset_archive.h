@@ -0,0 +1,36 @@
+#pragma once
+
+#include "qcommon/types.h"
+
+/*
+ * packed assets, written by the packassets tool
+ *
+ * layout is AssetArchiveHeader, AssetArchiveEntry[ num_entries ] sorted by
+ * hash, then the paths blob, then the file contents each aligned to
+ * ASSET_ARCHIVE_ALIGNMENT so they can be handed out straight from a mapping
+ */
+
+struct AssetArchiveHeader {
+	char magic[ 8 ];
+	u64 format_version;
+	u32 num_entries;
+	u32 paths_size;
+};
+
+enum AssetArchiveEntryFlags : u32 {
+	AssetArchiveEntryFlag_Compressed = 1 << 0, // contents are a zstd frame
+};
+
+struct AssetArchiveEntry {
+	u64 hash; // Hash64 of the path without .zst
+	u64 offset;
+	u64 size;
+	u32 path_offset;
+	u32 path_length;
+	AssetArchiveEntryFlags flags;
+	u32 padding;
+};
+
+constexpr const char ASSET_ARCHIVE_MAGIC[ sizeof( AssetArchiveHeader::magic ) ] = "cdpak";
+constexpr u64 ASSET_ARCHIVE_FORMAT_VERSION = 2;
+constexpr size_t ASSET_ARCHIVE_ALIGNMENT = 4096;
@@ -3,49 +3,52 @@
 
 #include "qcommon/qcommon.h"
 #include "qcommon/base.h"
+#include "qcommon/array.h"
 #include "qcommon/compression.h"
+#include "qcommon/dynamic_hashtable.h"
 #include "qcommon/fs.h"
 #include "qcommon/hash.h"
-#include "qcommon/hashtable.h"
 #include "qcommon/string.h"
+#include "qcommon/threadpool.h"
 #include "qcommon/threads.h"
 #include "client/assets.h"
-#include "client/threadpool.h"
+#include "client/asset_archive.h"
 
 #include "nanosort/nanosort.hpp"
 
+enum AssetMemory : u8 {
+	AssetMemory_SysAllocator,
+	AssetMemory_VirtualAlloc,
+	AssetMemory_Archive, // points into asset_archive, don't free it
+};
+
 struct Asset {
 	Span< char > path;
 	Span< u8 > data;
 	bool compressed;
-	bool virtual_free;
+	AssetMemory memory;
 };
 
-static constexpr u32 MAX_ASSETS = 4096;
-
 static Mutex * assets_mutex;
 
-static Asset assets[ MAX_ASSETS ];
-static Span< const char > asset_paths[ MAX_ASSETS ];
-static u32 num_assets;
+static NonRAIIDynamicArray< Asset > assets;
+static NonRAIIDynamicArray< Span< const char > > asset_paths;
 
 static FSChangeMonitor * fs_change_monitor;
 
-static Span< const char > modified_asset_paths[ MAX_ASSETS ];
-static u32 num_modified_assets;
+static NonRAIIDynamicArray< Span< const char > > modified_asset_paths;
 
-static Hashtable< MAX_ASSETS * 2 > assets_hashtable;
+static NonRAIIDynamicHashtable assets_hashtable;
+
+static u32 read_queue_depth;
+
+static Span< const u8 > asset_archive;
 
 enum IsCompressedBool : bool {
 	IsCompressed_No = false,
 	IsCompressed_Yes = true,
 };
 
-enum UseVirtualFree : bool {
-	UseVirtualFree_No = false,
-	UseVirtualFree_Yes = true,
-};
-
 #if PLATFORM_WINDOWS
 
 #include "qcommon/platform/windows_mini_windows_h.h"
@@ -59,28 +62,33 @@ static void CheckedVirtualFree( void * ptr ) {
 
 #endif
 
-static void FreeAssetData( Asset * asset ) {
+static void FreeAssetMemory( Span< u8 > data, AssetMemory memory ) {
+	switch( memory ) {
+		case AssetMemory_SysAllocator:
+			Free( sys_allocator, data.ptr );
+			break;
+
+		case AssetMemory_VirtualAlloc:
 #if PLATFORM_WINDOWS
-	if( asset->virtual_free ) {
-		CheckedVirtualFree( asset->data.ptr );
-		return;
-	}
+			CheckedVirtualFree( data.ptr );
 #endif
+			break;
+
+		case AssetMemory_Archive:
+			break;
+	}
+}
 
-	Free( sys_allocator, asset->data.ptr );
+static void FreeAssetData( Asset * asset ) {
+	FreeAssetMemory( asset->data, asset->memory );
 }
 
-static void AddAsset( Span< const char > path, u64 hash, Span< u8 > data, IsCompressedBool compressed, UseVirtualFree virtual_free ) {
+static void AddAsset( Span< const char > path, u64 hash, Span< u8 > data, IsCompressedBool compressed, AssetMemory memory ) {
 	TracyZoneScoped;
 
 	Lock( assets_mutex );
 	defer { Unlock( assets_mutex ); };
 
-	if( num_assets == MAX_ASSETS ) {
-		Com_Printf( S_COLOR_YELLOW "Too many assets\n" );
-		return;
-	}
-
 	u64 idx;
 	bool exists = assets_hashtable.get( hash, &idx );
 
@@ -90,21 +98,19 @@ static void AddAsset( Span< const char > path, u64 hash, Span< u8 > data, IsComp
 		FreeAssetData( a );
 	}
 	else {
-		a = &assets[ num_assets ];
+		a = assets.add();
 		a->path = CloneSpan( sys_allocator, path );
-		asset_paths[ num_assets ] = a->path;
+		asset_paths.add( a->path );
 	}
 
 	a->data = data;
 	a->compressed = compressed;
-	a->virtual_free = virtual_free;
+	a->memory = memory;
 
-	modified_asset_paths[ num_modified_assets ] = a->path;
-	num_modified_assets++;
+	modified_asset_paths.add( a->path );
 
 	if( !exists ) {
-		assets_hashtable.add( hash, num_assets );
-		num_assets++;
+		assets_hashtable.add( hash, assets.size() - 1 );
 	}
 }
 
@@ -112,7 +118,7 @@ struct DecompressAssetJob {
 	Span< char > path;
 	u64 hash;
 	Span< u8 > compressed;
-	bool virtual_free;
+	AssetMemory memory;
 };
 
 static void DecompressAsset( TempAllocator * temp, void * data ) {
@@ -125,75 +131,73 @@ static void DecompressAsset( TempAllocator * temp, void * data ) {
 	Span< char > path_with_zst = temp->sv( "{}.zst", job->path );
 	Span< u8 > decompressed;
 	if( Decompress( path_with_zst, sys_allocator, job->compressed, &decompressed ) ) {
-		AddAsset( job->path, job->hash, decompressed, IsCompressed_Yes, UseVirtualFree_No );
+		AddAsset( job->path, job->hash, decompressed, IsCompressed_Yes, AssetMemory_SysAllocator );
 	}
 
 	Free( sys_allocator, job->path.ptr );
-
-#if PLATFORM_WINDOWS
-	if( job->virtual_free ) {
-		CheckedVirtualFree( job->compressed.ptr );
-	}
-	else {
-		Free( sys_allocator, job->compressed.ptr );
-	}
-#else
-	Free( sys_allocator, job->compressed.ptr );
-#endif
+	FreeAssetMemory( job->compressed, job->memory );
 
 	Free( sys_allocator, job );
 }
 
-static void LaunchDecompressAssetJob( Span< const char > path, u64 hash, Span< u8 > compressed, UseVirtualFree virtual_free ) {
+static void LaunchDecompressAssetJob( Span< const char > path, u64 hash, Span< u8 > compressed, AssetMemory memory ) {
 	DecompressAssetJob * job = Alloc< DecompressAssetJob >( sys_allocator );
 	job->path = CloneSpan( sys_allocator, path );
 	job->hash = hash;
 	job->compressed = compressed;
-	job->virtual_free = virtual_free;
+	job->memory = memory;
 	ThreadPoolDo( DecompressAsset, job );
 }
 
-static void LoadAsset( TempAllocator * temp, Span< const char > game_path, const char * full_path ) {
+static void AddLoadedAsset( Span< const char > game_path, Span< u8 > contents, AssetMemory memory ) {
+	Span< const char > ext = FileExtension( game_path );
+	if( ext == ".zst" ) {
+		game_path.n -= ext.n;
+		LaunchDecompressAssetJob( game_path, Hash64( game_path ), contents, memory );
+	}
+	else {
+		AddAsset( game_path, Hash64( game_path ), contents, IsCompressed_No, memory );
+	}
+}
+
+// drop foo.zst when we already have an uncompressed foo loaded, which only
+// happens when hotloading
+static Span< const char * > SkipShadowedAssets( TempAllocator * temp, Span< const char * > files, size_t skip ) {
 	TracyZoneScoped;
-	TracyZoneSpan( game_path );
 
-	Span< const char > ext = FileExtension( game_path );
-	bool compressed = ext == ".zst";
+	Lock( assets_mutex );
+	defer { Unlock( assets_mutex ); };
 
-	Span< const char > game_path_no_zst = game_path;
-	if( compressed ) {
-		game_path_no_zst.n -= ext.n;
-	}
+	Span< const char * > filtered = AllocSpan< const char * >( temp, files.n );
+	size_t n = 0;
 
-	u64 hash = Hash64( game_path_no_zst );
+	for( const char * file : files ) {
+		Span< const char > game_path = MakeSpan( file + skip );
+		Span< const char > ext = FileExtension( game_path );
+		bool compressed = ext == ".zst";
 
-	{
-		Lock( assets_mutex );
-		defer { Unlock( assets_mutex ); };
+		Span< const char > game_path_no_zst = game_path;
+		if( compressed ) {
+			game_path_no_zst.n -= ext.n;
+		}
 
 		u64 idx;
-		bool exists = assets_hashtable.get( hash, &idx );
+		bool exists = assets_hashtable.get( Hash64( game_path_no_zst ), &idx );
 		if( exists ) {
 			if( !StrEqual( game_path_no_zst, asset_paths[ idx ] ) ) {
 				Fatal( "%s", ( *temp )( "Asset hash name collision: {} and {}", game_path, assets[ idx ].path ) );
 			}
 
 			if( compressed && !assets[ idx ].compressed ) {
-				return;
+				continue;
 			}
 		}
-	}
-
-	Span< u8 > contents = ReadFileBinary( sys_allocator, full_path );
-	if( contents.ptr == NULL )
-		return;
 
-	if( compressed ) {
-		LaunchDecompressAssetJob( game_path_no_zst, hash, contents, UseVirtualFree_No );
-	}
-	else {
-		AddAsset( game_path, hash, contents, IsCompressed_No, UseVirtualFree_No );
+		filtered[ n ] = file;
+		n++;
 	}
+
+	return filtered.slice( 0, n );
 }
 
 #if PLATFORM_WINDOWS
@@ -217,9 +221,11 @@ static size_t FileSize( HANDLE file ) {
 	return size.QuadPart;
 }
 
-void LoadAssets( TempAllocator * temp, Span< const char * > files, size_t skip ) {
+static void LoadAssets( TempAllocator * temp, Span< const char * > files, size_t skip ) {
 	TracyZoneScoped;
 
+	files = SkipShadowedAssets( temp, files, skip );
+
 	DynamicArray< LoadAssetResult > results( temp );
 
 	Span< HandleAndPath > handles_and_paths = AllocSpan< HandleAndPath >( temp, files.n );
@@ -256,11 +262,8 @@ void LoadAssets( TempAllocator * temp, Span< const char * > files, size_t skip )
 	{
 		TracyZoneScopedN( "Async I/O" );
 
-		// keep 32 async reads in flight at a time. chosen semi-arbitrarily by
-		// seeing where perf pleateaus on my computer, which is around 60% of
-		// my SSD's paper bandwidth
-		constexpr size_t overlap = 32;
-		OVERLAPPED overlapped[ overlap ];
+		const size_t overlap = read_queue_depth;
+		Span< OVERLAPPED > overlapped = AllocSpan< OVERLAPPED >( temp, overlap );
 
 		for( size_t i = 0; i < files.n + overlap - 1; i++ ) {
 			if( i < files.n && handles_and_paths[ i ].handle != INVALID_HANDLE_VALUE ) {
@@ -281,15 +284,7 @@ void LoadAssets( TempAllocator * temp, Span< const char * > files, size_t skip )
 						buffers[ prev ] = Span< u8 >();
 					}
 
-					Span< const char > game_path = MakeSpan( files[ prev ] + skip );
-					Span< const char > ext = FileExtension( game_path );
-					if( ext == ".zst" ) {
-						game_path.n -= ext.n;
-						LaunchDecompressAssetJob( game_path, Hash64( game_path ), buffers[ prev ], UseVirtualFree_Yes );
-					}
-					else {
-						AddAsset( game_path, Hash64( game_path ), buffers[ prev ], IsCompressed_No, UseVirtualFree_Yes );
-					}
+					AddLoadedAsset( MakeSpan( files[ prev ] + skip ), buffers[ prev ], AssetMemory_VirtualAlloc );
 				}
 			}
 		}
@@ -306,13 +301,316 @@ void LoadAssets( TempAllocator * temp, Span< const char * > files, size_t skip )
 
 #else
 
-void LoadAssets( TempAllocator * temp, Span< const char * > files, size_t skip ) {
+#include <atomic>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/*
+ * blocking reads on a handful of dedicated threads. we can't use the thread
+ * pool here because InitAssets itself runs as a thread pool job
+ */
+
+struct BlockingAssetLoader {
+	Span< const char * > files;
+	size_t skip;
+	std::atomic< size_t > next;
+};
+
+static void BlockingAssetLoaderThread( void * data ) {
+	TracyCSetThreadName( "Asset loader" );
+
+	BlockingAssetLoader * loader = ( BlockingAssetLoader * ) data;
+
+	while( true ) {
+		size_t i = loader->next.fetch_add( 1 );
+		if( i >= loader->files.n )
+			break;
+
+		Span< u8 > contents = ReadFileBinary( sys_allocator, loader->files[ i ] );
+		if( contents.ptr == NULL )
+			continue;
+
+		AddLoadedAsset( MakeSpan( loader->files[ i ] + loader->skip ), contents, AssetMemory_SysAllocator );
+	}
+}
+
+static void LoadAssetsBlocking( TempAllocator * temp, Span< const char * > files, size_t skip ) {
 	TracyZoneScoped;
-	for( const char * file : files ) {
-		LoadAsset( temp, MakeSpan( file + skip ), file );
+
+	BlockingAssetLoader loader;
+	loader.files = files;
+	loader.skip = skip;
+	loader.next = 0;
+
+	size_t num_threads = Min2( size_t( read_queue_depth ), files.n );
+	if( num_threads <= 1 ) {
+		BlockingAssetLoaderThread( &loader );
+		return;
+	}
+
+	Span< Thread * > threads = AllocSpan< Thread * >( temp, num_threads );
+	for( Thread *& thread : threads ) {
+		thread = NewThread( BlockingAssetLoaderThread, &loader );
+	}
+
+	for( Thread * thread : threads ) {
+		JoinThread( thread );
 	}
 }
 
+#if PLATFORM_LINUX
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+/*
+ * io_uring through raw syscalls because we don't want to depend on liburing
+ */
+
+struct IOURing {
+	int fd;
+
+	void * sq_ring;
+	size_t sq_ring_size;
+	void * cq_ring;
+	size_t cq_ring_size;
+
+	u32 * sq_head;
+	u32 * sq_tail;
+	u32 sq_mask;
+	u32 * sq_array;
+	io_uring_sqe * sqes;
+	size_t sqes_size;
+
+	u32 * cq_head;
+	u32 * cq_tail;
+	u32 cq_mask;
+	io_uring_cqe * cqes;
+};
+
+static bool NewIOURing( IOURing * ring, u32 entries ) {
+	io_uring_params params = { };
+	int fd = syscall( __NR_io_uring_setup, entries, &params );
+	if( fd == -1 ) {
+		// ENOSYS on old kernels, EPERM in sandboxes that block io_uring, etc
+		return false;
+	}
+
+	*ring = { };
+	ring->fd = fd;
+
+	ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof( u32 );
+	ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof( io_uring_cqe );
+	bool single_mmap = ( params.features & IORING_FEAT_SINGLE_MMAP ) != 0;
+	if( single_mmap ) {
+		ring->sq_ring_size = Max2( ring->sq_ring_size, ring->cq_ring_size );
+		ring->cq_ring_size = ring->sq_ring_size;
+	}
+
+	ring->sq_ring = mmap( NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING );
+	if( ring->sq_ring == MAP_FAILED ) {
+		FatalErrno( "mmap" );
+	}
+
+	ring->cq_ring = ring->sq_ring;
+	if( !single_mmap ) {
+		ring->cq_ring = mmap( NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING );
+		if( ring->cq_ring == MAP_FAILED ) {
+			FatalErrno( "mmap" );
+		}
+	}
+
+	ring->sqes_size = params.sq_entries * sizeof( io_uring_sqe );
+	ring->sqes = ( io_uring_sqe * ) mmap( NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES );
+	if( ring->sqes == MAP_FAILED ) {
+		FatalErrno( "mmap" );
+	}
+
+	u8 * sq = ( u8 * ) ring->sq_ring;
+	ring->sq_head = ( u32 * ) ( sq + params.sq_off.head );
+	ring->sq_tail = ( u32 * ) ( sq + params.sq_off.tail );
+	ring->sq_mask = *( u32 * ) ( sq + params.sq_off.ring_mask );
+	ring->sq_array = ( u32 * ) ( sq + params.sq_off.array );
+
+	u8 * cq = ( u8 * ) ring->cq_ring;
+	ring->cq_head = ( u32 * ) ( cq + params.cq_off.head );
+	ring->cq_tail = ( u32 * ) ( cq + params.cq_off.tail );
+	ring->cq_mask = *( u32 * ) ( cq + params.cq_off.ring_mask );
+	ring->cqes = ( io_uring_cqe * ) ( cq + params.cq_off.cqes );
+
+	return true;
+}
+
+static void DeleteIOURing( IOURing * ring ) {
+	munmap( ring->sqes, ring->sqes_size );
+	if( ring->cq_ring != ring->sq_ring ) {
+		munmap( ring->cq_ring, ring->cq_ring_size );
+	}
+	munmap( ring->sq_ring, ring->sq_ring_size );
+	close( ring->fd );
+}
+
+struct IOURingAssetRead {
+	int fd;
+	size_t file_idx;
+	Span< u8 > contents;
+	size_t bytes_read;
+	iovec iov;
+};
+
+// reads can come back short, so this also requeues whatever is left
+static void QueueIOURingRead( IOURing * ring, IOURingAssetRead * read, u32 read_idx ) {
+	read->iov.iov_base = read->contents.ptr + read->bytes_read;
+	read->iov.iov_len = read->contents.n - read->bytes_read;
+
+	// we are the only producer so a relaxed load of our own tail is fine
+	u32 tail = *ring->sq_tail;
+	u32 sqe_idx = tail & ring->sq_mask;
+
+	io_uring_sqe * sqe = &ring->sqes[ sqe_idx ];
+	*sqe = { };
+	sqe->opcode = IORING_OP_READV;
+	sqe->fd = read->fd;
+	sqe->addr = u64( uintptr_t( &read->iov ) );
+	sqe->len = 1;
+	sqe->off = read->bytes_read;
+	sqe->user_data = read_idx;
+
+	ring->sq_array[ sqe_idx ] = sqe_idx;
+	__atomic_store_n( ring->sq_tail, tail + 1, __ATOMIC_RELEASE );
+}
+
+static bool LoadAssetsIOURing( TempAllocator * temp, Span< const char * > files, size_t skip ) {
+	TracyZoneScoped;
+
+	IOURing ring;
+	if( !NewIOURing( &ring, read_queue_depth ) )
+		return false;
+	defer { DeleteIOURing( &ring ); };
+
+	Span< IOURingAssetRead > reads = AllocSpan< IOURingAssetRead >( temp, read_queue_depth );
+	Span< u32 > free_reads = AllocSpan< u32 >( temp, read_queue_depth );
+	for( u32 i = 0; i < read_queue_depth; i++ ) {
+		free_reads[ i ] = read_queue_depth - i - 1;
+	}
+	u32 num_free_reads = read_queue_depth;
+
+	size_t next_file = 0;
+	u32 unsubmitted = 0;
+
+	while( next_file < files.n || num_free_reads < read_queue_depth ) {
+		{
+			TracyZoneScopedN( "Queue reads" );
+
+			while( next_file < files.n && num_free_reads > 0 ) {
+				size_t file_idx = next_file;
+				next_file++;
+
+				int fd = open( files[ file_idx ], O_RDONLY | O_CLOEXEC );
+				if( fd == -1 )
+					continue;
+
+				struct stat st;
+				if( fstat( fd, &st ) != 0 ) {
+					close( fd );
+					continue;
+				}
+
+				num_free_reads--;
+				u32 read_idx = free_reads[ num_free_reads ];
+				IOURingAssetRead * read = &reads[ read_idx ];
+				read->fd = fd;
+				read->file_idx = file_idx;
+				read->contents = Span< u8 >( ( u8 * ) sys_allocator->allocate( st.st_size, 16 ), st.st_size );
+				read->bytes_read = 0;
+
+				QueueIOURingRead( &ring, read, read_idx );
+				unsubmitted++;
+			}
+		}
+
+		// everything left failed to open
+		if( num_free_reads == read_queue_depth )
+			break;
+
+		{
+			TracyZoneScopedN( "io_uring_enter" );
+
+			int submitted = syscall( __NR_io_uring_enter, ring.fd, unsubmitted, 1, IORING_ENTER_GETEVENTS, NULL, 0 );
+			if( submitted == -1 ) {
+				if( errno != EINTR ) {
+					FatalErrno( "io_uring_enter" );
+				}
+			}
+			else {
+				unsubmitted -= submitted;
+			}
+		}
+
+		u32 head = *ring.cq_head;
+		u32 tail = __atomic_load_n( ring.cq_tail, __ATOMIC_ACQUIRE );
+		while( head != tail ) {
+			const io_uring_cqe * cqe = &ring.cqes[ head & ring.cq_mask ];
+			head++;
+
+			u32 read_idx = checked_cast< u32 >( cqe->user_data );
+			IOURingAssetRead * read = &reads[ read_idx ];
+			const char * path = files[ read->file_idx ];
+
+			if( cqe->res > 0 ) {
+				read->bytes_read += cqe->res;
+				if( read->bytes_read < read->contents.n ) {
+					QueueIOURingRead( &ring, read, read_idx );
+					unsubmitted++;
+					continue;
+				}
+			}
+
+			close( read->fd );
+
+			if( read->bytes_read == read->contents.n ) {
+				AddLoadedAsset( MakeSpan( path + skip ), read->contents, AssetMemory_SysAllocator );
+			}
+			else {
+				if( cqe->res < 0 ) {
+					Com_Printf( S_COLOR_YELLOW "Can't read %s: %s\n", path, strerror( -cqe->res ) );
+				}
+				else {
+					// the file got shorter while we were reading it
+					Com_Printf( S_COLOR_YELLOW "Can't read %s: file was truncated\n", path );
+				}
+				Free( sys_allocator, read->contents.ptr );
+			}
+
+			free_reads[ num_free_reads ] = read_idx;
+			num_free_reads++;
+		}
+		__atomic_store_n( ring.cq_head, head, __ATOMIC_RELEASE );
+	}
+
+	return true;
+}
+
+#endif
+
+static void LoadAssets( TempAllocator * temp, Span< const char * > files, size_t skip ) {
+	TracyZoneScoped;
+
+	files = SkipShadowedAssets( temp, files, skip );
+
+#if PLATFORM_LINUX
+	if( LoadAssetsIOURing( temp, files, skip ) )
+		return;
+#endif
+
+	LoadAssetsBlocking( temp, files, skip );
+}
+
 #endif
 
 static void BuildAssetList( TempAllocator * temp, DynamicArray< const char * > * files, DynamicString * search_path ) {
@@ -337,14 +635,115 @@ static void BuildAssetList( TempAllocator * temp, DynamicArray< const char * > *
 	}
 }
 
-void InitAssets( TempAllocator * temp ) {
+static bool ParseAssetArchive( Span< const u8 > archive, Span< const AssetArchiveEntry > * entries, Span< const char > * paths ) {
+	if( archive.n < sizeof( AssetArchiveHeader ) )
+		return false;
+
+	const AssetArchiveHeader * header = ( const AssetArchiveHeader * ) archive.ptr;
+	if( memcmp( header->magic, ASSET_ARCHIVE_MAGIC, sizeof( header->magic ) ) != 0 || header->format_version != ASSET_ARCHIVE_FORMAT_VERSION )
+		return false;
+
+	size_t entries_size = size_t( header->num_entries ) * sizeof( AssetArchiveEntry );
+	if( archive.n - sizeof( AssetArchiveHeader ) < entries_size + header->paths_size )
+		return false;
+
+	*entries = Span< const AssetArchiveEntry >( ( const AssetArchiveEntry * ) ( header + 1 ), header->num_entries );
+	*paths = Span< const char >( ( const char * ) ( entries->end() ), header->paths_size );
+
+	for( size_t i = 0; i < entries->n; i++ ) {
+		const AssetArchiveEntry & entry = ( *entries )[ i ];
+		if( entry.offset > archive.n || entry.size > archive.n - entry.offset )
+			return false;
+		if( entry.path_offset > paths->n || entry.path_length > paths->n - entry.path_offset )
+			return false;
+		// strictly increasing so we can binary search and know there are no collisions
+		if( i > 0 && entry.hash <= ( *entries )[ i - 1 ].hash )
+			return false;
+	}
+
+	return true;
+}
+
+static Optional< size_t > FindArchiveEntry( Span< const AssetArchiveEntry > entries, u64 hash ) {
+	size_t lo = 0;
+	size_t hi = entries.n;
+	while( lo < hi ) {
+		size_t mid = lo + ( hi - lo ) / 2;
+		if( entries[ mid ].hash < hash ) {
+			lo = mid + 1;
+		}
+		else {
+			hi = mid;
+		}
+	}
+
+	if( lo == entries.n || entries[ lo ].hash != hash )
+		return NONE;
+	return lo;
+}
+
+// loose files take priority over the archive so you can still iterate on a packed install
+static void LoadAssetArchive( TempAllocator * temp, const char * path, Span< const char * > loose_files, size_t skip ) {
+	TracyZoneScoped;
+
+	asset_archive = MemoryMapFile( sys_allocator, path );
+	if( asset_archive.ptr == NULL )
+		return;
+
+	Span< const AssetArchiveEntry > entries;
+	Span< const char > paths;
+	if( !ParseAssetArchive( asset_archive, &entries, &paths ) ) {
+		Com_Printf( S_COLOR_YELLOW "%s is corrupt, ignoring it\n", path );
+		UnmapFile( asset_archive );
+		asset_archive = Span< const u8 >();
+		return;
+	}
+
+	Span< bool > overridden = AllocSpan< bool >( temp, entries.n );
+	memset( overridden.ptr, 0, overridden.num_bytes() );
+
+	for( const char * file : loose_files ) {
+		Span< const char > game_path = MakeSpan( file + skip );
+		if( FileExtension( game_path ) == ".zst" ) {
+			game_path = StripExtension( game_path );
+		}
+
+		Optional< size_t > idx = FindArchiveEntry( entries, Hash64( game_path ) );
+		if( idx.exists ) {
+			overridden[ idx.value ] = true;
+		}
+	}
+
+	for( size_t i = 0; i < entries.n; i++ ) {
+		if( overridden[ i ] )
+			continue;
+
+		const AssetArchiveEntry & entry = entries[ i ];
+		Span< const char > entry_path = paths.slice( entry.path_offset, entry.path_offset + entry.path_length );
+
+		// the mapping is read-only but we only ever hand out const spans
+		Span< u8 > data = Span< u8 >( const_cast< u8 * >( asset_archive.ptr ) + entry.offset, entry.size );
+
+		if( HasAllBits( entry.flags, AssetArchiveEntryFlag_Compressed ) ) {
+			LaunchDecompressAssetJob( entry_path, entry.hash, data, AssetMemory_Archive );
+		}
+		else {
+			AddAsset( entry_path, entry.hash, data, IsCompressed_No, AssetMemory_Archive );
+		}
+	}
+}
+
+void InitAssets( TempAllocator * temp, u32 queue_depth ) {
 	TracyZoneScoped;
 
 	assets_mutex = NewMutex();
 
-	num_assets = 0;
-	num_modified_assets = 0;
-	assets_hashtable.clear();
+	read_queue_depth = Clamp( 1u, queue_depth, 4096u );
+
+	assets.init( sys_allocator );
+	asset_paths.init( sys_allocator );
+	modified_asset_paths.init( sys_allocator );
+	assets_hashtable.init( sys_allocator );
 
 	DynamicString base( temp, "{}/base", RootDirPath() );
 	size_t skip = base.length() + 1;
@@ -368,9 +767,13 @@ void InitAssets( TempAllocator * temp ) {
 		}
 	}
 
+	LoadAssetArchive( temp, ( *temp )( "{}/base.cdpak", RootDirPath() ), deduped.span(), skip );
 	LoadAssets( temp, deduped.span(), skip );
 
-	num_modified_assets = 0;
+	// decompression jobs can still be adding assets
+	Lock( assets_mutex );
+	modified_asset_paths.clear();
+	Unlock( assets_mutex );
 }
 
 void HotloadAssets( TempAllocator * temp ) {
@@ -380,16 +783,21 @@ void HotloadAssets( TempAllocator * temp ) {
 	Span< const char * > changes = PollFSChangeMonitor( temp, fs_change_monitor, buf, ARRAY_COUNT( buf ) );
 	nanosort( changes.begin(), changes.end(), SortCStringsComparator );
 
+	DynamicArray< const char * > files( temp );
 	for( size_t i = 0; i < changes.n; i++ ) {
 		if( i > 0 && StrEqual( changes[ i ], changes[ i - 1 ] ) )
 			continue;
-		const char * full_path = ( *temp )( "{}/base/{}", RootDirPath(), changes[ i ] );
-		LoadAsset( temp, MakeSpan( changes[ i ] ), full_path );
+		files.add( ( *temp )( "{}/base/{}", RootDirPath(), changes[ i ] ) );
 	}
 
+	if( files.size() == 0 )
+		return;
+
+	LoadAssets( temp, files.span(), RootDirPath().n + strlen( "/base/" ) );
+
 	ThreadPoolFinish();
 
-	if( num_modified_assets > 0 ) {
+	if( modified_asset_paths.size() > 0 ) {
 		Com_Printf( "Hotloading:\n" );
 		for( Span< const char > path : ModifiedAssetPaths() ) {
 			Com_GGPrint( "    {}", path );
@@ -398,15 +806,24 @@ void HotloadAssets( TempAllocator * temp ) {
 }
 
 void DoneHotloadingAssets() {
-	num_modified_assets = 0;
+	modified_asset_paths.clear();
 }
 
 void ShutdownAssets() {
 	TracyZoneScoped;
 
-	for( u32 i = 0; i < num_assets; i++ ) {
-		Free( sys_allocator, assets[ i ].path.ptr );
-		FreeAssetData( &assets[ i ] );
+	for( Asset & asset : assets ) {
+		Free( sys_allocator, asset.path.ptr );
+		FreeAssetData( &asset );
+	}
+
+	assets.shutdown();
+	asset_paths.shutdown();
+	modified_asset_paths.shutdown();
+	assets_hashtable.shutdown();
+
+	if( asset_archive.ptr != NULL ) {
+		UnmapFile( asset_archive );
 	}
 
 	DeleteFSChangeMonitor( sys_allocator, fs_change_monitor );
@@ -434,9 +851,9 @@ Span< const u8 > AssetBinary( Span< const char > path ) {
 }
 
 Span< Span< const char > > AssetPaths() {
-	return Span< Span< const char > >( asset_paths, num_assets );
+	return asset_paths.span();
 }
 
 Span< Span< const char > > ModifiedAssetPaths() {
-	return Span< Span< const char > >( modified_asset_paths, num_modified_assets );
+	return modified_asset_paths.span();
 }
@@ -3,7 +3,7 @@
 #include "qcommon/types.h"
 #include "qcommon/hash.h"
 
-void InitAssets( TempAllocator * temp );
+void InitAssets( TempAllocator * temp, u32 queue_depth );
 void ShutdownAssets();
 
 void HotloadAssets( TempAllocator * temp );
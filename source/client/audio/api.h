@@ -10,6 +10,13 @@ enum SpatialisationMethod {
 	SpatialisationMethod_LineSegment, // play sound from closest point on a line segment
 };
 
+enum SoundPriority : u8 {
+	SoundPriority_Normal,
+	SoundPriority_High, // UI, announcer, our own sounds, etc
+
+	SoundPriority_Count
+};
+
 struct PlaySFXConfig {
 	SpatialisationMethod spatialisation;
 	union {
@@ -20,6 +27,7 @@ struct PlaySFXConfig {
 
 	float volume;
 	float pitch;
+	SoundPriority priority;
 
 	Optional< u64 > entropy;
 };
@@ -44,6 +52,9 @@ PlayingSFXHandle PlaySFX( StringHash name, const PlaySFXConfig & config = PlaySF
 PlayingSFXHandle PlayImmediateSFX( StringHash name, PlayingSFXHandle handle, const PlaySFXConfig & config );
 void StopSFX( PlayingSFXHandle handle );
 
+// decode every sound an effect might play now rather than on first use
+void PrefetchSFX( Span< const StringHash > names );
+
 void StopAllSounds( bool stopMusic );
 
 void StartMenuMusic();
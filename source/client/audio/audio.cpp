@@ -3,11 +3,11 @@
 #include "qcommon/fpe.h"
 #include "qcommon/hash.h"
 #include "qcommon/hashmap.h"
+#include "qcommon/threadpool.h"
 #include "qcommon/time.h"
 #include "client/audio/api.h"
 #include "client/audio/backend.h"
 #include "client/assets.h"
-#include "client/threadpool.h"
 #include "cgame/cg_local.h"
 #include "gameshared/gs_public.h"
 
@@ -23,9 +23,18 @@
 #include "stb/stb_vorbis.h"
 
 struct Sound {
+	Span< const char > path;
+	Span< const u8 > ogg;
+
+	// decoded on first use and evicted when the PCM cache is full
 	ALuint buf;
 	Span< s16 > samples;
 	bool mono;
+	bool decode_failed;
+	float duration; // seconds, kept after eviction
+
+	u32 num_playing;
+	u64 last_used;
 };
 
 struct SoundEffect {
@@ -53,9 +62,14 @@ struct PlayingSFX {
 	bool immediate;
 	bool keep_playing_immediate;
 
+	// voices only get a source when they're loud enough to make the cut,
+	// virtual voices just keep track of how far through the sound they are
 	ALuint sources[ ARRAY_COUNT( &SoundEffect::sounds ) ];
+	Sound * playing[ ARRAY_COUNT( &SoundEffect::sounds ) ];
+	float pitch[ ARRAY_COUNT( &SoundEffect::sounds ) ];
 	bool started[ ARRAY_COUNT( &SoundEffect::sounds ) ];
 	bool stopped[ ARRAY_COUNT( &SoundEffect::sounds ) ];
+	bool real[ ARRAY_COUNT( &SoundEffect::sounds ) ];
 };
 
 static ALCdevice * al_device;
@@ -68,10 +82,13 @@ Cvar * s_device;
 static Cvar * s_volume;
 static Cvar * s_musicvolume;
 static Cvar * s_muteinbackground;
+static Cvar * s_pcmcachesize;
 
 static constexpr u32 MAX_SOUND_ASSETS = 4096;
 static constexpr u32 MAX_SOUND_EFFECTS = 4096;
-static constexpr u32 MAX_PLAYING_SOUNDS = 256;
+static constexpr u32 MAX_PLAYING_SOUNDS = 1024;
+static constexpr u32 MAX_REAL_VOICES = 64;
+static constexpr float MIN_AUDIBLE_GAIN = 0.001f; // -60dB
 
 static u64 GetPlayingSFXKey( const PlayingSFX & sfx ) {
 	return sfx.handle.handle;
@@ -79,11 +96,21 @@ static u64 GetPlayingSFXKey( const PlayingSFX & sfx ) {
 
 static Hashmap< Sound, MAX_SOUND_ASSETS > sounds;
 static Hashmap< SoundEffect, MAX_SOUND_EFFECTS > sound_effects;
-static BoundedDynamicArray< ALuint, MAX_PLAYING_SOUNDS > free_sound_sources;
+static BoundedDynamicArray< ALuint, MAX_REAL_VOICES > free_sound_sources;
 static Hashmap< PlayingSFX, MAX_PLAYING_SOUNDS, GetPlayingSFXKey > playing_sounds;
 static u64 playing_sound_handle_autoinc;
 
+static size_t pcm_cache_bytes;
+static u64 pcm_cache_clock;
+
+// music is streamed rather than decoded up front, it's by far the longest
+// sound we have and doesn't need to be resident
+static constexpr size_t MUSIC_STREAM_BUFFERS = 4;
+static constexpr size_t MUSIC_STREAM_CHUNK_SAMPLES = 16384; // per channel, ~0.37s at 44.1kHz
+
 static ALuint music_source;
+static ALuint music_buffers[ MUSIC_STREAM_BUFFERS ];
+static stb_vorbis * music_decoder;
 static bool music_playing;
 
 constexpr float MusicIsWayTooLoud = 0.25f;
@@ -186,7 +213,7 @@ static void InitOpenAL() {
 		ALC_FORMAT_TYPE_SOFT, ALC_FLOAT_SOFT,
 		ALC_FREQUENCY, AUDIO_BACKEND_SAMPLE_RATE,
 		ALC_HRTF_SOFT, ALC_HRTF_ENABLED_SOFT,
-		ALC_MONO_SOURCES, MAX_PLAYING_SOUNDS,
+		ALC_MONO_SOURCES, MAX_REAL_VOICES,
 		ALC_STEREO_SOURCES, 16,
 		0
 	};
@@ -206,6 +233,7 @@ static void InitOpenAL() {
 		alGenSources( 1, free_sound_sources.add().value );
 	}
 	alGenSources( 1, &music_source );
+	alGenBuffers( ARRAY_COUNT( music_buffers ), music_buffers );
 
 	if( alGetError() != AL_NO_ERROR ) {
 		Fatal( "Failed to allocate sound sources" );
@@ -215,6 +243,7 @@ static void InitOpenAL() {
 static void ShutdownOpenAL() {
 	alDeleteSources( ARRAY_COUNT( free_sound_sources ), free_sound_sources.ptr() );
 	alDeleteSources( 1, &music_source );
+	alDeleteBuffers( ARRAY_COUNT( music_buffers ), music_buffers );
 
 	CheckALErrors( "ShutdownSound" );
 
@@ -222,29 +251,100 @@ static void ShutdownOpenAL() {
 	alcCloseDevice( al_device );
 }
 
-struct DecodeSoundJob {
-	struct {
-		Span< const char > path;
-		Span< const u8 > ogg;
-	} in;
-
-	struct {
-		int channels;
-		int sample_rate;
-		int num_samples;
-		s16 * samples;
-	} out;
+struct DecodedSound {
+	int num_samples;
+	int channels;
+	int sample_rate;
+	s16 * samples;
 };
 
-static void AddSound( Span< const char > path, int num_samples, int channels, int sample_rate, s16 * samples ) {
-	TracyZoneScoped;
+static DecodedSound DecodeSound( Span< const char > path, Span< const u8 > ogg ) {
+	TracyZoneScopedN( "stb_vorbis_decode_memory" );
 	TracyZoneSpan( path );
 
-	if( num_samples == -1 ) {
-		Com_GGPrint( S_COLOR_RED "Couldn't decode sound {}", path );
+	DisableFPEScoped;
+
+	DecodedSound decoded;
+	decoded.num_samples = stb_vorbis_decode_memory( ogg.ptr, ogg.num_bytes(), &decoded.channels, &decoded.sample_rate, &decoded.samples );
+	return decoded;
+}
+
+static void EvictSound( Sound * sound ) {
+	Assert( sound->num_playing == 0 );
+
+	alDeleteBuffers( 1, &sound->buf );
+	CheckALErrors( "EvictSound" );
+
+	pcm_cache_bytes -= sound->samples.num_bytes();
+	free( sound->samples.ptr );
+
+	sound->buf = 0;
+	sound->samples = Span< s16 >();
+}
+
+static void TrimPCMCache( size_t incoming_bytes ) {
+	TracyZoneScoped;
+
+	size_t budget = size_t( Max2( s_pcmcachesize->integer, 0 ) ) * 1024 * 1024;
+
+	while( pcm_cache_bytes + incoming_bytes > budget ) {
+		Sound * lru = NULL;
+		for( size_t i = 0; i < sounds.size(); i++ ) {
+			Sound * sound = &sounds[ i ];
+			if( sound->buf == 0 || sound->num_playing > 0 )
+				continue;
+			if( lru == NULL || sound->last_used < lru->last_used ) {
+				lru = sound;
+			}
+		}
+
+		// everything resident is playing, let it go over budget
+		if( lru == NULL )
+			break;
+
+		EvictSound( lru );
+	}
+}
+
+static void UploadSound( Sound * sound, const DecodedSound & decoded ) {
+	TracyZoneScoped;
+	TracyZoneSpan( sound->path );
+
+	if( decoded.num_samples == -1 ) {
+		Com_GGPrint( S_COLOR_RED "Couldn't decode sound {}", sound->path );
+		sound->decode_failed = true;
 		return;
 	}
 
+	size_t num_bytes = size_t( decoded.num_samples ) * decoded.channels * sizeof( s16 );
+	TrimPCMCache( num_bytes );
+
+	ALenum format = decoded.channels == 1 ? AL_FORMAT_MONO16 : AL_FORMAT_STEREO16;
+	alGenBuffers( 1, &sound->buf );
+	sound->samples = Span< s16 >( decoded.samples, size_t( decoded.num_samples ) * decoded.channels );
+	sound->mono = decoded.channels == 1;
+	sound->duration = decoded.num_samples / float( decoded.sample_rate );
+
+	alBufferDataStatic( sound->buf, format, decoded.samples, num_bytes, decoded.sample_rate );
+	CheckALErrors( "UploadSound" );
+
+	pcm_cache_bytes += num_bytes;
+}
+
+static bool DecodeSoundIfNeeded( Sound * sound ) {
+	sound->last_used = ++pcm_cache_clock;
+
+	if( sound->buf == 0 && !sound->decode_failed ) {
+		UploadSound( sound, DecodeSound( sound->path, sound->ogg ) );
+	}
+
+	return sound->buf != 0;
+}
+
+static void AddSound( Span< const char > path ) {
+	TracyZoneScoped;
+	TracyZoneSpan( path );
+
 	u64 hash = Hash64( StripExtension( path ) );
 
 	bool restart_music = false;
@@ -261,6 +361,7 @@ static void AddSound( Span< const char > path, int num_samples, int channels, in
 		}
 
 		sound = sounds.add( hash );
+		*sound = { };
 
 		// add simple sound effect
 		sound_effects.add( hash, SoundEffect {
@@ -277,16 +378,14 @@ static void AddSound( Span< const char > path, int num_samples, int channels, in
 	else {
 		restart_music = music_playing;
 		StopAllSounds( true );
-		alDeleteBuffers( 1, &sound->buf );
+		if( sound->buf != 0 ) {
+			EvictSound( sound );
+		}
 	}
 
-	ALenum format = channels == 1 ? AL_FORMAT_MONO16 : AL_FORMAT_STEREO16;
-	alGenBuffers( 1, &sound->buf );
-	sound->samples = Span< s16 >( samples, num_samples );
-	sound->mono = channels == 1;
-
-	alBufferDataStatic( sound->buf, format, samples, num_samples * channels * sizeof( s16 ), sample_rate );
-	CheckALErrors( "AddSound" );
+	sound->path = path;
+	sound->ogg = AssetBinary( path );
+	sound->decode_failed = false;
 
 	if( restart_music ) {
 		StartMenuMusic();
@@ -296,37 +395,10 @@ static void AddSound( Span< const char > path, int num_samples, int channels, in
 static void LoadSounds() {
 	TracyZoneScoped;
 
-	DynamicArray< DecodeSoundJob > jobs( sys_allocator );
-	{
-		TracyZoneScopedN( "Build job list" );
-
-		for( Span< const char > path : AssetPaths() ) {
-			if( FileExtension( path ) == ".ogg" ) {
-				DecodeSoundJob job;
-				job.in.path = path;
-				job.in.ogg = AssetBinary( path );
-
-				jobs.add( job );
-			}
+	for( Span< const char > path : AssetPaths() ) {
+		if( FileExtension( path ) == ".ogg" ) {
+			AddSound( path );
 		}
-
-		nanosort( jobs.begin(), jobs.end(), []( const DecodeSoundJob & a, const DecodeSoundJob & b ) {
-			return a.in.ogg.n > b.in.ogg.n;
-		} );
-	}
-
-	ParallelFor( jobs.span(), []( TempAllocator * temp, void * data ) {
-		DecodeSoundJob * job = ( DecodeSoundJob * ) data;
-
-		TracyZoneScopedN( "stb_vorbis_decode_memory" );
-		TracyZoneSpan( job->in.path );
-
-		DisableFPEScoped;
-		job->out.num_samples = stb_vorbis_decode_memory( job->in.ogg.ptr, job->in.ogg.num_bytes(), &job->out.channels, &job->out.sample_rate, &job->out.samples );
-	} );
-
-	for( DecodeSoundJob job : jobs ) {
-		AddSound( job.in.path, job.out.num_samples, job.out.channels, job.out.sample_rate, job.out.samples );
 	}
 }
 
@@ -335,18 +407,7 @@ static void HotloadSounds() {
 
 	for( Span< const char > path : ModifiedAssetPaths() ) {
 		if( FileExtension( path ) == ".ogg" ) {
-			Span< const u8 > ogg = AssetBinary( path );
-
-			int num_samples, channels, sample_rate;
-			s16 * samples;
-			{
-				TracyZoneScopedN( "stb_vorbis_decode_memory" );
-				TracyZoneSpan( path );
-				DisableFPEScoped;
-				num_samples = stb_vorbis_decode_memory( ogg.ptr, ogg.num_bytes(), &channels, &sample_rate, &samples );
-			}
-
-			AddSound( path, num_samples, channels, sample_rate, samples );
+			AddSound( path );
 		}
 	}
 }
@@ -527,6 +588,8 @@ static void AudioCallback( Span< Vec2 > buffer, void * userdata ) {
 	CheckALErrors( "alcRenderSamplesSOFT( {} )", buffer.n );
 }
 
+static void SoundBenchmark( const Tokenized & args );
+
 void InitSound() {
 	TracyZoneScoped;
 
@@ -534,7 +597,10 @@ void InitSound() {
 	sounds.clear();
 	sound_effects.clear();
 	playing_sounds.clear();
+	pcm_cache_bytes = 0;
+	pcm_cache_clock = 0;
 	music_playing = false;
+	music_decoder = NULL;
 	backend_initialized = false;
 	backend_device_initialized = false;
 
@@ -543,6 +609,7 @@ void InitSound() {
 	s_volume = NewCvar( "s_volume", "1", CvarFlag_Archive );
 	s_musicvolume = NewCvar( "s_musicvolume", "1", CvarFlag_Archive );
 	s_muteinbackground = NewCvar( "s_muteinbackground", "1", CvarFlag_Archive );
+	s_pcmcachesize = NewCvar( "s_pcmcachesize", "64", CvarFlag_Archive ); // MB
 
 	if( !InitAudioBackend() ) {
 		Com_Printf( S_COLOR_RED "Couldn't initialize audio backend!\n" );
@@ -555,6 +622,8 @@ void InitSound() {
 
 	backend_initialized = true;
 	backend_device_initialized = InitAudioDevice( s_device->value, AudioCallback, NULL );
+
+	AddCommand( "soundbenchmark", SoundBenchmark );
 }
 
 void ShutdownSound() {
@@ -564,6 +633,8 @@ void ShutdownSound() {
 		return;
 	}
 
+	RemoveCommand( "soundbenchmark" );
+
 	if( backend_device_initialized ) {
 		ShutdownAudioDevice();
 	}
@@ -571,15 +642,16 @@ void ShutdownSound() {
 	StopAllSounds( true );
 
 	for( size_t i = 0; i < sounds.size(); i++ ) {
-		alDeleteBuffers( 1, &sounds[ i ].buf );
-		free( sounds[ i ].samples.ptr );
+		if( sounds[ i ].buf != 0 ) {
+			EvictSound( &sounds[ i ] );
+		}
 	}
 
 	ShutdownOpenAL();
 	ShutdownAudioBackend();
 }
 
-static const Sound * FindSound( StringHash name ) {
+static Sound * FindSound( StringHash name ) {
 	return backend_initialized ? sounds.get( name.hash ) : NULL;
 }
 
@@ -587,6 +659,11 @@ static const SoundEffect * FindSoundEffect( StringHash name ) {
 	return backend_initialized ? sound_effects.get( name.hash ) : NULL;
 }
 
+static float RandomPitch( const PlayingSFX * ps, size_t i ) {
+	const SoundEffect::PlaybackConfig * config = &ps->sfx->sounds[ i ];
+	return ps->config.pitch * config->pitch + ( RandomFloat11( &cls.rng ) * config->pitch_random * config->pitch * ps->config.pitch );
+}
+
 static bool StartSound( PlayingSFX * ps, size_t i ) {
 	SoundEffect::PlaybackConfig config = ps->sfx->sounds[ i ];
 
@@ -599,29 +676,74 @@ static bool StartSound( PlayingSFX * ps, size_t i ) {
 		sound_name = RandomElement( &rng, config.sounds.span() );
 	}
 
-	const Sound * sound = FindSound( sound_name );
-	if( sound == NULL )
+	Sound * sound = FindSound( sound_name );
+	if( sound == NULL || !DecodeSoundIfNeeded( sound ) )
 		return false;
 
-	if( free_sound_sources.size() == 0 ) {
-		Com_Printf( S_COLOR_YELLOW "Too many playing sounds!\n" );
-		return false;
-	}
-
 	if( !sound->mono && ps->config.spatialisation != SpatialisationMethod_None ) {
 		Com_Printf( S_COLOR_YELLOW "Positioned sounds must be mono!\n" );
 		return false;
 	}
 
+	ps->playing[ i ] = sound;
+	ps->pitch[ i ] = RandomPitch( ps, i );
+
+	return true;
+}
+
+static float VoicePlaybackPosition( const PlayingSFX * ps, size_t i, Time now ) {
+	return ToSeconds( now - ps->start_time - ps->sfx->sounds[ i ].delay ) * ps->pitch[ i ];
+}
+
+static Vec3 VoicePosition( const PlayingSFX * ps, Vec3 listener ) {
+	switch( ps->config.spatialisation ) {
+		case SpatialisationMethod_None:
+			return listener;
+		case SpatialisationMethod_Position:
+			return ps->config.position;
+		case SpatialisationMethod_Entity:
+			return cg_entities[ ps->config.ent_num ].interpolated.origin;
+		case SpatialisationMethod_LineSegment:
+			return ClosestPointOnSegment( ps->config.line_segment.start, ps->config.line_segment.end, listener );
+	}
+
+	return listener;
+}
+
+static float VoiceGain( const PlayingSFX * ps, size_t i, Vec3 listener ) {
+	const SoundEffect::PlaybackConfig * config = &ps->sfx->sounds[ i ];
+	float gain = ps->config.volume * config->volume;
+
+	// same as AL_INVERSE_DISTANCE_CLAMPED
+	if( ps->config.spatialisation != SpatialisationMethod_None ) {
+		float distance = Clamp( S_DEFAULT_ATTENUATION_REFDISTANCE, Length( VoicePosition( ps, listener ) - listener ), S_DEFAULT_ATTENUATION_MAXDISTANCE );
+		gain *= S_DEFAULT_ATTENUATION_REFDISTANCE / ( S_DEFAULT_ATTENUATION_REFDISTANCE + config->attenuation * ( distance - S_DEFAULT_ATTENUATION_REFDISTANCE ) );
+	}
+
+	return gain;
+}
+
+static void PromoteVoice( PlayingSFX * ps, size_t i, Time now ) {
+	const SoundEffect::PlaybackConfig * config = &ps->sfx->sounds[ i ];
+	Sound * sound = ps->playing[ i ];
+
+	// it may have been evicted while we were virtual
+	if( !DecodeSoundIfNeeded( sound ) ) {
+		ps->stopped[ i ] = true;
+		return;
+	}
+
 	ALuint source = free_sound_sources.pop();
 	ps->sources[ i ] = source;
+	ps->real[ i ] = true;
+	sound->num_playing++;
 
 	CheckedALSource( source, AL_BUFFER, sound->buf );
-	CheckedALSource( source, AL_GAIN, ps->config.volume * config.volume * s_volume->number );
-	CheckedALSource( source, AL_PITCH, ps->config.pitch * config.pitch + ( RandomFloat11( &cls.rng ) * config.pitch_random * config.pitch * ps->config.pitch ) );
+	CheckedALSource( source, AL_GAIN, ps->config.volume * config->volume * s_volume->number );
+	CheckedALSource( source, AL_PITCH, ps->pitch[ i ] );
 	CheckedALSource( source, AL_REFERENCE_DISTANCE, S_DEFAULT_ATTENUATION_REFDISTANCE );
 	CheckedALSource( source, AL_MAX_DISTANCE, S_DEFAULT_ATTENUATION_MAXDISTANCE );
-	CheckedALSource( source, AL_ROLLOFF_FACTOR, config.attenuation );
+	CheckedALSource( source, AL_ROLLOFF_FACTOR, config->attenuation );
 
 	switch( ps->config.spatialisation ) {
 		case SpatialisationMethod_None:
@@ -649,16 +771,28 @@ static bool StartSound( PlayingSFX * ps, size_t i ) {
 			break;
 	}
 
+	float offset = VoicePlaybackPosition( ps, i, now );
+	if( ps->immediate ) {
+		offset = fmodf( offset, sound->duration );
+	}
+
 	CheckedALSource( source, AL_LOOPING, ps->immediate ? AL_TRUE : AL_FALSE );
+	CheckedALSource( source, AL_SEC_OFFSET, Min2( offset, sound->duration ) );
 	CheckedALSourcePlay( source );
-
-	return true;
 }
 
-static void StopSound( PlayingSFX * ps, size_t i ) {
+static void DemoteVoice( PlayingSFX * ps, size_t i ) {
 	CheckedALSourceStop( ps->sources[ i ] );
 	CheckedALSource( ps->sources[ i ], AL_BUFFER, 0 );
 	[[maybe_unused]] bool ok = free_sound_sources.add( ps->sources[ i ] );
+	ps->playing[ i ]->num_playing--;
+	ps->real[ i ] = false;
+}
+
+static void StopSound( PlayingSFX * ps, size_t i ) {
+	if( ps->real[ i ] ) {
+		DemoteVoice( ps, i );
+	}
 	ps->stopped[ i ] = true;
 }
 
@@ -677,63 +811,52 @@ static void UpdateSound( PlayingSFX * ps, float volume, float pitch ) {
 	ps->config.pitch = pitch;
 
 	for( size_t i = 0; i < ps->sfx->sounds.size(); i++ ) {
-		if( ps->started[ i ] ) {
+		if( !ps->started[ i ] || ps->stopped[ i ] )
+			continue;
+
+		ps->pitch[ i ] = RandomPitch( ps, i );
+
+		if( ps->real[ i ] ) {
 			const SoundEffect::PlaybackConfig * config = &ps->sfx->sounds[ i ];
 			CheckedALSource( ps->sources[ i ], AL_GAIN, ps->config.volume * config->volume * s_volume->number );
-			CheckedALSource( ps->sources[ i ], AL_PITCH, ps->config.pitch * config->pitch + ( RandomFloat11( &cls.rng ) * config->pitch_random * config->pitch * ps->config.pitch ) );
+			CheckedALSource( ps->sources[ i ], AL_PITCH, ps->pitch[ i ] );
 		}
 	}
 }
 
-void SoundFrame( Vec3 origin, Vec3 velocity, Vec3 forward, Vec3 up ) {
+static void UpdateVoices( Vec3 listener, Time now ) {
 	TracyZoneScoped;
 
-	if( !backend_initialized )
-		return;
-
-	if( s_device->modified ) {
-		ShutdownAudioDevice();
-		backend_device_initialized = InitAudioDevice( s_device->value, AudioCallback, NULL );
-		s_device->modified = false;
-	}
-
-	HotloadSounds();
-	HotloadSoundEffects();
-
-	CheckedALListener( AL_GAIN, IsWindowFocused() || s_muteinbackground->integer == 0 ? 1 : 0 );
-
-	CheckedALListener( AL_POSITION, origin );
-	CheckedALListener( AL_VELOCITY, velocity );
-	CheckedALListenerOrientation( forward, up );
-
+	// start sounds whose delay has passed and retire finished ones. voices
+	// end on a timer rather than by asking AL so virtual voices end too
 	for( size_t i = 0; i < playing_sounds.size(); i++ ) {
 		PlayingSFX * ps = &playing_sounds[ i ];
-		Time t = cls.monotonicTime - ps->start_time;
+		Time t = now - ps->start_time;
 		bool all_stopped = true;
 
 		for( size_t j = 0; j < ps->sfx->sounds.size(); j++ ) {
-			if( ps->started[ j ] ) {
-				if( ps->stopped[ j ] )
-					continue;
+			if( ps->stopped[ j ] )
+				continue;
 
-				ALint state = CheckedALGetSource( ps->sources[ j ], AL_SOURCE_STATE );
-				if( state == AL_STOPPED ) {
-					StopSound( ps, j );
-				}
-				else {
+			if( !ps->started[ j ] ) {
+				if( t < ps->sfx->sounds[ j ].delay ) {
 					all_stopped = false;
+					continue;
 				}
-				continue;
-			}
-
-			all_stopped = false;
 
-			if( t >= ps->sfx->sounds[ j ].delay ) {
 				ps->started[ j ] = true;
 				if( !StartSound( ps, j ) ) {
 					ps->stopped[ j ] = true;
+					continue;
 				}
 			}
+
+			if( !ps->immediate && VoicePlaybackPosition( ps, j, now ) >= ps->playing[ j ]->duration ) {
+				StopSound( ps, j );
+				continue;
+			}
+
+			all_stopped = false;
 		}
 
 		bool stop_immediate = ps->immediate && !ps->keep_playing_immediate;
@@ -743,9 +866,71 @@ void SoundFrame( Vec3 origin, Vec3 velocity, Vec3 forward, Vec3 up ) {
 			continue;
 		}
 		ps->keep_playing_immediate = false;
+	}
+
+	// give sources to the loudest voices
+	struct Voice {
+		PlayingSFX * ps;
+		size_t idx;
+		float score;
+		bool audible;
+	};
+
+	TempAllocator temp = cls.frame_arena.temp();
+	DynamicArray< Voice > voices( &temp );
+
+	{
+		TracyZoneScopedN( "Score voices" );
+
+		constexpr float priority_weights[] = { 1.0f, 16.0f };
+		STATIC_ASSERT( ARRAY_COUNT( priority_weights ) == SoundPriority_Count );
 
+		for( size_t i = 0; i < playing_sounds.size(); i++ ) {
+			PlayingSFX * ps = &playing_sounds[ i ];
+			for( size_t j = 0; j < ps->sfx->sounds.size(); j++ ) {
+				if( !ps->started[ j ] || ps->stopped[ j ] )
+					continue;
+
+				float gain = VoiceGain( ps, j, listener );
+
+				// favour voices that are already real so near ties don't flap
+				float hysteresis = ps->real[ j ] ? 1.25f : 1.0f;
+
+				voices.add( Voice {
+					.ps = ps,
+					.idx = j,
+					.score = gain * priority_weights[ ps->config.priority ] * hysteresis,
+					.audible = gain >= MIN_AUDIBLE_GAIN,
+				} );
+			}
+		}
+
+		nanosort( voices.begin(), voices.end(), []( const Voice & a, const Voice & b ) {
+			return a.score > b.score;
+		} );
+	}
+
+	// demote first so there are sources to promote with
+	for( size_t i = 0; i < voices.size(); i++ ) {
+		const Voice & voice = voices[ i ];
+		bool should_be_real = i < MAX_REAL_VOICES && voice.audible;
+		if( voice.ps->real[ voice.idx ] && !should_be_real ) {
+			DemoteVoice( voice.ps, voice.idx );
+		}
+	}
+
+	for( size_t i = 0; i < voices.size(); i++ ) {
+		const Voice & voice = voices[ i ];
+		bool should_be_real = i < MAX_REAL_VOICES && voice.audible;
+		if( !voice.ps->real[ voice.idx ] && should_be_real ) {
+			PromoteVoice( voice.ps, voice.idx, now );
+		}
+	}
+
+	for( size_t i = 0; i < playing_sounds.size(); i++ ) {
+		PlayingSFX * ps = &playing_sounds[ i ];
 		for( size_t j = 0; j < ps->sfx->sounds.size(); j++ ) {
-			if( !ps->started[ j ] || ps->stopped[ j ] )
+			if( !ps->real[ j ] )
 				continue;
 
 			if( s_volume->modified ) {
@@ -756,15 +941,97 @@ void SoundFrame( Vec3 origin, Vec3 velocity, Vec3 forward, Vec3 up ) {
 				CheckedALSource( ps->sources[ j ], AL_POSITION, cg_entities[ ps->config.ent_num ].interpolated.origin );
 				CheckedALSource( ps->sources[ j ], AL_VELOCITY, cg_entities[ ps->config.ent_num ].velocity );
 			}
-			else if( ps->config.spatialisation == SpatialisationMethod_Position ) {
-				CheckedALSource( ps->sources[ j ], AL_POSITION, ps->config.position );
-			}
 			else if( ps->config.spatialisation == SpatialisationMethod_LineSegment ) {
-				Vec3 p = ClosestPointOnSegment( ps->config.line_segment.start, ps->config.line_segment.end, origin );
-				CheckedALSource( ps->sources[ j ], AL_POSITION, p );
+				CheckedALSource( ps->sources[ j ], AL_POSITION, VoicePosition( ps, listener ) );
 			}
 		}
 	}
+}
+
+static bool FillMusicBuffer( ALuint buffer ) {
+	TracyZoneScoped;
+
+	static s16 pcm[ MUSIC_STREAM_CHUNK_SAMPLES * 2 ];
+
+	stb_vorbis_info info = stb_vorbis_get_info( music_decoder );
+	int channels = Min2( info.channels, 2 );
+
+	DisableFPEScoped;
+
+	size_t num_samples = 0;
+	bool rewound = false;
+	while( num_samples < MUSIC_STREAM_CHUNK_SAMPLES ) {
+		int remaining = int( ( MUSIC_STREAM_CHUNK_SAMPLES - num_samples ) * channels );
+		int decoded = stb_vorbis_get_samples_short_interleaved( music_decoder, channels, pcm + num_samples * channels, remaining );
+		if( decoded == 0 ) {
+			// loop, but don't spin on files with no samples
+			if( rewound || !stb_vorbis_seek_start( music_decoder ) )
+				break;
+			rewound = true;
+			continue;
+		}
+
+		num_samples += decoded;
+		rewound = false;
+	}
+
+	if( num_samples == 0 )
+		return false;
+
+	ALenum format = channels == 1 ? AL_FORMAT_MONO16 : AL_FORMAT_STEREO16;
+	alBufferData( buffer, format, pcm, num_samples * channels * sizeof( s16 ), info.sample_rate );
+	CheckALErrors( "FillMusicBuffer" );
+
+	return true;
+}
+
+static void UpdateMusicStream() {
+	TracyZoneScoped;
+
+	if( !music_playing )
+		return;
+
+	ALint processed = CheckedALGetSource( music_source, AL_BUFFERS_PROCESSED );
+	for( ALint i = 0; i < processed; i++ ) {
+		ALuint buffer;
+		alSourceUnqueueBuffers( music_source, 1, &buffer );
+		CheckALErrors( "alSourceUnqueueBuffers" );
+
+		if( FillMusicBuffer( buffer ) ) {
+			alSourceQueueBuffers( music_source, 1, &buffer );
+			CheckALErrors( "alSourceQueueBuffers" );
+		}
+	}
+
+	// we ran dry, probably from a long hitch like loading a map
+	if( CheckedALGetSource( music_source, AL_SOURCE_STATE ) == AL_STOPPED ) {
+		CheckedALSourcePlay( music_source );
+	}
+}
+
+void SoundFrame( Vec3 origin, Vec3 velocity, Vec3 forward, Vec3 up ) {
+	TracyZoneScoped;
+
+	if( !backend_initialized )
+		return;
+
+	if( s_device->modified ) {
+		ShutdownAudioDevice();
+		backend_device_initialized = InitAudioDevice( s_device->value, AudioCallback, NULL );
+		s_device->modified = false;
+	}
+
+	HotloadSounds();
+	HotloadSoundEffects();
+
+	CheckedALListener( AL_GAIN, IsWindowFocused() || s_muteinbackground->integer == 0 ? 1 : 0 );
+
+	CheckedALListener( AL_POSITION, origin );
+	CheckedALListener( AL_VELOCITY, velocity );
+	CheckedALListenerOrientation( forward, up );
+
+	UpdateVoices( origin, cls.monotonicTime );
+	UpdateMusicStream();
 
 	if( ( s_volume->modified || s_musicvolume->modified ) && music_playing ) {
 		CheckedALSource( music_source, AL_GAIN, s_volume->number * s_musicvolume->number * MusicIsWayTooLoud );
@@ -779,6 +1046,7 @@ PlaySFXConfig PlaySFXConfigGlobal( float volume ) {
 	config.spatialisation = SpatialisationMethod_None;
 	config.volume = volume;
 	config.pitch = 1.0f;
+	config.priority = SoundPriority_High;
 	return config;
 }
 
@@ -810,10 +1078,7 @@ PlaySFXConfig PlaySFXConfigLineSegment( Vec3 start, Vec3 end, float volume ) {
 	return config;
 }
 
-static PlayingSFX * PlaySFXInternal( StringHash name, const PlaySFXConfig & config ) {
-	if( !backend_device_initialized )
-		return NULL;
-
+static PlayingSFX * AddPlayingSFX( StringHash name, const PlaySFXConfig & config, Time now ) {
 	const SoundEffect * sfx = FindSoundEffect( name );
 	if( sfx == NULL )
 		return NULL;
@@ -831,7 +1096,7 @@ static PlayingSFX * PlaySFXInternal( StringHash name, const PlaySFXConfig & conf
 		.config = config,
 		.hash = name,
 		.sfx = sfx,
-		.start_time = cls.monotonicTime,
+		.start_time = now,
 	};
 
 	playing_sound_handle_autoinc++;
@@ -839,6 +1104,12 @@ static PlayingSFX * PlaySFXInternal( StringHash name, const PlaySFXConfig & conf
 	return ps;
 }
 
+static PlayingSFX * PlaySFXInternal( StringHash name, const PlaySFXConfig & config ) {
+	if( !backend_device_initialized )
+		return NULL;
+	return AddPlayingSFX( name, config, cls.monotonicTime );
+}
+
 PlayingSFXHandle PlaySFX( StringHash name, const PlaySFXConfig & config ) {
 	PlayingSFX * ps = PlaySFXInternal( name, config );
 	if( ps == NULL )
@@ -867,6 +1138,57 @@ PlayingSFXHandle PlayImmediateSFX( StringHash name, PlayingSFXHandle handle, con
 	return ps->handle;
 }
 
+void PrefetchSFX( Span< const StringHash > names ) {
+	TracyZoneScoped;
+
+	if( !backend_initialized )
+		return;
+
+	struct DecodeSoundJob {
+		Sound * sound;
+		DecodedSound decoded;
+	};
+
+	DynamicArray< DecodeSoundJob > jobs( sys_allocator );
+
+	for( StringHash name : names ) {
+		const SoundEffect * sfx = FindSoundEffect( name );
+		if( sfx == NULL )
+			continue;
+
+		for( const SoundEffect::PlaybackConfig & config : sfx->sounds ) {
+			for( StringHash sound_name : config.sounds ) {
+				Sound * sound = FindSound( sound_name );
+				if( sound == NULL || sound->buf != 0 || sound->decode_failed )
+					continue;
+
+				bool queued = false;
+				for( const DecodeSoundJob & job : jobs ) {
+					queued = queued || job.sound == sound;
+				}
+
+				if( !queued ) {
+					jobs.add( DecodeSoundJob { .sound = sound } );
+				}
+			}
+		}
+	}
+
+	nanosort( jobs.begin(), jobs.end(), []( const DecodeSoundJob & a, const DecodeSoundJob & b ) {
+		return a.sound->ogg.n > b.sound->ogg.n;
+	} );
+
+	ParallelFor( jobs.span(), []( TempAllocator * temp, void * data ) {
+		DecodeSoundJob * job = ( DecodeSoundJob * ) data;
+		job->decoded = DecodeSound( job->sound->path, job->sound->ogg );
+	} );
+
+	for( const DecodeSoundJob & job : jobs ) {
+		job.sound->last_used = ++pcm_cache_clock;
+		UploadSound( job.sound, job.decoded );
+	}
+}
+
 void StopSFX( PlayingSFXHandle handle ) {
 	PlayingSFX * ps = playing_sounds.get( handle.handle );
 	if( ps != NULL ) {
@@ -897,10 +1219,28 @@ void StartMenuMusic() {
 	if( music == NULL )
 		return;
 
+	{
+		TracyZoneScopedN( "stb_vorbis_open_memory" );
+		DisableFPEScoped;
+		int error;
+		music_decoder = stb_vorbis_open_memory( music->ogg.ptr, checked_cast< int >( music->ogg.num_bytes() ), &error, NULL );
+	}
+
+	if( music_decoder == NULL ) {
+		Com_GGPrint( S_COLOR_RED "Couldn't decode sound {}", music->path );
+		return;
+	}
+
 	CheckedALSource( music_source, AL_GAIN, s_volume->number * s_musicvolume->number * MusicIsWayTooLoud );
 	CheckedALSource( music_source, AL_DIRECT_CHANNELS_SOFT, AL_REMIX_UNMATCHED_SOFT );
-	CheckedALSource( music_source, AL_LOOPING, AL_TRUE );
-	CheckedALSource( music_source, AL_BUFFER, music->buf );
+	CheckedALSource( music_source, AL_LOOPING, AL_FALSE );
+
+	for( ALuint buffer : music_buffers ) {
+		if( FillMusicBuffer( buffer ) ) {
+			alSourceQueueBuffers( music_source, 1, &buffer );
+			CheckALErrors( "alSourceQueueBuffers" );
+		}
+	}
 
 	CheckedALSourcePlay( music_source );
 
@@ -912,5 +1252,82 @@ void StopMenuMusic() {
 		CheckedALSourceStop( music_source );
 		CheckedALSource( music_source, AL_BUFFER, 0 );
 	}
+
+	if( music_decoder != NULL ) {
+		stb_vorbis_close( music_decoder );
+		music_decoder = NULL;
+	}
+
 	music_playing = false;
 }
+
+// spams positioned sounds around the listener and mixes them through the
+// loopback device, doesn't need a working audio device
+static void SoundBenchmark( const Tokenized & args ) {
+	constexpr int frames = 600; // 10 seconds at 60fps
+	Time dt = Hz( 60 );
+	int num_sfx = args.tokens.n >= 2 ? SpanToInt( args.tokens[ 1 ], 4096 ) : 4096;
+
+	// pick a handful of sounds so we're measuring voices and not decoding
+	BoundedDynamicArray< StringHash, 16 > names;
+	for( size_t i = 0; i < sounds.size() && names.size() < ARRAY_COUNT( names ); i++ ) {
+		Sound * sound = &sounds[ i ];
+		if( DecodeSoundIfNeeded( sound ) && sound->mono ) {
+			[[maybe_unused]] bool ok = names.add( StringHash( StripExtension( sound->path ) ) );
+		}
+	}
+
+	if( names.size() == 0 ) {
+		Com_Printf( S_COLOR_YELLOW "No sounds to benchmark with\n" );
+		return;
+	}
+
+	bool restart_music = music_playing;
+	StopAllSounds( true );
+
+	// the device callback renders from another thread
+	if( backend_device_initialized ) {
+		ShutdownAudioDevice();
+	}
+
+	static Vec2 samples[ AUDIO_BACKEND_SAMPLE_RATE / 60 ];
+
+	RNG rng = NewRNG( 0, 0 );
+	Time now = cls.monotonicTime;
+	Time update_time = { };
+	Time render_time = { };
+	size_t real_voices = 0;
+	int played = 0;
+
+	for( int frame = 0; frame < frames; frame++ ) {
+		int target = num_sfx * ( frame + 1 ) / frames;
+		for( ; played < target && !playing_sounds.full(); played++ ) {
+			Vec3 position = Vec3( RandomFloat11( &rng ), RandomFloat11( &rng ), RandomFloat11( &rng ) * 0.1f ) * 4096.0f;
+			AddPlayingSFX( RandomElement( &rng, names.span() ), PlaySFXConfigPosition( position ), now );
+		}
+
+		Time before_update = Now();
+		UpdateVoices( Vec3( 0.0f ), now );
+		Time before_render = Now();
+		alcRenderSamplesSOFT( al_device, samples, ARRAY_COUNT( samples ) );
+		Time after_render = Now();
+
+		update_time += before_render - before_update;
+		render_time += after_render - before_render;
+		real_voices += MAX_REAL_VOICES - free_sound_sources.size();
+		now += dt;
+	}
+
+	Com_Printf( "%d sfx over %d frames, %zu playing at the end, %.1f real voices/frame\n", played, frames, playing_sounds.size(), real_voices / float( frames ) );
+	Com_Printf( "UpdateVoices: %.3fms/frame, alcRenderSamplesSOFT: %.3fms/frame\n", ToSeconds( update_time ) * 1000.0f / frames, ToSeconds( render_time ) * 1000.0f / frames );
+
+	StopAllSounds( true );
+
+	if( backend_device_initialized ) {
+		backend_device_initialized = InitAudioDevice( s_device->value, AudioCallback, NULL );
+	}
+
+	if( restart_music ) {
+		StartMenuMusic();
+	}
+}
@@ -1,8 +1,10 @@
 #include "client/client.h"
 #include "client/icon.h"
 #include "client/renderer/renderer.h"
+#include "qcommon/array.h"
 #include "qcommon/fpe.h"
 #include "qcommon/renderdoc.h"
+#include "qcommon/time.h"
 
 #define GLFW_INCLUDE_NONE
 #include "glfw3/GLFW/glfw3.h"
@@ -10,6 +12,8 @@
 #include "imgui/imgui.h"
 #include "imgui/imgui_internal.h"
 
+#include "nanosort/nanosort.hpp"
+
 #include "stb/stb_image.h"
 
 const bool is_dedicated_server = false;
@@ -20,6 +24,11 @@ static bool running_in_debugger;
 static bool running_in_renderdoc;
 static bool route_inputs_to_imgui;
 
+// no window/GL context, the renderer runs against the null backend
+static bool headless;
+constexpr int HEADLESS_WIDTH = 1920;
+constexpr int HEADLESS_HEIGHT = 1080;
+
 static int framebuffer_width, framebuffer_height;
 
 // TODO
@@ -304,9 +313,19 @@ static WindowMode CompleteWindowMode( WindowMode mode ) {
 	return mode;
 }
 
+bool IsHeadless() {
+	return headless;
+}
+
 void CreateWindow( WindowMode mode ) {
 	TracyZoneScoped;
 
+	if( headless ) {
+		framebuffer_width = HEADLESS_WIDTH;
+		framebuffer_height = HEADLESS_HEIGHT;
+		return;
+	}
+
 #if PLATFORM_MACOS
 	DisableFPEScoped;
 #endif
@@ -371,6 +390,8 @@ void CreateWindow( WindowMode mode ) {
 
 void DestroyWindow() {
 	TracyZoneScoped;
+	if( headless )
+		return;
 	glfwDestroyWindow( window );
 }
 
@@ -380,10 +401,16 @@ void GetFramebufferSize( int * width, int * height ) {
 }
 
 void FlashWindow() {
+	if( headless )
+		return;
 	glfwRequestWindowAttention( window );
 }
 
 VideoMode GetVideoMode( int monitor ) {
+	if( headless ) {
+		return { HEADLESS_WIDTH, HEADLESS_HEIGHT, 60 };
+	}
+
 	const GLFWvidmode * glfw_mode = glfwGetVideoMode( GetMonitorByIdx( monitor ) );
 
 	VideoMode mode;
@@ -396,6 +423,11 @@ VideoMode GetVideoMode( int monitor ) {
 WindowMode GetWindowMode() {
 	WindowMode mode = { };
 
+	if( headless ) {
+		mode.video_mode = GetVideoMode( 0 );
+		return mode;
+	}
+
 	glfwGetWindowPos( window, &mode.x, &mode.y );
 	glfwGetWindowSize( window, &mode.video_mode.width, &mode.video_mode.height );
 
@@ -430,6 +462,9 @@ WindowMode GetWindowMode() {
 }
 
 void SetWindowMode( WindowMode mode ) {
+	if( headless )
+		return;
+
 	mode = CompleteWindowMode( mode );
 
 	if( mode.fullscreen == FullscreenMode_Windowed ) {
@@ -447,15 +482,19 @@ void SetWindowMode( WindowMode mode ) {
 }
 
 void EnableVSync( bool enabled ) {
+	if( headless )
+		return;
 	glfwSwapInterval( enabled ? 1 : 0 );
 }
 
 bool IsWindowFocused() {
+	if( headless )
+		return true;
 	return IFDEF( PLATFORM_LINUX ) ? true : glfwGetWindowAttrib( window, GLFW_FOCUSED );
 }
 
 Vec2 GetJoystickMovement() {
-	if( route_inputs_to_imgui )
+	if( route_inputs_to_imgui || headless )
 		return Vec2( 0.0f );
 
 	Vec2 acc = Vec2( 0.0f );
@@ -535,14 +574,75 @@ static void InputFrame() {
 
 void SwapBuffers() {
 	TracyZoneScoped;
+	if( headless )
+		return;
 	glfwSwapBuffers( window );
 }
 
+static u32 ParseHeadlessArgs( int * argc, char *** argv ) {
+	if( *argc < 2 || !StrEqual( ( *argv )[ 1 ], "--headless" ) )
+		return 0;
+
+	headless = true;
+
+	// drop our args so the rest can still be passed to Qcommon_Init
+	int skip = 1;
+	u32 num_frames = 0;
+	if( *argc >= 3 ) {
+		Span< const char > frames = MakeSpan( ( *argv )[ 2 ] );
+		if( TrySpanToU32( frames, &num_frames ) ) {
+			skip++;
+		}
+	}
+
+	( *argv )[ skip ] = ( *argv )[ 0 ];
+	*argc -= skip;
+	*argv += skip;
+
+	return num_frames;
+}
+
+/*
+ * cocaine --headless <frames> +demo whatever
+ *
+ * runs the whole client against the null render backend with a fixed
+ * timestep, so frame times only measure CPU work and are repeatable
+ */
+static void RunHeadlessBenchmark( u32 num_frames ) {
+	constexpr s64 dt = 16;
+
+	DynamicArray< float > frame_times( sys_allocator );
+	for( u32 i = 0; i < num_frames; i++ ) {
+		Time before = Now();
+		if( !Qcommon_Frame( dt ) )
+			break;
+		frame_times.add( ToSeconds( Now() - before ) * 1000.0f );
+	}
+
+	if( frame_times.size() == 0 )
+		return;
+
+	float total = 0.0f;
+	for( float t : frame_times ) {
+		total += t;
+	}
+
+	nanosort( frame_times.begin(), frame_times.end() );
+	auto percentile = [&]( float p ) {
+		return frame_times[ Min2( size_t( p * frame_times.size() ), frame_times.size() - 1 ) ];
+	};
+
+	Com_Printf( "%zu frames, avg %.3fms, p50 %.3fms, p99 %.3fms, max %.3fms\n",
+		frame_times.size(), total / frame_times.size(), percentile( 0.5f ), percentile( 0.99f ), frame_times[ frame_times.size() - 1 ] );
+}
+
 int main( int argc, char ** argv ) {
 	running_in_debugger = !is_public_build && Sys_BeingDebugged();
 	running_in_renderdoc = IsRenderDocAttached();
 
-	{
+	u32 headless_frames = ParseHeadlessArgs( &argc, &argv );
+
+	if( !headless ) {
 		TracyZoneScopedN( "Init GLFW" );
 
 		glfwSetErrorCallback( OnGlfwError );
@@ -558,6 +658,27 @@ int main( int argc, char ** argv ) {
 	Con_Init();
 	Qcommon_Init( argc, argv );
 
+	if( headless ) {
+		if( headless_frames > 0 ) {
+			RunHeadlessBenchmark( headless_frames );
+		}
+		else {
+			s64 oldtime = Sys_Milliseconds();
+			while( true ) {
+				s64 now = Sys_Milliseconds();
+				if( now == oldtime )
+					continue;
+				bool keep_going = Qcommon_Frame( now - oldtime );
+				oldtime = now;
+				if( !keep_going )
+					break;
+			}
+		}
+
+		Qcommon_Shutdown();
+		return 0;
+	}
+
 	s64 oldtime = Sys_Milliseconds();
 	while( !glfwWindowShouldClose( window ) ) {
 		s64 dt = 0;
@@ -36,7 +36,9 @@ void CL_InitImGui() {
 
 	IMGUI_CHECKVERSION();
 	ImGui::CreateContext();
-	ImGui_ImplGlfw_InitForOpenGL( window, false );
+	if( !IsHeadless() ) {
+		ImGui_ImplGlfw_InitForOpenGL( window, false );
+	}
 
 	ImGuiIO & io = ImGui::GetIO();
 
@@ -145,7 +147,9 @@ void CL_InitImGui() {
 void CL_ShutdownImGui() {
 	DeleteTexture( atlas_texture );
 
-	ImGui_ImplGlfw_Shutdown();
+	if( !IsHeadless() ) {
+		ImGui_ImplGlfw_Shutdown();
+	}
 	ImGui::DestroyContext();
 }
 
@@ -239,7 +243,17 @@ static void SubmitDrawCalls() {
 void CL_ImGuiBeginFrame() {
 	TracyZoneScoped;
 
-	ImGui_ImplGlfw_NewFrame();
+	if( IsHeadless() ) {
+		int width, height;
+		GetFramebufferSize( &width, &height );
+
+		ImGuiIO & io = ImGui::GetIO();
+		io.DisplaySize = ImVec2( width, height );
+		io.DeltaTime = 1.0f / 60.0f;
+	}
+	else {
+		ImGui_ImplGlfw_NewFrame();
+	}
 	ImGui::NewFrame();
 }
 
@@ -11,8 +11,6 @@
 #include "gameshared/cdmap.h"
 #include "gameshared/collision.h"
 
-#include "cgltf/cgltf.h"
-
 constexpr u32 MAX_MAPS = 128;
 constexpr u32 MAX_MAP_MODELS = 1024;
 
@@ -88,32 +86,11 @@ bool AddMap( Span< const u8 > data, Span< const char > path ) {
 	return true;
 }
 
-static bool AddGLTFModel( Span< const u8 > data, Span< const char > path ) {
-	cgltf_options options = { };
-	options.type = cgltf_file_type_glb;
-
-	cgltf_data * gltf;
-	if( cgltf_parse( &options, data.ptr, data.num_bytes(), &gltf ) != cgltf_result_success ) {
-		Com_GGPrint( S_COLOR_YELLOW "{} isn't a GLTF file", path );
-		return false;
-	}
-
-	defer { cgltf_free( gltf ); };
-
-	if( !LoadGLBBuffers( gltf ) ) {
-		Com_GGPrint( S_COLOR_YELLOW "Couldn't load buffers in {}", path );
-		return false;
+static void AddGLTFModel( Span< const u8 > data, Span< const char > path ) {
+	GLTFCollisionData collision;
+	if( DecodeGLBCollisionData( &collision, path, data ) ) {
+		AddGLTFCollisionData( &collision_models, collision, StringHash( path ) );
 	}
-
-	if( cgltf_validate( gltf ) != cgltf_result_success ) {
-		Com_GGPrint( S_COLOR_YELLOW "{} is invalid GLTF", path );
-		return false;
-	}
-
-	StringHash name = StringHash( path );
-	LoadGLTFCollisionData( &collision_models, gltf, path, name );
-
-	return true;
 }
 
 void InitMaps() {
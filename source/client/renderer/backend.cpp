@@ -2,7 +2,9 @@
 #include "qcommon/qcommon.h"
 #include "qcommon/array.h"
 #include "qcommon/hash.h"
+#include "qcommon/hashtable.h"
 #include "qcommon/string.h"
+#include "qcommon/time.h"
 #include "client/renderer/renderer.h"
 
 #include "cgame/cg_local.h"
@@ -12,8 +14,6 @@
 #define GLFW_INCLUDE_NONE
 #include "glfw3/GLFW/glfw3.h"
 
-#include "nanosort/nanosort.hpp"
-
 #include "tracy/tracy/Tracy.hpp"
 #include "tracy/tracy/TracyOpenGL.hpp"
 
@@ -30,10 +30,20 @@ enum DrawCallType {
 	DrawCallType_IndirectCompute,
 };
 
+/*
+ * draw calls refer to pipelines/meshes by index into per-frame arrays so
+ * they stay small enough to radix sort. sorted passes are ordered by key:
+ *
+ * pass:8 | blend:2 | shader:14 | material:16 | mesh:16 | raster state:8
+ *
+ * material/mesh/shader are truncated ids/hashes, collisions only cost us a
+ * redundant state change
+ */
 struct DrawCall {
+	u64 key;
 	DrawCallType type;
-	PipelineState pipeline;
-	Mesh mesh;
+	u32 pipeline;
+	u32 mesh;
 	u32 num_vertices;
 	u32 num_instances;
 	u32 first_index;
@@ -51,9 +61,57 @@ struct RenderPass {
 static GLuint vao;
 static GLsync fences[ MAX_FRAMES_IN_FLIGHT ];
 
+/*
+ * the null backend is used when running headless. it records, dedupes and
+ * sorts draw calls like normal but never touches GL, so we can benchmark
+ * the client's CPU cost on machines with no GPU
+ */
+static bool null_backend;
+static u32 null_backend_handles;
+
+static u32 NewNullHandle() {
+	null_backend_handles++;
+	return null_backend_handles;
+}
+
 static NonRAIIDynamicArray< RenderPass > render_passes;
 static u8 num_render_passes;
 
+static NonRAIIDynamicArray< PipelineState > pipelines;
+static NonRAIIDynamicArray< Mesh > meshes;
+static Hashtable< 4096 > pipelines_hashtable;
+static Hashtable< 4096 > meshes_hashtable;
+static NonRAIIDynamicArray< DrawCall > sort_scratch;
+
+/*
+ * command buffers let jobs record draw calls without touching the global
+ * state above. they get deduped into the frame's pipelines/meshes when
+ * they're submitted, which happens on the main thread in a fixed order so
+ * the result doesn't depend on thread timing
+ */
+struct RenderCommandBuffer {
+	NonRAIIDynamicArray< DrawCall > draws;
+	NonRAIIDynamicArray< PipelineState > pipelines;
+	NonRAIIDynamicArray< u64 > pipeline_hashes;
+	NonRAIIDynamicArray< Mesh > meshes;
+	NonRAIIDynamicArray< u64 > mesh_hashes;
+	Hashtable< 1024 > pipelines_hashtable;
+	Hashtable< 1024 > meshes_hashtable;
+	NonRAIIDynamicArray< u32 > remap;
+
+	// reserved up front, jobs suballocate from it
+	const StreamingBuffer * uniforms_stream;
+	u32 uniforms_offset;
+	u32 uniforms_size;
+	u32 uniforms_used;
+
+	u32 num_vertices;
+	bool initialized;
+};
+
+static RenderCommandBuffer command_buffers[ 16 ];
+static u32 num_command_buffers;
+
 static NonRAIIDynamicArray< GPUBuffer > deferred_buffer_deletes;
 static NonRAIIDynamicArray< StreamingBuffer > deferred_streaming_buffer_deletes;
 
@@ -63,6 +121,7 @@ static tracy::GpuCtxScope * renderpass_zone;
 #endif
 
 static u32 num_vertices_this_frame;
+static u32 num_state_changes_this_frame;
 
 static bool in_frame;
 
@@ -290,9 +349,7 @@ static void RunDeferredDeletes() {
 	deferred_streaming_buffer_deletes.clear();
 }
 
-void InitRenderBackend() {
-	TracyZoneScoped;
-
+static void InitOpenGL() {
 	{
 		TracyZoneScopedN( "Load OpenGL" );
 		if( gladLoadGLLoader( GLADloadproc( glfwGetProcAddress ) ) != 1 ) {
@@ -352,12 +409,6 @@ void InitRenderBackend() {
 		fence = 0;
 	}
 
-	render_passes.init( sys_allocator );
-	num_render_passes = 0;
-
-	deferred_buffer_deletes.init( sys_allocator );
-	deferred_streaming_buffer_deletes.init( sys_allocator );
-
 	glEnable( GL_DEPTH_TEST );
 	glDepthFunc( GL_LESS );
 
@@ -388,6 +439,31 @@ void InitRenderBackend() {
 	GLint max_ubo_size;
 	glGetIntegerv( GL_MAX_UNIFORM_BLOCK_SIZE, &max_ubo_size );
 	Assert( max_ubo_size >= s32( UNIFORM_BUFFER_SIZE ) );
+}
+
+void InitRenderBackend() {
+	TracyZoneScoped;
+
+	null_backend = IsHeadless();
+	if( null_backend ) {
+		Com_Printf( "Using the null render backend\n" );
+		null_backend_handles = 0;
+		ubo_offset_alignment = 256;
+		ssbo_offset_alignment = 256;
+		max_anisotropic_filtering = 1.0f;
+	}
+	else {
+		InitOpenGL();
+	}
+
+	render_passes.init( sys_allocator );
+	pipelines.init( sys_allocator );
+	meshes.init( sys_allocator );
+	sort_scratch.init( sys_allocator );
+	num_render_passes = 0;
+
+	deferred_buffer_deletes.init( sys_allocator );
+	deferred_streaming_buffer_deletes.init( sys_allocator );
 
 	for( size_t i = 0; i < ARRAY_COUNT( ubos ); i++ ) {
 		TempAllocator temp = cls.frame_arena.temp();
@@ -405,6 +481,8 @@ void InitRenderBackend() {
 
 void FlushRenderBackend() {
 	TracyZoneScoped;
+	if( null_backend )
+		return;
 	glFinish();
 }
 
@@ -413,14 +491,16 @@ void ShutdownRenderBackend() {
 		DeleteStreamingBuffer( ubo.stream );
 	}
 
-	glBindVertexArray( 0 );
-	glDeleteVertexArrays( 1, &vao );
-
 	RunDeferredDeletes();
 
-	for( GLsync fence : fences ) {
-		if( fence != 0 ) {
-			glDeleteSync( fence );
+	if( !null_backend ) {
+		glBindVertexArray( 0 );
+		glDeleteVertexArrays( 1, &vao );
+
+		for( GLsync fence : fences ) {
+			if( fence != 0 ) {
+				glDeleteSync( fence );
+			}
 		}
 	}
 
@@ -428,6 +508,21 @@ void ShutdownRenderBackend() {
 		pass.draws.shutdown();
 	}
 	render_passes.shutdown();
+	pipelines.shutdown();
+	meshes.shutdown();
+	sort_scratch.shutdown();
+
+	for( RenderCommandBuffer & cmds : command_buffers ) {
+		if( !cmds.initialized )
+			continue;
+		cmds.draws.shutdown();
+		cmds.pipelines.shutdown();
+		cmds.pipeline_hashes.shutdown();
+		cmds.meshes.shutdown();
+		cmds.mesh_hashes.shutdown();
+		cmds.remap.shutdown();
+		cmds.initialized = false;
+	}
 
 	deferred_buffer_deletes.shutdown();
 	deferred_streaming_buffer_deletes.shutdown();
@@ -449,11 +544,21 @@ void RenderBackendBeginFrame() {
 	}
 
 	num_vertices_this_frame = 0;
+	num_state_changes_this_frame = 0;
+
+	pipelines.clear();
+	meshes.clear();
+	pipelines_hashtable.clear();
+	meshes_hashtable.clear();
+	num_command_buffers = 0;
 
 	for( UBO & ubo : ubos ) {
 		ubo.bytes_used = 0;
 	}
 
+	if( null_backend )
+		return;
+
 	if( frame_static.viewport_width != prev_viewport_width || frame_static.viewport_height != prev_viewport_height ) {
 		prev_viewport_width = frame_static.viewport_width;
 		prev_viewport_height = frame_static.viewport_height;
@@ -529,6 +634,7 @@ static void SetPipelineState( const PipelineState & pipeline ) {
 
 	if( pipeline.shader != NULL && ( prev_pipeline.shader == NULL || pipeline.shader->program != prev_pipeline.shader->program ) ) {
 		glUseProgram( pipeline.shader->program );
+		num_state_changes_this_frame++;
 	}
 
 	// uniforms
@@ -544,6 +650,7 @@ static void SetPipelineState( const PipelineState & pipeline ) {
 					if( block.offset != prev_block.offset || block.size != prev_block.size || block.ubo != prev_block.ubo ) {
 						glBindBufferRange( GL_UNIFORM_BUFFER, i, block.ubo, block.offset, block.size );
 						prev_bindings.uniforms[ i ] = block;
+						num_state_changes_this_frame++;
 					}
 					found = true;
 					break;
@@ -575,6 +682,7 @@ static void SetPipelineState( const PipelineState & pipeline ) {
 						glBindTextureUnit( i, texture->texture );
 						glBindSampler( i, GetSampler( pipeline.textures[ j ].sampler ).sampler );
 						prev_bindings.textures[ i ] = texture;
+						num_state_changes_this_frame++;
 					}
 					found = true;
 					break;
@@ -607,6 +715,7 @@ static void SetPipelineState( const PipelineState & pipeline ) {
 							glBindBufferRange( GL_SHADER_STORAGE_BUFFER, i, binding.buffer.buffer, binding.offset, binding.size );
 						}
 						prev_bindings.buffers[ i ] = binding;
+						num_state_changes_this_frame++;
 					}
 					should_unbind = false;
 					break;
@@ -622,6 +731,7 @@ static void SetPipelineState( const PipelineState & pipeline ) {
 
 	// alpha blending
 	if( pipeline.blend_func != prev_pipeline.blend_func ) {
+		num_state_changes_this_frame++;
 		if( pipeline.blend_func == BlendFunc_Disabled ) {
 			glDisable( GL_BLEND );
 		}
@@ -640,6 +750,7 @@ static void SetPipelineState( const PipelineState & pipeline ) {
 
 	// depth testing
 	if( pipeline.depth_func != prev_pipeline.depth_func ) {
+		num_state_changes_this_frame++;
 		if( pipeline.depth_func == DepthFunc_Disabled ) {
 			glDisable( GL_DEPTH_TEST );
 		}
@@ -654,6 +765,7 @@ static void SetPipelineState( const PipelineState & pipeline ) {
 	// backface culling
 	CullFace cull_face = pipeline.cull_face;
 	if( cull_face != prev_pipeline.cull_face ) {
+		num_state_changes_this_frame++;
 		if( cull_face == CullFace_Disabled ) {
 			glDisable( GL_CULL_FACE );
 		}
@@ -667,6 +779,7 @@ static void SetPipelineState( const PipelineState & pipeline ) {
 
 	// scissor
 	if( pipeline.scissor != prev_pipeline.scissor ) {
+		num_state_changes_this_frame++;
 		if( !pipeline.scissor.exists ) {
 			glDisable( GL_SCISSOR_TEST );
 		}
@@ -681,11 +794,13 @@ static void SetPipelineState( const PipelineState & pipeline ) {
 
 	// depth writing
 	if( pipeline.write_depth != prev_pipeline.write_depth ) {
+		num_state_changes_this_frame++;
 		glDepthMask( pipeline.write_depth ? GL_TRUE : GL_FALSE );
 	}
 
 	// depth clamping
 	if( pipeline.clamp_depth != prev_pipeline.clamp_depth ) {
+		num_state_changes_this_frame++;
 		if( pipeline.clamp_depth ) {
 			glEnable( GL_DEPTH_CLAMP );
 		}
@@ -696,6 +811,7 @@ static void SetPipelineState( const PipelineState & pipeline ) {
 
 	// alpha to coverage
 	if( pipeline.alpha_to_coverage != prev_pipeline.alpha_to_coverage ) {
+		num_state_changes_this_frame++;
 		if( pipeline.alpha_to_coverage ) {
 			glEnable( GL_SAMPLE_ALPHA_TO_COVERAGE );
 		}
@@ -706,12 +822,14 @@ static void SetPipelineState( const PipelineState & pipeline ) {
 
 	// view weapon depth hack
 	if( pipeline.view_weapon_depth_hack != prev_pipeline.view_weapon_depth_hack ) {
+		num_state_changes_this_frame++;
 		float far = pipeline.view_weapon_depth_hack ? 0.3f : 1.0f;
 		glDepthRange( 0.0f, far );
 	}
 
 	// polygon fill mode
 	if( pipeline.wireframe != prev_pipeline.wireframe ) {
+		num_state_changes_this_frame++;
 		if( pipeline.wireframe ) {
 			glPolygonMode( GL_FRONT_AND_BACK, GL_LINE );
 			glEnable( GL_POLYGON_OFFSET_LINE );
@@ -739,6 +857,8 @@ static void BindVertexDescriptorAndBuffers( const Mesh & mesh ) {
 		if( opt_attr == opt_prev_attr )
 			continue;
 
+		num_state_changes_this_frame++;
+
 		if( opt_prev_attr.exists != opt_attr.exists ) {
 			if( opt_attr.exists ) {
 				glEnableVertexArrayAttrib( vao, i );
@@ -786,10 +906,57 @@ static void BindVertexDescriptorAndBuffers( const Mesh & mesh ) {
 
 	// index buffer
 	glVertexArrayElementBuffer( vao, mesh.index_buffer.buffer );
+
+	num_state_changes_this_frame++;
 }
 
-static bool SortDrawCall( const DrawCall & a, const DrawCall & b ) {
-	return a.pipeline.shader < b.pipeline.shader;
+static void UnbindVertexBuffers() {
+	for( size_t i = 0; i < ARRAY_COUNT( &Mesh::vertex_buffers ); i++ ) {
+		glVertexArrayVertexBuffer( vao, i, 0, 0, 0 );
+	}
+
+	glVertexArrayElementBuffer( vao, 0 );
+}
+
+// LSD radix sort, stable so equal keys keep submission order
+static void RadixSortDrawCalls( Span< DrawCall > draws ) {
+	TracyZoneScoped;
+
+	if( draws.n <= 1 )
+		return;
+
+	sort_scratch.resize( draws.n );
+
+	DrawCall * src = draws.ptr;
+	DrawCall * dst = sort_scratch.ptr();
+
+	for( u32 shift = 0; shift < 64; shift += 8 ) {
+		size_t offsets[ 256 ] = { };
+		for( size_t i = 0; i < draws.n; i++ ) {
+			offsets[ ( src[ i ].key >> shift ) & 0xff ]++;
+		}
+
+		// every key has the same byte here, nothing to do
+		if( offsets[ ( src[ 0 ].key >> shift ) & 0xff ] == draws.n )
+			continue;
+
+		size_t total = 0;
+		for( size_t & offset : offsets ) {
+			size_t count = offset;
+			offset = total;
+			total += count;
+		}
+
+		for( size_t i = 0; i < draws.n; i++ ) {
+			dst[ offsets[ ( src[ i ].key >> shift ) & 0xff ]++ ] = src[ i ];
+		}
+
+		Swap2( &src, &dst );
+	}
+
+	if( src != draws.ptr ) {
+		memcpy( draws.ptr, src, draws.num_bytes() );
+	}
 }
 
 static void SubmitFramebufferBlit( const RenderPassConfig & pass ) {
@@ -863,14 +1030,18 @@ static void FinishRenderPass() {
 #endif
 }
 
-static void SubmitDrawCall( const DrawCall & dc ) {
+static void SubmitDrawCall( const DrawCall & dc, u32 * prev_pipeline_idx, u32 * prev_mesh_idx ) {
 	TracyZoneScoped;
 	TracyGpuZone( "Draw call" );
 
-	if( dc.pipeline.shader->program == 0 )
+	const PipelineState & pipeline = pipelines[ dc.pipeline ];
+	if( pipeline.shader->program == 0 )
 		return;
 
-	SetPipelineState( dc.pipeline );
+	if( dc.pipeline != *prev_pipeline_idx ) {
+		SetPipelineState( pipeline );
+		*prev_pipeline_idx = dc.pipeline;
+	}
 
 	if( dc.type == DrawCallType_Compute ) {
 		TracyZoneScopedN( "Compute command" );
@@ -886,16 +1057,20 @@ static void SubmitDrawCall( const DrawCall & dc ) {
 		return;
 	}
 
-	BindVertexDescriptorAndBuffers( dc.mesh );
+	const Mesh & mesh = meshes[ dc.mesh ];
+	if( dc.mesh != *prev_mesh_idx ) {
+		BindVertexDescriptorAndBuffers( mesh );
+		*prev_mesh_idx = dc.mesh;
+	}
 
-	GLenum gl_index_format = dc.mesh.index_format == IndexFormat_U16 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+	GLenum gl_index_format = mesh.index_format == IndexFormat_U16 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
 
 	{
 		TracyZoneScopedN( "Draw command" );
 
 		if( dc.type == DrawCallType_Normal ) {
-			if( dc.mesh.index_buffer.buffer != 0 ) {
-				size_t index_size = dc.mesh.index_format == IndexFormat_U16 ? sizeof( u16 ) : sizeof( u32 );
+			if( mesh.index_buffer.buffer != 0 ) {
+				size_t index_size = mesh.index_format == IndexFormat_U16 ? sizeof( u16 ) : sizeof( u32 );
 				const void * offset = ( const void * ) ( uintptr_t( dc.first_index ) * index_size );
 				glDrawElementsInstancedBaseVertex( GL_TRIANGLES, dc.num_vertices, gl_index_format, offset, dc.num_instances, dc.base_vertex );
 			}
@@ -905,7 +1080,7 @@ static void SubmitDrawCall( const DrawCall & dc ) {
 		}
 		else if( dc.type == DrawCallType_Indirect ) {
 			glBindBuffer( GL_DRAW_INDIRECT_BUFFER, dc.indirect.buffer );
-			if( dc.mesh.index_buffer.buffer != 0 ) {
+			if( mesh.index_buffer.buffer != 0 ) {
 				glDrawElementsIndirect( GL_TRIANGLES, gl_index_format, 0 );
 			}
 			else {
@@ -914,17 +1089,6 @@ static void SubmitDrawCall( const DrawCall & dc ) {
 			glBindBuffer( GL_DRAW_INDIRECT_BUFFER, 0 );
 		}
 	}
-
-	{
-		TracyZoneScopedN( "Unbind buffers" );
-
-		// unbind buffers
-		for( size_t i = 0; i < ARRAY_COUNT( dc.mesh.vertex_buffers ); i++ ) {
-			glVertexArrayVertexBuffer( vao, i, 0, 0, 0 );
-		}
-
-		glVertexArrayElementBuffer( vao, 0 );
-	}
 }
 
 void RenderBackendSubmitFrame() {
@@ -935,19 +1099,33 @@ void RenderBackendSubmitFrame() {
 	in_frame = false;
 
 	size_t num_draw_calls_this_frame = 0;
+	Time sort_time = { };
+
+	// pipeline state/vertex buffers stay bound across draws and passes, so
+	// consecutive draws that share them skip the diffing entirely
+	u32 prev_pipeline_idx = U32_MAX;
+	u32 prev_mesh_idx = U32_MAX;
+
 	for( u8 i = 0; i < num_render_passes; i++ ) {
 		RenderPass & pass = render_passes[ i ];
-		SetupRenderPass( pass.config );
 
 		if( pass.config.sorted ) {
-			TracyZoneScopedN( "Sort draw calls" );
-			nanosort( pass.draws.begin(), pass.draws.end(), SortDrawCall );
+			Time before = Now();
+			RadixSortDrawCalls( pass.draws.span() );
+			sort_time += Now() - before;
+		}
+
+		if( null_backend ) {
+			num_draw_calls_this_frame += pass.draws.size();
+			continue;
 		}
 
+		SetupRenderPass( pass.config );
+
 		{
 			TracyZoneScopedN( "Submit draw calls" );
 			for( const DrawCall & draw : pass.draws ) {
-				SubmitDrawCall( draw );
+				SubmitDrawCall( draw, &prev_pipeline_idx, &prev_mesh_idx );
 				num_draw_calls_this_frame++;
 			}
 		}
@@ -955,7 +1133,10 @@ void RenderBackendSubmitFrame() {
 		FinishRenderPass();
 	}
 
-	{
+	if( !null_backend ) {
+		// buffers can be deleted between frames so don't leave them bound
+		UnbindVertexBuffers();
+
 		// OBS captures the game with glBlitFramebuffer which gets
 		// nuked by scissor, so turn it off at the end of every frame
 		PipelineState no_scissor_test = prev_pipeline;
@@ -965,7 +1146,9 @@ void RenderBackendSubmitFrame() {
 
 	RunDeferredDeletes();
 
-	fences[ FrameSlot() ] = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+	if( !null_backend ) {
+		fences[ FrameSlot() ] = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+	}
 
 	u32 ubo_bytes_used = 0;
 	for( const UBO & ubo : ubos ) {
@@ -975,26 +1158,33 @@ void RenderBackendSubmitFrame() {
 
 	TracyPlotSample( "Draw calls", s64( num_draw_calls_this_frame ) );
 	TracyPlotSample( "Vertices", s64( num_vertices_this_frame ) );
+	TracyPlotSample( "Pipeline states", s64( pipelines.size() ) );
+	TracyPlotSample( "State changes", s64( num_state_changes_this_frame ) );
+	TracyPlotSample( "Draw call sort time (us)", s64( ToSeconds( sort_time ) * 1000000.0f ) );
 
-	TracyGpuCollect;
+	if( !null_backend ) {
+		TracyGpuCollect;
+	}
 }
 
-UniformBlock UploadUniforms( const void * data, size_t size ) {
-	Assert( in_frame );
-
-	UBO * ubo = NULL;
-	u32 offset = 0;
-
-	for( size_t i = 0; i < ARRAY_COUNT( ubos ); i++ ) {
-		offset = checked_cast< u32 >( AlignPow2( ubos[ i ].bytes_used, ubo_offset_alignment ) );
-		if( UNIFORM_BUFFER_SIZE - offset >= size ) {
-			ubo = &ubos[ i ];
-			break;
+static UBO * ReserveUniforms( size_t size, u32 * offset ) {
+	for( UBO & ubo : ubos ) {
+		*offset = checked_cast< u32 >( AlignPow2( ubo.bytes_used, ubo_offset_alignment ) );
+		if( UNIFORM_BUFFER_SIZE - *offset >= size ) {
+			ubo.bytes_used = *offset + size;
+			return &ubo;
 		}
 	}
 
-	if( ubo == NULL )
-		Fatal( "Ran out of UBO space" );
+	Fatal( "Ran out of UBO space" );
+	return NULL;
+}
+
+UniformBlock UploadUniforms( const void * data, size_t size ) {
+	Assert( in_frame );
+
+	u32 offset;
+	UBO * ubo = ReserveUniforms( size, &offset );
 
 	UniformBlock block;
 	block.ubo = ubo->stream.buffer.buffer;
@@ -1003,12 +1193,34 @@ UniformBlock UploadUniforms( const void * data, size_t size ) {
 
 	u8 * mapping = ( u8 * ) GetStreamingBufferMemory( ubo->stream );
 	memcpy( mapping + offset, data, size );
-	ubo->bytes_used = offset + size;
+
+	return block;
+}
+
+UniformBlock UploadUniforms( RenderCommandBuffer * cmds, const void * data, size_t size ) {
+	u32 offset = cmds->uniforms_offset + checked_cast< u32 >( AlignPow2( cmds->uniforms_used, ubo_offset_alignment ) );
+	if( cmds->uniforms_stream == NULL || offset + size > cmds->uniforms_offset + cmds->uniforms_size ) {
+		Fatal( "Ran out of command buffer uniform space" );
+	}
+
+	cmds->uniforms_used = offset + size - cmds->uniforms_offset;
+
+	UniformBlock block;
+	block.ubo = cmds->uniforms_stream->buffer.buffer;
+	block.offset = offset + cmds->uniforms_stream->size * FrameSlot();
+	block.size = checked_cast< u32 >( AlignPow2( size, 16 ) );
+
+	u8 * mapping = ( u8 * ) GetStreamingBufferMemory( *cmds->uniforms_stream );
+	memcpy( mapping + offset, data, size );
 
 	return block;
 }
 
 static GPUBuffer NewGPUBuffer( const void * data, u32 size, bool coherent, Span< const char > name ) {
+	if( null_backend ) {
+		return { NewNullHandle() };
+	}
+
 	GLbitfield flags = coherent ? GL_MAP_COHERENT_BIT | GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT : 0;
 	GPUBuffer buf = { };
 	glCreateBuffers( 1, &buf.buffer );
@@ -1030,7 +1242,7 @@ GPUBuffer NewGPUBuffer( u32 size, Span< const char > name ) {
 }
 
 void DeleteGPUBuffer( GPUBuffer buf ) {
-	if( buf.buffer == 0 )
+	if( buf.buffer == 0 || null_backend )
 		return;
 	glDeleteBuffers( 1, &buf.buffer );
 }
@@ -1044,9 +1256,15 @@ StreamingBuffer NewStreamingBuffer( u32 size, Span< const char > name ) {
 
 	StreamingBuffer stream = { };
 	stream.buffer = NewGPUBuffer( NULL, size * MAX_FRAMES_IN_FLIGHT, true, name );
-	stream.ptr = glMapNamedBufferRange( stream.buffer.buffer, 0, size * MAX_FRAMES_IN_FLIGHT, GL_MAP_COHERENT_BIT | GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT );
 	stream.size = size;
 
+	if( null_backend ) {
+		stream.ptr = AllocMany< u8 >( sys_allocator, size * MAX_FRAMES_IN_FLIGHT );
+		return stream;
+	}
+
+	stream.ptr = glMapNamedBufferRange( stream.buffer.buffer, 0, size * MAX_FRAMES_IN_FLIGHT, GL_MAP_COHERENT_BIT | GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT );
+
 	if( name.ptr != NULL ) {
 		DebugLabel( GL_BUFFER, stream.buffer.buffer, name );
 	}
@@ -1059,6 +1277,11 @@ void * GetStreamingBufferMemory( StreamingBuffer stream ) {
 }
 
 void DeleteStreamingBuffer( StreamingBuffer stream ) {
+	if( null_backend ) {
+		Free( sys_allocator, stream.ptr );
+		return;
+	}
+
 	glUnmapNamedBuffer( stream.buffer.buffer );
 	DeleteGPUBuffer( stream.buffer );
 }
@@ -1069,6 +1292,11 @@ void DeferDeleteStreamingBuffer( StreamingBuffer stream ) {
 
 Sampler NewSampler( const SamplerConfig & config ) {
 	Sampler sampler;
+	if( null_backend ) {
+		sampler.sampler = NewNullHandle();
+		return sampler;
+	}
+
 	glCreateSamplers( 1, &sampler.sampler );
 
 	glSamplerParameteri( sampler.sampler, GL_TEXTURE_WRAP_S, SamplerWrapToGL( config.wrap ) );
@@ -1090,7 +1318,7 @@ Sampler NewSampler( const SamplerConfig & config ) {
 }
 
 void DeleteSampler( Sampler sampler ) {
-	if( sampler.sampler == 0 )
+	if( sampler.sampler == 0 || null_backend )
 		return;
 	glDeleteSamplers( 1, &sampler.sampler );
 }
@@ -1104,6 +1332,11 @@ Texture NewTexture( const TextureConfig & config ) {
 	texture.msaa_samples = config.msaa_samples;
 	texture.format = config.format;
 
+	if( null_backend ) {
+		texture.texture = NewNullHandle();
+		return texture;
+	}
+
 	GLenum target;
 	if( config.msaa_samples == 0 ) {
 		target = config.num_layers == 0 ? GL_TEXTURE_2D : GL_TEXTURE_2D_ARRAY;
@@ -1191,7 +1424,7 @@ Texture NewTexture( const TextureConfig & config ) {
 }
 
 void DeleteTexture( Texture texture ) {
-	if( texture.texture == 0 )
+	if( texture.texture == 0 || null_backend )
 		return;
 	glDeleteTextures( 1, &texture.texture );
 }
@@ -1213,7 +1446,32 @@ static void AddRenderTargetAttachment( GLuint fbo, const RenderTargetConfig::Att
 	*height = config.texture.height;
 }
 
+static RenderTarget NewNullRenderTarget( const RenderTargetConfig & config ) {
+	RenderTarget rt = { };
+	rt.fbo = NewNullHandle();
+
+	for( size_t i = 0; i < ARRAY_COUNT( config.color_attachments ); i++ ) {
+		if( config.color_attachments[ i ].exists ) {
+			rt.color_attachments[ i ] = config.color_attachments[ i ].value.texture;
+			rt.width = rt.color_attachments[ i ].width;
+			rt.height = rt.color_attachments[ i ].height;
+		}
+	}
+
+	if( config.depth_attachment.exists ) {
+		rt.depth_attachment = config.depth_attachment.value.texture;
+		rt.width = rt.depth_attachment.width;
+		rt.height = rt.depth_attachment.height;
+	}
+
+	return rt;
+}
+
 RenderTarget NewRenderTarget( const RenderTargetConfig & config ) {
+	if( null_backend ) {
+		return NewNullRenderTarget( config );
+	}
+
 	RenderTarget rt = { };
 
 	glCreateFramebuffers( 1, &rt.fbo );
@@ -1248,7 +1506,7 @@ RenderTarget NewRenderTarget( const RenderTargetConfig & config ) {
 }
 
 void DeleteRenderTarget( RenderTarget rt ) {
-	if( rt.fbo == 0 )
+	if( rt.fbo == 0 || null_backend )
 		return;
 	glDeleteFramebuffers( 1, &rt.fbo );
 }
@@ -1382,6 +1640,11 @@ bool NewShader( Shader * shader, Span< const char > src, Span< const char > name
 
 	*shader = { };
 
+	if( null_backend ) {
+		shader->program = NewNullHandle();
+		return true;
+	}
+
 	Span< const char > vertex_shader_name = temp.sv( "{} [VS]", name );
 	GLuint vertex_shader = CompileShader( GL_VERTEX_SHADER, src, vertex_shader_name );
 	if( vertex_shader == 0 )
@@ -1409,6 +1672,11 @@ bool NewComputeShader( Shader * shader, Span< const char > src, Span< const char
 
 	*shader = { };
 
+	if( null_backend ) {
+		shader->program = NewNullHandle();
+		return true;
+	}
+
 	GLuint cs = CompileShader( GL_COMPUTE_SHADER, src, name );
 	if( cs == 0 )
 		return false;
@@ -1423,7 +1691,7 @@ bool NewComputeShader( Shader * shader, Span< const char > src, Span< const char
 }
 
 void DeleteShader( Shader shader ) {
-	if( shader.program == 0 )
+	if( shader.program == 0 || null_backend )
 		return;
 
 	if( prev_pipeline.shader != NULL && prev_pipeline.shader->program == shader.program ) {
@@ -1484,55 +1752,278 @@ u8 AddRenderPass( const tracy::SourceLocationData * tracy, Optional< Vec4 > clea
 	return AddRenderPass( tracy, target, clear_color, clear_depth );
 }
 
-void DrawMesh( const Mesh & mesh, const PipelineState & pipeline, u32 num_vertices_override, u32 first_index, u32 base_vertex ) {
-	DrawInstancedMesh( mesh, pipeline, 1, num_vertices_override, first_index, base_vertex );
+static u64 PipelineStateHash( const PipelineState & pipeline ) {
+	u64 hash = Hash64( u64( uintptr_t( pipeline.shader ) ) ^ pipeline.pass );
+	for( size_t i = 0; i < pipeline.num_uniforms; i++ ) {
+		const PipelineState::UniformBinding & binding = pipeline.uniforms[ i ];
+		hash = Hash64( hash ^ binding.name_hash ^ binding.block.ubo );
+		hash = Hash64( hash ^ ( u64( binding.block.offset ) << 32 ) ^ binding.block.size );
+	}
+	for( size_t i = 0; i < pipeline.num_textures; i++ ) {
+		hash = Hash64( hash ^ pipeline.textures[ i ].name_hash ^ u64( uintptr_t( pipeline.textures[ i ].texture ) ) );
+	}
+	for( size_t i = 0; i < pipeline.num_buffers; i++ ) {
+		const PipelineState::BufferBinding & binding = pipeline.buffers[ i ];
+		hash = Hash64( hash ^ binding.name_hash ^ binding.buffer.buffer ^ ( u64( binding.offset ) << 32 ) );
+	}
+	return hash;
 }
 
-void DrawInstancedMesh( const Mesh & mesh, const PipelineState & pipeline, u32 num_instances, u32 num_vertices_override, u32 first_index, u32 base_vertex ) {
+static bool operator==( const PipelineState & a, const PipelineState & b ) {
+	if( a.pass != b.pass || a.shader != b.shader || a.blend_func != b.blend_func || a.depth_func != b.depth_func || a.cull_face != b.cull_face )
+		return false;
+	if( a.scissor != b.scissor || a.write_depth != b.write_depth || a.clamp_depth != b.clamp_depth || a.alpha_to_coverage != b.alpha_to_coverage || a.view_weapon_depth_hack != b.view_weapon_depth_hack || a.wireframe != b.wireframe )
+		return false;
+	if( a.num_uniforms != b.num_uniforms || a.num_textures != b.num_textures || a.num_buffers != b.num_buffers )
+		return false;
+
+	for( size_t i = 0; i < a.num_uniforms; i++ ) {
+		UniformBlock x = a.uniforms[ i ].block;
+		UniformBlock y = b.uniforms[ i ].block;
+		if( a.uniforms[ i ].name_hash != b.uniforms[ i ].name_hash || x.ubo != y.ubo || x.offset != y.offset || x.size != y.size )
+			return false;
+	}
+
+	for( size_t i = 0; i < a.num_textures; i++ ) {
+		const PipelineState::TextureBinding & x = a.textures[ i ];
+		const PipelineState::TextureBinding & y = b.textures[ i ];
+		if( x.name_hash != y.name_hash || x.texture != y.texture || x.sampler != y.sampler )
+			return false;
+	}
+
+	for( size_t i = 0; i < a.num_buffers; i++ ) {
+		const PipelineState::BufferBinding & x = a.buffers[ i ];
+		const PipelineState::BufferBinding & y = b.buffers[ i ];
+		if( x.name_hash != y.name_hash || x.buffer.buffer != y.buffer.buffer || x.offset != y.offset || x.size != y.size )
+			return false;
+	}
+
+	return true;
+}
+
+static u64 MeshHash( const Mesh & mesh ) {
+	u64 hash = Hash64( mesh.index_buffer.buffer ^ ( u64( mesh.num_vertices ) << 32 ) );
+	for( GPUBuffer buffer : mesh.vertex_buffers ) {
+		hash = Hash64( hash ^ buffer.buffer );
+	}
+	return hash;
+}
+
+static bool operator==( const Mesh & a, const Mesh & b ) {
+	if( a.index_buffer.buffer != b.index_buffer.buffer || a.num_vertices != b.num_vertices || a.index_format != b.index_format || a.cw_winding != b.cw_winding )
+		return false;
+
+	for( size_t i = 0; i < ARRAY_COUNT( a.vertex_buffers ); i++ ) {
+		if( a.vertex_buffers[ i ].buffer != b.vertex_buffers[ i ].buffer )
+			return false;
+		if( a.vertex_descriptor.attributes[ i ] != b.vertex_descriptor.attributes[ i ] )
+			return false;
+		if( a.vertex_descriptor.buffer_strides[ i ] != b.vertex_descriptor.buffer_strides[ i ] )
+			return false;
+	}
+
+	return true;
+}
+
+// dedupe through hash -> index tables, on a hash collision or a full table
+// we just store another copy
+template< typename T, size_t N >
+static u32 AddDeduplicated( NonRAIIDynamicArray< T > * arr, Hashtable< N > * hashtable, const T & x, u64 hash ) {
+	hash = Max2( hash, u64( 1 ) );
+
+	u64 idx;
+	if( hashtable->get( hash, &idx ) ) {
+		if( ( *arr )[ idx ] == x )
+			return checked_cast< u32 >( idx );
+		return checked_cast< u32 >( arr->add( x ) );
+	}
+
+	idx = arr->add( x );
+	[[maybe_unused]] bool ok = hashtable->add( hash, idx );
+	return checked_cast< u32 >( idx );
+}
+
+static u64 DrawCallSortKey( const PipelineState & pipeline, const Mesh * mesh ) {
+	u64 material = 0;
+	for( size_t i = 0; i < pipeline.num_textures; i++ ) {
+		material = Hash64( material ^ u64( uintptr_t( pipeline.textures[ i ].texture ) ) );
+	}
+
+	u64 mesh_id = mesh == NULL ? 0 : MeshHash( *mesh );
+
+	u64 raster_state = u64( pipeline.depth_func )
+		| ( u64( pipeline.cull_face ) << 2 )
+		| ( u64( pipeline.write_depth ) << 4 )
+		| ( u64( pipeline.clamp_depth ) << 5 )
+		| ( u64( pipeline.alpha_to_coverage ) << 6 )
+		| ( u64( pipeline.scissor.exists ) << 7 );
+
+	return ( u64( pipeline.pass ) << 56 )
+		| ( u64( pipeline.blend_func & 0x3 ) << 54 )
+		| ( u64( pipeline.shader->program & 0x3fff ) << 40 )
+		| ( ( material & 0xffff ) << 24 )
+		| ( ( mesh_id & 0xffff ) << 8 )
+		| raster_state;
+}
+
+static void AddDrawCall( DrawCall dc, const PipelineState & pipeline, const Mesh * mesh ) {
 	Assert( in_frame );
 	Assert( pipeline.pass != U8_MAX );
 	Assert( pipeline.shader != NULL );
 
+	dc.key = DrawCallSortKey( pipeline, mesh );
+	dc.pipeline = AddDeduplicated( &pipelines, &pipelines_hashtable, pipeline, PipelineStateHash( pipeline ) );
+	dc.mesh = mesh == NULL ? U32_MAX : AddDeduplicated( &meshes, &meshes_hashtable, *mesh, MeshHash( *mesh ) );
+	render_passes[ pipeline.pass ].draws.add( dc );
+	num_vertices_this_frame += dc.num_vertices * dc.num_instances;
+}
+
+RenderCommandBuffer * NewRenderCommandBuffer( u32 uniform_bytes ) {
+	Assert( in_frame );
+
+	if( num_command_buffers == ARRAY_COUNT( command_buffers ) ) {
+		Fatal( "Too many render command buffers" );
+	}
+
+	RenderCommandBuffer * cmds = &command_buffers[ num_command_buffers ];
+	num_command_buffers++;
+
+	if( !cmds->initialized ) {
+		cmds->draws.init( sys_allocator );
+		cmds->pipelines.init( sys_allocator );
+		cmds->pipeline_hashes.init( sys_allocator );
+		cmds->meshes.init( sys_allocator );
+		cmds->mesh_hashes.init( sys_allocator );
+		cmds->remap.init( sys_allocator );
+		cmds->initialized = true;
+	}
+
+	cmds->draws.clear();
+	cmds->pipelines.clear();
+	cmds->pipeline_hashes.clear();
+	cmds->meshes.clear();
+	cmds->mesh_hashes.clear();
+	cmds->pipelines_hashtable.clear();
+	cmds->meshes_hashtable.clear();
+	cmds->num_vertices = 0;
+
+	cmds->uniforms_stream = NULL;
+	cmds->uniforms_offset = 0;
+	cmds->uniforms_size = uniform_bytes;
+	cmds->uniforms_used = 0;
+	if( uniform_bytes > 0 ) {
+		cmds->uniforms_stream = &ReserveUniforms( uniform_bytes, &cmds->uniforms_offset )->stream;
+	}
+
+	return cmds;
+}
+
+static void AddDrawCall( RenderCommandBuffer * cmds, DrawCall dc, const PipelineState & pipeline, const Mesh * mesh ) {
+	Assert( pipeline.pass != U8_MAX );
+	Assert( pipeline.shader != NULL );
+
+	u64 pipeline_hash = PipelineStateHash( pipeline );
+	size_t num_pipelines = cmds->pipelines.size();
+	dc.key = DrawCallSortKey( pipeline, mesh );
+	dc.pipeline = AddDeduplicated( &cmds->pipelines, &cmds->pipelines_hashtable, pipeline, pipeline_hash );
+	if( cmds->pipelines.size() != num_pipelines ) {
+		cmds->pipeline_hashes.add( pipeline_hash );
+	}
+
+	dc.mesh = U32_MAX;
+	if( mesh != NULL ) {
+		u64 mesh_hash = MeshHash( *mesh );
+		size_t num_meshes = cmds->meshes.size();
+		dc.mesh = AddDeduplicated( &cmds->meshes, &cmds->meshes_hashtable, *mesh, mesh_hash );
+		if( cmds->meshes.size() != num_meshes ) {
+			cmds->mesh_hashes.add( mesh_hash );
+		}
+	}
+
+	cmds->draws.add( dc );
+	cmds->num_vertices += dc.num_vertices * dc.num_instances;
+}
+
+void SubmitRenderCommandBuffer( RenderCommandBuffer * cmds ) {
+	TracyZoneScoped;
+	Assert( in_frame );
+
+	// remap is pipelines then meshes
+	size_t num_pipelines = cmds->pipelines.size();
+	cmds->remap.resize( num_pipelines + cmds->meshes.size() );
+
+	for( size_t i = 0; i < num_pipelines; i++ ) {
+		cmds->remap[ i ] = AddDeduplicated( &pipelines, &pipelines_hashtable, cmds->pipelines[ i ], cmds->pipeline_hashes[ i ] );
+	}
+
+	for( size_t i = 0; i < cmds->meshes.size(); i++ ) {
+		cmds->remap[ num_pipelines + i ] = AddDeduplicated( &meshes, &meshes_hashtable, cmds->meshes[ i ], cmds->mesh_hashes[ i ] );
+	}
+
+	for( DrawCall dc : cmds->draws ) {
+		u8 pass = u8( dc.key >> 56 );
+		dc.pipeline = cmds->remap[ dc.pipeline ];
+		if( dc.mesh != U32_MAX ) {
+			dc.mesh = cmds->remap[ num_pipelines + dc.mesh ];
+		}
+		render_passes[ pass ].draws.add( dc );
+	}
+
+	num_vertices_this_frame += cmds->num_vertices;
+}
+
+void DrawMesh( const Mesh & mesh, const PipelineState & pipeline, u32 num_vertices_override, u32 first_index, u32 base_vertex ) {
+	DrawInstancedMesh( mesh, pipeline, 1, num_vertices_override, first_index, base_vertex );
+}
+
+void DrawMesh( RenderCommandBuffer * cmds, const Mesh & mesh, const PipelineState & pipeline, u32 num_vertices_override, u32 first_index, u32 base_vertex ) {
 	DrawCall dc = { };
 	dc.type = DrawCallType_Normal;
-	dc.mesh = mesh;
-	dc.pipeline = pipeline;
 	dc.num_vertices = num_vertices_override == 0 ? mesh.num_vertices : num_vertices_override;
 	dc.first_index = first_index;
 	dc.base_vertex = base_vertex;
-	dc.num_instances = num_instances;
-	render_passes[ pipeline.pass ].draws.add( dc );
+	dc.num_instances = 1;
+	AddDrawCall( cmds, dc, pipeline, &mesh );
+}
 
-	num_vertices_this_frame += dc.num_vertices * num_instances;
+void DrawInstancedMesh( const Mesh & mesh, const PipelineState & pipeline, u32 num_instances, u32 num_vertices_override, u32 first_index, u32 base_vertex ) {
+	DrawCall dc = { };
+	dc.type = DrawCallType_Normal;
+	dc.num_vertices = num_vertices_override == 0 ? mesh.num_vertices : num_vertices_override;
+	dc.first_index = first_index;
+	dc.base_vertex = base_vertex;
+	dc.num_instances = num_instances;
+	AddDrawCall( dc, pipeline, &mesh );
 }
 
 void DrawMeshIndirect( const Mesh & mesh, const PipelineState & pipeline, GPUBuffer indirect ) {
 	DrawCall dc = { };
 	dc.type = DrawCallType_Indirect;
-	dc.pipeline = pipeline;
-	dc.mesh = mesh;
 	dc.indirect = indirect;
-	render_passes[ pipeline.pass ].draws.add( dc );
+	AddDrawCall( dc, pipeline, &mesh );
 }
 
 void DispatchCompute( const PipelineState & pipeline, u32 x, u32 y, u32 z ) {
 	DrawCall dc = { };
 	dc.type = DrawCallType_Compute;
-	dc.pipeline = pipeline;
 	dc.dispatch_size[ 0 ] = x;
 	dc.dispatch_size[ 1 ] = y;
 	dc.dispatch_size[ 2 ] = z;
-	render_passes[ pipeline.pass ].draws.add( dc );
+	AddDrawCall( dc, pipeline, NULL );
 }
 
 void DispatchComputeIndirect( const PipelineState & pipeline, GPUBuffer indirect ) {
 	DrawCall dc = { };
 	dc.type = DrawCallType_IndirectCompute;
-	dc.pipeline = pipeline;
 	dc.indirect = indirect;
-	render_passes[ pipeline.pass ].draws.add( dc );
+	AddDrawCall( dc, pipeline, NULL );
 }
 
 void DownloadFramebuffer( void * buf ) {
+	if( null_backend ) {
+		memset( buf, 0, frame_static.viewport_width * frame_static.viewport_height * 3 );
+		return;
+	}
+
 	glReadPixels( 0, 0, frame_static.viewport_width, frame_static.viewport_height, GL_RGB, GL_UNSIGNED_BYTE, buf );
 }
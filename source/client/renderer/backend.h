@@ -183,6 +183,17 @@ u8 AddRenderPass( const tracy::SourceLocationData * tracy, RenderTarget target,
 
 UniformBlock UploadUniforms( const void * data, size_t size );
 
+/*
+ * for recording draw calls from jobs. get command buffers on the main
+ * thread, fill them from jobs, then submit them after ThreadPoolFinish.
+ * uniform_bytes is reserved up front so jobs can UploadUniforms without
+ * locking. draws keep their submission order in unsorted passes
+ */
+struct RenderCommandBuffer;
+RenderCommandBuffer * NewRenderCommandBuffer( u32 uniform_bytes = 0 );
+void SubmitRenderCommandBuffer( RenderCommandBuffer * cmds );
+UniformBlock UploadUniforms( RenderCommandBuffer * cmds, const void * data, size_t size );
+
 GPUBuffer NewGPUBuffer( const void * data, u32 size, Span< const char > name = { } );
 void DeleteGPUBuffer( GPUBuffer buf );
 void DeferDeleteGPUBuffer( GPUBuffer buf );
@@ -215,6 +226,7 @@ Mesh NewMesh( const MeshConfig & config );
 void DeleteMesh( const Mesh & mesh );
 
 void DrawMesh( const Mesh & mesh, const PipelineState & pipeline, u32 num_vertices_override = 0, u32 first_index = 0, u32 base_vertex = 0 );
+void DrawMesh( RenderCommandBuffer * cmds, const Mesh & mesh, const PipelineState & pipeline, u32 num_vertices_override = 0, u32 first_index = 0, u32 base_vertex = 0 );
 void DrawInstancedMesh( const Mesh & mesh, const PipelineState & pipeline, u32 num_instances, u32 num_vertices_override = 0, u32 first_index = 0, u32 base_vertex = 0 );
 void DrawMeshIndirect( const Mesh & mesh, const PipelineState & pipeline, GPUBuffer indirect );
 void DispatchCompute( const PipelineState & pipeline, u32 x, u32 y, u32 z );
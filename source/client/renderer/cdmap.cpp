@@ -1,17 +1,34 @@
 #include "qcommon/base.h"
+#include "qcommon/threadpool.h"
 #include "client/client.h"
 #include "client/renderer/renderer.h"
 #include "gameshared/cdmap.h"
 
 MapSharedRenderData NewMapRenderData( const MapData & map, Span< const char > name ) {
+	TracyZoneScoped;
+
 	TempAllocator temp = cls.frame_arena.temp();
 
+	// the shaders want float positions/normals so unpack them here. indices
+	// stay u16 and get drawn relative to each cluster's base_vertex
+	Span< Vec3 > positions = AllocSpan< Vec3 >( sys_allocator, map.vertex_positions.n );
+	Span< Vec3 > normals = AllocSpan< Vec3 >( sys_allocator, map.vertex_normals.n );
+	defer { Free( sys_allocator, positions.ptr ); };
+	defer { Free( sys_allocator, normals.ptr ); };
+
+	for( const MapMesh & mesh : map.meshes ) {
+		for( u32 i = mesh.base_vertex; i < mesh.base_vertex + mesh.num_unique_vertices; i++ ) {
+			positions[ i ] = DequantizeMapPosition( mesh, map.vertex_positions[ i ] );
+			normals[ i ] = DecodeMapNormal( map.vertex_normals[ i ] );
+		}
+	}
+
 	MeshConfig mesh_config = { };
 	mesh_config.name = name;
-	mesh_config.set_attribute( VertexAttribute_Position, NewGPUBuffer( map.vertex_positions, temp.sv( "{} positions", name ) ) );
-	mesh_config.set_attribute( VertexAttribute_Normal, NewGPUBuffer( map.vertex_normals, temp.sv( "{} normals", name ) ) );
+	mesh_config.set_attribute( VertexAttribute_Position, NewGPUBuffer( positions, temp.sv( "{} positions", name ) ) );
+	mesh_config.set_attribute( VertexAttribute_Normal, NewGPUBuffer( normals, temp.sv( "{} normals", name ) ) );
 	mesh_config.index_buffer = NewGPUBuffer( map.vertex_indices, temp.sv( "{} indices", name ) );
-	mesh_config.index_format = IndexFormat_U32;
+	mesh_config.index_format = IndexFormat_U16;
 	mesh_config.num_vertices = map.vertex_indices.n;
 
 	MapSharedRenderData shared = { };
@@ -28,35 +45,81 @@ void DeleteMapRenderData( const MapSharedRenderData & render_data ) {
 	// DeleteGPUBuffer( render_data.planes );
 }
 
+struct MapShadowCascadeJob {
+	const Map * map;
+	Span< const MapMesh > meshes;
+	u32 cascade;
+	RenderCommandBuffer * cmds;
+};
+
+static void DrawMapShadowCascade( RenderCommandBuffer * cmds, const Map * map, Span< const MapMesh > meshes, u32 cascade ) {
+	TracyZoneScoped;
+
+	PipelineState pipeline;
+	pipeline.pass = frame_static.shadowmap_pass[ cascade ];
+	pipeline.shader = &shaders.depth_only;
+	pipeline.clamp_depth = true;
+	pipeline.bind_uniform( "u_View", frame_static.shadowmap_view_uniforms[ cascade ] );
+	pipeline.bind_uniform( "u_Model", frame_static.identity_model_uniforms );
+
+	// shadows are drawn without the model transform
+	for( const MapMesh & mesh : meshes ) {
+		if( !BoxInFrustum( frame_static.shadowmap_frustums[ cascade ], mesh.bounds ) )
+			continue;
+
+		if( cmds != NULL ) {
+			DrawMesh( cmds, map->render_data.mesh, pipeline, mesh.num_vertices, mesh.first_vertex_index, mesh.base_vertex );
+		}
+		else {
+			DrawMesh( map->render_data.mesh, pipeline, mesh.num_vertices, mesh.first_vertex_index, mesh.base_vertex );
+		}
+	}
+}
+
 void DrawMapModel( const DrawModelConfig & config, const MapSubModelRenderData * render_data, const Mat3x4 & transform, const Vec4 & color ) {
+	TracyZoneScoped;
+
 	if( render_data == NULL )
 		return;
 
 	const Map * map = FindMap( render_data->base_hash );
+	const MapModel & model = map->data.models[ render_data->sub_model ];
+	Span< const MapMesh > meshes = map->data.meshes.slice( model.first_mesh, model.first_mesh + model.num_meshes );
 
-	u32 first_mesh = map->data.models[ render_data->sub_model ].first_mesh;
-	for( u32 i = 0; i < map->data.models[ render_data->sub_model ].num_meshes; i++ ) {
-		const MapMesh & mesh = map->data.meshes[ i + first_mesh ];
-
-		for( u32 j = 0; j < frame_static.shadow_parameters.num_cascades; j++ ) {
-			PipelineState pipeline;
-			pipeline.pass = frame_static.shadowmap_pass[ j ];
-			pipeline.shader = &shaders.depth_only;
-			pipeline.clamp_depth = true;
-			pipeline.bind_uniform( "u_View", frame_static.shadowmap_view_uniforms[ j ] );
-			pipeline.bind_uniform( "u_Model", frame_static.identity_model_uniforms );
+	// record the shadow cascades on the thread pool while we do the view
+	// passes here. only worth it for the big world model
+	constexpr size_t min_meshes_for_jobs = 64;
+	u32 num_cascades = frame_static.shadow_parameters.num_cascades;
+	bool use_jobs = meshes.n >= min_meshes_for_jobs;
 
-			DrawMesh( map->render_data.mesh, pipeline, mesh.num_vertices, mesh.first_vertex_index );
+	MapShadowCascadeJob jobs[ ARRAY_COUNT( frame_static.shadowmap_pass ) ];
+	for( u32 i = 0; i < num_cascades; i++ ) {
+		if( use_jobs ) {
+			jobs[ i ] = { map, meshes, i, NewRenderCommandBuffer() };
+			ThreadPoolDo( []( TempAllocator * temp, void * data ) {
+				const MapShadowCascadeJob * job = ( const MapShadowCascadeJob * ) data;
+				DrawMapShadowCascade( job->cmds, job->map, job->meshes, job->cascade );
+			}, &jobs[ i ] );
+		}
+		else {
+			DrawMapShadowCascade( NULL, map, meshes, i );
 		}
+	}
+
+	UniformBlock model_uniforms = UploadModelUniforms( transform );
+
+	for( const MapMesh & mesh : meshes ) {
+		if( !BoxInFrustum( frame_static.frustum, TransformBounds( transform, mesh.bounds ) ) )
+			continue;
 
 		{
 			PipelineState pipeline = MaterialToPipelineState( FindMaterial( StringHash( mesh.material ) ) );
 			pipeline.pass = frame_static.world_opaque_prepass_pass;
 			pipeline.shader = &shaders.depth_only;
 			pipeline.bind_uniform( "u_View", frame_static.view_uniforms );
-			pipeline.bind_uniform( "u_Model", UploadModelUniforms( transform ) );
+			pipeline.bind_uniform( "u_Model", model_uniforms );
 
-			DrawMesh( map->render_data.mesh, pipeline, mesh.num_vertices, mesh.first_vertex_index );
+			DrawMesh( map->render_data.mesh, pipeline, mesh.num_vertices, mesh.first_vertex_index, mesh.base_vertex );
 		}
 
 		{
@@ -71,7 +134,14 @@ void DrawMapModel( const DrawModelConfig & config, const MapSubModelRenderData *
 			pipeline.write_depth = false;
 			pipeline.depth_func = DepthFunc_Equal;
 
-			DrawMesh( map->render_data.mesh, pipeline, mesh.num_vertices, mesh.first_vertex_index );
+			DrawMesh( map->render_data.mesh, pipeline, mesh.num_vertices, mesh.first_vertex_index, mesh.base_vertex );
+		}
+	}
+
+	if( use_jobs ) {
+		ThreadPoolFinish();
+		for( u32 i = 0; i < num_cascades; i++ ) {
+			SubmitRenderCommandBuffer( jobs[ i ].cmds );
 		}
 	}
 }
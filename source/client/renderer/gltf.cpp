@@ -1,6 +1,7 @@
 #include "qcommon/base.h"
 #include "qcommon/hash.h"
 #include "qcommon/hashtable.h"
+#include "qcommon/threadpool.h"
 #include "client/client.h"
 #include "client/renderer/renderer.h"
 #include "client/assets.h"
@@ -383,17 +384,32 @@ static GLTFInterpolationMode InterpolationModeFromGLTF( cgltf_interpolation_type
 	return interpolation == cgltf_interpolation_type_step ? GLTFInterpolationMode_Step : GLTFInterpolationMode_Linear;
 }
 
+struct AnimationDataCursor {
+	float * times;
+	Quaternion * rotations;
+	Vec3 * translations;
+	float * scales;
+};
+
 template< typename T >
-static float LoadChannel( const cgltf_animation_channel * chan, GLTFRenderData::AnimationChannel< T > * out_channel ) {
+static Span< T > TakeKeyframes( T ** cursor, size_t n ) {
+	Span< T > span( *cursor, n );
+	*cursor += n;
+	return span;
+}
+
+template< typename T >
+static float LoadChannel( const cgltf_animation_channel * chan, GLTFRenderData::AnimationChannel< T > * out_channel, float ** times, T ** values ) {
 	constexpr size_t lanes = sizeof( T ) / sizeof( float );
 	size_t n = chan->sampler->input->count;
 
-	out_channel->samples = AllocSpan< GLTFRenderData::AnimationSample< T > >( sys_allocator, n );
+	out_channel->times = TakeKeyframes( times, n );
+	out_channel->values = TakeKeyframes( values, n );
 	out_channel->interpolation = InterpolationModeFromGLTF( chan->sampler->interpolation );
 
 	for( size_t i = 0; i < n; i++ ) {
-		cgltf_bool ok = cgltf_accessor_read_float( chan->sampler->input, i, &out_channel->samples[ i ].time, 1 );
-		ok = ok && cgltf_accessor_read_float( chan->sampler->output, i, out_channel->samples[ i ].value.ptr(), lanes );
+		cgltf_bool ok = cgltf_accessor_read_float( chan->sampler->input, i, &out_channel->times[ i ], 1 );
+		ok = ok && cgltf_accessor_read_float( chan->sampler->output, i, out_channel->values[ i ].ptr(), lanes );
 		Assert( ok != 0 );
 	}
 
@@ -401,14 +417,15 @@ static float LoadChannel( const cgltf_animation_channel * chan, GLTFRenderData::
 	return duration;
 }
 
-static float LoadScaleChannel( const cgltf_animation_channel * chan, GLTFRenderData::AnimationChannel< float > * out_channel ) {
+static float LoadScaleChannel( const cgltf_animation_channel * chan, GLTFRenderData::AnimationChannel< float > * out_channel, float ** times, float ** values ) {
 	size_t n = chan->sampler->input->count;
 
-	out_channel->samples = AllocSpan< GLTFRenderData::AnimationSample< float > >( sys_allocator, n );
+	out_channel->times = TakeKeyframes( times, n );
+	out_channel->values = TakeKeyframes( values, n );
 	out_channel->interpolation = InterpolationModeFromGLTF( chan->sampler->interpolation );
 
 	for( size_t i = 0; i < n; i++ ) {
-		cgltf_accessor_read_float( chan->sampler->input, i, &out_channel->samples[ i ].time, 1 );
+		cgltf_accessor_read_float( chan->sampler->input, i, &out_channel->times[ i ], 1 );
 
 		float scale[ 3 ];
 		cgltf_accessor_read_float( chan->sampler->output, i, scale, 3 );
@@ -416,20 +433,14 @@ static float LoadScaleChannel( const cgltf_animation_channel * chan, GLTFRenderD
 		Assert( Abs( scale[ 0 ] - scale[ 1 ] ) < 0.001f );
 		Assert( Abs( scale[ 0 ] - scale[ 2 ] ) < 0.001f );
 
-		out_channel->samples[ i ].value = scale[ 0 ];
+		out_channel->values[ i ] = scale[ 0 ];
 	}
 
 	float duration = chan->sampler->input->max[ 0 ] - chan->sampler->input->min[ 0 ];
 	return duration;
 }
 
-template< typename T >
-static void CreateSingleSampleChannel( GLTFRenderData::AnimationChannel< T > * out_channel, T value ) {
-	out_channel->samples = AllocSpan< T >( sys_allocator, 1 );
-	out_channel->samples[ 0 ] = value;
-}
-
-static void LoadAnimation( GLTFRenderData * model, const cgltf_animation * animation, u8 index = 0 ) {
+static void LoadAnimation( GLTFRenderData * model, const cgltf_animation * animation, u8 index, AnimationDataCursor * cursor ) {
 	float duration = 0.0f;
 	for( size_t i = 0; i < animation->channels_count; i++ ) {
 		const cgltf_animation_channel * chan = &animation->channels[ i ];
@@ -439,13 +450,13 @@ static void LoadAnimation( GLTFRenderData * model, const cgltf_animation * anima
 
 		float channel_duration = 0.0f;
 		if( chan->target_path == cgltf_animation_path_type_translation ) {
-			channel_duration = LoadChannel( chan, &model->nodes[ node_idx ].animations[ index ].translations );
+			channel_duration = LoadChannel( chan, &model->nodes[ node_idx ].animations[ index ].translations, &cursor->times, &cursor->translations );
 		}
 		else if( chan->target_path == cgltf_animation_path_type_rotation ) {
-			channel_duration = LoadChannel( chan, &model->nodes[ node_idx ].animations[ index ].rotations );
+			channel_duration = LoadChannel( chan, &model->nodes[ node_idx ].animations[ index ].rotations, &cursor->times, &cursor->rotations );
 		}
 		else if( chan->target_path == cgltf_animation_path_type_scale ) {
-			channel_duration = LoadScaleChannel( chan, &model->nodes[ node_idx ].animations[ index ].scales );
+			channel_duration = LoadScaleChannel( chan, &model->nodes[ node_idx ].animations[ index ].scales, &cursor->times, &cursor->scales );
 		}
 		duration = Max2( channel_duration, duration );
 	}
@@ -453,6 +464,46 @@ static void LoadAnimation( GLTFRenderData * model, const cgltf_animation * anima
 	model->animations[ index ].duration = duration;
 }
 
+static void LoadAnimations( GLTFRenderData * model, const cgltf_data * gltf ) {
+	size_t num_times = 0;
+	size_t num_rotations = 0;
+	size_t num_translations = 0;
+	size_t num_scales = 0;
+
+	for( size_t i = 0; i < gltf->animations_count; i++ ) {
+		for( size_t j = 0; j < gltf->animations[ i ].channels_count; j++ ) {
+			const cgltf_animation_channel * chan = &gltf->animations[ i ].channels[ j ];
+			size_t n = chan->sampler->input->count;
+			if( chan->target_path == cgltf_animation_path_type_translation ) {
+				num_translations += n;
+			}
+			else if( chan->target_path == cgltf_animation_path_type_rotation ) {
+				num_rotations += n;
+			}
+			else if( chan->target_path == cgltf_animation_path_type_scale ) {
+				num_scales += n;
+			}
+			else {
+				continue;
+			}
+			num_times += n;
+		}
+	}
+
+	size_t size = num_rotations * sizeof( Quaternion ) + num_translations * sizeof( Vec3 ) + num_scales * sizeof( float ) + num_times * sizeof( float );
+	model->animation_data = sys_allocator->allocate( size, 16 );
+
+	AnimationDataCursor cursor;
+	cursor.rotations = ( Quaternion * ) model->animation_data;
+	cursor.translations = ( Vec3 * ) ( cursor.rotations + num_rotations );
+	cursor.scales = ( float * ) ( cursor.translations + num_translations );
+	cursor.times = cursor.scales + num_scales;
+
+	for( size_t i = 0; i < gltf->animations_count; i++ ) {
+		LoadAnimation( model, &gltf->animations[ i ], i, &cursor );
+	}
+}
+
 static void LoadSkin( GLTFRenderData * model, const cgltf_skin * skin ) {
 	model->skin = AllocSpan< GLTFRenderData::Joint >( sys_allocator, skin->joints_count );
 
@@ -511,9 +562,7 @@ bool NewGLTFRenderData( GLTFRenderData * render_data, cgltf_data * gltf, Span< c
 			memset( render_data->nodes[ i ].animations.ptr, 0, render_data->nodes[ i ].animations.num_bytes() );
 		}
 
-		for( size_t i = 0; i < render_data->animations.n; i++ ) {
-			LoadAnimation( render_data, &gltf->animations[ i ], i );
-		}
+		LoadAnimations( render_data, gltf );
 	}
 
 	for( size_t i = 0; i < gltf->nodes_count; i++ ) {
@@ -529,11 +578,6 @@ bool NewGLTFRenderData( GLTFRenderData * render_data, cgltf_data * gltf, Span< c
 
 void DeleteGLTFRenderData( GLTFRenderData * render_data ) {
 	for( GLTFRenderData::Node node : render_data->nodes ) {
-		for( GLTFRenderData::NodeAnimation animation : node.animations ) {
-			Free( sys_allocator, animation.rotations.samples.ptr );
-			Free( sys_allocator, animation.translations.samples.ptr );
-			Free( sys_allocator, animation.scales.samples.ptr );
-		}
 		DeleteMesh( node.mesh );
 		Free( sys_allocator, node.animations.ptr );
 	}
@@ -542,63 +586,100 @@ void DeleteGLTFRenderData( GLTFRenderData * render_data ) {
 	Free( sys_allocator, render_data->nodes.ptr );
 	Free( sys_allocator, render_data->skin.ptr );
 	Free( sys_allocator, render_data->animations.ptr );
+	Free( sys_allocator, render_data->animation_data );
+}
+
+// returns the keyframe before t, i.e. we interpolate between it and the next one
+static u32 FindKeyframe( Span< const float > times, float t, u16 * cursor ) {
+	// try the keyframe pair we used last time, then the one after it
+	if( cursor != NULL ) {
+		for( u32 i = *cursor; i < *cursor + 2u && i + 1 < times.n; i++ ) {
+			bool after_start = i == 0 || times[ i ] < t;
+			if( after_start && t <= times[ i + 1 ] ) {
+				*cursor = i;
+				return i;
+			}
+		}
+	}
+
+	// binary search for the first keyframe at or after t
+	u32 lo = 1;
+	u32 hi = times.n - 1;
+	while( lo < hi ) {
+		u32 mid = lo + ( hi - lo ) / 2;
+		if( times[ mid ] >= t ) {
+			hi = mid;
+		}
+		else {
+			lo = mid + 1;
+		}
+	}
+
+	if( cursor != NULL ) {
+		*cursor = lo - 1;
+	}
+
+	return lo - 1;
 }
 
 template< typename T, typename F >
-static T SampleAnimationChannel( const GLTFRenderData::AnimationChannel< T > & channel, float t, T def, F lerp ) {
-	if( channel.samples.ptr == NULL )
+static T SampleAnimationChannel( const GLTFRenderData::AnimationChannel< T > & channel, float t, T def, F lerp, u16 * cursor ) {
+	if( channel.times.ptr == NULL )
 		return def;
-	if( channel.samples.n == 1 )
-		return channel.samples[ 0 ].value;
+	if( channel.times.n == 1 )
+		return channel.values[ 0 ];
 
-	t = Clamp( channel.samples[ 0 ].time, t, channel.samples[ channel.samples.n - 1 ].time );
+	t = Clamp( channel.times[ 0 ], t, channel.times[ channel.times.n - 1 ] );
 
-	u32 sample = 0;
-	for( u32 i = 1; i < channel.samples.n; i++ ) {
-		if( channel.samples[ i ].time >= t ) {
-			sample = i - 1;
-			break;
-		}
+	if( channel.times.n > U16_MAX ) {
+		cursor = NULL;
 	}
 
+	u32 sample = FindKeyframe( channel.times, t, cursor );
+
 	// TODO: cubic
 	if( channel.interpolation == GLTFInterpolationMode_Step ) {
-		return channel.samples[ sample ].value;
+		return channel.values[ sample ];
 	}
 
-	float lerp_frac = Unlerp( channel.samples[ sample ].time, t, channel.samples[ sample + 1 ].time );
-	return lerp( channel.samples[ sample ].value, lerp_frac, channel.samples[ sample + 1 ].value );
+	float lerp_frac = Unlerp( channel.times[ sample ], t, channel.times[ sample + 1 ] );
+	return lerp( channel.values[ sample ], lerp_frac, channel.values[ sample + 1 ] );
 }
 
 // can't use overloaded function as a template parameter
 static Vec3 LerpVec3( Vec3 a, float t, Vec3 b ) { return Lerp( a, t, b ); }
 static float LerpFloat( float a, float t, float b ) { return Lerp( a, t, b ); }
 
-Span< Transform > SampleAnimation( Allocator * a, const GLTFRenderData * render_data, float t, u8 animation ) {
+void SampleAnimation( Span< Transform > local_poses, const GLTFRenderData * render_data, float t, u8 animation, Span< AnimationCursor > cursors ) {
 	TracyZoneScoped;
 
-	Span< Transform > local_poses = AllocSpan< Transform >( a, render_data->nodes.n );
+	Assert( local_poses.n == render_data->nodes.n );
+
+	bool use_cursors = cursors.n >= render_data->nodes.n;
 
 	for( u8 i = 0; i < render_data->nodes.n; i++ ) {
 		const GLTFRenderData::Node * node = &render_data->nodes[ i ];
-		local_poses[ i ].rotation = SampleAnimationChannel( node->animations[ animation ].rotations, t, node->local_transform.rotation, NLerp );
-		local_poses[ i ].translation = SampleAnimationChannel( node->animations[ animation ].translations, t, node->local_transform.translation, LerpVec3 );
-		local_poses[ i ].scale = SampleAnimationChannel( node->animations[ animation ].scales, t, node->local_transform.scale, LerpFloat );
+		const GLTFRenderData::NodeAnimation * channels = &node->animations[ animation ];
+		AnimationCursor * cursor = use_cursors ? &cursors[ i ] : NULL;
+
+		local_poses[ i ].rotation = SampleAnimationChannel( channels->rotations, t, node->local_transform.rotation, NLerp, cursor == NULL ? NULL : &cursor->rotation );
+		local_poses[ i ].translation = SampleAnimationChannel( channels->translations, t, node->local_transform.translation, LerpVec3, cursor == NULL ? NULL : &cursor->translation );
+		local_poses[ i ].scale = SampleAnimationChannel( channels->scales, t, node->local_transform.scale, LerpFloat, cursor == NULL ? NULL : &cursor->scale );
 	}
+}
 
+Span< Transform > SampleAnimation( Allocator * a, const GLTFRenderData * render_data, float t, u8 animation ) {
+	Span< Transform > local_poses = AllocSpan< Transform >( a, render_data->nodes.n );
+	SampleAnimation( local_poses, render_data, t, animation );
 	return local_poses;
 }
 
-MatrixPalettes ComputeMatrixPalettes( Allocator * a, const GLTFRenderData * render_data, Span< const Transform > local_poses ) {
+void ComputeMatrixPalettes( MatrixPalettes palettes, const GLTFRenderData * render_data, Span< const Transform > local_poses ) {
 	TracyZoneScoped;
 
 	Assert( local_poses.n == render_data->nodes.n );
-
-	MatrixPalettes palettes = { };
-	palettes.node_transforms = AllocSpan< Mat3x4 >( a, render_data->nodes.n );
-	if( render_data->skin.n != 0 ) {
-		palettes.skinning_matrices = AllocSpan< Mat3x4 >( a, render_data->skin.n );
-	}
+	Assert( palettes.node_transforms.n == render_data->nodes.n );
+	Assert( palettes.skinning_matrices.n == render_data->skin.n );
 
 	for( u8 i = 0; i < render_data->nodes.n; i++ ) {
 		u8 parent = render_data->nodes[ i ].parent;
@@ -614,7 +695,20 @@ MatrixPalettes ComputeMatrixPalettes( Allocator * a, const GLTFRenderData * rend
 		u8 node_idx = render_data->skin[ i ].node_idx;
 		palettes.skinning_matrices[ i ] = palettes.node_transforms[ node_idx ] * render_data->skin[ i ].joint_to_bind;
 	}
+}
 
+MatrixPalettes AllocMatrixPalettes( Allocator * a, const GLTFRenderData * render_data ) {
+	MatrixPalettes palettes = { };
+	palettes.node_transforms = AllocSpan< Mat3x4 >( a, render_data->nodes.n );
+	if( render_data->skin.n != 0 ) {
+		palettes.skinning_matrices = AllocSpan< Mat3x4 >( a, render_data->skin.n );
+	}
+	return palettes;
+}
+
+MatrixPalettes ComputeMatrixPalettes( Allocator * a, const GLTFRenderData * render_data, Span< const Transform > local_poses ) {
+	MatrixPalettes palettes = AllocMatrixPalettes( a, render_data );
+	ComputeMatrixPalettes( palettes, render_data, local_poses );
 	return palettes;
 }
 
@@ -661,6 +755,61 @@ void MergeLowerUpperPoses( Span< Transform > lower, Span< const Transform > uppe
 	}
 }
 
+void EvaluatePose( TempAllocator * temp, const PoseRequest & request ) {
+	const GLTFRenderData * render_data = request.model;
+
+	Span< Transform > local_poses = AllocSpan< Transform >( temp, render_data->nodes.n );
+	SampleAnimation( local_poses, render_data, request.t, request.animation, request.cursors );
+
+	if( request.merge_upper ) {
+		Span< Transform > upper = AllocSpan< Transform >( temp, render_data->nodes.n );
+		SampleAnimation( upper, render_data, request.upper_t, request.animation, request.upper_cursors );
+		MergeLowerUpperPoses( local_poses, upper, render_data, request.upper_root_node );
+	}
+
+	for( u8 i = 0; i < request.num_rotations; i++ ) {
+		local_poses[ request.rotations[ i ].node ].rotation *= request.rotations[ i ].rotation;
+	}
+
+	ComputeMatrixPalettes( request.palettes, render_data, local_poses );
+}
+
+struct PoseBatch {
+	Span< const PoseRequest > requests;
+};
+
+static void EvaluatePoseBatch( TempAllocator * temp, void * data ) {
+	TracyZoneScoped;
+
+	const PoseBatch * batch = ( const PoseBatch * ) data;
+	for( const PoseRequest & request : batch->requests ) {
+		EvaluatePose( temp, request );
+	}
+}
+
+void EvaluatePoses( TempAllocator * temp, Span< const PoseRequest > requests ) {
+	TracyZoneScoped;
+
+	// a single player pose is only a few microseconds so hand them out in
+	// batches, otherwise the job queue overhead dominates
+	constexpr size_t POSES_PER_BATCH = 8;
+
+	if( requests.n <= POSES_PER_BATCH ) {
+		PoseBatch batch = { requests };
+		EvaluatePoseBatch( temp, &batch );
+		return;
+	}
+
+	size_t num_batches = ( requests.n + POSES_PER_BATCH - 1 ) / POSES_PER_BATCH;
+	Span< PoseBatch > batches = AllocSpan< PoseBatch >( temp, num_batches );
+	for( size_t i = 0; i < num_batches; i++ ) {
+		size_t first = i * POSES_PER_BATCH;
+		batches[ i ].requests = requests.slice( first, Min2( first + POSES_PER_BATCH, requests.n ) );
+	}
+
+	ParallelFor( batches, EvaluatePoseBatch );
+}
+
 static void DrawVfxNode( DrawModelConfig::DrawModel config, const GLTFRenderData::Node * node, const Mat3x4 & transform, const Vec4 & color ) {
 	TracyZoneScoped;
 	if( !config.enabled || node->vfx_type == ModelVfxType_None )
@@ -737,7 +886,7 @@ static void DrawModelNode( DrawModelConfig::DrawModel config, const Mesh & mesh,
 	AddInstanceToCollection( model_instance_collection, mesh, pipeline, instance, hash );
 }
 
-static void DrawShadowsNode( DrawModelConfig::DrawShadows config, const Mesh & mesh, bool skinned, PipelineState pipeline, const Mat3x4 & transform ) {
+static void DrawShadowsNode( DrawModelConfig::DrawShadows config, u32 shadow_cascades, const Mesh & mesh, bool skinned, PipelineState pipeline, const Mat3x4 & transform ) {
 	TracyZoneScoped;
 	if( !config.enabled )
 		return;
@@ -748,6 +897,9 @@ static void DrawShadowsNode( DrawModelConfig::DrawShadows config, const Mesh & m
 	pipeline.write_depth = true;
 
 	for( u32 i = 0; i < frame_static.shadow_parameters.entity_cascades; i++ ) {
+		if( ( shadow_cascades & ( 1u << i ) ) == 0 )
+			continue;
+
 		pipeline.pass = frame_static.shadowmap_pass[ i ];
 		pipeline.bind_uniform( "u_View", frame_static.shadowmap_view_uniforms[ i ] );
 
@@ -812,6 +964,20 @@ static void DrawSilhouetteNode( DrawModelConfig::DrawSilhouette config, const Me
 	AddInstanceToCollection( model_silhouette_instance_collection, mesh, pipeline, instance, hash );
 }
 
+static MinMax3 GLTFModelBounds( const GLTFRenderData * render_data, const Mat3x4 & transform, bool animated ) {
+	MinMax3 bounds = render_data->bounds;
+
+	// we only have bounds for the bind pose. limbs can swing out but not
+	// further than the model is big
+	if( animated ) {
+		Vec3 size = bounds.maxs - bounds.mins;
+		float grow = Max2( Max2( size.x, size.y ), size.z ) * 0.5f;
+		bounds = MinMax3( bounds.mins - grow, bounds.maxs + grow );
+	}
+
+	return TransformBounds( transform * render_data->transform, bounds );
+}
+
 void DrawGLTFModel( const DrawModelConfig & config, const GLTFRenderData * render_data, const Mat3x4 & transform, const Vec4 & color, MatrixPalettes palettes ) {
 	TracyZoneScoped;
 	if( render_data == NULL )
@@ -820,6 +986,23 @@ void DrawGLTFModel( const DrawModelConfig & config, const GLTFRenderData * rende
 	bool animated = palettes.node_transforms.ptr != NULL;
 	bool any_skinned = render_data->skin.n > 0;
 
+	// vfx nodes still go through config because dlights/decals can be
+	// visible when the model isn't
+	DrawModelConfig culled = config;
+	u32 shadow_cascades = U32_MAX;
+	if( !config.draw_model.view_weapon ) {
+		MinMax3 bounds = GLTFModelBounds( render_data, transform, animated );
+		bool in_view = BoxInFrustum( frame_static.frustum, bounds );
+		culled.draw_model.enabled = culled.draw_model.enabled && in_view;
+		culled.draw_outlines.enabled = culled.draw_outlines.enabled && in_view;
+		culled.draw_silhouette.enabled = culled.draw_silhouette.enabled && in_view;
+
+		shadow_cascades = VisibleShadowCascades( bounds, frame_static.shadow_parameters.entity_cascades );
+		culled.draw_shadows.enabled = culled.draw_shadows.enabled && shadow_cascades != 0;
+	}
+
+	bool draw_meshes = culled.draw_model.enabled || culled.draw_shadows.enabled || culled.draw_outlines.enabled || culled.draw_silhouette.enabled;
+
 	UniformBlock pose_uniforms = { };
 	if( any_skinned && animated ) {
 		pose_uniforms = UploadUniforms( palettes.skinning_matrices.ptr, palettes.skinning_matrices.num_bytes() );
@@ -858,7 +1041,7 @@ void DrawGLTFModel( const DrawModelConfig & config, const GLTFRenderData * rende
 
 		DrawVfxNode( config.draw_model, node, node_transform, color );
 
-		if( node->mesh.num_vertices == 0 )
+		if( node->mesh.num_vertices == 0 || !draw_meshes )
 			continue;
 
 		GPUMaterial gpu_material;
@@ -871,10 +1054,10 @@ void DrawGLTFModel( const DrawModelConfig & config, const GLTFRenderData * rende
 			pipeline.bind_uniform( "u_Pose", pose_uniforms );
 		}
 
-		DrawModelNode( config.draw_model, node->mesh, skinned, pipeline, node_transform, gpu_material );
-		DrawShadowsNode( config.draw_shadows, node->mesh, skinned, pipeline, node_transform );
-		DrawOutlinesNode( config.draw_outlines, node->mesh, skinned, pipeline, outline_uniforms, node_transform );
-		DrawSilhouetteNode( config.draw_silhouette, node->mesh, skinned, pipeline, silhouette_uniforms, node_transform );
+		DrawModelNode( culled.draw_model, node->mesh, skinned, pipeline, node_transform, gpu_material );
+		DrawShadowsNode( culled.draw_shadows, shadow_cascades, node->mesh, skinned, pipeline, node_transform );
+		DrawOutlinesNode( culled.draw_outlines, node->mesh, skinned, pipeline, outline_uniforms, node_transform );
+		DrawSilhouetteNode( culled.draw_silhouette, node->mesh, skinned, pipeline, silhouette_uniforms, node_transform );
 	}
 }
 
@@ -17,15 +17,10 @@ enum ModelVfxType {
 };
 
 struct GLTFRenderData {
-	template< typename T >
-	struct AnimationSample {
-		T value;
-		float time;
-	};
-
 	template< typename T >
 	struct AnimationChannel {
-		Span< AnimationSample< T > > samples;
+		Span< float > times;
+		Span< T > values;
 		GLTFInterpolationMode interpolation;
 	};
 
@@ -96,6 +91,9 @@ struct GLTFRenderData {
 	Span< Node > nodes;
 	Span< Joint > skin;
 	Span< Animation > animations;
+
+	// every channel's keyframes live in here, grouped by type
+	void * animation_data;
 };
 
 struct cgltf_data;
@@ -110,8 +108,38 @@ bool FindNodeByName( const GLTFRenderData * model, StringHash name, u8 * idx );
 bool FindAnimationByName( const GLTFRenderData * model, StringHash name, u8 * idx );
 
 Span< Transform > SampleAnimation( Allocator * a, const GLTFRenderData * model, float t, u8 animation = 0 );
+void SampleAnimation( Span< Transform > local_poses, const GLTFRenderData * model, float t, u8 animation = 0, Span< AnimationCursor > cursors = Span< AnimationCursor >() );
 void MergeLowerUpperPoses( Span< Transform > lower, Span< const Transform > upper, const GLTFRenderData * model, u8 upper_root_joint );
 MatrixPalettes ComputeMatrixPalettes( Allocator * a, const GLTFRenderData * model, Span< const Transform > local_poses );
+void ComputeMatrixPalettes( MatrixPalettes palettes, const GLTFRenderData * model, Span< const Transform > local_poses );
+MatrixPalettes AllocMatrixPalettes( Allocator * a, const GLTFRenderData * model );
+
+struct PoseRequest {
+	struct NodeRotation {
+		u8 node;
+		Quaternion rotation;
+	};
+
+	const GLTFRenderData * model;
+	u8 animation;
+	float t;
+	Span< AnimationCursor > cursors;
+
+	// players sample their upper body at a different time and merge it in
+	bool merge_upper;
+	u8 upper_root_node;
+	float upper_t;
+	Span< AnimationCursor > upper_cursors;
+
+	// applied on top of the sampled local pose
+	NodeRotation rotations[ 4 ];
+	u8 num_rotations;
+
+	MatrixPalettes palettes; // allocated by the caller with AllocMatrixPalettes
+};
+
+void EvaluatePose( TempAllocator * temp, const PoseRequest & request );
+void EvaluatePoses( TempAllocator * temp, Span< const PoseRequest > requests );
 
 void InitGLTFInstancing();
 void ShutdownGLTFInstancing();
@@ -3,17 +3,17 @@
 #include "qcommon/hashtable.h"
 #include "qcommon/string.h"
 #include "qcommon/span2d.h"
+#include "qcommon/threadpool.h"
 #include "gameshared/q_shared.h"
 #include "client/client.h"
 #include "client/assets.h"
-#include "client/threadpool.h"
 #include "client/renderer/renderer.h"
 #include "client/renderer/dds.h"
+#include "client/renderer/texture_cache.h"
 #include "cgame/cg_dynamics.h"
 
 #include "nanosort/nanosort.hpp"
 
-#include "stb/stb_image.h"
 #include "stb/stb_rect_pack.h"
 
 struct MaterialSpecKey {
@@ -29,7 +29,7 @@ constexpr int DECAL_ATLAS_SIZE = 2048;
 constexpr int DECAL_ATLAS_BLOCK_SIZE = DECAL_ATLAS_SIZE / 4;
 
 static Texture textures[ MAX_TEXTURES ];
-static void * texture_stb_data[ MAX_TEXTURES ];
+static void * texture_decoded_data[ MAX_TEXTURES ];
 static Span< const BC4Block > texture_bc4_data[ MAX_TEXTURES ];
 static Hashtable< MAX_TEXTURES * 2 > textures_hashtable;
 
@@ -336,9 +336,9 @@ static void DeleteSamplers() {
 }
 
 static void UnloadTexture( u64 idx ) {
-	stbi_image_free( texture_stb_data[ idx ] );
+	Free( sys_allocator, texture_decoded_data[ idx ] );
 
-	texture_stb_data[ idx ] = NULL;
+	texture_decoded_data[ idx ] = NULL;
 	texture_bc4_data[ idx ] = Span< const BC4Block >();
 
 	DeleteTexture( textures[ idx ] );
@@ -393,33 +393,30 @@ static Optional< size_t > AddTexture( Span< const char > name, u64 hash, const T
 	return idx;
 }
 
-static void LoadSTBTexture( Span< const char > path, u8 * pixels, int w, int h, int channels, const char * failure_reason ) {
+static void LoadDecodedTexture( Span< const char > path, bool ok, const DecodedTexture & decoded, const char * failure_reason ) {
 	TracyZoneScoped;
 	TracyZoneSpan( path );
 
-	if( pixels == NULL ) {
+	if( !ok ) {
 		Assert( failure_reason != NULL );
 		Com_GGPrint( S_COLOR_YELLOW "WARNING: couldn't load texture from {}: {}", path, failure_reason );
 		return;
 	}
 
-	constexpr TextureFormat formats[] = {
-		TextureFormat_R_U8,
-		TextureFormat_RA_U8,
-		{ },
-		TextureFormat_RGBA_U8_sRGB,
-	};
-
 	TextureConfig config = {
-		.format = formats[ channels - 1 ],
-		.width = checked_cast< u32 >( w ),
-		.height = checked_cast< u32 >( h ),
-		.data = pixels,
+		.format = decoded.format,
+		.width = decoded.width,
+		.height = decoded.height,
+		.num_mipmaps = decoded.num_mipmaps,
+		.data = decoded.texels.ptr,
 	};
 
 	Optional< size_t > idx = AddTexture( path, Hash64( StripExtension( path ) ), config );
 	if( idx.exists ) {
-		texture_stb_data[ idx.value ] = pixels;
+		texture_decoded_data[ idx.value ] = const_cast< u8 * >( decoded.texels.ptr );
+	}
+	else {
+		Free( sys_allocator, const_cast< u8 * >( decoded.texels.ptr ) );
 	}
 }
 
@@ -498,17 +495,16 @@ static void LoadMaterialFile( Span< const char > path ) {
 	}
 }
 
-struct DecodeSTBTextureJob {
+struct DecodeTextureJob {
 	struct {
 		Span< const char > path;
 		Span< const u8 > data;
 	} in;
 
 	struct {
-		int width, height;
-		int channels;
-		u8 * pixels;
-		Span< const char > failure_reason;
+		bool ok;
+		DecodedTexture texture;
+		const char * failure_reason;
 	} out;
 };
 
@@ -700,7 +696,7 @@ static void PackDecalAtlas() {
 			continue;
 
 		u64 texture_idx = material->texture - textures;
-		Span2D< const RGBA8 > rgba = Span2D< const RGBA8 >( ( const RGBA8 * ) texture_stb_data[ texture_idx ], material->texture->width, material->texture->height );
+		Span2D< const RGBA8 > rgba = Span2D< const RGBA8 >( ( const RGBA8 * ) texture_decoded_data[ texture_idx ], material->texture->width, material->texture->height );
 		Span2D< const BC4Block > bc4 = RGBAToBC4( rgba );
 		texture_bc4_data[ texture_idx ] = Span< const BC4Block >( bc4.ptr, bc4.w * bc4.h );
 	}
@@ -858,7 +854,7 @@ void InitMaterials() {
 	{
 		TracyZoneScopedN( "Load disk textures" );
 
-		DynamicArray< DecodeSTBTextureJob > jobs( sys_allocator );
+		DynamicArray< DecodeTextureJob > jobs( sys_allocator );
 		{
 			TracyZoneScopedN( "Build job list" );
 
@@ -866,7 +862,7 @@ void InitMaterials() {
 				Span< const char > ext = FileExtension( path );
 
 				if( ext == ".png" || ext == ".jpg" ) {
-					DecodeSTBTextureJob job;
+					DecodeTextureJob job;
 					job.in.path = path;
 					job.in.data = AssetBinary( path );
 
@@ -878,43 +874,18 @@ void InitMaterials() {
 				}
 			}
 
-			nanosort( jobs.begin(), jobs.end(), []( const DecodeSTBTextureJob & a, const DecodeSTBTextureJob & b ) {
+			nanosort( jobs.begin(), jobs.end(), []( const DecodeTextureJob & a, const DecodeTextureJob & b ) {
 				return a.in.data.n > b.in.data.n;
 			} );
 		}
 
 		ParallelFor( jobs.span(), []( TempAllocator * temp, void * data ) {
-			DecodeSTBTextureJob * job = ( DecodeSTBTextureJob * ) data;
-
-			TracyZoneScopedN( "stbi_load_from_memory" );
-			TracyZoneSpan( job->in.path );
-
-			job->out.pixels = stbi_load_from_memory( job->in.data.ptr, job->in.data.num_bytes(), &job->out.width, &job->out.height, &job->out.channels, 0 );
-
-			if( job->out.channels == 3 ) {
-				TracyZoneScopedN( "RGB -> RGBA" );
-
-				// stb_image uses sys_allocator so this is ok
-				size_t num_pixels = checked_cast< size_t >( job->out.width * job->out.height );
-				RGBA8 * rgba_pixels = AllocMany< RGBA8 >( sys_allocator, num_pixels );
-				for( size_t i = 0; i < num_pixels; i++ ) {
-					rgba_pixels[ i ] = RGBA8(
-						job->out.pixels[ i * 3 + 0 ],
-						job->out.pixels[ i * 3 + 1 ],
-						job->out.pixels[ i * 3 + 2 ],
-						255
-					);
-				}
-
-				stbi_image_free( job->out.pixels );
-				job->out.pixels = ( u8 * ) rgba_pixels;
-				job->out.channels = 4;
-			}
-
+			DecodeTextureJob * job = ( DecodeTextureJob * ) data;
+			job->out.ok = DecodeTexture( temp, job->in.path, job->in.data, &job->out.texture, &job->out.failure_reason );
 		} );
 
-		for( DecodeSTBTextureJob job : jobs ) {
-			LoadSTBTexture( job.in.path, job.out.pixels, job.out.width, job.out.height, job.out.channels, stbi_failure_reason() );
+		for( const DecodeTextureJob & job : jobs ) {
+			LoadDecodedTexture( job.in.path, job.out.ok, job.out.texture, job.out.failure_reason );
 		}
 	}
 
@@ -940,17 +911,12 @@ void HotloadMaterials() {
 		Span< const char > ext = FileExtension( path );
 
 		if( ext == ".png" || ext == ".jpg" ) {
-			Span< const u8 > data = AssetBinary( path );
-
-			int w, h, channels;
-			u8 * pixels;
-			{
-				TracyZoneScopedN( "stbi_load_from_memory" );
-				TracyZoneSpan( path );
-				pixels = stbi_load_from_memory( data.ptr, data.num_bytes(), &w, &h, &channels, 0 );
-			}
+			TempAllocator temp = cls.frame_arena.temp();
 
-			LoadSTBTexture( path, pixels, w, h, channels, stbi_failure_reason() );
+			DecodedTexture texture;
+			const char * failure_reason = NULL;
+			bool ok = DecodeTexture( &temp, path, AssetBinary( path ), &texture, &failure_reason );
+			LoadDecodedTexture( path, ok, texture, failure_reason );
 
 			changes = true;
 		}
@@ -684,6 +684,8 @@ void SetupShadowCascades() {
 			shadow_projection.col3.y += rounded_offset.y;
 		}
 
+		frame_static.shadowmap_frustums[ i ] = FrustumFromMatrix( shadow_projection * Mat4( shadow_view ), false, true );
+
 		Mat3x4 inv_shadow_view = InvertViewMatrix( shadow_view, shadow_camera_position );
 		frame_static.shadowmap_view_uniforms[ i ] = UploadViewUniforms( shadow_view, Mat3x4::Identity(), shadow_projection, Mat4::Identity(), shadow_camera_position, Vec2(), cascade_dist[ i ], 0, frame_static.light_direction );
 
@@ -718,6 +720,7 @@ void RendererSetView( Vec3 position, EulerDegrees3 angles, float vertical_fov )
 	frame_static.position = position;
 	frame_static.vertical_fov = vertical_fov;
 	frame_static.near_plane = near_plane;
+	frame_static.frustum = FrustumFromMatrix( frame_static.P * Mat4( frame_static.V ), true, false );
 
 	float t = 1.0f;
 	if( client_gs.gameState.sun_moved_from != client_gs.gameState.sun_moved_to ) {
@@ -731,6 +734,16 @@ void RendererSetView( Vec3 position, EulerDegrees3 angles, float vertical_fov )
 	frame_static.view_uniforms = UploadViewUniforms( frame_static.V, frame_static.inverse_V, frame_static.P, frame_static.inverse_P, position, frame_static.viewport, near_plane, frame_static.msaa_samples, frame_static.light_direction );
 }
 
+u32 VisibleShadowCascades( const MinMax3 & bounds, u32 num_cascades ) {
+	u32 visible = 0;
+	for( u32 i = 0; i < num_cascades; i++ ) {
+		if( BoxInFrustum( frame_static.shadowmap_frustums[ i ], bounds ) ) {
+			visible |= 1u << i;
+		}
+	}
+	return visible;
+}
+
 void RendererSubmitFrame() {
 	RenderBackendSubmitFrame();
 	frame_counter++;
@@ -53,6 +53,9 @@ struct FrameStatic {
 	float vertical_fov;
 	float near_plane;
 
+	Frustum frustum;
+	Frustum shadowmap_frustums[ 4 ]; // no near planes, casters between the light and the cascade still count
+
 	struct {
 		RenderTarget silhouette_mask;
 		RenderTarget msaa;
@@ -96,6 +99,7 @@ void ShutdownRenderer();
 
 void RendererBeginFrame( u32 viewport_width, u32 viewport_height );
 void RendererSetView( Vec3 position, EulerDegrees3 angles, float vertical_fov );
+u32 VisibleShadowCascades( const MinMax3 & bounds, u32 num_cascades );
 void RendererSubmitFrame();
 
 size_t FrameSlot();
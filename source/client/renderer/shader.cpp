@@ -71,7 +71,10 @@ static void BuildShaderSrcs( DynamicString * src, Span< const char > path, Span<
 		cursor += length_up_to_include + strlen( "#include" );
 
 		Span< const char > include = ParseToken( &cursor, Parse_StopOnNewLine );
-		StringHash hash = StringHash( Hash64( include.ptr, include.n, Hash64( "glsl/" ) ) );
+		Hasher64 hasher;
+		hasher.add( "glsl/" );
+		hasher.add( include );
+		StringHash hash = StringHash( hasher.finish() );
 
 		Span< const char > contents = AssetString( hash );
 		if( contents.ptr == NULL ) {
@@ -3,6 +3,7 @@
 #include "qcommon/array.h"
 #include "qcommon/utf8.h"
 #include "qcommon/hash.h"
+#include "qcommon/hashtable.h"
 #include "qcommon/serialization.h"
 
 #include "client/renderer/renderer.h"
@@ -34,8 +35,11 @@ struct Font {
 
 static BoundedDynamicArray< Font, 64 > fonts;
 
+static void ClearTextLayoutCache();
+
 void InitText() {
 	fonts.clear();
+	ClearTextLayoutCache();
 }
 
 void ShutdownText() {
@@ -122,88 +126,207 @@ static float Area( const MinMax2 & rect ) {
 	return w * h;
 }
 
-static void DrawText( const Font * font, float pixel_size, Span< const char > str, float x, float y, Vec4 color, bool border, Vec4 border_color ) {
-	if( font == NULL )
-		return;
+/*
+ * the HUD and scoreboard draw mostly the same strings every frame, and
+ * usually measure them before drawing them, so laid out glyph quads and
+ * bounds get cached on ( font, size, string ). entries that haven't been
+ * used for a frame get evicted in bulk when the cache fills up. strings
+ * longer than MAX_CACHED_LAYOUT_GLYPHS bytes get laid out every time
+ */
+
+struct TextQuad {
+	MinMax2 position;
+	MinMax2 uv;
+};
 
-	y += pixel_size * font->ascent;
+struct TextLayout {
+	MinMax2 bounds;
+	Span< const TextQuad > quads;
+};
 
-	ImGuiShaderAndMaterial sam;
-	sam.shader = &shaders.text;
-	sam.material = &font->material;
-	sam.uniform_name = "u_Text";
-	sam.uniform_block = UploadUniformBlock( color, border_color, font->dSDF_dTexel, border ? 1 : 0 );
+constexpr size_t MAX_CACHED_LAYOUTS = 512;
+constexpr size_t MAX_CACHED_LAYOUT_GLYPHS = 64;
 
-	ImDrawList * bg = ImGui::GetBackgroundDrawList();
-	bg->PushTextureID( sam );
+struct CachedTextLayout {
+	u64 key;
+	MinMax2 bounds;
+	u32 num_quads;
+	TextQuad quads[ MAX_CACHED_LAYOUT_GLYPHS ];
+};
+
+static CachedTextLayout cached_layouts[ MAX_CACHED_LAYOUTS ];
+static int cached_layout_last_used[ MAX_CACHED_LAYOUTS ];
+static size_t num_cached_layouts;
+static Hashtable< MAX_CACHED_LAYOUTS * 2 > cached_layouts_hashtable;
+
+static void ClearTextLayoutCache() {
+	num_cached_layouts = 0;
+	cached_layouts_hashtable.clear();
+}
+
+// quads needs room for str.n entries
+static TextLayout BuildTextLayout( const Font * font, float pixel_size, Span< const char > str, TextQuad * quads ) {
+	TracyZoneScoped;
+
+	size_t num_quads = 0;
+	float x = 0.0f;
+	float y = pixel_size * font->ascent;
+	float width = 0.0f;
+	MinMax1 y_extents = MinMax1::Empty();
 
 	u32 state = 0;
 	u32 c = 0;
+	const Glyph * glyph = NULL;
+
 	for( size_t i = 0; i < str.n; i++ ) {
 		if( DecodeUTF8( &state, &c, str[ i ] ) != 0 )
 			continue;
 		if( c > 255 )
 			c = '?';
 
-		const Glyph * glyph = &font->glyphs[ c ];
+		glyph = &font->glyphs[ c ];
 
 		if( Area( glyph->bounds ) > 0.0f ) {
 			// TODO: this is bogus. it should expand glyphs by 1 or
 			// 2 pixels to allow for border/antialiasing, up to a
 			// limit determined by font->glyph_padding
-			Vec2 mins = Vec2( x, y ) + pixel_size * ( glyph->bounds.mins - font->glyph_padding );
-			Vec2 maxs = Vec2( x, y ) + pixel_size * ( glyph->bounds.maxs + font->glyph_padding );
-			bg->PrimReserve( 6, 4 );
-			bg->PrimRectUV( mins, maxs, glyph->uv_bounds.mins, glyph->uv_bounds.maxs, IM_COL32_WHITE );
+			quads[ num_quads ].position.mins = Vec2( x, y ) + pixel_size * ( glyph->bounds.mins - font->glyph_padding );
+			quads[ num_quads ].position.maxs = Vec2( x, y ) + pixel_size * ( glyph->bounds.maxs + font->glyph_padding );
+			quads[ num_quads ].uv = glyph->uv_bounds;
+			num_quads++;
 		}
 
 		x += pixel_size * glyph->advance;
-		// TODO: kerning
+		width += glyph->advance;
+		y_extents.lo = Min2( glyph->bounds.mins.y, y_extents.lo );
+		y_extents.hi = Max2( glyph->bounds.maxs.y, y_extents.hi );
+		// TODO: kerning. the msdf spec doesn't have kerning pairs yet, but
+		// this is the place to apply them since it's cached
 	}
 
-	bg->PopTextureID();
-}
+	TextLayout layout;
+	layout.quads = Span< const TextQuad >( quads, num_quads );
 
-void DrawText( const Font * font, float pixel_size, const char * str, float x, float y, Vec4 color, bool border ) {
-	Vec4 border_color = Vec4( 0, 0, 0, color.w );
-	DrawText( font, pixel_size, MakeSpan( str ), x, y, color, border, border_color );
+	if( glyph == NULL ) {
+		layout.bounds = MinMax2( Vec2( 0 ), Vec2( 0 ) );
+		return layout;
+	}
+
+	width -= glyph->advance;
+	width += glyph->bounds.maxs.x - glyph->bounds.mins.x;
+
+	layout.bounds = MinMax2( pixel_size * Vec2( 0, y_extents.lo ), pixel_size * Vec2( width, y_extents.hi ) );
+	return layout;
 }
 
-void DrawText( const Font * font, float pixel_size, const char * str, float x, float y, Vec4 color, Vec4 border_color ) {
-	DrawText( font, pixel_size, MakeSpan( str ), x, y, color, true, border_color );
+static void EvictTextLayouts( int frame ) {
+	TracyZoneScoped;
+
+	size_t kept = 0;
+	for( size_t i = 0; i < num_cached_layouts; i++ ) {
+		if( cached_layout_last_used[ i ] < frame - 1 )
+			continue;
+		if( kept != i ) {
+			cached_layouts[ kept ] = cached_layouts[ i ];
+			cached_layout_last_used[ kept ] = cached_layout_last_used[ i ];
+		}
+		kept++;
+	}
+
+	if( kept == num_cached_layouts )
+		return;
+
+	num_cached_layouts = kept;
+	cached_layouts_hashtable.clear();
+	for( size_t i = 0; i < num_cached_layouts; i++ ) {
+		cached_layouts_hashtable.add( cached_layouts[ i ].key, i );
+	}
 }
 
-MinMax2 TextBounds( const Font * font, float pixel_size, const char * str ) {
-	float width = 0.0f;
-	MinMax1 y_extents = MinMax1::Empty();
+static TextLayout LayoutText( TempAllocator * temp, const Font * font, float pixel_size, Span< const char > str ) {
+	if( str.n > MAX_CACHED_LAYOUT_GLYPHS ) {
+		return BuildTextLayout( font, pixel_size, str, AllocMany< TextQuad >( temp, str.n ) );
+	}
 
-	u32 state = 0;
-	u32 c = 0;
-	const Glyph * glyph = NULL;
+	u64 key = Hash64( str, Hash64( &pixel_size, sizeof( pixel_size ), font->path_hash ) ) | 1; // hashtable keys can't be 0
 
-	for( const char * p = str; *p != '\0'; p++ ) {
-		if( DecodeUTF8( &state, &c, *p ) != 0 )
-			continue;
-		if( c > 255 )
-			c = '?';
+	int frame = ImGui::GetFrameCount();
 
-		glyph = &font->glyphs[ c ];
-		width += glyph->advance;
-		y_extents.lo = Min2( glyph->bounds.mins.y, y_extents.lo );
-		y_extents.hi = Max2( glyph->bounds.maxs.y, y_extents.hi );
+	u64 idx;
+	if( cached_layouts_hashtable.get( key, &idx ) ) {
+		const CachedTextLayout * cached = &cached_layouts[ idx ];
+		cached_layout_last_used[ idx ] = frame;
+		return { cached->bounds, Span< const TextQuad >( cached->quads, cached->num_quads ) };
 	}
 
-	if( glyph == NULL )
-		return MinMax2( Vec2( 0 ), Vec2( 0 ) );
+	if( num_cached_layouts == MAX_CACHED_LAYOUTS ) {
+		EvictTextLayouts( frame );
+		// everything is in use, don't thrash
+		if( num_cached_layouts == MAX_CACHED_LAYOUTS ) {
+			return BuildTextLayout( font, pixel_size, str, AllocMany< TextQuad >( temp, str.n ) );
+		}
+	}
 
-	width -= glyph->advance;
-	width += glyph->bounds.maxs.x - glyph->bounds.mins.x;
+	idx = num_cached_layouts;
+	num_cached_layouts++;
+
+	CachedTextLayout * cached = &cached_layouts[ idx ];
+	TextLayout layout = BuildTextLayout( font, pixel_size, str, cached->quads );
+	cached->key = key;
+	cached->bounds = layout.bounds;
+	cached->num_quads = checked_cast< u32 >( layout.quads.n );
+	cached_layout_last_used[ idx ] = frame;
+	cached_layouts_hashtable.add( key, idx );
+
+	return layout;
+}
+
+static void DrawTextLayout( const Font * font, const TextLayout & layout, float x, float y, Vec4 color, bool border, Vec4 border_color ) {
+	ImGuiShaderAndMaterial sam;
+	sam.shader = &shaders.text;
+	sam.material = &font->material;
+	sam.uniform_name = "u_Text";
+	sam.uniform_block = UploadUniformBlock( color, border_color, font->dSDF_dTexel, border ? 1 : 0 );
+
+	ImDrawList * bg = ImGui::GetBackgroundDrawList();
+	bg->PushTextureID( sam );
+
+	Vec2 origin = Vec2( x, y );
+	bg->PrimReserve( 6 * layout.quads.n, 4 * layout.quads.n );
+	for( const TextQuad & quad : layout.quads ) {
+		bg->PrimRectUV( origin + quad.position.mins, origin + quad.position.maxs, quad.uv.mins, quad.uv.maxs, IM_COL32_WHITE );
+	}
 
-	return MinMax2( pixel_size * Vec2( 0, y_extents.lo ), pixel_size * Vec2( width, y_extents.hi ) );
+	bg->PopTextureID();
+}
+
+void DrawText( const Font * font, float pixel_size, const char * str, float x, float y, Vec4 color, bool border ) {
+	if( font == NULL )
+		return;
+	TempAllocator temp = cls.frame_arena.temp();
+	Vec4 border_color = Vec4( 0, 0, 0, color.w );
+	DrawTextLayout( font, LayoutText( &temp, font, pixel_size, MakeSpan( str ) ), x, y, color, border, border_color );
+}
+
+void DrawText( const Font * font, float pixel_size, const char * str, float x, float y, Vec4 color, Vec4 border_color ) {
+	if( font == NULL )
+		return;
+	TempAllocator temp = cls.frame_arena.temp();
+	DrawTextLayout( font, LayoutText( &temp, font, pixel_size, MakeSpan( str ) ), x, y, color, true, border_color );
+}
+
+MinMax2 TextBounds( const Font * font, float pixel_size, const char * str ) {
+	TempAllocator temp = cls.frame_arena.temp();
+	return LayoutText( &temp, font, pixel_size, MakeSpan( str ) ).bounds;
 }
 
 static void DrawText( const Font * font, float pixel_size, const char * str, Alignment align, float x, float y, Vec4 color, bool border, Vec4 border_color ) {
-	MinMax2 bounds = TextBounds( font, pixel_size, str );
+	if( font == NULL )
+		return;
+
+	TempAllocator temp = cls.frame_arena.temp();
+	TextLayout layout = LayoutText( &temp, font, pixel_size, MakeSpan( str ) );
+	MinMax2 bounds = layout.bounds;
 
 	if( align.x == XAlignment_Center ) {
 		x -= bounds.maxs.x / 2.0f;
@@ -220,7 +343,7 @@ static void DrawText( const Font * font, float pixel_size, const char * str, Ali
 		y += ( bounds.maxs.y - bounds.mins.y ) / 2.0f;
 	}
 
-	DrawText( font, pixel_size, MakeSpan( str ), x, y, color, border, border_color );
+	DrawTextLayout( font, layout, x, y, color, border, border_color );
 }
 
 void DrawText( const Font * font, float pixel_size, const char * str, Alignment align, float x, float y, Vec4 color, bool border ) {
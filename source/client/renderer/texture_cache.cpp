@@ -0,0 +1,179 @@
+#include "qcommon/base.h"
+#include "qcommon/compression.h"
+#include "qcommon/fs.h"
+#include "qcommon/hash.h"
+#include "gameshared/q_shared.h"
+#include "client/renderer/texture_cache.h"
+
+#include "gg/ggentropy.h"
+
+#include "stb/stb_image.h"
+
+#include "zstd/zstd.h"
+
+struct TextureCacheHeader {
+	char magic[ 8 ];
+	u64 format_version;
+	u64 source_hash;
+	u32 format;
+	u32 width, height;
+	u32 num_mipmaps;
+	u64 texels_size;
+};
+
+constexpr const char TEXTURE_CACHE_MAGIC[ sizeof( TextureCacheHeader::magic ) ] = "cdtex";
+// bump this when the decoder changes
+constexpr u64 TEXTURE_CACHE_FORMAT_VERSION = 2;
+
+static const char * TextureCachePath( TempAllocator * temp, Span< const char > path ) {
+	return ( *temp )( "{}/cache/textures/{}.cdtex", HomeDirPath(), path );
+}
+
+static bool LoadFromTextureCache( const char * cache_path, u64 source_hash, DecodedTexture * texture ) {
+	TracyZoneScoped;
+
+	Span< u8 > file = ReadFileBinary( sys_allocator, cache_path );
+	if( file.ptr == NULL )
+		return false;
+	defer { Free( sys_allocator, file.ptr ); };
+
+	if( file.n < sizeof( TextureCacheHeader ) )
+		return false;
+
+	TextureCacheHeader header;
+	memcpy( &header, file.ptr, sizeof( header ) );
+
+	bool valid = memcmp( header.magic, TEXTURE_CACHE_MAGIC, sizeof( header.magic ) ) == 0
+		&& header.format_version == TEXTURE_CACHE_FORMAT_VERSION
+		&& header.source_hash == source_hash;
+	if( !valid )
+		return false;
+
+	Span< u8 > decompressed;
+	if( !Decompress( MakeSpan( cache_path ), sys_allocator, file + sizeof( header ), &decompressed ) )
+		return false;
+
+	if( decompressed.n != header.texels_size ) {
+		Free( sys_allocator, decompressed.ptr );
+		return false;
+	}
+
+	texture->format = TextureFormat( header.format );
+	texture->width = header.width;
+	texture->height = header.height;
+	texture->num_mipmaps = header.num_mipmaps;
+	texture->texels = decompressed;
+
+	return true;
+}
+
+static void WriteTextureCache( TempAllocator * temp, const char * cache_path, u64 source_hash, const DecodedTexture & texture ) {
+	TracyZoneScoped;
+
+	Span< const u8 > payload = texture.texels;
+
+	TextureCacheHeader header = { };
+	memcpy( header.magic, TEXTURE_CACHE_MAGIC, sizeof( header.magic ) );
+	header.format_version = TEXTURE_CACHE_FORMAT_VERSION;
+	header.source_hash = source_hash;
+	header.format = texture.format;
+	header.width = texture.width;
+	header.height = texture.height;
+	header.num_mipmaps = texture.num_mipmaps;
+	header.texels_size = texture.texels.n;
+
+	size_t max_size = sizeof( header ) + ZSTD_compressBound( payload.n );
+	u8 * file = AllocMany< u8 >( sys_allocator, max_size );
+	defer { Free( sys_allocator, file ); };
+
+	memcpy( file, &header, sizeof( header ) );
+
+	// favour decompression speed, this is all about startup time
+	size_t compressed_size = ZSTD_compress( file + sizeof( header ), max_size - sizeof( header ), payload.ptr, payload.n, 1 );
+	if( ZSTD_isError( compressed_size ) ) {
+		Com_Printf( S_COLOR_YELLOW "ZSTD_compress: %s\n", ZSTD_getErrorName( compressed_size ) );
+		return;
+	}
+
+	// other clients on the same machine can be decoding the same texture, so
+	// write somewhere unique and move it into place
+	u64 nonce;
+	if( !ggentropy( &nonce, sizeof( nonce ) ) ) {
+		return;
+	}
+
+	const char * tmp_path = ( *temp )( "{}.{016x}.tmp", cache_path, nonce );
+	if( !WriteFile( temp, tmp_path, file, sizeof( header ) + compressed_size ) ) {
+		return;
+	}
+
+	if( !MoveFile( temp, tmp_path, cache_path, MoveFile_DoReplace ) ) {
+		RemoveFile( temp, tmp_path );
+	}
+}
+
+static bool DecodeWithSTB( Span< const u8 > data, DecodedTexture * texture, const char ** failure_reason ) {
+	TracyZoneScopedN( "stbi_load_from_memory" );
+
+	int w, h, channels;
+	u8 * pixels = stbi_load_from_memory( data.ptr, data.num_bytes(), &w, &h, &channels, 0 );
+	if( pixels == NULL ) {
+		*failure_reason = stbi_failure_reason();
+		return false;
+	}
+	defer { stbi_image_free( pixels ); };
+
+	if( channels == 3 ) {
+		texture->format = TextureFormat_RGBA_U8_sRGB;
+	}
+	else {
+		constexpr TextureFormat formats[] = {
+			TextureFormat_R_U8,
+			TextureFormat_RA_U8,
+			{ },
+			TextureFormat_RGBA_U8_sRGB,
+		};
+		texture->format = formats[ channels - 1 ];
+	}
+
+	texture->width = checked_cast< u32 >( w );
+	texture->height = checked_cast< u32 >( h );
+	texture->num_mipmaps = 1;
+
+	size_t num_pixels = size_t( texture->width ) * size_t( texture->height );
+	size_t texels_size = num_pixels * ( texture->format == TextureFormat_RGBA_U8_sRGB ? 4 : channels );
+	u8 * memory = ( u8 * ) sys_allocator->allocate( texels_size, 16 );
+	texture->texels = Span< const u8 >( memory, texels_size );
+
+	if( channels == 3 ) {
+		TracyZoneScopedN( "RGB -> RGBA" );
+
+		RGBA8 * rgba_pixels = ( RGBA8 * ) memory;
+		for( size_t i = 0; i < num_pixels; i++ ) {
+			rgba_pixels[ i ] = RGBA8( pixels[ i * 3 + 0 ], pixels[ i * 3 + 1 ], pixels[ i * 3 + 2 ], 255 );
+		}
+	}
+	else {
+		memcpy( memory, pixels, texels_size );
+	}
+
+	return true;
+}
+
+bool DecodeTexture( TempAllocator * temp, Span< const char > path, Span< const u8 > data, DecodedTexture * texture, const char ** failure_reason ) {
+	TracyZoneScoped;
+	TracyZoneSpan( path );
+
+	u64 source_hash = Hash64( data.ptr, data.num_bytes() );
+	const char * cache_path = TextureCachePath( temp, path );
+
+	if( LoadFromTextureCache( cache_path, source_hash, texture ) )
+		return true;
+
+	if( !DecodeWithSTB( data, texture, failure_reason ) )
+		return false;
+
+	WriteTextureCache( temp, cache_path, source_hash, *texture );
+
+	return true;
+}
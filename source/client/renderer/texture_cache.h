@@ -0,0 +1,21 @@
+#pragma once
+
+#include "qcommon/types.h"
+#include "client/renderer/types.h"
+
+/*
+ * decodes pngs/jpgs into upload-ready texels, caching the results on disk
+ * keyed on the image's path so edits overwrite the old entry. entries store
+ * the hash of the source image and get rebuilt when it changes. doesn't
+ * touch the GPU
+ */
+
+struct DecodedTexture {
+	TextureFormat format;
+	u32 width, height;
+	u32 num_mipmaps;
+
+	Span< const u8 > texels; // allocated with sys_allocator
+};
+
+bool DecodeTexture( TempAllocator * temp, Span< const char > path, Span< const u8 > data, DecodedTexture * texture, const char ** failure_reason );
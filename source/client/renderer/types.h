@@ -146,6 +146,14 @@ struct Transform {
 	float scale;
 };
 
+// the keyframes each channel of a node last sampled from. keep one per node
+// per animated instance and sampling forwards doesn't need to search
+struct AnimationCursor {
+	u16 rotation;
+	u16 translation;
+	u16 scale;
+};
+
 struct MatrixPalettes {
 	Span< Mat3x4 > node_transforms;
 	Span< Mat3x4 > skinning_matrices;
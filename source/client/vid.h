@@ -25,6 +25,8 @@ bool operator!=( WindowMode lhs, WindowMode rhs );
 
 void VID_Init();
 
+bool IsHeadless();
+
 void CreateWindow( WindowMode mode );
 void DestroyWindow();
 
@@ -115,6 +115,7 @@ static bool G_VoteMapValidate( callvotedata_t *data, bool first ) {
 
 static void G_VoteMapPassed( callvotedata_t *vote ) {
 	ggformat( level.callvote_map, sizeof( level.callvote_map ), "{}", vote->argv[ 0 ] );
+	PreloadServerMap( MakeSpan( level.callvote_map ) );
 	G_EndMatch();
 }
 
@@ -290,6 +290,7 @@ void G_RunFrame( unsigned int msec ) {
 	TracyZoneScoped;
 
 	G_CheckCvars();
+	UpdateServerMapPreloads();
 
 	game.frametime = msec;
 	G_Timeout_Update( msec );
@@ -703,6 +703,8 @@ struct game_locals_t {
 	int64_t prevServerTime;         // last frame's server time
 
 	int numBots;
+
+	StringHash map; // held in the map cache until the next level
 };
 
 extern game_locals_t game;
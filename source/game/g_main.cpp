@@ -154,6 +154,9 @@ void G_Shutdown() {
 
 	G_FreeCallvotes();
 
+	ReleaseServerMap( game.map );
+	game.map = EMPTY_HASH;
+
 	for( int i = 0; i < game.numentities; i++ ) {
 		if( game.edicts[i].r.inuse ) {
 			G_FreeEdict( &game.edicts[i] );
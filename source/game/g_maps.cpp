@@ -2,52 +2,70 @@
 #include "qcommon/array.h"
 #include "qcommon/compression.h"
 #include "qcommon/fs.h"
+#include "qcommon/hashtable.h"
 #include "qcommon/string.h"
+#include "qcommon/threadpool.h"
+#include "qcommon/threads.h"
 #include "game/g_maps.h"
 #include "gameshared/cdmap.h"
 #include "gameshared/collision.h"
 #include "server/server.h"
 
-#include "cgltf/cgltf.h"
-
 static CollisionModelStorage collision_models;
 
+/*
+ * maps are cached and refcounted, so respawning the level or going back to
+ * an arena doesn't read and decompress it again. PreloadServerMap loads maps
+ * on a background thread, and they get added to the collision storage on the
+ * main thread by UpdateServerMapPreloads or whoever needs them first
+ */
+
+struct MapFile {
+	Span< const u8 > data;
+	bool memory_mapped;
+};
+
 struct ServerMapData {
 	StringHash base_hash;
-	Span< u8 > data;
+	MapFile file;
+	bool loading;
+	u32 refcount;
+	u64 last_used;
 };
 
-static BoundedDynamicArray< ServerMapData, CollisionModelStorage::MAX_MAPS > maps;
-
-static bool AddGLTFModel( Span< const u8 > data, Span< const char > path ) {
-	cgltf_options options = { };
-	options.type = cgltf_file_type_glb;
+static ServerMapData maps[ CollisionModelStorage::MAX_MAPS ];
+static Hashtable< CollisionModelStorage::MAX_MAPS * 2 > maps_hashtable;
+static u64 maps_clock;
 
-	cgltf_data * gltf;
-	if( cgltf_parse( &options, data.ptr, data.num_bytes(), &gltf ) != cgltf_result_success ) {
-		Com_GGPrint( S_COLOR_YELLOW "{} isn't a GLTF file", path );
-		return false;
-	}
-
-	defer { cgltf_free( gltf ); };
+struct MapLoadJob {
+	StringHash base_hash;
+	String< 256 > name;
+	MapFile file;
+	MapData decoded;
+	bool ok;
+};
 
-	if( !LoadGLBBuffers( gltf ) ) {
-		Com_GGPrint( S_COLOR_YELLOW "Couldn't load buffers in {}", path );
-		return false;
-	}
+struct MapLoader {
+	Thread * thread;
+	Mutex * mutex;
+	Semaphore * jobs_sem;
+	Semaphore * finished_sem;
+	bool shutting_down;
 
-	if( cgltf_validate( gltf ) != cgltf_result_success ) {
-		Com_GGPrint( S_COLOR_YELLOW "{} is invalid GLTF", path );
-		return false;
-	}
+	BoundedDynamicArray< MapLoadJob, CollisionModelStorage::MAX_MAPS > queue;
+	BoundedDynamicArray< MapLoadJob, CollisionModelStorage::MAX_MAPS > finished;
+};
 
-	StringHash name = StringHash( path );
-	LoadGLTFCollisionData( &collision_models, gltf, path, name );
+static MapLoader map_loader;
 
-	return true;
-}
+struct GLBLoadJob {
+	const char * path;
+	Span< const char > name;
+	GLTFCollisionData data;
+	bool has_collision;
+};
 
-static void LoadModelsRecursive( TempAllocator * temp, DynamicString * path, size_t skip ) {
+static void FindModelsRecursive( TempAllocator * temp, DynamicString * path, size_t skip, DynamicArray< GLBLoadJob > * jobs ) {
 	ListDirHandle scan = BeginListDir( temp, path->c_str() );
 
 	const char * name;
@@ -60,81 +78,371 @@ static void LoadModelsRecursive( TempAllocator * temp, DynamicString * path, siz
 		size_t old_len = path->length();
 		path->append( "/{}", name );
 		if( dir ) {
-			LoadModelsRecursive( temp, path, skip );
+			FindModelsRecursive( temp, path, skip, jobs );
 		}
-		else if( FileExtension( path->span() ) == ".glb" ) {
-			Span< u8 > data = ReadFileBinary( sys_allocator, path->c_str() );
-			AddGLTFModel( data, StripExtension( path->span() + skip ) );
-			Free( sys_allocator, data.ptr );
+		else if( FileExtension( path->c_str() ) == ".glb" ) {
+			GLBLoadJob job = { };
+			job.path = ( *temp )( "{}", path->c_str() );
+			job.name = StripExtension( MakeSpan( job.path ) + skip );
+			jobs->add( job );
 		}
 		path->truncate( old_len );
 	}
 }
 
-void InitServerCollisionModels() {
+// models get decoded in parallel but added in directory order so the
+// storage doesn't depend on scheduling
+static void LoadModels( TempAllocator * temp ) {
 	TracyZoneScoped;
 
-	InitCollisionModelStorage( &collision_models );
+	DynamicArray< GLBLoadJob > jobs( temp );
+	DynamicString base( temp, "{}/base", RootDirPath() );
+	FindModelsRecursive( temp, &base, base.length() + 1, &jobs );
 
-	TempAllocator temp = svs.frame_arena.temp();
-	DynamicString base( &temp, "{}/base", RootDirPath() );
-	LoadModelsRecursive( &temp, &base, base.length() + 1 );
+	ParallelFor( jobs.span(), []( TempAllocator * temp, void * data ) {
+		GLBLoadJob * job = ( GLBLoadJob * ) data;
+		Span< u8 > glb = ReadFileBinary( sys_allocator, job->path );
+		defer { Free( sys_allocator, glb.ptr ); };
+		job->has_collision = glb.ptr != NULL && DecodeGLBCollisionData( &job->data, job->name, glb );
+	} );
 
-	maps.clear();
+	for( const GLBLoadJob & job : jobs ) {
+		if( job.has_collision ) {
+			AddGLTFCollisionData( &collision_models, job.data, StringHash( job.name ) );
+		}
+	}
 }
 
-void ShutdownServerCollisionModels() {
-	TracyZoneScoped;
-
-	ShutdownCollisionModelStorage( &collision_models );
-
-	for( ServerMapData & map : maps ) {
-		Free( sys_allocator, map.data.ptr );
+static void FreeMapFile( MapFile file ) {
+	if( file.memory_mapped ) {
+		UnmapFile( file.data );
+	}
+	else {
+		Free( sys_allocator, const_cast< u8 * >( file.data.ptr ) );
 	}
 }
 
-bool LoadServerMap( Span< const char > name ) {
-	TempAllocator temp = svs.frame_arena.temp();
+// this runs on the loader thread too so it can't touch the frame arena
+static void LoadMap( MapLoadJob * job ) {
+	TracyZoneScoped;
+	TracyZoneSpan( job->name.span() );
+
+	job->ok = false;
 
-	const char * path = temp( "{}/base/maps/{}.cdmap", RootDirPath(), name );
+	char * path = ( *sys_allocator )( "{}/base/maps/{}.cdmap", RootDirPath(), job->name );
+	defer { Free( sys_allocator, path ); };
 
-	ServerMapData map;
-	map.base_hash = StringHash( name );
-	map.data = ReadFileBinary( sys_allocator, path );
+	// uncompressed maps get mapped so every server on the box shares the
+	// same pages, and only the sections we touch get read in. windows won't
+	// let dieselmap replace a file while it's mapped, so read it there instead
+#if PLATFORM_WINDOWS
+	job->file.data = ReadFileBinary( sys_allocator, path );
+	job->file.memory_mapped = false;
+#else
+	job->file.data = MemoryMapFile( sys_allocator, path );
+	job->file.memory_mapped = job->file.data.ptr != NULL;
+#endif
+
+	if( job->file.data.ptr == NULL ) {
+		char * zst_path = ( *sys_allocator )( "{}.zst", path );
+		defer { Free( sys_allocator, zst_path ); };
 
-	if( map.data.ptr == NULL ) {
-		const char * zst_path = temp( "{}.zst", path );
 		Span< u8 > compressed = ReadFileBinary( sys_allocator, zst_path );
 		defer { Free( sys_allocator, compressed.ptr ); };
 		if( compressed.ptr == NULL ) {
-			Com_GGPrint( "Couldn't find map {}", name );
-			return false;
+			Com_GGPrint( "Couldn't find map {}", job->name );
+			return;
 		}
 
-		bool ok = Decompress( MakeSpan( zst_path ), sys_allocator, compressed, &map.data );
+		Span< u8 > decompressed;
+		bool ok = Decompress( MakeSpan( zst_path ), sys_allocator, compressed, &decompressed );
 		if( !ok ) {
 			Com_Printf( "Couldn't decompress %s\n", zst_path );
-			return false;
+			return;
 		}
+
+		job->file.data = decompressed;
 	}
 
-	MapData decoded;
-	DecodeMapResult res = DecodeMap( &decoded, map.data );
+	DecodeMapResult res = DecodeMap( &job->decoded, job->file.data );
 	if( res != DecodeMapResult_Ok ) {
-		Com_GGPrint( "Can't decode map {}", name );
-		Free( sys_allocator, map.data.ptr );
-		return false;
+		Com_GGPrint( "Can't decode map {}", job->name );
+		FreeMapFile( job->file );
+		job->file = { };
+		return;
 	}
 
-	LoadMapCollisionData( &collision_models, &decoded, map.base_hash );
+	job->ok = true;
+}
+
+static void MapLoaderThread( void * data ) {
+	while( true ) {
+		Wait( map_loader.jobs_sem );
+
+		MapLoadJob job;
+		{
+			Lock( map_loader.mutex );
+			defer { Unlock( map_loader.mutex ); };
+
+			if( map_loader.shutting_down )
+				return;
+
+			// the main thread can steal jobs so the queue might be empty
+			if( map_loader.queue.size() == 0 )
+				continue;
 
-	if( !maps.add( map ) ) {
-		Fatal( "Too many maps" );
+			job = map_loader.queue[ 0 ];
+			for( size_t i = 1; i < map_loader.queue.size(); i++ ) {
+				map_loader.queue[ i - 1 ] = map_loader.queue[ i ];
+			}
+			map_loader.queue.pop();
+		}
+
+		LoadMap( &job );
+
+		{
+			Lock( map_loader.mutex );
+			defer { Unlock( map_loader.mutex ); };
+			[[maybe_unused]] bool ok = map_loader.finished.add( job );
+			Assert( ok );
+		}
+
+		Signal( map_loader.finished_sem );
 	}
+}
+
+static void RemoveMap( u64 idx ) {
+	ServerMapData * map = &maps[ idx ];
+	Assert( !map->loading );
+
+	UnloadMapCollisionData( &collision_models, map->base_hash );
+	FreeMapFile( map->file );
+
+	maps_hashtable.remove( map->base_hash.hash );
+	u64 last = maps_hashtable.size();
+	if( idx != last ) {
+		maps[ idx ] = maps[ last ];
+		maps_hashtable.update( maps[ idx ].base_hash.hash, idx );
+	}
+}
+
+static ServerMapData * AddMap( StringHash base_hash ) {
+	if( maps_hashtable.size() == ARRAY_COUNT( maps ) ) {
+		// evict whichever unreferenced map was used longest ago
+		Optional< u64 > lru = NONE;
+		for( u64 i = 0; i < maps_hashtable.size(); i++ ) {
+			if( maps[ i ].refcount > 0 || maps[ i ].loading )
+				continue;
+			if( !lru.exists || maps[ i ].last_used < maps[ lru.value ].last_used ) {
+				lru = i;
+			}
+		}
+
+		if( !lru.exists ) {
+			Fatal( "Too many maps" );
+		}
+
+		RemoveMap( lru.value );
+	}
+
+	u64 idx = maps_hashtable.size();
+	maps_hashtable.add( base_hash.hash, idx );
+
+	ServerMapData * map = &maps[ idx ];
+	*map = { };
+	map->base_hash = base_hash;
+	map->loading = true;
+	map->last_used = maps_clock++;
+
+	return map;
+}
+
+static void FinishLoadingMap( const MapLoadJob & job ) {
+	TracyZoneScoped;
+
+	u64 idx;
+	if( !maps_hashtable.get( job.base_hash.hash, &idx ) ) {
+		FreeMapFile( job.file );
+		return;
+	}
+
+	ServerMapData * map = &maps[ idx ];
+	map->loading = false;
+
+	if( !job.ok ) {
+		RemoveMap( idx );
+		return;
+	}
+
+	map->file = job.file;
+	LoadMapCollisionData( &collision_models, &job.decoded, job.base_hash );
+}
+
+void UpdateServerMapPreloads() {
+	Lock( map_loader.mutex );
+	defer { Unlock( map_loader.mutex ); };
+
+	for( const MapLoadJob & job : map_loader.finished ) {
+		FinishLoadingMap( job );
+	}
+	map_loader.finished.clear();
+}
+
+static void WaitForMap( StringHash base_hash ) {
+	TracyZoneScoped;
+
+	// if the loader hasn't got to it yet do it here instead of waiting for
+	// the rest of the queue
+	Optional< MapLoadJob > stolen = NONE;
+	{
+		Lock( map_loader.mutex );
+		defer { Unlock( map_loader.mutex ); };
+
+		for( size_t i = 0; i < map_loader.queue.size(); i++ ) {
+			if( map_loader.queue[ i ].base_hash == base_hash ) {
+				stolen = map_loader.queue[ i ];
+				for( size_t j = i + 1; j < map_loader.queue.size(); j++ ) {
+					map_loader.queue[ j - 1 ] = map_loader.queue[ j ];
+				}
+				map_loader.queue.pop();
+				break;
+			}
+		}
+	}
+
+	if( stolen.exists ) {
+		LoadMap( &stolen.value );
+		FinishLoadingMap( stolen.value );
+		return;
+	}
+
+	while( true ) {
+		UpdateServerMapPreloads();
+
+		u64 idx;
+		if( !maps_hashtable.get( base_hash.hash, &idx ) || !maps[ idx ].loading )
+			return;
+
+		Wait( map_loader.finished_sem );
+	}
+}
+
+void InitServerCollisionModels() {
+	TracyZoneScoped;
+
+	InitCollisionModelStorage( &collision_models );
+
+	TempAllocator temp = svs.frame_arena.temp();
+	LoadModels( &temp );
+
+	maps_hashtable.clear();
+
+	map_loader.mutex = NewMutex();
+	map_loader.jobs_sem = NewSemaphore();
+	map_loader.finished_sem = NewSemaphore();
+	map_loader.shutting_down = false;
+	map_loader.queue.clear();
+	map_loader.finished.clear();
+	map_loader.thread = NewThread( MapLoaderThread );
+}
+
+void ShutdownServerCollisionModels() {
+	TracyZoneScoped;
+
+	{
+		Lock( map_loader.mutex );
+		defer { Unlock( map_loader.mutex ); };
+		map_loader.shutting_down = true;
+	}
+
+	Signal( map_loader.jobs_sem );
+	JoinThread( map_loader.thread );
+
+	for( const MapLoadJob & job : map_loader.finished ) {
+		FreeMapFile( job.file );
+	}
+
+	DeleteSemaphore( map_loader.finished_sem );
+	DeleteSemaphore( map_loader.jobs_sem );
+	DeleteMutex( map_loader.mutex );
+
+	ShutdownCollisionModelStorage( &collision_models );
+
+	for( u64 i = 0; i < maps_hashtable.size(); i++ ) {
+		FreeMapFile( maps[ i ].file );
+	}
+	maps_hashtable.clear();
+}
+
+void PreloadServerMap( Span< const char > name ) {
+	TracyZoneScoped;
+
+	StringHash base_hash = StringHash( name );
+	u64 idx;
+	if( maps_hashtable.get( base_hash.hash, &idx ) )
+		return;
+
+	AddMap( base_hash );
+
+	MapLoadJob job = { };
+	job.base_hash = base_hash;
+	job.name.format( "{}", name );
+
+	{
+		Lock( map_loader.mutex );
+		defer { Unlock( map_loader.mutex ); };
+		[[maybe_unused]] bool ok = map_loader.queue.add( job );
+		Assert( ok );
+	}
+
+	Signal( map_loader.jobs_sem );
+}
+
+bool AcquireServerMap( StringHash name ) {
+	u64 idx;
+	if( !maps_hashtable.get( name.hash, &idx ) )
+		return false;
+
+	if( maps[ idx ].loading ) {
+		WaitForMap( name );
+		if( !maps_hashtable.get( name.hash, &idx ) )
+			return false;
+	}
+
+	maps[ idx ].refcount++;
+	maps[ idx ].last_used = maps_clock++;
 
 	return true;
 }
 
+void ReleaseServerMap( StringHash name ) {
+	u64 idx;
+	if( !maps_hashtable.get( name.hash, &idx ) )
+		return;
+
+	Assert( maps[ idx ].refcount > 0 );
+	maps[ idx ].refcount--;
+	maps[ idx ].last_used = maps_clock++;
+}
+
+bool LoadServerMap( Span< const char > name ) {
+	TracyZoneScoped;
+
+	StringHash base_hash = StringHash( name );
+	u64 idx;
+	if( !maps_hashtable.get( base_hash.hash, &idx ) ) {
+		AddMap( base_hash );
+
+		MapLoadJob job = { };
+		job.base_hash = base_hash;
+		job.name.format( "{}", name );
+		LoadMap( &job );
+		FinishLoadingMap( job );
+	}
+
+	return AcquireServerMap( base_hash );
+}
+
 const MapData * FindServerMap( StringHash name ) {
 	const MapSharedCollisionData * map = FindMapSharedCollisionData( &collision_models, name );
 	return map == NULL ? NULL : &map->data;
@@ -6,7 +6,13 @@
 void InitServerCollisionModels();
 void ShutdownServerCollisionModels();
 
+// these take a reference that has to be released with ReleaseServerMap
 bool LoadServerMap( Span< const char > name );
+bool AcquireServerMap( StringHash name );
+void ReleaseServerMap( StringHash name );
+
+void PreloadServerMap( Span< const char > name );
+void UpdateServerMapPreloads();
 
 struct MapData;
 struct MapSubModelCollisionData;
@@ -289,7 +289,11 @@ void G_InitLevel( Span< const char > mapname, int64_t levelTime ) {
 
 	memset( &server_gs.gameState, 0, sizeof( server_gs.gameState ) );
 	server_gs.gameState.map = StringHash( mapname );
-	LoadServerMap( mapname );// TODO: errors???
+
+	// take the new reference first so restarting the same map is a cache hit
+	StringHash old_map = game.map;
+	game.map = LoadServerMap( mapname ) ? StringHash( mapname ) : EMPTY_HASH; // TODO: errors???
+	ReleaseServerMap( old_map );
 	GClip_ClearWorld(); // clear areas links
 
 	G_SunCycle( Seconds( 0 ) );
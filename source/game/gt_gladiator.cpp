@@ -40,6 +40,7 @@ static struct GladiatorState {
 	RespawnQueues respawn_queues;
 
 	bool randomize_arena;
+	StringHash arena; // held in the map cache while we play on it
 
 	s64 bomb_action_time;
 	bool bomb_exploded;
@@ -74,7 +75,23 @@ static void BombKill() {
 }
 
 static void PickRandomArena() {
-	const GladiatorArena& arena = RandomElement( &svs.rng, arenas.span() );
+	// arenas load in the background so this is where we find out if one was broken
+	GladiatorArena arena;
+	while( true ) {
+		size_t idx = RandomUniform( &svs.rng, 0, arenas.size() );
+		arena = arenas[ idx ];
+		if( AcquireServerMap( arena.hash ) )
+			break;
+
+		arenas[ idx ] = arenas[ arenas.size() - 1 ];
+		arenas.resize( arenas.size() - 1 );
+		if( arenas.size() == 0 ) {
+			Fatal( "No gladiator arenas" );
+		}
+	}
+
+	ReleaseServerMap( gladiator_state.arena );
+	gladiator_state.arena = arena.hash;
 	server_gs.gameState.map = arena.hash;
 
 	constexpr auto PickRandomPerk = [](RNG * rng) {
@@ -459,9 +476,8 @@ static void LoadArenaFolder( const char * folder, PerkType perk, TempAllocator &
 			continue;
 
 		Span< const char > arena = temp.sv( "gladiator/{}/{}", folder, StripExtension( StripExtension( name ) ) );
-		if( LoadServerMap( arena ) ) {
-			arenas.add( { StringHash( arena ), perk } );
-		}
+		PreloadServerMap( arena );
+		arenas.add( { StringHash( arena ), perk } );
 	}
 }
 
@@ -481,6 +497,16 @@ static void LoadArenas() {
 	}
 }
 
+static void HotloadArenas() {
+	// the map cache got flushed so we don't have a reference to release
+	gladiator_state.arena = EMPTY_HASH;
+	LoadArenas();
+
+	if( AcquireServerMap( server_gs.gameState.map ) ) {
+		gladiator_state.arena = server_gs.gameState.map;
+	}
+}
+
 static void Gladiator_Init() {
 	server_gs.gameState.gametype = Gametype_Gladiator;
 	server_gs.gameState.scorelimit = 5;
@@ -503,6 +529,7 @@ static void Gladiator_Shutdown() {
 		server_gs.gameState.map = "gladiator";
 	}
 
+	ReleaseServerMap( gladiator_state.arena );
 	arenas.shutdown();
 }
 
@@ -526,7 +553,7 @@ GametypeDef GetGladiatorGametype() {
 	gt.PlayerKilled = Gladiator_PlayerKilled;
 	gt.SelectSpawnPoint = Gladiator_SelectSpawnPoint;
 	gt.Shutdown = Gladiator_Shutdown;
-	gt.MapHotloading = LoadArenas;
+	gt.MapHotloading = HotloadArenas;
 	gt.SpawnEntity = Gladiator_SpawnEntity;
 
 	gt.numTeams = Team_Count - Team_One;
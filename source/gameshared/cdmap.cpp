@@ -12,7 +12,7 @@ static bool DecodeMapSection( Span< T > * span, Span< const u8 > data, MapSectio
 	if( section.offset + section.size > data.n )
 		return false;
 
-	if( section.size % sizeof( T ) != 0 )
+	if( section.size % sizeof( T ) != 0 || section.offset % alignof( T ) != 0 )
 		return false;
 
 	*span = ( data + section.offset ).slice( 0, section.size ).cast< const T >();
@@ -44,9 +44,55 @@ DecodeMapResult DecodeMap( MapData * map, Span< const u8 > data ) {
 	ok = ok && DecodeMapSection( &map->vertex_normals, data, MapSection_VertexNormals );
 	ok = ok && DecodeMapSection( &map->vertex_indices, data, MapSection_VertexIndices );
 
+	ok = ok && map->vertex_positions.n == map->vertex_normals.n;
+	for( const MapMesh & mesh : map->meshes ) {
+		ok = ok && u64( mesh.first_vertex_index ) + mesh.num_vertices <= map->vertex_indices.n;
+		ok = ok && u64( mesh.base_vertex ) + mesh.num_unique_vertices <= map->vertex_positions.n;
+	}
+
 	return ok ? DecodeMapResult_Ok : DecodeMapResult_NotAMap;
 }
 
+Vec3 DequantizeMapPosition( const MapMesh & mesh, MapVertexPosition p ) {
+	Vec3 v = mesh.quantization_origin + Vec3( p.x, p.y, p.z ) * mesh.quantization_step;
+	if( v.z <= MAP_VOID_EXTEND_BELOW_Z ) {
+		v.z = MAP_VOID_Z;
+	}
+	return v;
+}
+
+/*
+ * https://knarkowicz.wordpress.com/2014/04/16/octahedron-normal-vector-encoding/
+ */
+
+static float SignNotZero( float x ) {
+	return x >= 0.0f ? 1.0f : -1.0f;
+}
+
+Vec3 DecodeMapNormal( MapVertexNormal n ) {
+	Vec2 f = Vec2( n.x, n.y ) / float( S16_MAX );
+	Vec3 v = Vec3( f.x, f.y, 1.0f - Abs( f.x ) - Abs( f.y ) );
+	if( v.z < 0.0f ) {
+		v.x = ( 1.0f - Abs( f.y ) ) * SignNotZero( f.x );
+		v.y = ( 1.0f - Abs( f.x ) ) * SignNotZero( f.y );
+	}
+	return Normalize( v );
+}
+
+MapVertexNormal EncodeMapNormal( Vec3 n ) {
+	n /= Abs( n.x ) + Abs( n.y ) + Abs( n.z );
+	Vec2 f = Vec2( n.x, n.y );
+	if( n.z < 0.0f ) {
+		f.x = ( 1.0f - Abs( n.y ) ) * SignNotZero( n.x );
+		f.y = ( 1.0f - Abs( n.x ) ) * SignNotZero( n.y );
+	}
+
+	MapVertexNormal encoded;
+	encoded.x = s16( roundf( Clamp( -1.0f, f.x, 1.0f ) * S16_MAX ) );
+	encoded.y = s16( roundf( Clamp( -1.0f, f.y, 1.0f ) * S16_MAX ) );
+	return encoded;
+}
+
 Span< const char > GetWorldspawnKey( const MapData * map, const char * key ) {
 	const MapEntity * worldspawn = &map->entities[ 0 ];
 
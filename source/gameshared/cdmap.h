@@ -38,7 +38,8 @@ struct MapHeader {
 };
 
 constexpr const char CDMAP_MAGIC[ sizeof( MapHeader::magic ) ] = "cdmap";
-constexpr u64 CDMAP_FORMAT_VERSION = 1;
+constexpr u64 CDMAP_FORMAT_VERSION = 4;
+constexpr size_t CDMAP_PAGE_SIZE = 4096;
 
 struct MapEntity {
 	u32 first_key_value;
@@ -90,12 +91,41 @@ struct MapBrush {
 	SolidBits solidity;
 };
 
+/*
+ * render geometry is split into spatial clusters so the renderer can cull
+ * them individually. each cluster has its own vertex range, so indices are
+ * u16s relative to base_vertex, and positions are u16s on a power of two grid
+ * starting at quantization_origin. the origin is a multiple of the step, so
+ * clusters with the same step quantize shared positions the same way, and
+ * dieselmap snaps positions shared with coarser clusters to the coarser grid
+ */
 struct MapMesh {
 	u64 material;
 	u32 first_vertex_index;
 	u32 num_vertices;
+	u32 base_vertex;
+	u32 num_unique_vertices;
+	MinMax3 bounds;
+	Vec3 quantization_origin;
+	float quantization_step;
+};
+
+STATIC_ASSERT( sizeof( MapMesh ) == 64 );
+
+struct MapVertexPosition {
+	u16 x, y, z;
 };
 
+// octahedral encoded
+struct MapVertexNormal {
+	s16 x, y;
+};
+
+// geometry below this gets pulled down to MAP_VOID_Z when decoding so walls
+// that go into the void never show their bottoms
+constexpr float MAP_VOID_EXTEND_BELOW_Z = -1024.0f;
+constexpr float MAP_VOID_Z = -999999.0f;
+
 struct MapData {
 	Span< const MapEntity > entities;
 	Span< const char > entity_data;
@@ -109,9 +139,9 @@ struct MapData {
 	Span< const Plane > brush_planes;
 
 	Span< const MapMesh > meshes;
-	Span< const Vec3 > vertex_positions;
-	Span< const Vec3 > vertex_normals;
-	Span< const u32 > vertex_indices;
+	Span< const MapVertexPosition > vertex_positions;
+	Span< const MapVertexNormal > vertex_normals;
+	Span< const u16 > vertex_indices;
 };
 
 enum DecodeMapResult {
@@ -122,4 +152,8 @@ enum DecodeMapResult {
 
 DecodeMapResult DecodeMap( MapData * map, Span< const u8 > data );
 
+Vec3 DequantizeMapPosition( const MapMesh & mesh, MapVertexPosition p );
+Vec3 DecodeMapNormal( MapVertexNormal n );
+MapVertexNormal EncodeMapNormal( Vec3 n );
+
 Span< const char > GetWorldspawnKey( const MapData * map, const char * key );
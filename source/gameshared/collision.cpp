@@ -1,5 +1,6 @@
 #include "qcommon/base.h"
 #include "qcommon/array.h"
+#include "qcommon/fs.h"
 #include "qcommon/hash.h"
 #include "qcommon/string.h"
 #include "gameshared/cdmap.h"
@@ -11,6 +12,7 @@
 #include "gameshared/q_math.h"
 
 #include "cgltf/cgltf.h"
+#include "gg/ggentropy.h"
 
 CollisionModel CollisionModelAABB( const MinMax3 & aabb ) {
 	return CollisionModel {
@@ -86,7 +88,10 @@ bool LoadGLBBuffers( cgltf_data * data ) {
 	return true;
 }
 
-bool LoadGLTFCollisionData( CollisionModelStorage * storage, const cgltf_data * gltf, Span< const char > path, StringHash name ) {
+// returns true with no brushes if the model just doesn't have any collision
+static bool ExtractGLTFCollisionData( GLTFCollisionData * out, const cgltf_data * gltf, Span< const char > path ) {
+	TracyZoneScoped;
+
 	NonRAIIDynamicArray< Vec3 > vertices( sys_allocator );
 	NonRAIIDynamicArray< Plane > planes( sys_allocator );
 	NonRAIIDynamicArray< GLTFCollisionBrush > brushes( sys_allocator );
@@ -216,7 +221,8 @@ bool LoadGLTFCollisionData( CollisionModelStorage * storage, const cgltf_data *
 	}
 
 	if( brushes.size() == 0 ) {
-		return false;
+		*out = { };
+		return true;
 	}
 
 	data.vertices = vertices.span();
@@ -239,6 +245,13 @@ bool LoadGLTFCollisionData( CollisionModelStorage * storage, const cgltf_data *
 		}
 	}
 
+	*out = data;
+
+	ok = true;
+	return true;
+}
+
+void AddGLTFCollisionData( CollisionModelStorage * storage, const GLTFCollisionData & data, StringHash name ) {
 	u64 idx = storage->gltfs_hashtable.size();
 	if( !storage->gltfs_hashtable.get( name.hash, &idx ) ) {
 		storage->gltfs_hashtable.add( name.hash, storage->gltfs_hashtable.size() );
@@ -248,11 +261,179 @@ bool LoadGLTFCollisionData( CollisionModelStorage * storage, const cgltf_data *
 	}
 
 	storage->gltfs[ idx ] = data;
+}
+
+bool LoadGLTFCollisionData( CollisionModelStorage * storage, const cgltf_data * gltf, Span< const char > path, StringHash name ) {
+	GLTFCollisionData data;
+	if( !ExtractGLTFCollisionData( &data, gltf, path ) || data.brushes.n == 0 )
+		return false;
+
+	AddGLTFCollisionData( storage, data, name );
+	return true;
+}
+
+/*
+ * cgltf parsing and the vertex/plane dedup above are most of the cost of
+ * loading models, so the results get cached on disk. entries are keyed on
+ * the model's path and store the hash of the .glb, so editing a model, or
+ * changing Hash64, overwrites the old entry instead of leaving it behind.
+ * models with no collision get cached too so we can skip them
+ */
+
+struct CollisionCacheHeader {
+	char magic[ 8 ];
+	u64 format_version;
+	u64 source_hash;
+	MinMax3 bounds;
+	u32 broadphase_solidity;
+	u32 num_vertices;
+	u32 num_planes;
+	u32 num_brushes;
+};
+
+constexpr const char COLLISION_CACHE_MAGIC[ sizeof( CollisionCacheHeader::magic ) ] = "cdcol";
+// bump this when ExtractGLTFCollisionData or the editor materials change
+constexpr u64 COLLISION_CACHE_FORMAT_VERSION = 1;
+
+template< typename T >
+static Span< T > CloneFromCache( Span< const u8 > * cursor, size_t n ) {
+	if( n == 0 )
+		return Span< T >();
+
+	Span< T > span = AllocSpan< T >( sys_allocator, n );
+	memcpy( span.ptr, cursor->ptr, span.num_bytes() );
+	*cursor = *cursor + span.num_bytes();
+	return span;
+}
+
+static bool LoadFromCollisionCache( const char * cache_path, u64 source_hash, GLTFCollisionData * data ) {
+	TracyZoneScoped;
+
+	Span< u8 > file = ReadFileBinary( sys_allocator, cache_path );
+	if( file.ptr == NULL )
+		return false;
+	defer { Free( sys_allocator, file.ptr ); };
+
+	if( file.n < sizeof( CollisionCacheHeader ) )
+		return false;
+
+	CollisionCacheHeader header;
+	memcpy( &header, file.ptr, sizeof( header ) );
+
+	size_t expected_size = sizeof( header )
+		+ size_t( header.num_vertices ) * sizeof( Vec3 )
+		+ size_t( header.num_planes ) * sizeof( Plane )
+		+ size_t( header.num_brushes ) * sizeof( GLTFCollisionBrush );
+
+	bool valid = memcmp( header.magic, COLLISION_CACHE_MAGIC, sizeof( header.magic ) ) == 0
+		&& header.format_version == COLLISION_CACHE_FORMAT_VERSION
+		&& header.source_hash == source_hash
+		&& file.n == expected_size;
+	if( !valid )
+		return false;
+
+	Span< const u8 > cursor = file + sizeof( header );
+
+	*data = { };
+	data->bounds = header.bounds;
+	data->broadphase_solidity = SolidBits( header.broadphase_solidity );
+	data->vertices = CloneFromCache< Vec3 >( &cursor, header.num_vertices );
+	data->planes = CloneFromCache< Plane >( &cursor, header.num_planes );
+	data->brushes = CloneFromCache< GLTFCollisionBrush >( &cursor, header.num_brushes );
 
-	ok = true;
 	return true;
 }
 
+static void WriteCollisionCache( const char * cache_path, u64 source_hash, const GLTFCollisionData & data ) {
+	TracyZoneScoped;
+
+	CollisionCacheHeader header = { };
+	memcpy( header.magic, COLLISION_CACHE_MAGIC, sizeof( header.magic ) );
+	header.format_version = COLLISION_CACHE_FORMAT_VERSION;
+	header.source_hash = source_hash;
+	header.bounds = data.bounds;
+	header.broadphase_solidity = data.broadphase_solidity;
+	header.num_vertices = checked_cast< u32 >( data.vertices.n );
+	header.num_planes = checked_cast< u32 >( data.planes.n );
+	header.num_brushes = checked_cast< u32 >( data.brushes.n );
+
+	size_t size = sizeof( header ) + data.vertices.num_bytes() + data.planes.num_bytes() + data.brushes.num_bytes();
+	u8 * file = AllocMany< u8 >( sys_allocator, size );
+	defer { Free( sys_allocator, file ); };
+
+	u8 * cursor = file;
+	memcpy( cursor, &header, sizeof( header ) );
+	cursor += sizeof( header );
+	memcpy( cursor, data.vertices.ptr, data.vertices.num_bytes() );
+	cursor += data.vertices.num_bytes();
+	memcpy( cursor, data.planes.ptr, data.planes.num_bytes() );
+	cursor += data.planes.num_bytes();
+	memcpy( cursor, data.brushes.ptr, data.brushes.num_bytes() );
+
+	// same deal as the texture cache, the client and a server on the same
+	// machine can load the same model at once so write somewhere unique and
+	// move it into place
+	u64 nonce;
+	if( !ggentropy( &nonce, sizeof( nonce ) ) ) {
+		return;
+	}
+
+	char * tmp_path = ( *sys_allocator )( "{}.{016x}.tmp", cache_path, nonce );
+	defer { Free( sys_allocator, tmp_path ); };
+	if( !WriteFile( sys_allocator, tmp_path, file, size ) ) {
+		return;
+	}
+
+	if( !MoveFile( sys_allocator, tmp_path, cache_path, MoveFile_DoReplace ) ) {
+		RemoveFile( sys_allocator, tmp_path );
+	}
+}
+
+static bool ParseGLBCollisionData( GLTFCollisionData * data, Span< const char > path, Span< const u8 > glb ) {
+	TracyZoneScoped;
+
+	cgltf_options options = { };
+	options.type = cgltf_file_type_glb;
+
+	cgltf_data * gltf;
+	if( cgltf_parse( &options, glb.ptr, glb.num_bytes(), &gltf ) != cgltf_result_success ) {
+		Com_GGPrint( S_COLOR_YELLOW "{} isn't a GLTF file", path );
+		return false;
+	}
+
+	defer { cgltf_free( gltf ); };
+
+	if( !LoadGLBBuffers( gltf ) ) {
+		Com_GGPrint( S_COLOR_YELLOW "Couldn't load buffers in {}", path );
+		return false;
+	}
+
+	if( cgltf_validate( gltf ) != cgltf_result_success ) {
+		Com_GGPrint( S_COLOR_YELLOW "{} is invalid GLTF", path );
+		return false;
+	}
+
+	return ExtractGLTFCollisionData( data, gltf, path );
+}
+
+bool DecodeGLBCollisionData( GLTFCollisionData * data, Span< const char > path, Span< const u8 > glb ) {
+	TracyZoneScoped;
+	TracyZoneSpan( path );
+
+	u64 source_hash = Hash64( glb.ptr, glb.num_bytes() );
+	char * cache_path = ( *sys_allocator )( "{}/cache/collision/{}.cdcol", HomeDirPath(), path );
+	defer { Free( sys_allocator, cache_path ); };
+
+	if( !LoadFromCollisionCache( cache_path, source_hash, data ) ) {
+		// broken models don't get cached so they keep complaining
+		if( !ParseGLBCollisionData( data, path, glb ) )
+			return false;
+		WriteCollisionCache( cache_path, source_hash, *data );
+	}
+
+	return data->brushes.n > 0;
+}
+
 static MinMax3 GLTFBounds( const GLTFCollisionData * gltf, const Mat3x4 & transform ) {
 	MinMax3 bounds = MinMax3::Empty();
 	for( const Vec3 & vert : gltf->vertices ) {
@@ -312,6 +493,24 @@ void LoadMapCollisionData( CollisionModelStorage * storage, const MapData * data
 	FillMapModelsHashtable( storage );
 }
 
+void UnloadMapCollisionData( CollisionModelStorage * storage, StringHash base_hash ) {
+	TracyZoneScoped;
+
+	u64 idx;
+	if( !storage->maps_hashtable.get( base_hash.hash, &idx ) )
+		return;
+
+	// keep maps packed so FillMapModelsHashtable can walk them
+	storage->maps_hashtable.remove( base_hash.hash );
+	u64 last = storage->maps_hashtable.size();
+	if( idx != last ) {
+		storage->maps[ idx ] = storage->maps[ last ];
+		storage->maps_hashtable.update( storage->maps[ idx ].base_hash.hash, idx );
+	}
+
+	FillMapModelsHashtable( storage );
+}
+
 const MapSharedCollisionData * FindMapSharedCollisionData( const CollisionModelStorage * storage, StringHash name ) {
 	u64 idx;
 	if( !storage->maps_hashtable.get( name.hash, &idx ) )
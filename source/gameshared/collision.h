@@ -59,9 +59,16 @@ struct cgltf_data;
 bool LoadGLBBuffers( cgltf_data * data );
 bool LoadGLTFCollisionData( CollisionModelStorage * storage, const cgltf_data * gltf, Span< const char > path, StringHash name );
 
+// parses a .glb, or pulls its collision out of the on-disk cache. thread safe,
+// returns false if the model has no collision, otherwise the result is owned
+// by the caller until it goes to AddGLTFCollisionData
+bool DecodeGLBCollisionData( GLTFCollisionData * data, Span< const char > path, Span< const u8 > glb );
+void AddGLTFCollisionData( CollisionModelStorage * storage, const GLTFCollisionData & data, StringHash name );
+
 const GLTFCollisionData * FindGLTFSharedCollisionData( const CollisionModelStorage * storage, StringHash name );
 
 void LoadMapCollisionData( CollisionModelStorage * storage, const MapData * map, StringHash base_hash );
+void UnloadMapCollisionData( CollisionModelStorage * storage, StringHash base_hash );
 
 const MapSharedCollisionData * FindMapSharedCollisionData( const CollisionModelStorage * storage, StringHash name );
 const MapSubModelCollisionData * FindMapSubModelCollisionData( const CollisionModelStorage * storage, StringHash name );
@@ -433,6 +433,115 @@ MinMax1 Union( MinMax1 a, MinMax1 b ) {
 	return MinMax1( Min2( a.lo, b.lo ), Max2( a.hi, b.hi ) );
 }
 
+MinMax3 TransformBounds( const Mat3x4 & transform, const MinMax3 & bounds ) {
+	// transform the center and project the extents onto the new axes
+	Vec3 center = ( bounds.mins + bounds.maxs ) * 0.5f;
+	Vec3 extents = ( bounds.maxs - bounds.mins ) * 0.5f;
+
+	Vec3 new_center = ( transform * Vec4( center, 1.0f ) ).xyz();
+	Vec3 new_extents = Vec3(
+		Abs( transform.col0.x ) * extents.x + Abs( transform.col1.x ) * extents.y + Abs( transform.col2.x ) * extents.z,
+		Abs( transform.col0.y ) * extents.x + Abs( transform.col1.y ) * extents.y + Abs( transform.col2.y ) * extents.z,
+		Abs( transform.col0.z ) * extents.x + Abs( transform.col1.z ) * extents.y + Abs( transform.col2.z ) * extents.z
+	);
+
+	return MinMax3( new_center - new_extents, new_center + new_extents );
+}
+
+static Plane FrustumPlane( Vec4 clip_plane ) {
+	// clip_plane is inside when Dot( clip_plane.xyz, p ) + clip_plane.w >= 0
+	float inv_length = 1.0f / Length( clip_plane.xyz() );
+	return Plane {
+		.normal = -clip_plane.xyz() * inv_length,
+		.distance = clip_plane.w * inv_length,
+	};
+}
+
+Frustum FrustumFromMatrix( const Mat4 & VP, bool near_plane, bool far_plane ) {
+	// Gribb and Hartmann, "Fast Extraction of Viewing Frustum Planes from the World-View-Projection Matrix"
+	Frustum frustum = { };
+	frustum.planes[ frustum.num_planes++ ] = FrustumPlane( VP.row3() + VP.row0() );
+	frustum.planes[ frustum.num_planes++ ] = FrustumPlane( VP.row3() - VP.row0() );
+	frustum.planes[ frustum.num_planes++ ] = FrustumPlane( VP.row3() + VP.row1() );
+	frustum.planes[ frustum.num_planes++ ] = FrustumPlane( VP.row3() - VP.row1() );
+	if( near_plane ) {
+		frustum.planes[ frustum.num_planes++ ] = FrustumPlane( VP.row3() + VP.row2() );
+	}
+	if( far_plane ) {
+		frustum.planes[ frustum.num_planes++ ] = FrustumPlane( VP.row3() - VP.row2() );
+	}
+	return frustum;
+}
+
+bool BoxInFrustum( const Frustum & frustum, const MinMax3 & bounds ) {
+	Vec3 center = ( bounds.mins + bounds.maxs ) * 0.5f;
+	Vec3 extents = ( bounds.maxs - bounds.mins ) * 0.5f;
+
+	for( u32 i = 0; i < frustum.num_planes; i++ ) {
+		const Plane & plane = frustum.planes[ i ];
+		Vec3 abs_normal = Vec3( Abs( plane.normal.x ), Abs( plane.normal.y ), Abs( plane.normal.z ) );
+		float closest = Dot( plane.normal, center ) - Dot( abs_normal, extents );
+		if( closest > plane.distance ) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+TEST( "Frustum culling" ) {
+	// 90 degree FOV looking down -Z with an infinite far plane, like the renderer
+	constexpr float near_plane = 4.0f;
+	constexpr float epsilon = 4.8e-7f;
+	Mat4 P = Mat4(
+		1.0f, 0.0f, 0.0f, 0.0f,
+		0.0f, 1.0f, 0.0f, 0.0f,
+		0.0f, 0.0f, epsilon - 1.0f, ( epsilon - 2.0f ) * near_plane,
+		0.0f, 0.0f, -1.0f, 0.0f
+	);
+	Frustum view = FrustumFromMatrix( P, true, false );
+
+	bool ok = true;
+	ok = ok && BoxInFrustum( view, MinMax3( Vec3( -1.0f, -1.0f, -101.0f ), Vec3( 1.0f, 1.0f, -99.0f ) ) );
+	ok = ok && BoxInFrustum( view, MinMax3( Vec3( -1.0f, -1.0f, -1000001.0f ), Vec3( 1.0f, 1.0f, -999999.0f ) ) );
+	ok = ok && BoxInFrustum( view, MinMax3( Vec3( 90.0f, -1.0f, -101.0f ), Vec3( 110.0f, 1.0f, -99.0f ) ) ); // straddles the right plane
+	ok = ok && BoxInFrustum( view, MinMax3( Vec3( -1.0f, -1.0f, -5.0f ), Vec3( 1.0f, 1.0f, 5.0f ) ) ); // straddles the near plane
+	ok = ok && !BoxInFrustum( view, MinMax3( Vec3( -1.0f, -1.0f, 99.0f ), Vec3( 1.0f, 1.0f, 101.0f ) ) ); // behind
+	ok = ok && !BoxInFrustum( view, MinMax3( Vec3( 199.0f, -1.0f, -101.0f ), Vec3( 201.0f, 1.0f, -99.0f ) ) ); // right
+	ok = ok && !BoxInFrustum( view, MinMax3( Vec3( -1.0f, -201.0f, -101.0f ), Vec3( 1.0f, -199.0f, -99.0f ) ) ); // below
+	ok = ok && !BoxInFrustum( view, MinMax3( Vec3( -1.0f, -1.0f, -3.0f ), Vec3( 1.0f, 1.0f, -2.0f ) ) ); // in front of the near plane
+
+	// camera at ( 0, 0, 500 ) looking down -Z, rotated 90 degrees about Z
+	Mat3x4 V = Mat3x4(
+		0.0f, 1.0f, 0.0f, 0.0f,
+		-1.0f, 0.0f, 0.0f, 0.0f,
+		0.0f, 0.0f, 1.0f, -500.0f
+	);
+	Frustum moved = FrustumFromMatrix( P * Mat4( V ), true, false );
+	ok = ok && BoxInFrustum( moved, MinMax3( Vec3( -1.0f, -1.0f, 399.0f ), Vec3( 1.0f, 1.0f, 401.0f ) ) );
+	ok = ok && !BoxInFrustum( moved, MinMax3( Vec3( -1.0f, -1.0f, 599.0f ), Vec3( 1.0f, 1.0f, 601.0f ) ) );
+	ok = ok && !BoxInFrustum( moved, MinMax3( Vec3( -1.0f, 199.0f, 399.0f ), Vec3( 1.0f, 201.0f, 401.0f ) ) );
+
+	// orthographic shadow cascade covering [-100, 100] on X and Y and depth [0, 200] down -Z, without the near plane
+	Mat4 ortho = Mat4(
+		0.01f, 0.0f, 0.0f, 0.0f,
+		0.0f, 0.01f, 0.0f, 0.0f,
+		0.0f, 0.0f, -0.01f, -1.0f,
+		0.0f, 0.0f, 0.0f, 1.0f
+	);
+	Frustum cascade = FrustumFromMatrix( ortho, false, true );
+	ok = ok && BoxInFrustum( cascade, MinMax3( Vec3( -1.0f, -1.0f, -101.0f ), Vec3( 1.0f, 1.0f, -99.0f ) ) );
+	ok = ok && BoxInFrustum( cascade, MinMax3( Vec3( -1.0f, -1.0f, 499.0f ), Vec3( 1.0f, 1.0f, 501.0f ) ) ); // between the light and the cascade
+	ok = ok && !BoxInFrustum( cascade, MinMax3( Vec3( -1.0f, -1.0f, -301.0f ), Vec3( 1.0f, 1.0f, -299.0f ) ) ); // past the far plane
+	ok = ok && !BoxInFrustum( cascade, MinMax3( Vec3( 149.0f, -1.0f, -101.0f ), Vec3( 151.0f, 1.0f, -99.0f ) ) );
+
+	// rotating a box 90 degrees about Z swaps its X and Y extents
+	MinMax3 rotated = TransformBounds( V, MinMax3( Vec3( -1.0f, -2.0f, -3.0f ), Vec3( 1.0f, 2.0f, 3.0f ) ) );
+	ok = ok && rotated.mins == Vec3( -2.0f, -1.0f, -503.0f ) && rotated.maxs == Vec3( 2.0f, 1.0f, -497.0f );
+
+	return ok;
+}
+
 u32 Log2( u64 x ) {
 	u32 log = 0;
 	x >>= 1;
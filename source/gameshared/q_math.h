@@ -119,4 +119,15 @@ MinMax3 Union( const MinMax3 & a, const MinMax3 & b );
 MinMax1 Union( MinMax1 bounds, float x );
 MinMax1 Union( MinMax1 a, MinMax1 b );
 
+MinMax3 TransformBounds( const Mat3x4 & transform, const MinMax3 & bounds );
+
+// planes face outwards, so points are inside when Dot( normal, p ) <= distance for every plane
+struct Frustum {
+	Plane planes[ 6 ];
+	u32 num_planes;
+};
+
+Frustum FrustumFromMatrix( const Mat4 & VP, bool near_plane, bool far_plane );
+bool BoxInFrustum( const Frustum & frustum, const MinMax3 & bounds );
+
 u32 Log2( u64 x );
@@ -2,11 +2,8 @@
 #include "gameshared/collision.h"
 
 static inline u64 GetCellHash( s32 x, s32 y, s32 z ) {
-	u64 hash;
-	hash = Hash64( &x, sizeof( x ) );
-	hash = Hash64( &y, sizeof( y ), hash );
-	hash = Hash64( &z, sizeof( z ), hash );
-	return hash;
+	s32 cell[] = { x, y, z };
+	return Hash64( cell, sizeof( cell ) );
 }
 
 static SpatialHashBounds GetSpatialHashBounds( MinMax3 bounds ) {
@@ -11,7 +11,14 @@ struct Vsay {
 	constexpr Vsay( Span< const char > d, Span< const char > n )
 		: description( d ),
 		short_name( n ),
-		sfx( Hash64_CT( n.ptr, n.n, Hash64_CT( "sounds/vsay/" ) ) ) { }
+		sfx( SfxHash( n ) ) { }
+
+	static constexpr StringHash SfxHash( Span< const char > name ) {
+		Hasher64 hasher;
+		hasher.add( "sounds/vsay/" );
+		hasher.add( name );
+		return StringHash( hasher.finish() );
+	}
 };
 
 constexpr Vsay vsays[] = {
@@ -23,6 +23,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "qcommon/fpe.h"
 #include "qcommon/fs.h"
 #include "qcommon/maplist.h"
+#include "qcommon/threadpool.h"
 #include "qcommon/threads.h"
 #include "qcommon/time.h"
 
@@ -279,6 +280,8 @@ void Qcommon_Init( int argc, char ** argv ) {
 
 	InitMapList();
 
+	InitThreadPool();
+
 	SV_Init();
 	CL_Init();
 
@@ -336,6 +339,8 @@ void Qcommon_Shutdown() {
 	SV_Shutdown( "Server quit\n" );
 	CL_Shutdown();
 
+	ShutdownThreadPool();
+
 	ShutdownMapList();
 
 	Netchan_Shutdown();
@@ -0,0 +1,399 @@
+#include "qcommon/base.h"
+#include "qcommon/dynamic_hashtable.h"
+
+#include <bit>
+
+#if ARCHITECTURE_X64
+#include <emmintrin.h>
+#else
+#include <arm_neon.h>
+#endif
+
+/*
+ * control bytes are EMPTY, DELETED or the low 7 bits of a full slot's hash,
+ * so a group tells us which slots might hold the key, and whether the probe
+ * can stop here, without touching the entries. groups start at multiples of
+ * 16 and get probed in triangular order, which visits every group when the
+ * group count is a power of 2. inserts go in the first EMPTY or DELETED slot
+ * along the probe sequence, and lookups stop at the first group with an EMPTY
+ */
+
+static constexpr u8 CTRL_EMPTY = 0x80;
+static constexpr u8 CTRL_DELETED = 0xFE;
+
+static constexpr size_t GROUP_SIZE = 16;
+static constexpr size_t MIN_CAPACITY = GROUP_SIZE;
+
+// each add/remove moves this many slots from the old table into the new one.
+// it only has to be a few times bigger than 8/7 to finish before the new
+// table wants to grow again
+static constexpr size_t MIGRATE_SLOTS_PER_OP = 32;
+
+static bool IsFull( u8 ctrl ) {
+	return ( ctrl & 0x80 ) == 0;
+}
+
+static size_t MaxLoad( size_t capacity ) {
+	return capacity - capacity / 8;
+}
+
+// keys are usually hashes already but they might be small integers, and we
+// take the probe position and the control byte from different bits
+static u64 MixKey( u64 key ) {
+	key ^= key >> 32;
+	key *= 0xd6e8feb86659fd93_u64;
+	key ^= key >> 32;
+	return key;
+}
+
+struct GroupMask {
+	u64 bits;
+
+#if ARCHITECTURE_X64
+	static constexpr u32 shift = 0;
+#else
+	static constexpr u32 shift = 2;
+#endif
+
+	bool any() const { return bits != 0; }
+	size_t lowest() const { return size_t( std::countr_zero( bits ) ) >> shift; }
+	void clear_lowest() { bits &= bits - 1; }
+};
+
+#if ARCHITECTURE_X64
+
+struct Group {
+	__m128i ctrl;
+
+	explicit Group( const u8 * p ) {
+		ctrl = _mm_loadu_si128( ( const __m128i * ) p );
+	}
+
+	GroupMask match( u8 h2 ) const {
+		return { u64( _mm_movemask_epi8( _mm_cmpeq_epi8( ctrl, _mm_set1_epi8( char( h2 ) ) ) ) ) };
+	}
+
+	GroupMask match_empty() const {
+		return match( CTRL_EMPTY );
+	}
+
+	GroupMask match_empty_or_deleted() const {
+		return { u64( _mm_movemask_epi8( ctrl ) ) };
+	}
+};
+
+#else
+
+// NEON has no movemask, narrowing the compare result gives 4 bits per byte
+// and we keep the top one
+struct Group {
+	uint8x16_t ctrl;
+
+	explicit Group( const u8 * p ) {
+		ctrl = vld1q_u8( p );
+	}
+
+	static GroupMask to_mask( uint8x16_t eq ) {
+		u64 bits = vget_lane_u64( vreinterpret_u64_u8( vshrn_n_u16( vreinterpretq_u16_u8( eq ), 4 ) ), 0 );
+		return { bits & 0x8888888888888888_u64 };
+	}
+
+	GroupMask match( u8 h2 ) const {
+		return to_mask( vceqq_u8( ctrl, vdupq_n_u8( h2 ) ) );
+	}
+
+	GroupMask match_empty() const {
+		return match( CTRL_EMPTY );
+	}
+
+	GroupMask match_empty_or_deleted() const {
+		return to_mask( vcltq_s8( vreinterpretq_s8_u8( ctrl ), vdupq_n_s8( 0 ) ) );
+	}
+};
+
+#endif
+
+template< typename Table >
+static Table NewTable( Allocator * a, size_t capacity ) {
+	Table t = { };
+	if( capacity == 0 )
+		return t;
+
+	u8 * memory = AllocMany< u8 >( a, capacity + capacity * sizeof( t.entries[ 0 ] ) );
+	t.ctrl = memory;
+	t.entries = ( decltype( t.entries ) ) ( memory + capacity );
+	t.capacity = capacity;
+	t.size = 0;
+	t.growth_left = MaxLoad( capacity );
+	memset( t.ctrl, CTRL_EMPTY, capacity );
+
+	return t;
+}
+
+template< typename Table >
+static s64 FindSlot( const Table & t, u64 key, u64 hash ) {
+	if( t.size == 0 )
+		return -1;
+
+	u8 h2 = u8( hash & 0x7F );
+	size_t group_mask = t.capacity / GROUP_SIZE - 1;
+	size_t group = size_t( hash >> 7 ) & group_mask;
+	for( size_t step = 1; ; step++ ) {
+		size_t base = group * GROUP_SIZE;
+		Group g( t.ctrl + base );
+		for( GroupMask m = g.match( h2 ); m.any(); m.clear_lowest() ) {
+			size_t i = base + m.lowest();
+			if( t.entries[ i ].key == key ) {
+				return s64( i );
+			}
+		}
+		if( g.match_empty().any() )
+			return -1;
+		group = ( group + step ) & group_mask;
+	}
+}
+
+// returns the key's slot if it's there, otherwise the first free slot along
+// its probe sequence, which is where it should go
+template< typename Table >
+static size_t FindOrFreeSlot( const Table & t, u64 key, u64 hash, bool * found ) {
+	u8 h2 = u8( hash & 0x7F );
+	size_t group_mask = t.capacity / GROUP_SIZE - 1;
+	size_t group = size_t( hash >> 7 ) & group_mask;
+	size_t free_slot = SIZE_MAX;
+	for( size_t step = 1; ; step++ ) {
+		size_t base = group * GROUP_SIZE;
+		Group g( t.ctrl + base );
+		for( GroupMask m = g.match( h2 ); m.any(); m.clear_lowest() ) {
+			size_t i = base + m.lowest();
+			if( t.entries[ i ].key == key ) {
+				*found = true;
+				return i;
+			}
+		}
+
+		GroupMask free = g.match_empty_or_deleted();
+		if( free_slot == SIZE_MAX && free.any() ) {
+			free_slot = base + free.lowest();
+		}
+
+		if( g.match_empty().any() ) {
+			*found = false;
+			return free_slot;
+		}
+
+		group = ( group + step ) & group_mask;
+	}
+}
+
+template< typename Table >
+static void Place( Table * t, size_t slot, u64 key, u64 hash, u64 value ) {
+	if( t->ctrl[ slot ] == CTRL_EMPTY ) {
+		Assert( t->growth_left > 0 );
+		t->growth_left--;
+	}
+
+	t->ctrl[ slot ] = u8( hash & 0x7F );
+	t->entries[ slot ].key = key;
+	t->entries[ slot ].value = value;
+	t->size++;
+}
+
+// the caller has to make sure the key isn't already there and there's room
+template< typename Table >
+static void Insert( Table * t, u64 key, u64 hash, u64 value ) {
+	size_t group_mask = t->capacity / GROUP_SIZE - 1;
+	size_t group = size_t( hash >> 7 ) & group_mask;
+	for( size_t step = 1; ; step++ ) {
+		size_t base = group * GROUP_SIZE;
+		GroupMask m = Group( t->ctrl + base ).match_empty_or_deleted();
+		if( m.any() ) {
+			Place( t, base + m.lowest(), key, hash, value );
+			return;
+		}
+		group = ( group + step ) & group_mask;
+	}
+}
+
+void NonRAIIDynamicHashtable::init( Allocator * a_ ) {
+	a = a_;
+	table = { };
+	old = { };
+	old_cursor = 0;
+}
+
+void NonRAIIDynamicHashtable::shutdown() {
+	Free( a, table.ctrl );
+	free_old();
+}
+
+void NonRAIIDynamicHashtable::free_old() {
+	Free( a, old.ctrl );
+	old = { };
+	old_cursor = 0;
+}
+
+NonRAIIDynamicHashtable::Entry * NonRAIIDynamicHashtable::find( u64 key ) const {
+	u64 hash = MixKey( key );
+
+	s64 i = FindSlot( table, key, hash );
+	if( i >= 0 )
+		return &table.entries[ i ];
+
+	i = FindSlot( old, key, hash );
+	if( i >= 0 )
+		return &old.entries[ i ];
+
+	return NULL;
+}
+
+void NonRAIIDynamicHashtable::migrate_some( size_t slots ) {
+	if( old.capacity == 0 )
+		return;
+
+	size_t end = Min2( old_cursor + slots, old.capacity );
+	for( size_t i = old_cursor; i < end; i++ ) {
+		if( !IsFull( old.ctrl[ i ] ) )
+			continue;
+
+		const Entry & e = old.entries[ i ];
+		Insert( &table, e.key, MixKey( e.key ), e.value );
+		old.ctrl[ i ] = CTRL_DELETED;
+		old.size--;
+	}
+	old_cursor = end;
+
+	if( old_cursor == old.capacity || old.size == 0 ) {
+		free_old();
+	}
+}
+
+void NonRAIIDynamicHashtable::grow() {
+	TracyZoneScoped;
+
+	// only happens if we grow twice in quick succession at tiny sizes
+	migrate_some( old.capacity );
+
+	// if it's mostly tombstones rebuild at the same size
+	size_t capacity = table.capacity == 0 ? MIN_CAPACITY : table.capacity;
+	if( table.size >= MaxLoad( capacity ) / 2 ) {
+		capacity *= 2;
+	}
+
+	old = table;
+	old_cursor = 0;
+	table = NewTable< Table >( a, capacity );
+
+	if( old.size == 0 ) {
+		free_old();
+	}
+}
+
+bool NonRAIIDynamicHashtable::add( u64 key, u64 value ) {
+	u64 hash = MixKey( key );
+	if( FindSlot( old, key, hash ) >= 0 )
+		return false;
+
+	// find the key and where it would go in one probe. we can only use that
+	// slot if taking it doesn't need a grow
+	bool placed = false;
+	if( table.capacity > 0 ) {
+		bool found;
+		size_t slot = FindOrFreeSlot( table, key, hash, &found );
+		if( found )
+			return false;
+
+		if( table.growth_left > 0 || table.ctrl[ slot ] == CTRL_DELETED ) {
+			Place( &table, slot, key, hash, value );
+			placed = true;
+		}
+	}
+
+	if( !placed ) {
+		grow();
+		Insert( &table, key, hash, value );
+	}
+
+	migrate_some( MIGRATE_SLOTS_PER_OP );
+
+	return true;
+}
+
+bool NonRAIIDynamicHashtable::update( u64 key, u64 value ) {
+	Entry * e = find( key );
+	if( e == NULL )
+		return false;
+	e->value = value;
+	return true;
+}
+
+bool NonRAIIDynamicHashtable::get( u64 key, u64 * value ) const {
+	const Entry * e = find( key );
+	if( e == NULL )
+		return false;
+	*value = e->value;
+	return true;
+}
+
+bool NonRAIIDynamicHashtable::remove( u64 key ) {
+	u64 hash = MixKey( key );
+
+	s64 i = FindSlot( table, key, hash );
+	if( i >= 0 ) {
+		table.ctrl[ i ] = CTRL_DELETED;
+		table.size--;
+	}
+	else {
+		i = FindSlot( old, key, hash );
+		if( i < 0 )
+			return false;
+		old.ctrl[ i ] = CTRL_DELETED;
+		old.size--;
+	}
+
+	migrate_some( MIGRATE_SLOTS_PER_OP );
+	return true;
+}
+
+void NonRAIIDynamicHashtable::clear() {
+	free_old();
+	if( table.capacity > 0 ) {
+		memset( table.ctrl, CTRL_EMPTY, table.capacity );
+		table.size = 0;
+		table.growth_left = MaxLoad( table.capacity );
+	}
+}
+
+TEST( "DynamicHashtable" ) {
+	DynamicHashtable hashtable( sys_allocator );
+
+	// small integer keys, enough to grow a bunch of times with migrations
+	// still in flight
+	constexpr u64 N = 5000;
+	bool ok = true;
+	for( u64 i = 0; i < N; i++ ) {
+		ok = ok && hashtable.add( i, i * 2 );
+		ok = ok && !hashtable.add( i, 0 );
+	}
+
+	for( u64 i = 0; i < N; i += 2 ) {
+		ok = ok && hashtable.remove( i );
+	}
+	ok = ok && !hashtable.remove( 0 ) && hashtable.size() == N / 2;
+
+	for( u64 i = 0; i < N; i++ ) {
+		u64 value;
+		bool found = hashtable.get( i, &value );
+		ok = ok && found == ( i % 2 == 1 ) && ( !found || value == i * 2 );
+	}
+
+	ok = ok && hashtable.update( 1, 123 ) && !hashtable.update( 2, 123 );
+
+	u64 value;
+	ok = ok && hashtable.get( 1, &value ) && value == 123;
+
+	hashtable.clear();
+	ok = ok && hashtable.size() == 0 && !hashtable.get( 1, &value );
+
+	return ok;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "qcommon/types.h"
+
+/*
+ * growable u64 -> u64 map with the same interface as Hashtable. it's a
+ * Swiss table: a control byte per slot holds 7 bits of the hash, and probing
+ * checks 16 control bytes at a time with SIMD so most lookups touch one
+ * group and one entry. unlike Hashtable any key is fine, including 0.
+ *
+ * growing doesn't rehash everything at once. the old table hangs around and
+ * each add/remove moves a few of its slots over, so one insert never costs
+ * more than a handful of others
+ */
+
+class NonRAIIDynamicHashtable {
+	struct Entry {
+		u64 key;
+		u64 value;
+	};
+
+	struct Table {
+		u8 * ctrl;
+		Entry * entries;
+		size_t capacity;
+		size_t size;
+		size_t growth_left;
+	};
+
+	Allocator * a;
+	Table table;
+	Table old;
+	size_t old_cursor;
+
+public:
+	NonRAIIDynamicHashtable() = default;
+
+	void init( Allocator * a_ );
+	void shutdown();
+
+	bool add( u64 key, u64 value );
+	bool update( u64 key, u64 value );
+	bool get( u64 key, u64 * value ) const;
+	bool remove( u64 key );
+
+	void clear();
+	size_t size() const { return table.size + old.size; }
+
+private:
+	void grow();
+	void migrate_some( size_t slots );
+	void free_old();
+	Entry * find( u64 key ) const;
+};
+
+class DynamicHashtable : public NonRAIIDynamicHashtable {
+	using NonRAIIDynamicHashtable::init;
+	using NonRAIIDynamicHashtable::shutdown;
+
+public:
+	NONCOPYABLE( DynamicHashtable );
+
+	DynamicHashtable( Allocator * a_ ) {
+		init( a_ );
+	}
+
+	~DynamicHashtable() {
+		shutdown();
+	}
+};
@@ -26,6 +26,10 @@ Span< const char > HomeDirPath();
 
 Span< u8 > ReadFileBinary( Allocator * a, const char * path, SourceLocation src_loc = CurrentSourceLocation() );
 
+// read-only, returns an empty span if the file can't be opened or is empty
+Span< const u8 > MemoryMapFile( Allocator * a, const char * path );
+void UnmapFile( Span< const u8 > mapping );
+
 FILE * OpenFile( Allocator * a, const char * path, OpenFileMode mode );
 bool CloseFile( FILE * file );
 bool ReadPartialFile( FILE * file, void * data, size_t len, size_t * bytes_read );
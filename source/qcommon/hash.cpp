@@ -6,8 +6,8 @@ u32 Hash32( const void * data, size_t n, u32 hash ) {
 	return Hash32_CT( ( const char * ) data, n, hash );
 }
 
-u64 Hash64( const void * data, size_t n, u64 hash ) {
-	return Hash64_CT( ( const char * ) data, n, hash );
+u64 Hash64( const void * data, size_t n, u64 seed ) {
+	return Hash64_CT( ( const char * ) data, n, seed );
 }
 
 u32 Hash32( const char * str ) {
@@ -26,12 +26,17 @@ u64 Hash64( u64 x ) {
 }
 
 u64 CaseHash64( Span< const char > str ) {
-	u64 hash = Hash64( "" );
-	for( char c : str ) {
-		c = ToLowerASCII( c );
-		hash = Hash64( &c, 1, hash );
+	Hasher64 hasher;
+	while( str.n > 0 ) {
+		char lower[ 64 ];
+		size_t n = Min2( str.n, sizeof( lower ) );
+		for( size_t i = 0; i < n; i++ ) {
+			lower[ i ] = ToLowerASCII( str[ i ] );
+		}
+		hasher.add( lower, n );
+		str += n;
 	}
-	return hash;
+	return hasher.finish();
 }
 
 u64 CaseHash64( const char * str ) {
@@ -65,3 +70,30 @@ void format( FormatBuffer * fb, const StringHash & v, const FormatOpts & opts )
 	ggformat_impl( fb, "{} (0x{08x})", v.str == NULL ? "NULL" : v.str, v.hash );
 #endif
 }
+
+// the runtime path only differs in how it loads and multiplies, so check
+// it agrees with the compile time path at every tail length and chunking
+TEST( "Hash64" ) {
+	constexpr char str[] = "the quick brown fox jumps over the lazy dog, 0123456789";
+	constexpr size_t len = sizeof( str ) - 1;
+	STATIC_ASSERT( Hash64_CT( "" ) != 0 );
+
+	bool ok = StringHash( "glsl/include/common.glsl" ) == StringHash( MakeSpan( "glsl/include/common.glsl" ) );
+
+	for( size_t n = 0; n <= len; n++ ) {
+		u64 hash = Hash64_CT( str, n );
+		ok = ok && Hash64( str, n ) == hash;
+		ok = ok && Hash64( str, n, 1 ) != hash;
+
+		for( size_t split = 0; split <= n; split++ ) {
+			Hasher64 hasher;
+			hasher.add( str, split );
+			hasher.add( str + split, n - split );
+			ok = ok && hasher.finish() == hash;
+		}
+	}
+
+	ok = ok && CaseHash64( "Sensitivity" ) == Hash64( "sensitivity" );
+
+	return ok;
+}
@@ -2,12 +2,40 @@
 
 #include "qcommon/types.h"
 
-// fnv1a
+#include <string.h>
+
+#if COMPILER_MSVC && ARCHITECTURE_X64
+#include <intrin.h>
+#endif
+
+/*
+ * Hash64 is wyhash style: it eats 16 bytes at a time with one 64x64->128
+ * multiply, and inputs up to 16 bytes, which is most paths and every key
+ * struct we have, skip the loop and get read with two pairs of overlapping
+ * 4 byte loads.
+ *
+ * the seed picks a different hash function, it doesn't continue an earlier
+ * hash the way fnv's basis did. use Hasher64 if you want the hash of a few
+ * pieces glued together, it gives the same answer as hashing them in one go.
+ *
+ * Hash32 is still fnv1a, it only hashes the version string and font paths.
+ *
+ * string hashes end up in cdmaps, asset archives, the bc4 manifest and the
+ * disk caches, and go over the network as StringHashes. if you change
+ * anything below bump CDMAP_FORMAT_VERSION and rebuild the maps, and bump
+ * ASSET_ARCHIVE_FORMAT_VERSION. the bc4 manifest and the caches notice on
+ * their own because their source hashes stop matching, and the protocol
+ * version is per build already
+ */
+
 constexpr u32 FNV1A_BASIS_32 = 2166136261_u32;
-constexpr u64 FNV1A_BASIS_64 = 14695981039346656037_u64;
+
+constexpr u64 HASH64_P0 = 0xa0761d6478bd642f_u64;
+constexpr u64 HASH64_P1 = 0xe7037ed1a0b428db_u64;
+constexpr size_t HASH64_BLOCK_SIZE = 16;
 
 u32 Hash32( const void * data, size_t n, u32 basis = FNV1A_BASIS_32 );
-u64 Hash64( const void * data, size_t n, u64 basis = FNV1A_BASIS_64 );
+u64 Hash64( const void * data, size_t n, u64 seed = 0 );
 
 u32 Hash32( const char * str );
 u64 Hash64( const char * str );
@@ -20,8 +48,8 @@ u32 Hash32( Span< const T > data, u32 basis = FNV1A_BASIS_32 ) {
 }
 
 template< typename T >
-u64 Hash64( Span< const T > data, u64 basis = FNV1A_BASIS_64 ) {
-	return Hash64( data.ptr, data.num_bytes(), basis );
+u64 Hash64( Span< const T > data, u64 seed = 0 ) {
+	return Hash64( data.ptr, data.num_bytes(), seed );
 }
 
 // case insensitive hashing
@@ -37,12 +65,99 @@ constexpr u32 Hash32_CT( const char * data, size_t n, u32 hash = FNV1A_BASIS_32
 	return hash;
 }
 
-constexpr u64 Hash64_CT( const char * data, size_t n, u64 hash = FNV1A_BASIS_64 ) {
-	constexpr u64 prime = 1099511628211_u64;
-	for( size_t i = 0; i < n; i++ ) {
-		hash = ( hash ^ data[ i ] ) * prime;
+// everything from here to Hash64_CT works at compile time and at runtime,
+// and runs the fast version at runtime
+
+constexpr void Hash64Multiply( u64 * a, u64 * b ) {
+#if COMPILER_GCC_OR_CLANG
+	__uint128_t r = __uint128_t( *a ) * *b;
+	*a = u64( r );
+	*b = u64( r >> 64 );
+#else
+#if ARCHITECTURE_X64
+	if( !__builtin_is_constant_evaluated() ) {
+		*a = _umul128( *a, *b, b );
+		return;
 	}
-	return hash;
+#endif
+
+	u64 a_lo = *a & 0xFFFFFFFF;
+	u64 a_hi = *a >> 32;
+	u64 b_lo = *b & 0xFFFFFFFF;
+	u64 b_hi = *b >> 32;
+
+	u64 lo_lo = a_lo * b_lo;
+	u64 lo_hi = a_lo * b_hi;
+	u64 hi_lo = a_hi * b_lo;
+	u64 hi_hi = a_hi * b_hi;
+
+	u64 middle = ( lo_lo >> 32 ) + ( lo_hi & 0xFFFFFFFF ) + ( hi_lo & 0xFFFFFFFF );
+	*a = ( middle << 32 ) | ( lo_lo & 0xFFFFFFFF );
+	*b = hi_hi + ( lo_hi >> 32 ) + ( hi_lo >> 32 ) + ( middle >> 32 );
+#endif
+}
+
+constexpr u64 Hash64Mix( u64 a, u64 b ) {
+	Hash64Multiply( &a, &b );
+	return a ^ b;
+}
+
+constexpr u64 Hash64Read32( const char * p ) {
+	if( !__builtin_is_constant_evaluated() ) {
+		u32 x;
+		memcpy( &x, p, sizeof( x ) );
+		return x;
+	}
+
+	return u64( u8( p[ 0 ] ) ) | u64( u8( p[ 1 ] ) ) << 8 | u64( u8( p[ 2 ] ) ) << 16 | u64( u8( p[ 3 ] ) ) << 24;
+}
+
+constexpr u64 Hash64Read64( const char * p ) {
+	if( !__builtin_is_constant_evaluated() ) {
+		u64 x;
+		memcpy( &x, p, sizeof( x ) );
+		return x;
+	}
+
+	return Hash64Read32( p ) | Hash64Read32( p + 4 ) << 32;
+}
+
+constexpr u64 Hash64Start( u64 seed ) {
+	return seed ^ Hash64Mix( seed ^ HASH64_P0, HASH64_P1 );
+}
+
+constexpr u64 Hash64Block( u64 state, const char * p ) {
+	return Hash64Mix( Hash64Read64( p ) ^ HASH64_P1, Hash64Read64( p + 8 ) ^ state );
+}
+
+// the last 1-16 bytes, or the whole thing for short inputs
+constexpr u64 Hash64Finish( u64 state, const char * p, size_t tail, size_t total ) {
+	u64 a = 0;
+	u64 b = 0;
+	if( tail >= 4 ) {
+		size_t step = ( tail >> 3 ) << 2;
+		a = Hash64Read32( p ) << 32 | Hash64Read32( p + step );
+		b = Hash64Read32( p + tail - 4 ) << 32 | Hash64Read32( p + tail - 4 - step );
+	}
+	else if( tail > 0 ) {
+		a = u64( u8( p[ 0 ] ) ) << 16 | u64( u8( p[ tail >> 1 ] ) ) << 8 | u64( u8( p[ tail - 1 ] ) );
+	}
+
+	a ^= HASH64_P1;
+	b ^= state;
+	Hash64Multiply( &a, &b );
+	return Hash64Mix( a ^ HASH64_P0 ^ total, b ^ HASH64_P1 );
+}
+
+constexpr u64 Hash64_CT( const char * data, size_t n, u64 seed = 0 ) {
+	u64 state = Hash64Start( seed );
+	size_t left = n;
+	while( left > HASH64_BLOCK_SIZE ) {
+		state = Hash64Block( state, data );
+		data += HASH64_BLOCK_SIZE;
+		left -= HASH64_BLOCK_SIZE;
+	}
+	return Hash64Finish( state, data, left, n );
 }
 
 template< size_t N >
@@ -50,6 +165,60 @@ constexpr u64 Hash64_CT( const char ( &s )[ N ] ) {
 	return Hash64_CT( s, N - 1 );
 }
 
+// streaming Hash64. it holds back the last 16 bytes it was given because
+// they might be the tail
+struct Hasher64 {
+	u64 state;
+	u64 total;
+	char buffer[ HASH64_BLOCK_SIZE ];
+	size_t buffered;
+
+	constexpr explicit Hasher64( u64 seed = 0 ) : state( Hash64Start( seed ) ), total( 0 ), buffer(), buffered( 0 ) { }
+
+	constexpr void add( const char * data, size_t n ) {
+		total += n;
+		while( n > 0 ) {
+			if( buffered == HASH64_BLOCK_SIZE ) {
+				state = Hash64Block( state, buffer );
+				buffered = 0;
+			}
+
+			if( buffered == 0 ) {
+				while( n > HASH64_BLOCK_SIZE ) {
+					state = Hash64Block( state, data );
+					data += HASH64_BLOCK_SIZE;
+					n -= HASH64_BLOCK_SIZE;
+				}
+			}
+
+			size_t m = Min2( HASH64_BLOCK_SIZE - buffered, n );
+			for( size_t i = 0; i < m; i++ ) {
+				buffer[ buffered + i ] = data[ i ];
+			}
+			buffered += m;
+			data += m;
+			n -= m;
+		}
+	}
+
+	constexpr void add( Span< const char > str ) {
+		add( str.ptr, str.n );
+	}
+
+	template< size_t N >
+	constexpr void add( const char ( &s )[ N ] ) {
+		add( s, N - 1 );
+	}
+
+	void add( const void * data, size_t n ) {
+		add( ( const char * ) data, n );
+	}
+
+	constexpr u64 finish() const {
+		return Hash64Finish( state, buffer, buffered, total );
+	}
+};
+
 struct StringHash {
 	u64 hash;
 
@@ -4,6 +4,7 @@
 // unplayable in debug builds, so we put manually vectorised and optimised
 // kernels in their own TU in debug builds and inline it in release builds
 // Mat4 * Mat4: ~30x speedup
+// Mat3x4 * Mat3x4: ~4x speedup
 // Mat3x4 * Vec4: ~10x speedup
 #if PUBLIC_BUILD
 #undef PUBLIC_BUILD // to break the cyclic include of types.h -> kernels -> types.h
@@ -287,26 +288,8 @@ constexpr Mat3x4 Mat4Scale( Vec3 v ) {
 	return Mat4Scale( v.x, v.y, v.z );
 }
 
-constexpr Mat3x4 operator*( const Mat3x4 & lhs, const Mat3x4 & rhs ) {
-	return Mat3x4(
-		Dot( lhs.row0(), Vec4( rhs.col0, 0.0f ) ),
-		Dot( lhs.row0(), Vec4( rhs.col1, 0.0f ) ),
-		Dot( lhs.row0(), Vec4( rhs.col2, 0.0f ) ),
-		Dot( lhs.row0(), Vec4( rhs.col3, 1.0f ) ),
-
-		Dot( lhs.row1(), Vec4( rhs.col0, 0.0f ) ),
-		Dot( lhs.row1(), Vec4( rhs.col1, 0.0f ) ),
-		Dot( lhs.row1(), Vec4( rhs.col2, 0.0f ) ),
-		Dot( lhs.row1(), Vec4( rhs.col3, 1.0f ) ),
-
-		Dot( lhs.row2(), Vec4( rhs.col0, 0.0f ) ),
-		Dot( lhs.row2(), Vec4( rhs.col1, 0.0f ) ),
-		Dot( lhs.row2(), Vec4( rhs.col2, 0.0f ) ),
-		Dot( lhs.row2(), Vec4( rhs.col3, 1.0f ) )
-	);
-}
-
 #if !PUBLIC_BUILD
+Mat3x4 operator*( const Mat3x4 & lhs, const Mat3x4 & rhs );
 Vec4 operator*( const Mat3x4 & m, const Vec4 & v );
 #endif
 
@@ -38,6 +38,37 @@ INLINE_IN_RELEASE_BUILDS Mat4 operator*( const Mat4 & lhs, const Mat4 & rhs ) {
 	return result;
 }
 
+INLINE_IN_RELEASE_BUILDS Mat3x4 operator*( const Mat3x4 & lhs, const Mat3x4 & rhs ) {
+	Mat3x4 result;
+
+	// the last lane of each column is the next column's x, which we ignore
+	__m128 col0 = _mm_loadu_ps( &lhs.col0.x );
+	__m128 col1 = _mm_loadu_ps( &lhs.col1.x );
+	__m128 col2 = _mm_loadu_ps( &lhs.col2.x );
+	__m128 col3 = _mm_loadu_ps( &lhs.col2.z );
+	col3 = _mm_shuffle_ps( col3, col3, _MM_SHUFFLE( 0, 3, 2, 1 ) );
+
+	__m128 res[ 4 ];
+	for( size_t i = 0; i < 4; i++ ) {
+		const Vec3 & rhs_col = ( &rhs.col0 )[ i ];
+		res[ i ] = _mm_add_ps(
+			_mm_mul_ps( col0, _mm_set1_ps( rhs_col.x ) ),
+			_mm_add_ps( _mm_mul_ps( col1, _mm_set1_ps( rhs_col.y ) ), _mm_mul_ps( col2, _mm_set1_ps( rhs_col.z ) ) )
+		);
+	}
+	res[ 3 ] = _mm_add_ps( res[ 3 ], col3 );
+
+	// each store clobbers the next column's x, so go in order and don't
+	// write past the end with the last one
+	_mm_storeu_ps( &result.col0.x, res[ 0 ] );
+	_mm_storeu_ps( &result.col1.x, res[ 1 ] );
+	_mm_storeu_ps( &result.col2.x, res[ 2 ] );
+	_mm_storel_pi( ( __m64 * ) &result.col3.x, res[ 3 ] );
+	_mm_store_ss( &result.col3.z, _mm_movehl_ps( res[ 3 ], res[ 3 ] ) );
+
+	return result;
+}
+
 INLINE_IN_RELEASE_BUILDS Vec4 operator*( const Mat3x4 & m, const Vec4 & v ) {
 	float w = v.w;
 
@@ -97,6 +128,36 @@ INLINE_IN_RELEASE_BUILDS Mat4 operator*( const Mat4 & lhs, const Mat4 & rhs ) {
 	return result;
 }
 
+INLINE_IN_RELEASE_BUILDS Mat3x4 operator*( const Mat3x4 & lhs, const Mat3x4 & rhs ) {
+	Mat3x4 result;
+
+	// the last lane of each column is the next column's x, which we ignore
+	float32x4_t col0 = vld1q_f32( &lhs.col0.x );
+	float32x4_t col1 = vld1q_f32( &lhs.col1.x );
+	float32x4_t col2 = vld1q_f32( &lhs.col2.x );
+
+	float32x2_t col3xy = vld1_f32( &lhs.col3.x );
+	float32x2_t col3z0 = vld1_lane_f32( &lhs.col3.z, vdup_n_f32( 0.0f ), 0 );
+	float32x4_t col3 = vcombine_f32( col3xy, col3z0 );
+
+	float32x4_t res[ 4 ];
+	for( size_t i = 0; i < 4; i++ ) {
+		const Vec3 & rhs_col = ( &rhs.col0 )[ i ];
+		res[ i ] = vfmaq_n_f32( vfmaq_n_f32( vmulq_n_f32( col0, rhs_col.x ), col1, rhs_col.y ), col2, rhs_col.z );
+	}
+	res[ 3 ] = vaddq_f32( res[ 3 ], col3 );
+
+	// each store clobbers the next column's x, so go in order and don't
+	// write past the end with the last one
+	vst1q_f32( &result.col0.x, res[ 0 ] );
+	vst1q_f32( &result.col1.x, res[ 1 ] );
+	vst1q_f32( &result.col2.x, res[ 2 ] );
+	vst1_f32( &result.col3.x, vget_low_f32( res[ 3 ] ) );
+	vst1q_lane_f32( &result.col3.z, res[ 3 ], 2 );
+
+	return result;
+}
+
 INLINE_IN_RELEASE_BUILDS Vec4 operator*( const Mat3x4 & m, const Vec4 & v ) {
     float w = v.w;
 
@@ -11,7 +11,9 @@
 // these must come after qcommon because both tracy and one of these defines BLOCK_SIZE
 #include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <unistd.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 
 Span< char > FindHomeDirectory( Allocator * a ) {
@@ -36,6 +38,29 @@ bool RemoveFile( Allocator * a, const char * path ) {
 	return unlink( path ) == 0;
 }
 
+Span< const u8 > MemoryMapFile( Allocator * a, const char * path ) {
+	int fd = open( path, O_RDONLY | O_CLOEXEC );
+	if( fd == -1 )
+		return Span< const u8 >();
+	defer { close( fd ); };
+
+	struct stat st;
+	if( fstat( fd, &st ) != 0 || st.st_size == 0 )
+		return Span< const u8 >();
+
+	void * mapping = mmap( NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+	if( mapping == MAP_FAILED )
+		return Span< const u8 >();
+
+	return Span< const u8 >( ( const u8 * ) mapping, st.st_size );
+}
+
+void UnmapFile( Span< const u8 > mapping ) {
+	if( munmap( const_cast< u8 * >( mapping.ptr ), mapping.n ) != 0 ) {
+		FatalErrno( "munmap" );
+	}
+}
+
 bool CreateDirectory( Allocator * a, const char * path ) {
 	return mkdir( path, 0755 ) == 0 || errno == EEXIST;
 }
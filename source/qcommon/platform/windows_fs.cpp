@@ -68,6 +68,38 @@ FILE * OpenFile( Allocator * a, const char * path, OpenFileMode mode ) {
 	return _wfopen( wide_path, wide_mode );
 }
 
+Span< const u8 > MemoryMapFile( Allocator * a, const char * path ) {
+	wchar_t * wide_path = UTF8ToWide( a, path );
+	defer { Free( a, wide_path ); };
+
+	HANDLE file = CreateFileW( wide_path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+	if( file == INVALID_HANDLE_VALUE )
+		return Span< const u8 >();
+	defer { CloseHandle( file ); };
+
+	LARGE_INTEGER size;
+	if( GetFileSizeEx( file, &size ) == 0 || size.QuadPart == 0 )
+		return Span< const u8 >();
+
+	// the view keeps the mapping alive so we can close both handles immediately
+	HANDLE mapping = CreateFileMappingW( file, NULL, PAGE_READONLY, 0, 0, NULL );
+	if( mapping == NULL )
+		return Span< const u8 >();
+	defer { CloseHandle( mapping ); };
+
+	void * view = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+	if( view == NULL )
+		return Span< const u8 >();
+
+	return Span< const u8 >( ( const u8 * ) view, size.QuadPart );
+}
+
+void UnmapFile( Span< const u8 > mapping ) {
+	if( UnmapViewOfFile( mapping.ptr ) == 0 ) {
+		FatalGLE( "UnmapViewOfFile" );
+	}
+}
+
 #undef MoveFile
 bool MoveFile( Allocator * a, const char * old_path, const char * new_path, MoveFileReplace replace ) {
 	wchar_t * wide_old_path = UTF8ToWide( a, old_path );
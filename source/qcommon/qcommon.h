@@ -37,21 +37,19 @@ constexpr Vec3 FromQFAxis( const mat3_t m, int axis ) {
 }
 
 constexpr Mat3x4 FromAxisAndOrigin( const mat3_t axis, Vec3 origin ) {
-	Mat3x4 rotation = Mat3x4::Identity();
-	rotation.col0.x = axis[ 0 ];
-	rotation.col0.y = axis[ 1 ];
-	rotation.col0.z = axis[ 2 ];
-	rotation.col1.x = axis[ 3 ];
-	rotation.col1.y = axis[ 4 ];
-	rotation.col1.z = axis[ 5 ];
-	rotation.col2.x = axis[ 6 ];
-	rotation.col2.y = axis[ 7 ];
-	rotation.col2.z = axis[ 8 ];
-
-	Mat3x4 translation = Mat3x4::Identity();
-	translation.col3 = Vec3( origin );
-
-	return translation * rotation;
+	Mat3x4 transform = Mat3x4::Identity();
+	transform.col0.x = axis[ 0 ];
+	transform.col0.y = axis[ 1 ];
+	transform.col0.z = axis[ 2 ];
+	transform.col1.x = axis[ 3 ];
+	transform.col1.y = axis[ 4 ];
+	transform.col1.z = axis[ 5 ];
+	transform.col2.x = axis[ 6 ];
+	transform.col2.y = axis[ 7 ];
+	transform.col2.z = axis[ 8 ];
+	transform.col3 = origin;
+
+	return transform;
 }
 
 //============================================================================
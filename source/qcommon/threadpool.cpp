@@ -0,0 +1,496 @@
+#include "qcommon/base.h"
+#include "qcommon/array.h"
+#include "qcommon/threads.h"
+#include "qcommon/threadpool.h"
+
+#include <thread>
+
+/*
+ * each thread owns a Chase-Lev deque:
+ * https://www.dre.vanderbilt.edu/~schmidt/PDF/work-stealing-dequeue.pdf
+ * with the memory orderings from "Correct and Efficient Work-Stealing for
+ * Weak Memory Models". it doesn't grow, if it's full we run the job inline
+ *
+ * range jobs split themselves in half until they get down to the grain
+ * size, pushing the right halves so thieves take the biggest chunks
+ *
+ * threads outside the pool don't have a deque, so their jobs go in a locked
+ * queue that everyone checks before stealing
+ */
+
+struct Job {
+	JobCallback callback;
+	RangeJobCallback range_callback;
+	void * data;
+	size_t begin;
+	size_t end;
+	size_t grain;
+	JobCounter * counter;
+	const char * name;
+};
+
+constexpr s64 JOB_DEQUE_SIZE = 4096;
+
+// sys_allocator only does 16 byte alignment so pad instead of alignas to
+// keep top and bottom on their own cache lines
+struct JobDeque {
+	std::atomic< s64 > top;
+	char pad0[ 64 ];
+	std::atomic< s64 > bottom;
+	char pad1[ 64 ];
+	Job jobs[ JOB_DEQUE_SIZE ];
+};
+
+struct PoolThread {
+	Thread * thread;
+	ArenaAllocator arena;
+	JobDeque * deque;
+
+	Semaphore * wake;
+	std::atomic< bool > asleep;
+	std::atomic< JobCounter * > waiting_on;
+};
+
+constexpr u32 MAX_POOL_THREADS = 64;
+constexpr u32 SPINS_BEFORE_SLEEPING = 64;
+
+static PoolThread pool_threads[ MAX_POOL_THREADS ];
+static u32 num_pool_threads;
+static std::atomic< bool > shutting_down;
+static JobCounter fire_and_forget_jobs;
+
+static Mutex * outside_jobs_mutex;
+static NonRAIIDynamicArray< Job > outside_jobs;
+static size_t outside_jobs_head;
+static std::atomic< size_t > num_outside_jobs;
+
+static thread_local PoolThread * current_thread;
+
+static bool PushJob( JobDeque * deque, const Job & job ) {
+	s64 b = deque->bottom.load( std::memory_order_relaxed );
+	s64 t = deque->top.load( std::memory_order_acquire );
+	if( b - t >= JOB_DEQUE_SIZE )
+		return false;
+
+	deque->jobs[ b & ( JOB_DEQUE_SIZE - 1 ) ] = job;
+	std::atomic_thread_fence( std::memory_order_release );
+	deque->bottom.store( b + 1, std::memory_order_relaxed );
+
+	return true;
+}
+
+static bool PopJob( JobDeque * deque, Job * job ) {
+	s64 b = deque->bottom.load( std::memory_order_relaxed ) - 1;
+	deque->bottom.store( b, std::memory_order_relaxed );
+	std::atomic_thread_fence( std::memory_order_seq_cst );
+	s64 t = deque->top.load( std::memory_order_relaxed );
+
+	if( t > b ) {
+		deque->bottom.store( b + 1, std::memory_order_relaxed );
+		return false;
+	}
+
+	*job = deque->jobs[ b & ( JOB_DEQUE_SIZE - 1 ) ];
+	if( t < b )
+		return true;
+
+	// last job, race the thieves for it
+	bool won = deque->top.compare_exchange_strong( t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed );
+	deque->bottom.store( b + 1, std::memory_order_relaxed );
+	return won;
+}
+
+static bool StealJob( JobDeque * deque, Job * job ) {
+	s64 t = deque->top.load( std::memory_order_acquire );
+	std::atomic_thread_fence( std::memory_order_seq_cst );
+	s64 b = deque->bottom.load( std::memory_order_acquire );
+	if( t >= b )
+		return false;
+
+	// the owner can only overwrite this slot after someone else took it, in
+	// which case the CAS fails and we throw the copy away
+	Job stolen = deque->jobs[ t & ( JOB_DEQUE_SIZE - 1 ) ];
+	if( !deque->top.compare_exchange_strong( t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed ) )
+		return false;
+
+	*job = stolen;
+	return true;
+}
+
+static bool TakeOutsideJob( Job * job ) {
+	if( num_outside_jobs.load( std::memory_order_relaxed ) == 0 )
+		return false;
+
+	Lock( outside_jobs_mutex );
+	defer { Unlock( outside_jobs_mutex ); };
+
+	if( outside_jobs_head == outside_jobs.size() )
+		return false;
+
+	*job = outside_jobs[ outside_jobs_head ];
+	outside_jobs_head++;
+	num_outside_jobs--;
+
+	if( outside_jobs_head == outside_jobs.size() ) {
+		outside_jobs.clear();
+		outside_jobs_head = 0;
+	}
+
+	return true;
+}
+
+static bool FindJob( PoolThread * self, Job * job ) {
+	if( PopJob( self->deque, job ) )
+		return true;
+
+	if( TakeOutsideJob( job ) )
+		return true;
+
+	u32 self_idx = u32( self - pool_threads );
+	for( u32 i = 1; i < num_pool_threads; i++ ) {
+		PoolThread * victim = &pool_threads[ ( self_idx + i ) % num_pool_threads ];
+		if( StealJob( victim->deque, job ) )
+			return true;
+	}
+
+	return false;
+}
+
+static bool AnyThreadHasJobs() {
+	if( num_outside_jobs.load( std::memory_order_relaxed ) > 0 )
+		return true;
+
+	for( u32 i = 0; i < num_pool_threads; i++ ) {
+		const JobDeque * deque = pool_threads[ i ].deque;
+		if( deque->bottom.load( std::memory_order_relaxed ) > deque->top.load( std::memory_order_relaxed ) )
+			return true;
+	}
+	return false;
+}
+
+static void WakeThread( PoolThread * thread ) {
+	if( thread->asleep.exchange( false ) ) {
+		Signal( thread->wake );
+	}
+}
+
+static void WakeOneThread() {
+	std::atomic_thread_fence( std::memory_order_seq_cst );
+	for( u32 i = 0; i < num_pool_threads; i++ ) {
+		PoolThread * thread = &pool_threads[ i ];
+		if( thread->asleep.load( std::memory_order_relaxed ) && thread->asleep.exchange( false ) ) {
+			Signal( thread->wake );
+			return;
+		}
+	}
+}
+
+// whoever wakes us clears asleep before signalling, so if we decide not to
+// sleep after all and somebody beat us to it we have to eat their signal
+static void SleepUntilWoken( PoolThread * self, const JobCounter * counter ) {
+	self->asleep.store( true );
+	std::atomic_thread_fence( std::memory_order_seq_cst );
+
+	bool nothing_to_do = !AnyThreadHasJobs() && !shutting_down.load( std::memory_order_relaxed );
+	if( counter != NULL ) {
+		nothing_to_do = nothing_to_do && counter->pending.load( std::memory_order_relaxed ) > 0;
+	}
+
+	if( nothing_to_do || !self->asleep.exchange( false ) ) {
+		TracyZoneScopedN( "Sleep" );
+		Wait( self->wake );
+	}
+}
+
+static void FinishJob( JobCounter * counter ) {
+	if( counter->pending.fetch_sub( 1, std::memory_order_acq_rel ) != 1 )
+		return;
+
+	std::atomic_thread_fence( std::memory_order_seq_cst );
+	for( u32 i = 0; i < num_pool_threads; i++ ) {
+		if( pool_threads[ i ].waiting_on.load( std::memory_order_relaxed ) == counter ) {
+			WakeThread( &pool_threads[ i ] );
+		}
+	}
+}
+
+static void RunJob( Job job );
+
+static void PushOrRunJob( const Job & job ) {
+	job.counter->pending.fetch_add( 1, std::memory_order_relaxed );
+
+	if( current_thread == NULL ) {
+		Lock( outside_jobs_mutex );
+		outside_jobs.add( job );
+		num_outside_jobs++;
+		Unlock( outside_jobs_mutex );
+	}
+	else if( !PushJob( current_thread->deque, job ) ) {
+		RunJob( job );
+		return;
+	}
+
+	WakeOneThread();
+}
+
+static void RunJob( Job job ) {
+	TracyZoneScoped;
+	TracyZoneText( job.name, strlen( job.name ) );
+
+	if( job.range_callback != NULL ) {
+		while( job.end - job.begin > job.grain ) {
+			Job right = job;
+			right.begin = job.begin + ( job.end - job.begin ) / 2;
+			PushOrRunJob( right );
+			job.end = right.begin;
+		}
+
+		TempAllocator temp = current_thread->arena.temp();
+		job.range_callback( &temp, job.data, job.begin, job.end );
+	}
+	else {
+		TempAllocator temp = current_thread->arena.temp();
+		job.callback( &temp, job.data );
+	}
+
+	FinishJob( job.counter );
+}
+
+static void ThreadPoolWorker( void * data ) {
+	TracyCSetThreadName( "Thread pool worker" );
+
+	PoolThread * self = ( PoolThread * ) data;
+	current_thread = self;
+
+	u32 idle = 0;
+	while( !shutting_down.load( std::memory_order_acquire ) ) {
+		Job job;
+		if( FindJob( self, &job ) ) {
+			RunJob( job );
+			idle = 0;
+			continue;
+		}
+
+		idle++;
+		if( idle < SPINS_BEFORE_SLEEPING ) {
+			std::this_thread::yield();
+			continue;
+		}
+
+		SleepUntilWoken( self, NULL );
+		idle = 0;
+	}
+}
+
+void InitThreadPool() {
+	InitThreadPool( GetCoreCount() );
+}
+
+void InitThreadPool( u32 num_threads ) {
+	TracyZoneScoped;
+
+	Assert( current_thread == NULL );
+
+	num_pool_threads = Clamp( 1_u32, num_threads, MAX_POOL_THREADS );
+	shutting_down = false;
+	fire_and_forget_jobs.pending = 0;
+
+	outside_jobs_mutex = NewMutex();
+	outside_jobs.init( sys_allocator );
+	outside_jobs_head = 0;
+	num_outside_jobs = 0;
+
+	for( u32 i = 0; i < num_pool_threads; i++ ) {
+		PoolThread * thread = &pool_threads[ i ];
+
+		constexpr size_t arena_size = 1024 * 1024; // 1MB
+		void * arena_memory = sys_allocator->allocate( arena_size, 16 );
+		thread->arena = ArenaAllocator( arena_memory, arena_size );
+
+		thread->deque = ( JobDeque * ) sys_allocator->allocate( sizeof( JobDeque ), 16 );
+		thread->deque->top = 0;
+		thread->deque->bottom = 0;
+
+		thread->wake = NewSemaphore();
+		thread->asleep = false;
+		thread->waiting_on = NULL;
+	}
+
+	// the calling thread is thread 0, it runs jobs while it waits on them
+	current_thread = &pool_threads[ 0 ];
+
+	for( u32 i = 1; i < num_pool_threads; i++ ) {
+		pool_threads[ i ].thread = NewThread( ThreadPoolWorker, &pool_threads[ i ] );
+	}
+}
+
+void ShutdownThreadPool() {
+	TracyZoneScoped;
+
+	Assert( current_thread == &pool_threads[ 0 ] );
+	ThreadPoolFinish();
+
+	shutting_down = true;
+	for( u32 i = 1; i < num_pool_threads; i++ ) {
+		WakeThread( &pool_threads[ i ] );
+	}
+
+	for( u32 i = 0; i < num_pool_threads; i++ ) {
+		PoolThread * thread = &pool_threads[ i ];
+		if( i > 0 ) {
+			JoinThread( thread->thread );
+		}
+		DeleteSemaphore( thread->wake );
+		Free( sys_allocator, thread->deque );
+		Free( sys_allocator, thread->arena.get_memory() );
+	}
+
+	outside_jobs.shutdown();
+	DeleteMutex( outside_jobs_mutex );
+
+	current_thread = NULL;
+	num_pool_threads = 0;
+}
+
+u32 ThreadPoolSize() {
+	return num_pool_threads;
+}
+
+void SpawnJob( JobCounter * counter, JobCallback callback, void * data, const char * name ) {
+	Job job = { };
+	job.callback = callback;
+	job.data = data;
+	job.counter = counter;
+	job.name = name;
+
+	PushOrRunJob( job );
+}
+
+void WaitForJobs( JobCounter * counter ) {
+	TracyZoneScoped;
+
+	PoolThread * self = current_thread;
+	Assert( self != NULL );
+
+	u32 idle = 0;
+	while( counter->pending.load( std::memory_order_acquire ) > 0 ) {
+		Job job;
+		if( FindJob( self, &job ) ) {
+			RunJob( job );
+			idle = 0;
+			continue;
+		}
+
+		idle++;
+		if( idle < SPINS_BEFORE_SLEEPING ) {
+			std::this_thread::yield();
+			continue;
+		}
+
+		self->waiting_on.store( counter );
+		SleepUntilWoken( self, counter );
+		self->waiting_on.store( NULL );
+		idle = 0;
+	}
+}
+
+void ThreadPoolDo( JobCallback callback, void * data ) {
+	SpawnJob( &fire_and_forget_jobs, callback, data, "ThreadPoolDo" );
+}
+
+void ThreadPoolFinish() {
+	WaitForJobs( &fire_and_forget_jobs );
+}
+
+void ParallelForRange( size_t n, size_t grain, RangeJobCallback callback, void * data, const char * name ) {
+	TracyZoneScoped;
+
+	Assert( current_thread != NULL );
+
+	if( n == 0 )
+		return;
+
+	JobCounter counter = { };
+	counter.pending = 1;
+
+	Job job = { };
+	job.range_callback = callback;
+	job.data = data;
+	job.begin = 0;
+	job.end = n;
+	job.grain = Max2( grain, size_t( 1 ) );
+	job.counter = &counter;
+	job.name = name;
+
+	// start splitting on this thread and let the others steal from us
+	RunJob( job );
+	WaitForJobs( &counter );
+}
+
+void ParallelFor( void * datum, size_t n, size_t stride, JobCallback callback, size_t grain ) {
+	struct ParallelForElements {
+		char * datum;
+		size_t stride;
+		JobCallback callback;
+	};
+
+	ParallelForElements elements = { ( char * ) datum, stride, callback };
+
+	ParallelForRange( n, grain, []( TempAllocator * temp, void * data, size_t begin, size_t end ) {
+		const ParallelForElements * elements = ( const ParallelForElements * ) data;
+		for( size_t i = begin; i < end; i++ ) {
+			TempAllocator element_temp = current_thread->arena.temp();
+			elements->callback( &element_temp, elements->datum + elements->stride * i );
+		}
+	}, &elements );
+}
+
+TEST( "Thread pool" ) {
+	InitThreadPool( 4 );
+	defer { ShutdownThreadPool(); };
+
+	// nested loops and a grain that doesn't divide n
+	u32 visited[ 10 * 100 ] = { };
+	ParallelFor( 10, 1, [&]( size_t i ) {
+		ParallelFor( 100, 7, [&]( size_t j ) {
+			visited[ i * 100 + j ]++;
+		} );
+	} );
+
+	bool ok = true;
+	for( u32 v : visited ) {
+		ok = ok && v == 1;
+	}
+
+	// jobs that spawn more jobs on the same counter
+	struct Spawner {
+		JobCounter counter;
+		std::atomic< u32 > leaves;
+	};
+
+	Spawner spawner = { };
+	for( int i = 0; i < 16; i++ ) {
+		SpawnJob( &spawner.counter, []( TempAllocator * temp, void * data ) {
+			Spawner * spawner = ( Spawner * ) data;
+			for( int j = 0; j < 16; j++ ) {
+				SpawnJob( &spawner->counter, []( TempAllocator * temp, void * data ) {
+					( ( Spawner * ) data )->leaves++;
+				}, data );
+			}
+		}, &spawner );
+	}
+	WaitForJobs( &spawner.counter );
+
+	// jobs spawned from outside the pool
+	Thread * outside = NewThread( []( void * data ) {
+		for( int i = 0; i < 16; i++ ) {
+			SpawnJob( &( ( Spawner * ) data )->counter, []( TempAllocator * temp, void * data ) {
+				( ( Spawner * ) data )->leaves++;
+			}, data );
+		}
+	}, &spawner );
+	JoinThread( outside );
+	WaitForJobs( &spawner.counter );
+
+	return ok && spawner.leaves == 16 * 16 + 16;
+}
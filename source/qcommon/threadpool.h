@@ -0,0 +1,63 @@
+#pragma once
+
+#include "qcommon/types.h"
+
+#include <atomic>
+
+/*
+ * work stealing thread pool. every thread has its own deque of jobs, it
+ * pushes and pops its own jobs from the bottom and idle threads steal from
+ * the top of everyone else's, so nothing takes a lock in the common case.
+ *
+ * jobs get counted by a JobCounter and WaitForJobs runs other jobs until
+ * the counter hits zero. that's also how you do dependencies: spawn the
+ * first batch, wait on it, then spawn whatever needs its results. waiting
+ * inside a job is fine.
+ *
+ * any thread can spawn jobs, but only the thread that called InitThreadPool
+ * and the pool's own workers can wait on them
+ */
+
+using JobCallback = void ( * )( TempAllocator * temp, void * data );
+using RangeJobCallback = void ( * )( TempAllocator * temp, void * data, size_t begin, size_t end );
+
+struct JobCounter {
+	std::atomic< u32 > pending;
+};
+
+void InitThreadPool(); // one thread per core
+void InitThreadPool( u32 num_threads ); // including the calling thread
+void ShutdownThreadPool();
+u32 ThreadPoolSize();
+
+void SpawnJob( JobCounter * counter, JobCallback callback, void * data = NULL, const char * name = "Job" );
+void WaitForJobs( JobCounter * counter );
+
+// fire and forget jobs that all get waited on by ThreadPoolFinish
+void ThreadPoolDo( JobCallback callback, void * data = NULL );
+void ThreadPoolFinish();
+
+// callback gets called for disjoint ranges that cover [0, n). ranges get
+// split in half until they're no bigger than grain
+void ParallelForRange( size_t n, size_t grain, RangeJobCallback callback, void * data, const char * name = "ParallelFor" );
+
+// callback gets called once per element, and waits for all of them to finish
+void ParallelFor( void * datum, size_t n, size_t stride, JobCallback callback, size_t grain = 1 );
+
+template< typename T >
+void ParallelFor( Span< T > datum, JobCallback callback, size_t grain = 1 ) {
+	ParallelFor( datum.ptr, datum.n, sizeof( T ), callback, grain );
+}
+
+// f( i ) gets called once for each i in [0, n)
+template< typename F >
+void ParallelFor( size_t n, size_t grain, const F & f, const char * name = "ParallelFor" ) {
+	RangeJobCallback callback = []( TempAllocator * temp, void * data, size_t begin, size_t end ) {
+		const F * f = ( const F * ) data;
+		for( size_t i = begin; i < end; i++ ) {
+			( *f )( i );
+		}
+	};
+
+	ParallelForRange( n, grain, callback, const_cast< F * >( &f ), name );
+}
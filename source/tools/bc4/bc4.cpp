@@ -1,10 +1,18 @@
 #include "qcommon/base.h"
+#include "qcommon/array.h"
 #include "qcommon/fs.h"
+#include "qcommon/hash.h"
 #include "qcommon/span2d.h"
 #include "qcommon/string.h"
+#include "qcommon/threadpool.h"
+#include "qcommon/threads.h"
 #include "gameshared/q_shared.h"
 #include "client/renderer/dds.h"
 
+#include "gg/ggtime.h"
+
+#include "nanosort/nanosort.hpp"
+
 #include "rgbcx/rgbcx.h"
 
 #include "stb/stb_image.h"
@@ -16,6 +24,19 @@ void ShowErrorMessage( const char * msg, const char * file, int line ) {
 	printf( "%s (%s:%d)\n", msg, file, line );
 }
 
+// TODO: should use the stuff in material.cpp instead of duplicating it here
+constexpr u32 BC4BlockSize = 8;
+
+// bump this when the output changes for the same input, it invalidates everyone's manifests
+constexpr u64 BC4_ENCODER_VERSION = 1;
+
+// compress a batch at a time so we don't keep every image in memory
+constexpr size_t IMAGES_PER_BATCH = 64;
+// big images get split into chunks of block rows so they encode in parallel too
+constexpr u32 BLOCK_ROWS_PER_CHUNK = 16;
+
+constexpr u32 MAX_THREADS = 64;
+
 static u32 BlockFormatMipLevels( u32 w, u32 h ) {
 	u32 dim = Min2( w, h );
 	u32 levels = 0;
@@ -38,6 +59,15 @@ static u32 MipSize( u32 w, u32 h, u32 level ) {
 	return w * h;
 }
 
+static u32 MipBlocks( u32 w, u32 h, u32 level ) {
+	MipDims( &w, &h, w, h, level );
+	return ( w / 4 ) * ( h / 4 );
+}
+
+static float FlicksToSeconds( u64 flicks ) {
+	return flicks / float( GGTIME_FLICKS_PER_SECOND );
+}
+
 // TODO: should put this in qcommon/compression but gotta get rid of the Com_Printfs first
 static Span< u8 > Compress( Allocator * a, Span< const u8 > data ) {
 	size_t max_size = ZSTD_compressBound( data.n );
@@ -49,61 +79,177 @@ static Span< u8 > Compress( Allocator * a, Span< const u8 > data ) {
 	return Span< u8 >( compressed, compressed_size );
 }
 
-int main( int argc, char ** argv ) {
-	if( argc != 2 && !( argc == 4 && StrEqual( argv[ 1 ], "--output-dir" ) ) ) {
-		printf( "Usage: %s [--output-dir dir] <file.png>\n", argv[ 0 ] );
-		return 1;
+/*
+ * the manifest remembers the hash of the png and the encoder settings we
+ * last compressed each output with, so reruns only touch what changed.
+ * it's a text file with one "input_hash settings_hash output_path" per line
+ */
+
+struct ManifestEntry {
+	u64 output_hash;
+	u64 input_hash;
+	u64 settings_hash;
+	Span< const char > output_path;
+};
+
+static bool ParseManifestLine( Span< const char > line, ManifestEntry * entry ) {
+	char * end;
+	entry->input_hash = strtoull( line.ptr, &end, 16 );
+	if( end != line.ptr + 16 || line.n < 16 + 1 + 16 + 2 || line[ 16 ] != ' ' )
+		return false;
+
+	entry->settings_hash = strtoull( line.ptr + 17, &end, 16 );
+	if( end != line.ptr + 33 || line[ 33 ] != ' ' )
+		return false;
+
+	entry->output_path = line + 34;
+	entry->output_hash = Hash64( entry->output_path );
+	return true;
+}
+
+static void LoadManifest( const char * path, Span< u8 > * contents, DynamicArray< ManifestEntry > * entries ) {
+	*contents = ReadFileBinary( sys_allocator, path );
+	if( contents->ptr == NULL )
+		return;
+
+	Span< const char > cursor = contents->cast< const char >();
+	while( cursor.n > 0 ) {
+		const char * newline = StrChr( cursor, '\n' );
+		size_t line_length = newline == NULL ? cursor.n : newline - cursor.ptr;
+
+		ManifestEntry entry;
+		if( ParseManifestLine( cursor.slice( 0, line_length ), &entry ) ) {
+			entries->add( entry );
+		}
+
+		cursor = cursor + Min2( line_length + 1, cursor.n );
+	}
+
+	nanosort( entries->begin(), entries->end(), []( const ManifestEntry & a, const ManifestEntry & b ) {
+		return a.output_hash < b.output_hash;
+	} );
+}
+
+static const ManifestEntry * FindManifestEntry( Span< const ManifestEntry > entries, Span< const char > output_path ) {
+	u64 hash = Hash64( output_path );
+
+	size_t lo = 0;
+	size_t hi = entries.n;
+	while( lo < hi ) {
+		size_t mid = lo + ( hi - lo ) / 2;
+		if( entries[ mid ].output_hash < hash ) {
+			lo = mid + 1;
+		}
+		else {
+			hi = mid;
+		}
+	}
+
+	if( lo == entries.n || entries[ lo ].output_hash != hash )
+		return NULL;
+	return &entries[ lo ];
+}
+
+static void WriteManifest( const char * path, DynamicArray< ManifestEntry > * entries ) {
+	// paths from the old manifest aren't NUL terminated
+	nanosort( entries->begin(), entries->end(), []( const ManifestEntry & a, const ManifestEntry & b ) {
+		int cmp = memcmp( a.output_path.ptr, b.output_path.ptr, Min2( a.output_path.n, b.output_path.n ) );
+		return cmp != 0 ? cmp < 0 : a.output_path.n < b.output_path.n;
+	} );
+
+	DynamicString manifest( sys_allocator );
+	for( const ManifestEntry & entry : *entries ) {
+		manifest.append( "{016x} {016x} {}\n", entry.input_hash, entry.settings_hash, entry.output_path );
+	}
+
+	if( !WriteFile( sys_allocator, path, manifest.c_str(), manifest.length() ) ) {
+		FatalErrno( "WriteFile" );
+	}
+}
+
+struct Image {
+	const char * png_path;
+	const char * dds_path;
+	u64 input_hash;
+	bool up_to_date;
+	bool failed;
+
+	u32 w, h;
+	u32 num_levels;
+	u8 * mips; // alpha channel of every mip level back to back
+	Span< u8 > packed; // DDS header followed by the BC4 blocks
+};
+
+struct EncodeChunk {
+	Image * image;
+	Span2D< const u8 > mip;
+	u32 first_row;
+	u32 num_rows;
+	u8 * dst;
+};
+
+static void DecodeAndResize( Image * image, Span< const ManifestEntry > manifest, u64 settings_hash, bool force ) {
+	TracyZoneScoped;
+	TracyZoneSpan( MakeSpan( image->png_path ) );
+
+	Span< u8 > png_file = ReadFileBinary( sys_allocator, image->png_path );
+	if( png_file.ptr == NULL ) {
+		printf( "Can't read %s\n", image->png_path );
+		image->failed = true;
+		return;
 	}
+	defer { Free( sys_allocator, png_file.ptr ); };
+
+	image->input_hash = Hash64( png_file.ptr, png_file.num_bytes() );
 
-	const char * png_path = argc == 2 ? argv[ 1 ] : argv[ 3 ];
-	const char * output_dir = argc == 2 ? "." : argv[ 2 ];
+	const ManifestEntry * entry = FindManifestEntry( manifest, MakeSpan( image->dds_path ) );
+	if( !force && entry != NULL && entry->input_hash == image->input_hash && entry->settings_hash == settings_hash && FileExists( sys_allocator, image->dds_path ) ) {
+		image->up_to_date = true;
+		return;
+	}
 
 	int w, h, num_channels;
-	u8 * png = stbi_load( png_path, &w, &h, &num_channels, 0 );
+	u8 * png = stbi_load_from_memory( png_file.ptr, png_file.num_bytes(), &w, &h, &num_channels, 0 );
 	if( png == NULL ) {
-		Fatal( "Can't load image: %s", stbi_failure_reason() );
+		printf( "Can't load image %s: %s\n", image->png_path, stbi_failure_reason() );
+		image->failed = true;
+		return;
 	}
 	defer { stbi_image_free( png ); };
 
-	u8 * alpha_channel = AllocMany< u8 >( sys_allocator, w * h );
-	defer { Free( sys_allocator, alpha_channel ); };
-	for( size_t i = 0; i < checked_cast< size_t >( w * h ); i++ ) {
-		alpha_channel[ i ] = png[ i * num_channels + num_channels - 1 ];
-	}
+	image->w = w;
+	image->h = h;
 
 	bool generate_mipmaps = IsPowerOf2( w ) && IsPowerOf2( h );
 	if( !generate_mipmaps ) {
-		printf( "Image isn't pow2 sized so we aren't computing mipmaps: %s\n", png_path );
-	}
-
-	u32 num_levels = generate_mipmaps ? BlockFormatMipLevels( w, h ) : 1;
-	u32 total_size = 0;
-	for( u32 i = 0; i < num_levels; i++ ) {
-		total_size += MipSize( w, h, i );
+		printf( "Image isn't pow2 sized so we aren't computing mipmaps: %s\n", image->png_path );
 	}
 
-	// TODO: should use the stuff in material.cpp instead of duplicating it here
-	constexpr u32 BC4BitsPerPixel = 4;
-	constexpr u32 BC4BlockSize = ( 4 * 4 * BC4BitsPerPixel ) / 8;
-
-	u32 bc4_bytes = ( total_size * BC4BitsPerPixel ) / 8;
-	Span< u8 > bc4 = AllocSpan< u8 >( sys_allocator, bc4_bytes );
-	u32 bc4_cursor = 0;
+	image->num_levels = generate_mipmaps ? BlockFormatMipLevels( w, h ) : 1;
 
-	u8 * resized = AllocMany< u8 >( sys_allocator, w * h );
+	u32 total_pixels = 0;
+	u32 total_blocks = 0;
+	for( u32 i = 0; i < image->num_levels; i++ ) {
+		total_pixels += MipSize( w, h, i );
+		total_blocks += MipBlocks( w, h, i );
+	}
 
-	defer { Free( sys_allocator, bc4.ptr ); };
-	defer { Free( sys_allocator, resized ); };
+	image->mips = AllocMany< u8 >( sys_allocator, total_pixels );
+	image->packed = AllocSpan< u8 >( sys_allocator, sizeof( DDSHeader ) + total_blocks * BC4BlockSize );
 
-	rgbcx::init();
+	u8 * alpha_channel = image->mips;
+	for( size_t i = 0; i < checked_cast< size_t >( w * h ); i++ ) {
+		alpha_channel[ i ] = png[ i * num_channels + num_channels - 1 ];
+	}
 
-	for( u32 i = 0; i < num_levels; i++ ) {
+	u8 * mip = image->mips + w * h;
+	for( u32 i = 1; i < image->num_levels; i++ ) {
 		u32 mip_w, mip_h;
 		MipDims( &mip_w, &mip_h, w, h, i );
 
 		u8 * ok = stbir_resize_uint8_linear(
 			alpha_channel, w, h, 0,
-			resized, mip_w, mip_h, 0,
+			mip, mip_w, mip_h, 0,
 			STBIR_1CHANNEL
 		);
 
@@ -111,43 +257,300 @@ int main( int argc, char ** argv ) {
 			Fatal( "stb_image_resize died lol" );
 		}
 
-		Span2D< const u8 > mip = Span2D< u8 >( resized, mip_w, mip_h );
-
-		for( u32 row = 0; row < mip_h / 4; row++ ) {
-			for( u32 col = 0; col < mip_w / 4; col++ ) {
-				Span2D< const u8 > src = mip.slice( col * 4, row * 4, 4, 4 );
-				u8 src_block[ 16 ];
-				CopySpan2D( Span2D< u8 >( src_block, 4, 4 ), src );
-
-				Span< u8 > dst = bc4.slice( bc4_cursor, bc4_cursor + BC4BlockSize );
-				rgbcx::encode_bc4( dst.ptr, src_block, 1 );
-				bc4_cursor += BC4BlockSize;
-			}
-		}
+		mip += mip_w * mip_h;
 	}
 
-	Assert( bc4_cursor == bc4.num_bytes() );
-
 	DDSHeader dds_header = { };
 	dds_header.magic = DDSMagic;
 	dds_header.height = h;
 	dds_header.width = w;
-	dds_header.mipmap_count = num_levels;
+	dds_header.mipmap_count = image->num_levels;
 	dds_header.format_flags = DDSTextureFormatFlag_FourCC;
 	dds_header.format = DDSTextureFormat_BC4;
 
-	Span< u8 > packed = AllocSpan< u8 >( sys_allocator, sizeof( dds_header ) + bc4.num_bytes() );
-	defer { Free( sys_allocator, packed.ptr ); };
-	memcpy( packed.ptr, &dds_header, sizeof( dds_header ) );
-	memcpy( packed.ptr + sizeof( dds_header ), bc4.ptr, bc4.num_bytes() );
+	memcpy( image->packed.ptr, &dds_header, sizeof( dds_header ) );
+}
+
+static void AddEncodeChunks( DynamicArray< EncodeChunk > * chunks, Image * image ) {
+	const u8 * mip = image->mips;
+	u8 * dst = image->packed.ptr + sizeof( DDSHeader );
+
+	for( u32 i = 0; i < image->num_levels; i++ ) {
+		u32 mip_w, mip_h;
+		MipDims( &mip_w, &mip_h, image->w, image->h, i );
+
+		u32 block_rows = mip_h / 4;
+		for( u32 row = 0; row < block_rows; row += BLOCK_ROWS_PER_CHUNK ) {
+			EncodeChunk chunk;
+			chunk.image = image;
+			chunk.mip = Span2D< const u8 >( mip, mip_w, mip_h );
+			chunk.first_row = row;
+			chunk.num_rows = Min2( BLOCK_ROWS_PER_CHUNK, block_rows - row );
+			chunk.dst = dst + row * ( mip_w / 4 ) * BC4BlockSize;
+			chunks->add( chunk );
+		}
+
+		mip += mip_w * mip_h;
+		dst += MipBlocks( image->w, image->h, i ) * BC4BlockSize;
+	}
+}
+
+static void EncodeChunkBlocks( const EncodeChunk & chunk ) {
+	TracyZoneScoped;
+
+	u8 * dst = chunk.dst;
+	for( u32 row = chunk.first_row; row < chunk.first_row + chunk.num_rows; row++ ) {
+		for( u32 col = 0; col < chunk.mip.w / 4; col++ ) {
+			Span2D< const u8 > src = chunk.mip.slice( col * 4, row * 4, 4, 4 );
+			u8 src_block[ 16 ];
+			CopySpan2D( Span2D< u8 >( src_block, 4, 4 ), src );
 
-	Span< u8 > compressed = Compress( sys_allocator, packed );
+			rgbcx::encode_bc4( dst, src_block, 1 );
+			dst += BC4BlockSize;
+		}
+	}
+}
+
+static void CompressAndWrite( Image * image ) {
+	TracyZoneScoped;
+	TracyZoneSpan( MakeSpan( image->dds_path ) );
+
+	Span< u8 > compressed = Compress( sys_allocator, image->packed );
 	defer { Free( sys_allocator, compressed.ptr ); };
 
-	DynamicString dds_path( sys_allocator, "{}/{}.dds.zst", output_dir, StripExtension( png_path ) );
-	if( !WriteFile( sys_allocator, dds_path.c_str(), compressed.ptr, compressed.num_bytes() ) ) {
-		FatalErrno( "WriteFile" );
+	if( !WriteFile( sys_allocator, image->dds_path, compressed.ptr, compressed.num_bytes() ) ) {
+		printf( "Can't write %s\n", image->dds_path );
+		image->failed = true;
+	}
+}
+
+static void FindPNGsRecursive( DynamicArray< const char * > * pngs, DynamicString * path ) {
+	ListDirHandle scan = BeginListDir( sys_allocator, path->c_str() );
+
+	const char * name;
+	bool dir;
+	while( ListDirNext( &scan, &name, &dir ) ) {
+		// skip ., .., .git, etc
+		if( name[ 0 ] == '.' )
+			continue;
+
+		size_t old_len = path->length();
+		path->append( "/{}", name );
+		if( dir ) {
+			FindPNGsRecursive( pngs, path );
+		}
+		else if( FileExtension( path->c_str() ) == ".png" ) {
+			pngs->add( CopyString( sys_allocator, path->c_str() ) );
+		}
+		path->truncate( old_len );
+	}
+}
+
+// inputs can be pngs, directories to search for pngs, or @file with one png per line
+static bool AddInput( DynamicArray< const char * > * pngs, const char * input ) {
+	if( input[ 0 ] == '@' ) {
+		Span< u8 > list = ReadFileBinary( sys_allocator, input + 1 );
+		if( list.ptr == NULL ) {
+			printf( "Can't read %s\n", input + 1 );
+			return false;
+		}
+		defer { Free( sys_allocator, list.ptr ); };
+
+		Span< const char > cursor = list.cast< const char >();
+		while( cursor.n > 0 ) {
+			const char * newline = StrChr( cursor, '\n' );
+			size_t line_length = newline == NULL ? cursor.n : newline - cursor.ptr;
+			Span< const char > line = cursor.slice( 0, line_length );
+			if( line.n > 0 && line[ line.n - 1 ] == '\r' ) {
+				line.n--;
+			}
+			if( line.n > 0 ) {
+				pngs->add( ( *sys_allocator )( "{}", line ) );
+			}
+			cursor = cursor + Min2( line_length + 1, cursor.n );
+		}
+
+		return true;
+	}
+
+	if( FileExtension( input ) == ".png" ) {
+		pngs->add( CopyString( sys_allocator, input ) );
+		return true;
+	}
+
+	DynamicString path( sys_allocator, "{}", input );
+	FindPNGsRecursive( pngs, &path );
+	return true;
+}
+
+static void PrintUsage( const char * argv0 ) {
+	printf( "Usage: %s [--output-dir dir] [--manifest path] [--threads N] [--force] <file.png|dir|@list.txt>...\n", argv0 );
+}
+
+int main( int argc, char ** argv ) {
+	const char * output_dir = ".";
+	const char * manifest_path = NULL;
+	bool force = false;
+	u32 num_threads = GetCoreCount();
+
+	DynamicArray< const char * > pngs( sys_allocator );
+	defer {
+		for( const char * png : pngs ) {
+			Free( sys_allocator, const_cast< char * >( png ) );
+		}
+	};
+
+	for( int i = 1; i < argc; i++ ) {
+		bool has_value = i + 1 < argc;
+		if( StrEqual( argv[ i ], "--output-dir" ) && has_value ) {
+			output_dir = argv[ ++i ];
+		}
+		else if( StrEqual( argv[ i ], "--manifest" ) && has_value ) {
+			manifest_path = argv[ ++i ];
+		}
+		else if( StrEqual( argv[ i ], "--threads" ) && has_value ) {
+			num_threads = Clamp( 1_u32, u32( atoi( argv[ ++i ] ) ), MAX_THREADS );
+		}
+		else if( StrEqual( argv[ i ], "--force" ) ) {
+			force = true;
+		}
+		else if( argv[ i ][ 0 ] == '-' && argv[ i ][ 1 ] == '-' ) {
+			PrintUsage( argv[ 0 ] );
+			return 1;
+		}
+		else if( !AddInput( &pngs, argv[ i ] ) ) {
+			return 1;
+		}
+	}
+
+	if( pngs.size() == 0 ) {
+		PrintUsage( argv[ 0 ] );
+		return 1;
+	}
+
+	InitThreadPool( Min2( num_threads, MAX_THREADS ) );
+	defer { ShutdownThreadPool(); };
+
+	nanosort( pngs.begin(), pngs.end(), SortCStringsComparator );
+
+	// the same png given twice would race on its output
+	size_t num_unique = 0;
+	for( size_t i = 0; i < pngs.size(); i++ ) {
+		if( num_unique > 0 && StrEqual( pngs[ i ], pngs[ num_unique - 1 ] ) ) {
+			Free( sys_allocator, const_cast< char * >( pngs[ i ] ) );
+			continue;
+		}
+		pngs[ num_unique ] = pngs[ i ];
+		num_unique++;
+	}
+	pngs.resize( num_unique );
+
+	DynamicString default_manifest_path( sys_allocator, "{}/bc4_manifest.txt", output_dir );
+	if( manifest_path == NULL ) {
+		manifest_path = default_manifest_path.c_str();
+	}
+
+	Span< u8 > manifest_contents;
+	DynamicArray< ManifestEntry > manifest( sys_allocator );
+	LoadManifest( manifest_path, &manifest_contents, &manifest );
+	defer { Free( sys_allocator, manifest_contents.ptr ); };
+
+	struct {
+		u64 version;
+		int zstd_level;
+	} settings = { BC4_ENCODER_VERSION, ZSTD_maxCLevel() };
+	u64 settings_hash = Hash64( &settings, sizeof( settings ) );
+
+	rgbcx::init();
+
+	Span< Image > images = AllocSpan< Image >( sys_allocator, pngs.size() );
+	defer { Free( sys_allocator, images.ptr ); };
+	for( size_t i = 0; i < pngs.size(); i++ ) {
+		images[ i ] = { };
+		images[ i ].png_path = pngs[ i ];
+		images[ i ].dds_path = ( *sys_allocator )( "{}/{}.dds.zst", output_dir, StripExtension( pngs[ i ] ) );
+	}
+
+	u64 start = ggtime();
+	u64 encode_flicks = 0;
+	u64 pixels = 0;
+
+	for( size_t first = 0; first < images.n; first += IMAGES_PER_BATCH ) {
+		Span< Image > batch = images.slice( first, Min2( first + IMAGES_PER_BATCH, images.n ) );
+
+		ParallelFor( batch.n, 1, [&]( size_t i ) {
+			DecodeAndResize( &batch[ i ], manifest.span(), settings_hash, force );
+		} );
+
+		DynamicArray< EncodeChunk > chunks( sys_allocator );
+		for( Image & image : batch ) {
+			if( image.mips == NULL )
+				continue;
+
+			AddEncodeChunks( &chunks, &image );
+			for( u32 i = 0; i < image.num_levels; i++ ) {
+				pixels += MipSize( image.w, image.h, i );
+			}
+		}
+
+		u64 encode_start = ggtime();
+		ParallelFor( chunks.size(), 1, [&]( size_t i ) {
+			EncodeChunkBlocks( chunks[ i ] );
+		} );
+		encode_flicks += ggtime() - encode_start;
+
+		ParallelFor( batch.n, 1, [&]( size_t i ) {
+			if( batch[ i ].mips != NULL ) {
+				CompressAndWrite( &batch[ i ] );
+			}
+		} );
+
+		for( Image & image : batch ) {
+			Free( sys_allocator, image.mips );
+			Free( sys_allocator, image.packed.ptr );
+			image.mips = NULL;
+			image.packed = Span< u8 >();
+		}
+	}
+
+	float seconds = FlicksToSeconds( ggtime() - start );
+
+	size_t num_up_to_date = 0;
+	size_t num_failed = 0;
+	size_t num_manifest_entries = manifest.size();
+
+	for( const Image & image : images ) {
+		num_up_to_date += image.up_to_date ? 1 : 0;
+		num_failed += image.failed ? 1 : 0;
+		if( image.failed || image.up_to_date )
+			continue;
+
+		ManifestEntry entry;
+		entry.output_hash = Hash64( MakeSpan( image.dds_path ) );
+		entry.input_hash = image.input_hash;
+		entry.settings_hash = settings_hash;
+		entry.output_path = MakeSpan( image.dds_path );
+
+		const ManifestEntry * existing = FindManifestEntry( manifest.span().slice( 0, num_manifest_entries ), entry.output_path );
+		if( existing != NULL ) {
+			manifest[ existing - manifest.begin() ] = entry;
+		}
+		else {
+			manifest.add( entry );
+		}
 	}
 
-	return 0;
+	WriteManifest( manifest_path, &manifest );
+
+	for( const Image & image : images ) {
+		Free( sys_allocator, const_cast< char * >( image.dds_path ) );
+	}
+
+	float mpixels = pixels / 1000.0f / 1000.0f;
+	ggprint( "{} images, {} compressed, {} up to date, {} failed\n", images.n, images.n - num_up_to_date - num_failed, num_up_to_date, num_failed );
+	ggprint( "{.2} MPixels in {.2}s with {} threads: {.2} MPixels/s overall, {.2} MPixels/s BC4 encoding\n",
+		mpixels, seconds, num_threads,
+		mpixels / Max2( seconds, 0.001f ), mpixels / Max2( FlicksToSeconds( encode_flicks ), 0.001f ) );
+
+	return num_failed == 0 ? 0 : 1;
 }
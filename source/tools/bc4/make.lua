@@ -5,6 +5,7 @@ bin( "bc4", {
 		"source/qcommon/base.cpp",
 		"source/qcommon/fs.cpp",
 		"source/qcommon/hash.cpp",
+		"source/qcommon/threadpool.cpp",
 		"source/qcommon/platform/*_fs.cpp",
 		"source/qcommon/platform/*_sys.cpp",
 		"source/qcommon/platform/*_threads.cpp",
@@ -14,6 +15,7 @@ bin( "bc4", {
 
 	libs = {
 		"ggformat",
+		"ggtime",
 		"rgbcx",
 		"stb_image",
 		"stb_image_resize",
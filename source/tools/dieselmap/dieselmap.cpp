@@ -3,11 +3,14 @@
 #include "qcommon/fs.h"
 #include "qcommon/string.h"
 #include "qcommon/hash.h"
+#include "qcommon/threads.h"
 #include "gameshared/cdmap.h"
 #include "gameshared/editor_materials.h"
 #include "gameshared/q_math.h"
 #include "gameshared/q_shared.h"
 
+#include "gg/ggtime.h"
+
 #include "meshoptimizer/meshoptimizer.h"
 
 #include "nanosort/nanosort.hpp"
@@ -16,6 +19,8 @@
 
 // include these last so initializer_list.h doesn't blow up
 #include "parsing.h"
+#include "qcommon/threadpool.h"
+#include <atomic>
 #include <vector>
 
 void ShowErrorMessage( const char * msg, const char * file, int line ) {
@@ -192,9 +197,6 @@ static std::vector< CompiledMesh > BrushToCompiledMeshes( const ParsedBrush & br
 		Vec3 normal = planes[ i ].normal;
 		for( Vec3 position : hull ) {
 			InterleavedMapVertex v = { position, normal };
-			if( v.position.z <= -1024.0f ) {
-				v.position.z = -999999.0f;
-			}
 			material_mesh.vertices.push_back( v );
 		}
 
@@ -216,14 +218,41 @@ static std::vector< CompiledMesh > BrushToCompiledMeshes( const ParsedBrush & br
 	return face_meshes;
 }
 
-struct CandidatePlane {
+/*
+ * kd-tree splits are chosen with the surface area heuristic. big nodes bin
+ * brush edges into SAH_BINS buckets per axis, which only needs one pass over
+ * the brushes, and small nodes sort their edges and try every one of them
+ * like the PBR book does. subtrees get built as separate jobs when
+ * they're big enough, and are stitched back together in the same order a
+ * serial build would produce, so the output doesn't depend on scheduling
+ */
+
+constexpr float KDTREE_TRAVERSAL_COST = 1.0f;
+constexpr float KDTREE_INTERSECT_COST = 80.0f;
+
+constexpr u32 SAH_BINS = 32;
+constexpr size_t BINNED_SAH_MIN_BRUSHES = 1024;
+constexpr size_t PARALLEL_SUBTREE_MIN_BRUSHES = 512;
+
+struct KDTreeBuildConfig {
+	bool binned;
+	bool parallel;
+};
+
+struct KDTreeBuilder {
+	KDTreeBuildConfig config;
+	Span< const MinMax3 > brush_bounds;
+};
+
+struct KDTreeSplit {
+	int axis;
 	float distance;
-	u32 brush_id;
-	bool start_edge;
+	float cost;
 };
 
-struct CandidatePlanes {
-	std::vector< CandidatePlane > axes[ 3 ];
+struct CandidatePlane {
+	float distance;
+	bool start_edge;
 };
 
 static int MaxAxis( MinMax3 bounds ) {
@@ -238,50 +267,102 @@ static float SurfaceArea( MinMax3 bounds ) {
 	return 2.0f * ( dims.x * dims.y + dims.x * dims.z + dims.y * dims.z );
 }
 
-static CandidatePlanes BuildCandidatePlanes( Span< const u32 > brush_ids, Span< const MinMax3 > brush_bounds ) {
-	TracyZoneScoped;
+static void SplitBounds( MinMax3 bounds, int axis, float distance, MinMax3 * below, MinMax3 * above ) {
+	*below = bounds;
+	*above = bounds;
+
+	below->maxs[ axis ] = distance;
+	above->mins[ axis ] = distance;
+}
 
-	CandidatePlanes planes;
+static float SplitCost( MinMax3 node_bounds, float node_surface_area, int axis, float distance, size_t num_below, size_t num_above ) {
+	MinMax3 below_bounds, above_bounds;
+	SplitBounds( node_bounds, axis, distance, &below_bounds, &above_bounds );
 
-#if TRACY_ENABLE
-	constexpr const char * zone_labels[ 3 ] = { "X", "Y", "Z" };
-#endif
+	float frac_below = SurfaceArea( below_bounds ) / node_surface_area;
+	float frac_above = SurfaceArea( above_bounds ) / node_surface_area;
 
-	for( int i = 0; i < 3; i++ ) {
-		TracyZoneScopedN( zone_labels[ i ] );
+	float empty_bonus = num_below == 0 || num_above == 0 ? 0.5f : 1.0f;
+
+	return KDTREE_TRAVERSAL_COST + KDTREE_INTERSECT_COST * empty_bonus * ( frac_below * num_below + frac_above * num_above );
+}
+
+static void ConsiderSplit( KDTreeSplit * best, int axis, float distance, float cost ) {
+	if( cost < best->cost ) {
+		*best = { axis, distance, cost };
+	}
+}
+
+static void FindBestSplitExact( TempAllocator * temp, KDTreeSplit * best, Span< const u32 > brush_ids, Span< const MinMax3 > brush_bounds, MinMax3 node_bounds, int axis ) {
+	float node_surface_area = SurfaceArea( node_bounds );
+
+	Span< CandidatePlane > planes = AllocSpan< CandidatePlane >( temp, brush_ids.n * 2 );
+	for( size_t i = 0; i < brush_ids.n; i++ ) {
+		planes[ i * 2 + 0 ] = { brush_bounds[ brush_ids[ i ] ].mins[ axis ], true };
+		planes[ i * 2 + 1 ] = { brush_bounds[ brush_ids[ i ] ].maxs[ axis ], false };
+	}
+
+	nanosort( planes.begin(), planes.end(), []( const CandidatePlane & a, const CandidatePlane & b ) {
+		if( a.distance == b.distance )
+			return a.start_edge < b.start_edge;
+		return a.distance < b.distance;
+	} );
 
-		std::vector< CandidatePlane > & axis = planes.axes[ i ];
-		axis.reserve( brush_ids.n * 2 );
+	size_t num_below = 0;
+	size_t num_above = brush_ids.n;
 
-		for( u32 brush_id : brush_ids ) {
-			axis.push_back( { brush_bounds[ brush_id ].mins[ i ], brush_id, true } );
-			axis.push_back( { brush_bounds[ brush_id ].maxs[ i ], brush_id, false } );
+	for( const CandidatePlane & plane : planes ) {
+		if( !plane.start_edge ) {
+			num_above--;
 		}
 
-		{
-			TracyZoneScopedN( "Sort" );
-			nanosort( axis.begin(), axis.end(), []( const CandidatePlane & a, const CandidatePlane & b ) {
-				if( a.distance == b.distance )
-					return a.start_edge < b.start_edge;
-				return a.distance < b.distance;
-			} );
+		if( plane.distance > node_bounds.mins[ axis ] && plane.distance < node_bounds.maxs[ axis ] ) {
+			ConsiderSplit( best, axis, plane.distance, SplitCost( node_bounds, node_surface_area, axis, plane.distance, num_below, num_above ) );
 		}
-	}
 
-	return planes;
+		if( plane.start_edge ) {
+			num_below++;
+		}
+	}
 }
 
-static void SplitBounds( MinMax3 bounds, int axis, float distance, MinMax3 * below, MinMax3 * above ) {
-	*below = bounds;
-	*above = bounds;
+static void FindBestSplitBinned( KDTreeSplit * best, Span< const u32 > brush_ids, Span< const MinMax3 > brush_bounds, MinMax3 node_bounds, int axis ) {
+	float node_surface_area = SurfaceArea( node_bounds );
 
-	below->maxs[ axis ] = distance;
-	above->mins[ axis ] = distance;
+	float lo = node_bounds.mins[ axis ];
+	float extent = node_bounds.maxs[ axis ] - lo;
+	if( extent <= 0.0f )
+		return;
+
+	float to_bin = SAH_BINS / extent;
+
+	// starts[ i ] counts brushes whose mins land in bin i, so the brushes
+	// below boundary k are the sum of starts[ 0, k ). likewise with maxs
+	// for the brushes above
+	u32 starts[ SAH_BINS ] = { };
+	u32 ends[ SAH_BINS ] = { };
+
+	for( u32 brush_id : brush_ids ) {
+		const MinMax3 & bounds = brush_bounds[ brush_id ];
+		float start_bin = ( bounds.mins[ axis ] - lo ) * to_bin;
+		float end_bin = ( bounds.maxs[ axis ] - lo ) * to_bin;
+		starts[ u32( Clamp( 0.0f, start_bin, float( SAH_BINS - 1 ) ) ) ]++;
+		ends[ u32( Clamp( 0.0f, end_bin, float( SAH_BINS - 1 ) ) ) ]++;
+	}
+
+	size_t num_below = 0;
+	size_t num_above = brush_ids.n;
+
+	for( u32 i = 1; i < SAH_BINS; i++ ) {
+		num_below += starts[ i - 1 ];
+		num_above -= ends[ i - 1 ];
+
+		float distance = lo + extent * ( float( i ) / SAH_BINS );
+		ConsiderSplit( best, axis, distance, SplitCost( node_bounds, node_surface_area, axis, distance, num_below, num_above ) );
+	}
 }
 
 static u32 MakeLeaf( CompiledKDTree * tree, Span< const u32 > brush_ids ) {
-	TracyZoneScoped;
-
 	MapKDTreeNode leaf;
 	leaf.leaf.is_leaf = 3;
 	leaf.leaf.first_brush = tree->brush_indices.size();
@@ -295,141 +376,137 @@ static u32 MakeLeaf( CompiledKDTree * tree, Span< const u32 > brush_ids ) {
 	return tree->nodes.size() - 1;
 }
 
-static u32 BuildKDTreeRecursive( CompiledKDTree * tree, Span< const u32 > brush_ids, Span< const MinMax3 > brush_bounds, CandidatePlanes candidate_planes, MinMax3 node_bounds, u32 max_depth ) {
-	/*
-	 * this is copied from Physically Based Rendering
-	 * https://pbr-book.org/3ed-2018/Primitives_and_Intersection_Acceleration/Kd-Tree_Accelerator
-	 */
+static void AppendKDTree( CompiledKDTree * tree, const CompiledKDTree & subtree ) {
+	u32 base_node = checked_cast< u32 >( tree->nodes.size() );
+	u32 base_brush_index = checked_cast< u32 >( tree->brush_indices.size() );
 
-	TracyZoneScoped;
-
-	if( brush_ids.n <= 1 || max_depth == 0 ) {
-		return MakeLeaf( tree, brush_ids );
+	for( MapKDTreeNode node : subtree.nodes ) {
+		if( MapKDTreeNode::is_leaf( node ) )
+			node.leaf.first_brush += base_brush_index;
+		else
+			node.node.front_child += base_node;
+		tree->nodes.push_back( node );
 	}
 
-	int best_axis = 0;
-	size_t best_plane = 0;
+	tree->brush_indices.insert( tree->brush_indices.end(), subtree.brush_indices.begin(), subtree.brush_indices.end() );
+}
 
-	float node_surface_area = SurfaceArea( node_bounds );
+static u32 BuildKDTreeRecursive( KDTreeBuilder * builder, ArenaAllocator * arena, CompiledKDTree * tree, Span< const u32 > brush_ids, MinMax3 node_bounds, u32 max_depth );
 
-	{
-		TracyZoneScopedN( "Find best split" );
-
-		float best_cost = INFINITY;
+struct KDSubtreeJob {
+	KDTreeBuilder * builder;
+	Span< const u32 > brush_ids;
+	MinMax3 bounds;
+	u32 max_depth;
+	CompiledKDTree tree;
+};
 
-		for( int i = 0; i < 3; i++ ) {
-			int axis = ( MaxAxis( node_bounds ) + i ) % 3;
+static ArenaAllocator NewKDTreeScratchArena( size_t num_brushes, u32 max_depth ) {
+	// each level keeps its children's brush lists alive while recursing
+	size_t size = 1024 * 1024 + num_brushes * ( max_depth + 1 ) * 2 * sizeof( u32 );
+	return ArenaAllocator( sys_allocator->allocate( size, 16 ), size );
+}
 
-			size_t num_below = 0;
-			size_t num_above = brush_ids.n;
+static void BuildKDSubtreeJob( TempAllocator * temp, void * data ) {
+	TracyZoneScoped;
 
-			for( size_t j = 0; j < candidate_planes.axes[ axis ].size(); j++ ) {
-				const CandidatePlane & plane = candidate_planes.axes[ axis ][ j ];
+	KDSubtreeJob * job = ( KDSubtreeJob * ) data;
 
-				if( !plane.start_edge ) {
-					num_above--;
-				}
+	ArenaAllocator arena = NewKDTreeScratchArena( job->brush_ids.n, job->max_depth );
+	defer { Free( sys_allocator, arena.get_memory() ); };
 
-				if( plane.distance > node_bounds.mins[ axis ] && plane.distance < node_bounds.maxs[ axis ] ) {
-					MinMax3 below_bounds, above_bounds;
-					SplitBounds( node_bounds, axis, plane.distance, &below_bounds, &above_bounds );
+	BuildKDTreeRecursive( job->builder, &arena, &job->tree, job->brush_ids, job->bounds, job->max_depth );
+}
 
-					float frac_below = SurfaceArea( below_bounds ) / node_surface_area;
-					float frac_above = SurfaceArea( above_bounds ) / node_surface_area;
+static u32 BuildKDTreeRecursive( KDTreeBuilder * builder, ArenaAllocator * arena, CompiledKDTree * tree, Span< const u32 > brush_ids, MinMax3 node_bounds, u32 max_depth ) {
+	/*
+	 * this is copied from Physically Based Rendering
+	 * https://pbr-book.org/3ed-2018/Primitives_and_Intersection_Acceleration/Kd-Tree_Accelerator
+	 */
 
-					float empty_bonus = num_below == 0 || num_above == 0 ? 0.5f : 1.0f;
+	if( brush_ids.n <= 1 || max_depth == 0 ) {
+		return MakeLeaf( tree, brush_ids );
+	}
 
-					constexpr float traversal_cost = 1.0f;
-					constexpr float intersect_cost = 80.0f;
-					float cost = traversal_cost + intersect_cost * empty_bonus * ( frac_below * num_below + frac_above * num_above );
+	TempAllocator temp = arena->temp();
+	Span< const MinMax3 > brush_bounds = builder->brush_bounds;
 
-					if( cost < best_cost ) {
-						best_cost = cost;
-						best_axis = axis;
-						best_plane = j;
-					}
-				}
+	KDTreeSplit best = { 0, 0.0f, INFINITY };
+	bool binned = builder->config.binned && brush_ids.n >= BINNED_SAH_MIN_BRUSHES;
 
-				if( plane.start_edge ) {
-					num_below++;
-				}
-			}
+	for( int i = 0; i < 3; i++ ) {
+		int axis = ( MaxAxis( node_bounds ) + i ) % 3;
 
-			if( best_cost != INFINITY ) {
-				break;
-			}
+		if( binned ) {
+			FindBestSplitBinned( &best, brush_ids, brush_bounds, node_bounds, axis );
+		}
+		else {
+			TempAllocator sort_temp = arena->temp();
+			FindBestSplitExact( &sort_temp, &best, brush_ids, brush_bounds, node_bounds, axis );
 		}
 
-		if( best_cost == INFINITY ) {
-			return MakeLeaf( tree, brush_ids );
+		if( best.cost != INFINITY ) {
+			break;
 		}
 	}
 
-	// make node
-	float distance = candidate_planes.axes[ best_axis ][ best_plane ].distance;
+	if( best.cost == INFINITY ) {
+		return MakeLeaf( tree, brush_ids );
+	}
 
 	MapKDTreeNode node;
-	node.node.is_leaf_and_splitting_plane_axis = best_axis;
-	node.node.splitting_plane_distance = distance;
+	node.node.is_leaf_and_splitting_plane_axis = best.axis;
+	node.node.splitting_plane_distance = best.distance;
 
-	std::vector< u32 > below_brush_ids;
-	std::vector< u32 > above_brush_ids;
+	Span< u32 > below_brush_ids = AllocSpan< u32 >( &temp, brush_ids.n );
+	Span< u32 > above_brush_ids = AllocSpan< u32 >( &temp, brush_ids.n );
+	size_t num_below = 0;
+	size_t num_above = 0;
 
-	{
-		TracyZoneScopedN( "Classify above/below" );
-
-		for( size_t i = 0; i < best_plane; i++ ) {
-			if( candidate_planes.axes[ best_axis ][ i ].start_edge ) {
-				below_brush_ids.push_back( candidate_planes.axes[ best_axis ][ i ].brush_id );
-			}
+	for( u32 brush_id : brush_ids ) {
+		if( brush_bounds[ brush_id ].mins[ best.axis ] < best.distance ) {
+			below_brush_ids[ num_below ] = brush_id;
+			num_below++;
 		}
-
-		for( size_t i = best_plane + 1; i < candidate_planes.axes[ best_axis ].size(); i++ ) {
-			if( !candidate_planes.axes[ best_axis ][ i ].start_edge ) {
-				above_brush_ids.push_back( candidate_planes.axes[ best_axis ][ i ].brush_id );
-			}
+		if( brush_bounds[ brush_id ].maxs[ best.axis ] > best.distance ) {
+			above_brush_ids[ num_above ] = brush_id;
+			num_above++;
 		}
 	}
 
-	CandidatePlanes below_planes;
-	CandidatePlanes above_planes;
-	{
-		TracyZoneScopedN( "Split candidate planes" );
-
-		for( int i = 0; i < 3; i++ ) {
-			std::vector< CandidatePlane > & axis_below = below_planes.axes[ i ];
-			std::vector< CandidatePlane > & axis_above = above_planes.axes[ i ];
-
-			for( size_t j = 0; j < candidate_planes.axes[ i ].size(); j++ ) {
-				CandidatePlane & plane = candidate_planes.axes[ i ][ j ];
-				const MinMax3 & curr_brush_bounds = brush_bounds[ plane.brush_id ];
-
-				if( curr_brush_bounds.mins[ best_axis ] < distance )
-					axis_below.push_back( plane );
-				if( curr_brush_bounds.maxs[ best_axis ] > distance )
-					axis_above.push_back( plane );
-			}
-
-			below_planes.axes[ i ] = axis_below;
-			above_planes.axes[ i ] = axis_above;
-		}
-	}
+	below_brush_ids = below_brush_ids.slice( 0, num_below );
+	above_brush_ids = above_brush_ids.slice( 0, num_above );
 
 	MinMax3 below_bounds, above_bounds;
-	SplitBounds( node_bounds, best_axis, distance, &below_bounds, &above_bounds );
+	SplitBounds( node_bounds, best.axis, best.distance, &below_bounds, &above_bounds );
 
 	u32 node_id = checked_cast< u32 >( tree->nodes.size() );
 	tree->nodes.push_back( MapKDTreeNode() );
 
-	BuildKDTreeRecursive( tree, VectorToSpan( below_brush_ids ), brush_bounds, below_planes, below_bounds, max_depth - 1 );
-	node.node.front_child = BuildKDTreeRecursive( tree, VectorToSpan( above_brush_ids ), brush_bounds, above_planes, above_bounds, max_depth - 1 );
+	bool parallel = builder->config.parallel && num_above >= PARALLEL_SUBTREE_MIN_BRUSHES && num_below >= PARALLEL_SUBTREE_MIN_BRUSHES;
+	if( parallel ) {
+		KDSubtreeJob above_job = { builder, above_brush_ids, above_bounds, max_depth - 1 };
+		JobCounter above_done = { };
+		SpawnJob( &above_done, BuildKDSubtreeJob, &above_job, "BuildKDSubtree" );
+
+		BuildKDTreeRecursive( builder, arena, tree, below_brush_ids, below_bounds, max_depth - 1 );
+
+		WaitForJobs( &above_done );
+
+		node.node.front_child = checked_cast< u32 >( tree->nodes.size() );
+		AppendKDTree( tree, above_job.tree );
+	}
+	else {
+		BuildKDTreeRecursive( builder, arena, tree, below_brush_ids, below_bounds, max_depth - 1 );
+		node.node.front_child = BuildKDTreeRecursive( builder, arena, tree, above_brush_ids, above_bounds, max_depth - 1 );
+	}
 
 	tree->nodes[ node_id ] = node;
 
 	return node_id;
 }
 
-static void BuildKDTree( CompiledKDTree * tree, Span< const MinMax3 > brush_bounds ) {
+static void BuildKDTree( CompiledKDTree * tree, Span< const MinMax3 > brush_bounds, KDTreeBuildConfig config ) {
 	TracyZoneScoped;
 
 	MinMax3 tree_bounds = MinMax3::Empty();
@@ -439,16 +516,94 @@ static void BuildKDTree( CompiledKDTree * tree, Span< const MinMax3 > brush_boun
 
 	u32 max_depth = roundf( 8.0f + 1.3f * Log2( brush_bounds.n ) );
 
-	std::vector< u32 > brush_ids;
+	KDTreeBuilder builder;
+	builder.config = config;
+	builder.brush_bounds = brush_bounds;
+
+	ArenaAllocator arena = NewKDTreeScratchArena( brush_bounds.n, max_depth );
+	defer { Free( sys_allocator, arena.get_memory() ); };
+
+	Span< u32 > brush_ids = AllocSpan< u32 >( &arena, brush_bounds.n );
 	for( u32 i = 0; i < checked_cast< u32 >( brush_bounds.n ); i++ ) {
-		brush_ids.push_back( i );
+		brush_ids[ i ] = i;
+	}
+
+	BuildKDTreeRecursive( &builder, &arena, tree, brush_ids, tree_bounds, max_depth );
+}
+
+static float FlicksToSeconds( u64 flicks ) {
+	return float( double( flicks ) / GGTIME_FLICKS_PER_SECOND );
+}
+
+struct KDTreeStats {
+	u32 num_nodes;
+	u32 num_leaves;
+	u32 max_depth;
+	u32 num_brush_references;
+	float sah_cost;
+};
+
+static void AccumulateKDTreeStats( KDTreeStats * stats, const CompiledKDTree & tree, u32 node_id, MinMax3 bounds, float root_surface_area, u32 depth ) {
+	const MapKDTreeNode & node = tree.nodes[ node_id ];
+	float probability = SurfaceArea( bounds ) / root_surface_area;
+
+	stats->num_nodes++;
+	stats->max_depth = Max2( stats->max_depth, depth );
+
+	if( MapKDTreeNode::is_leaf( node ) ) {
+		stats->num_leaves++;
+		stats->num_brush_references += node.leaf.num_brushes;
+		stats->sah_cost += probability * KDTREE_INTERSECT_COST * node.leaf.num_brushes;
+		return;
 	}
 
-	CandidatePlanes candidate_planes = BuildCandidatePlanes( VectorToSpan( brush_ids ), brush_bounds );
+	stats->sah_cost += probability * KDTREE_TRAVERSAL_COST;
 
-	BuildKDTreeRecursive( tree, VectorToSpan( brush_ids ), brush_bounds, candidate_planes, tree_bounds, max_depth );
+	MinMax3 below_bounds, above_bounds;
+	SplitBounds( bounds, node.node.is_leaf_and_splitting_plane_axis, node.node.splitting_plane_distance, &below_bounds, &above_bounds );
+	AccumulateKDTreeStats( stats, tree, node_id + 1, below_bounds, root_surface_area, depth + 1 );
+	AccumulateKDTreeStats( stats, tree, node.node.front_child, above_bounds, root_surface_area, depth + 1 );
 }
 
+static KDTreeStats ComputeKDTreeStats( const CompiledKDTree & tree ) {
+	KDTreeStats stats = { };
+	if( tree.nodes.size() > 0 ) {
+		AccumulateKDTreeStats( &stats, tree, 0, tree.bounds, SurfaceArea( tree.bounds ), 1 );
+	}
+	return stats;
+}
+
+static void PrintKDTreeStats( const char * label, const KDTreeStats & stats, float seconds ) {
+	printf( "  %-9s %6u nodes, %6u leaves, depth %2u, %5.2f brushes/leaf, SAH cost %8.2f, built in %.2fms\n",
+		label, stats.num_nodes, stats.num_leaves, stats.max_depth,
+		stats.num_leaves == 0 ? 0.0f : float( stats.num_brush_references ) / stats.num_leaves,
+		stats.sah_cost, seconds * 1000.0f );
+}
+
+// builds the tree again with the exact serial builder and prints both, so
+// changes to the builder can't make traces slower without anyone noticing
+static void ReportKDTreeQuality( size_t entity_id, const CompiledKDTree & tree, Span< const MinMax3 > brush_bounds, float build_seconds ) {
+	CompiledKDTree reference;
+	reference.bounds = tree.bounds;
+
+	u64 before = ggtime();
+	BuildKDTree( &reference, brush_bounds, KDTreeBuildConfig { .binned = false, .parallel = false } );
+	float reference_seconds = FlicksToSeconds( ggtime() - before );
+
+	KDTreeStats stats = ComputeKDTreeStats( tree );
+	KDTreeStats reference_stats = ComputeKDTreeStats( reference );
+
+	printf( "entity %zu, %zu brushes:\n", entity_id, brush_bounds.n );
+	PrintKDTreeStats( "binned", stats, build_seconds );
+	PrintKDTreeStats( "reference", reference_stats, reference_seconds );
+	printf( "  SAH cost ratio %.3f, %.1fx faster\n",
+		reference_stats.sah_cost == 0.0f ? 1.0f : stats.sah_cost / reference_stats.sah_cost,
+		build_seconds == 0.0f ? 0.0f : reference_seconds / build_seconds );
+}
+
+// per-brush work is small, so only split it up for entities with lots of brushes
+constexpr size_t PARALLEL_MIN_BRUSHES = 256;
+
 static CompiledMesh MergeMeshes( Span< const CompiledMesh > meshes ) {
 	CompiledMesh merged;
 	merged.material = meshes[ 0 ].material;
@@ -466,13 +621,158 @@ static CompiledMesh MergeMeshes( Span< const CompiledMesh > meshes ) {
 	return merged;
 }
 
+/*
+ * positions are snapped to a grid of MIN_QUANTIZATION_STEP units, or a
+ * coarser power of two if a cluster is too big for u16s with that
+ */
+
+constexpr float MIN_QUANTIZATION_STEP = 1.0f / 32.0f;
+
+struct QuantizationStats {
+	size_t num_meshes;
+	size_t num_coarse_meshes;
+	float max_error;
+};
+
+static float QuantizationStep( MinMax3 bounds ) {
+	Vec3 extent = bounds.maxs - bounds.mins;
+	float max_extent = Max2( extent.x, Max2( extent.y, extent.z ) );
+
+	// +1 because the origin gets rounded down to the grid
+	float step = MIN_QUANTIZATION_STEP;
+	while( max_extent / step + 1.0f > U16_MAX ) {
+		step *= 2.0f;
+	}
+
+	return step;
+}
+
+static MinMax3 MeshBounds( const CompiledMesh & mesh ) {
+	MinMax3 bounds = MinMax3::Empty();
+	for( const InterleavedMapVertex & v : mesh.vertices ) {
+		bounds = Union( bounds, v.position );
+	}
+	return bounds;
+}
+
+/*
+ * split meshes into clusters of nearby triangles so they can be culled
+ * separately. triangles go in the cell their centroid lands in, and big cells
+ * get split again so clusters can use u16 indices. triangles can poke out of
+ * their cell, so clusters that end up too big for the finest quantization grid
+ * get split in half until they fit or are down to one triangle
+ */
+
+constexpr float RENDER_CLUSTER_SIZE = 1024.0f;
+constexpr size_t MAX_CLUSTER_VERTICES = size_t( U16_MAX ) + 1;
+
+static u64 ClusterCell( Vec3 p ) {
+	u64 cell = 0;
+	for( int i = 0; i < 3; i++ ) {
+		s64 c = s64( floorf( p[ i ] / RENDER_CLUSTER_SIZE ) ) + ( 1 << 20 );
+		cell = ( cell << 21 ) | ( u64( Clamp( s64( 0 ), c, s64( ( 1 << 21 ) - 1 ) ) ) );
+	}
+	return cell;
+}
+
+static void AddCluster( std::vector< CompiledMesh > * clusters, const CompiledMesh & cluster ) {
+	MinMax3 bounds = MeshBounds( cluster );
+	if( cluster.indices.size() == 3 || QuantizationStep( bounds ) == MIN_QUANTIZATION_STEP ) {
+		clusters->push_back( cluster );
+		return;
+	}
+
+	struct SortedTriangle {
+		float centroid;
+		size_t first_index;
+	};
+
+	Vec3 extent = bounds.maxs - bounds.mins;
+	int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : extent.y >= extent.z ? 1 : 2;
+
+	std::vector< SortedTriangle > triangles;
+	for( size_t i = 0; i < cluster.indices.size(); i += 3 ) {
+		float centroid = 0.0f;
+		for( size_t j = 0; j < 3; j++ ) {
+			centroid += cluster.vertices[ cluster.indices[ i + j ] ].position[ axis ] / 3.0f;
+		}
+		triangles.push_back( { centroid, i } );
+	}
+
+	nanosort( triangles.begin(), triangles.end(), []( const SortedTriangle & a, const SortedTriangle & b ) {
+		return a.centroid == b.centroid ? a.first_index < b.first_index : a.centroid < b.centroid;
+	} );
+
+	CompiledMesh halves[ 2 ];
+	for( size_t i = 0; i < triangles.size(); i++ ) {
+		CompiledMesh & half = halves[ i < triangles.size() / 2 ? 0 : 1 ];
+		half.material = cluster.material;
+		for( size_t j = 0; j < 3; j++ ) {
+			half.indices.push_back( half.vertices.size() );
+			half.vertices.push_back( cluster.vertices[ cluster.indices[ triangles[ i ].first_index + j ] ] );
+		}
+	}
+
+	AddCluster( clusters, halves[ 0 ] );
+	AddCluster( clusters, halves[ 1 ] );
+}
+
+static void SplitIntoClusters( std::vector< CompiledMesh > * clusters, const CompiledMesh & mesh ) {
+	TracyZoneScoped;
+
+	struct ClusterTriangle {
+		u64 cell;
+		size_t first_index;
+	};
+
+	std::vector< ClusterTriangle > triangles;
+	for( size_t i = 0; i < mesh.indices.size(); i += 3 ) {
+		Vec3 centroid = Vec3( 0.0f );
+		for( size_t j = 0; j < 3; j++ ) {
+			centroid += mesh.vertices[ mesh.indices[ i + j ] ].position / 3.0f;
+		}
+		triangles.push_back( { ClusterCell( centroid ), i } );
+	}
+
+	nanosort( triangles.begin(), triangles.end(), []( const ClusterTriangle & a, const ClusterTriangle & b ) {
+		return a.cell == b.cell ? a.first_index < b.first_index : a.cell < b.cell;
+	} );
+
+	CompiledMesh cluster;
+	u64 cluster_cell = 0;
+
+	for( const ClusterTriangle & triangle : triangles ) {
+		bool full = cluster.vertices.size() + 3 > MAX_CLUSTER_VERTICES;
+		if( cluster.indices.size() > 0 && ( triangle.cell != cluster_cell || full ) ) {
+			AddCluster( clusters, cluster );
+			cluster = CompiledMesh();
+		}
+
+		cluster.material = mesh.material;
+		cluster_cell = triangle.cell;
+
+		for( size_t j = 0; j < 3; j++ ) {
+			cluster.indices.push_back( cluster.vertices.size() );
+			cluster.vertices.push_back( mesh.vertices[ mesh.indices[ triangle.first_index + j ] ] );
+		}
+	}
+
+	if( cluster.indices.size() > 0 ) {
+		AddCluster( clusters, cluster );
+	}
+}
+
 static std::vector< CompiledMesh > GenerateRenderGeometry( const ParsedEntity & entity ) {
 	TracyZoneScoped;
 
+	std::vector< std::vector< CompiledMesh > > brush_meshes( entity.brushes.size() );
+	ParallelFor( entity.brushes.size(), PARALLEL_MIN_BRUSHES, [&]( size_t i ) {
+		brush_meshes[ i ] = BrushToCompiledMeshes( entity.brushes[ i ] );
+	} );
+
 	std::vector< CompiledMesh > face_meshes;
-	for( const ParsedBrush & brush : entity.brushes ) {
-		std::vector< CompiledMesh > brush_meshes = BrushToCompiledMeshes( brush );
-		for( const CompiledMesh & mesh : brush_meshes ) {
+	for( const std::vector< CompiledMesh > & meshes : brush_meshes ) {
+		for( const CompiledMesh & mesh : meshes ) {
 			face_meshes.push_back( mesh );
 		}
 	}
@@ -500,16 +800,23 @@ static std::vector< CompiledMesh > GenerateRenderGeometry( const ParsedEntity &
 		material_start_index = i + 1;
 	}
 
-	std::vector< CompiledMesh > optimized_meshes;
+	std::vector< CompiledMesh > clusters;
 	for( const CompiledMesh & merged : merged_meshes ) {
+		SplitIntoClusters( &clusters, merged );
+	}
+
+	std::vector< CompiledMesh > optimized_meshes( clusters.size() );
+	ParallelFor( clusters.size(), 1, [&]( size_t i ) {
 		TracyZoneScopedN( "meshopt" );
 
+		const CompiledMesh & merged = clusters[ i ];
+
 		std::vector< u32 > remap( merged.indices.size() );
 		size_t unique_verts = meshopt_generateVertexRemap( remap.data(),
 			merged.indices.data(), merged.indices.size(),
 			merged.vertices.data(), merged.vertices.size(), sizeof( InterleavedMapVertex ) );
 
-		CompiledMesh optimized;
+		CompiledMesh & optimized = optimized_meshes[ i ];
 		optimized.material = merged.material;
 		optimized.vertices.resize( unique_verts );
 		optimized.indices.resize( merged.indices.size() );
@@ -525,9 +832,7 @@ static std::vector< CompiledMesh > GenerateRenderGeometry( const ParsedEntity &
 		// { TracyZoneScopedN( "meshopt_optimizeVertexCache" ); meshopt_optimizeVertexCache( indices, indices, num_indices, num_vertices ); }
 		{ TracyZoneScopedN( "meshopt_optimizeOverdraw" ); meshopt_optimizeOverdraw( indices, indices, num_indices, &vertices[ 0 ].position.x, num_vertices, sizeof( InterleavedMapVertex ), 1.05f ); }
 		{ TracyZoneScopedN( "meshopt_optimizeVertexFetch" ); meshopt_optimizeVertexFetch( vertices, indices, num_indices, vertices, num_vertices, sizeof( InterleavedMapVertex ) ); }
-
-		optimized_meshes.push_back( optimized );
-	}
+	} );
 
 	return optimized_meshes;
 }
@@ -542,7 +847,7 @@ static bool IsNearlyAxial( Vec3 v ) {
 	return false;
 }
 
-static CompiledKDTree GenerateCollisionGeometry( const ParsedEntity & entity ) {
+static CompiledKDTree GenerateCollisionGeometry( const ParsedEntity & entity, bool kdtree_report ) {
 	TracyZoneScoped;
 
 	CompiledKDTree kd_tree;
@@ -553,12 +858,20 @@ static CompiledKDTree GenerateCollisionGeometry( const ParsedEntity & entity ) {
 		return kd_tree;
 	}
 
-	std::vector< MinMax3 > brush_bounds;
+	struct BrushPlanes {
+		std::vector< Plane > planes;
+		MinMax3 bounds;
+		const EditorMaterial * editor_material;
+	};
+
+	std::vector< BrushPlanes > brush_planes( entity.brushes.size() );
+
+	ParallelFor( entity.brushes.size(), PARALLEL_MIN_BRUSHES, [&]( size_t brush_idx ) {
+		const ParsedBrush & brush = entity.brushes[ brush_idx ];
 
-	for( const ParsedBrush & brush : entity.brushes ) {
 		// convert triple-vert planes to normal-distance planes
 		const EditorMaterial * editor_material = NULL;
-		std::vector< Plane > planes;
+		std::vector< Plane > & planes = brush_planes[ brush_idx ].planes;
 		for( const ParsedBrushFace & face : brush.faces ) {
 			Plane plane;
 			if( !PlaneFrom3Points( &plane, face.plane[ 0 ], face.plane[ 1 ], face.plane[ 2 ] ) ) {
@@ -588,18 +901,27 @@ static CompiledKDTree GenerateCollisionGeometry( const ParsedEntity & entity ) {
 				bounds = Union( bounds, p );
 			}
 		}
+
+		brush_planes[ brush_idx ].bounds = bounds;
+		brush_planes[ brush_idx ].editor_material = editor_material;
+	} );
+
+	std::vector< MinMax3 > brush_bounds;
+
+	for( const BrushPlanes & brush : brush_planes ) {
+		MinMax3 bounds = brush.bounds;
 		brush_bounds.push_back( bounds );
 
 		// make MapBrush
 		MapBrush map_brush = { };
 		map_brush.bounds = bounds;
 		map_brush.first_plane = checked_cast< u16 >( kd_tree.planes.size() );
-		map_brush.solidity = editor_material->solidity;
+		map_brush.solidity = brush.editor_material->solidity;
 
 		size_t num_planes = 0;
 
 		// add non-axial planes
-		for( Plane plane : planes ) {
+		for( Plane plane : brush.planes ) {
 			if( !IsNearlyAxial( plane.normal ) ) {
 				kd_tree.planes.push_back( plane );
 				num_planes++;
@@ -625,19 +947,149 @@ static CompiledKDTree GenerateCollisionGeometry( const ParsedEntity & entity ) {
 		kd_tree.solidity = kd_tree.solidity | map_brush.solidity;
 	}
 
-	BuildKDTree( &kd_tree, VectorToSpan( brush_bounds ) );
+	u64 before = ggtime();
+	BuildKDTree( &kd_tree, VectorToSpan( brush_bounds ), KDTreeBuildConfig { .binned = true, .parallel = true } );
+
+	if( kdtree_report ) {
+		ReportKDTreeQuality( entity.brushes[ 0 ].entity_id, kd_tree, VectorToSpan( brush_bounds ), FlicksToSeconds( ggtime() - before ) );
+	}
 
 	return kd_tree;
 }
 
+/*
+ * every grid is aligned to a multiple of its own power of two step, so a
+ * position on a coarse grid lands exactly on all the finer ones. positions
+ * that a coarse cluster shares with its neighbours get snapped to the coarsest
+ * grid that touches them in every cluster, so the seams between them line up
+ */
+static std::vector< float > SnapSharedPositions( std::vector< CompiledMesh > * clusters, QuantizationStats * stats ) {
+	TracyZoneScoped;
+
+	struct ClusterVertex {
+		Vec3 position;
+		u32 cluster;
+		u32 vertex;
+	};
+
+	std::vector< float > steps( clusters->size() );
+	std::vector< ClusterVertex > vertices;
+	for( size_t i = 0; i < clusters->size(); i++ ) {
+		const CompiledMesh & cluster = ( *clusters )[ i ];
+		steps[ i ] = QuantizationStep( MeshBounds( cluster ) );
+		for( size_t j = 0; j < cluster.vertices.size(); j++ ) {
+			vertices.push_back( { cluster.vertices[ j ].position, u32( i ), u32( j ) } );
+		}
+	}
+
+	nanosort( vertices.begin(), vertices.end(), []( const ClusterVertex & a, const ClusterVertex & b ) {
+		if( a.position.x != b.position.x ) return a.position.x < b.position.x;
+		if( a.position.y != b.position.y ) return a.position.y < b.position.y;
+		if( a.position.z != b.position.z ) return a.position.z < b.position.z;
+		return a.cluster == b.cluster ? a.vertex < b.vertex : a.cluster < b.cluster;
+	} );
+
+	// snapping can push a cluster past the size its grid allows, so repeat until no step changes
+	bool changed = true;
+	while( changed ) {
+		size_t group_start = 0;
+		for( size_t i = 1; i <= vertices.size(); i++ ) {
+			if( i < vertices.size() && vertices[ i ].position == vertices[ group_start ].position )
+				continue;
+
+			float step = 0.0f;
+			for( size_t j = group_start; j < i; j++ ) {
+				step = Max2( step, steps[ vertices[ j ].cluster ] );
+			}
+
+			Vec3 p = vertices[ group_start ].position;
+			Vec3 snapped = Vec3( roundf( p.x / step ), roundf( p.y / step ), roundf( p.z / step ) ) * step;
+			for( size_t j = group_start; j < i; j++ ) {
+				( *clusters )[ vertices[ j ].cluster ].vertices[ vertices[ j ].vertex ].position = snapped;
+			}
+
+			group_start = i;
+		}
+
+		changed = false;
+		for( size_t i = 0; i < clusters->size(); i++ ) {
+			float step = QuantizationStep( MeshBounds( ( *clusters )[ i ] ) );
+			if( step > steps[ i ] ) {
+				steps[ i ] = step;
+				changed = true;
+			}
+		}
+	}
+
+	for( const ClusterVertex & v : vertices ) {
+		Vec3 snapped = ( *clusters )[ v.cluster ].vertices[ v.vertex ].position;
+		stats->max_error = Max2( stats->max_error, Length( snapped - v.position ) );
+	}
+
+	return steps;
+}
+
+static MapMesh QuantizeMesh( const CompiledMesh & mesh, float quantization_step, DynamicArray< MapVertexPosition > * positions, DynamicArray< MapVertexNormal > * normals, QuantizationStats * stats ) {
+	MinMax3 bounds = MeshBounds( mesh );
+
+	MapMesh map_mesh = { };
+	map_mesh.material = mesh.material;
+	map_mesh.num_vertices = checked_cast< u32 >( mesh.indices.size() );
+	map_mesh.base_vertex = checked_cast< u32 >( positions->size() );
+	map_mesh.num_unique_vertices = checked_cast< u32 >( mesh.vertices.size() );
+	map_mesh.bounds = MinMax3::Empty();
+	map_mesh.quantization_step = quantization_step;
+	for( int i = 0; i < 3; i++ ) {
+		map_mesh.quantization_origin[ i ] = floorf( bounds.mins[ i ] / map_mesh.quantization_step ) * map_mesh.quantization_step;
+	}
+
+	for( const InterleavedMapVertex & v : mesh.vertices ) {
+		Vec3 q = ( v.position - map_mesh.quantization_origin ) / map_mesh.quantization_step;
+
+		MapVertexPosition p;
+		p.x = u16( Clamp( 0.0f, roundf( q.x ), float( U16_MAX ) ) );
+		p.y = u16( Clamp( 0.0f, roundf( q.y ), float( U16_MAX ) ) );
+		p.z = u16( Clamp( 0.0f, roundf( q.z ), float( U16_MAX ) ) );
+
+		positions->add( p );
+		normals->add( EncodeMapNormal( v.normal ) );
+
+		// cull with the positions the game will see, void extension included
+		map_mesh.bounds = Union( map_mesh.bounds, DequantizeMapPosition( map_mesh, p ) );
+	}
+
+	stats->num_meshes++;
+	if( map_mesh.quantization_step > MIN_QUANTIZATION_STEP ) {
+		stats->num_coarse_meshes++;
+	}
+
+	return map_mesh;
+}
+
+static void PrintQuantizationStats( const QuantizationStats & stats ) {
+	printf( "%zu render clusters, %zu with a grid coarser than %g units, max position error %g units\n",
+		stats.num_meshes, stats.num_coarse_meshes, MIN_QUANTIZATION_STEP, stats.max_error );
+}
+
+// write to a temp file and rename it over the old one, so a server that has
+// the old map memory mapped keeps seeing the old contents instead of a
+// truncated file
 static void WriteFileOrComplain( ArenaAllocator * arena, const char * path, const void * data, size_t len ) {
-	if( WriteFile( arena, path, data, len ) ) {
-		printf( "Wrote %s\n", path );
+	char * tmp_path = ( *arena )( "{}.tmp", path );
+	if( !WriteFile( arena, tmp_path, data, len ) ) {
+		char * msg = ( *arena )( "Can't write {}", tmp_path );
+		perror( msg );
+		return;
 	}
-	else {
-		char * msg = ( *arena )( "Can't write {}", path );
+
+	if( !MoveFile( arena, tmp_path, path, MoveFile_DoReplace ) ) {
+		char * msg = ( *arena )( "Can't replace {}", path );
 		perror( msg );
+		RemoveFile( arena, tmp_path );
+		return;
 	}
+
+	printf( "Wrote %s\n", path );
 }
 
 static constexpr const char * section_names[] = {
@@ -661,11 +1113,15 @@ static constexpr const char * section_names[] = {
 };
 STATIC_ASSERT( ARRAY_COUNT( section_names ) == MapSection_Count );
 
+static void PadTo( DynamicArray< u8 > & packed, size_t alignment ) {
+	size_t padding = AlignPow2( packed.size(), alignment ) - packed.size();
+	size_t offset = packed.extend( padding );
+	memset( packed.ptr() + offset, 0, padding );
+}
+
 template< typename T >
-void Pack( DynamicArray< u8 > & packed, MapHeader * header, MapSectionType section, Span< const T > data, size_t * last_alignment ) {
-	assert( packed.size() % alignof( T ) == 0 );
-	assert( alignof( T ) <= *last_alignment );
-	*last_alignment = alignof( T );
+void Pack( DynamicArray< u8 > & packed, MapHeader * header, MapSectionType section, Span< const T > data ) {
+	PadTo( packed, alignof( T ) );
 
 	if( data.n > 0 ) {
 		size_t offset = packed.extend( data.num_bytes() );
@@ -690,20 +1146,29 @@ static void WriteCDMap( ArenaAllocator * arena, const char * path, Span< const c
 	packed.extend( sizeof( header ) );
 	memset( packed.ptr(), 0, packed.size() ); // zero out padding bytes
 
-	size_t last_alignment = alignof( MapHeader );
-	Pack( packed, &header, MapSection_Meshes, map->meshes, &last_alignment );
-	Pack( packed, &header, MapSection_Entities, map->entities, &last_alignment );
-	Pack( packed, &header, MapSection_EntityKeyValues, map->entity_kvs, &last_alignment );
-	Pack( packed, &header, MapSection_Models, map->models, &last_alignment );
-	Pack( packed, &header, MapSection_Nodes, map->nodes, &last_alignment );
-	Pack( packed, &header, MapSection_BrushPlanes, map->brush_planes, &last_alignment );
-	Pack( packed, &header, MapSection_VertexPositions, map->vertex_positions, &last_alignment );
-	Pack( packed, &header, MapSection_VertexNormals, map->vertex_normals, &last_alignment );
-	Pack( packed, &header, MapSection_VertexIndices, map->vertex_indices, &last_alignment );
-	Pack( packed, &header, MapSection_BrushIndices, map->brush_indices, &last_alignment );
-	Pack( packed, &header, MapSection_Brushes, map->brushes, &last_alignment );
-	Pack( packed, &header, MapSection_Source, src, &last_alignment );
-	Pack( packed, &header, MapSection_EntityData, map->entity_data, &last_alignment );
+	/*
+	 * servers mmap uncompressed maps, so sections are grouped by who reads
+	 * them and each group starts on its own page. the server only ever
+	 * faults in the first group, the client reads the first two, and
+	 * nothing at runtime touches the source
+	 */
+	Pack( packed, &header, MapSection_Entities, map->entities );
+	Pack( packed, &header, MapSection_EntityKeyValues, map->entity_kvs );
+	Pack( packed, &header, MapSection_EntityData, map->entity_data );
+	Pack( packed, &header, MapSection_Models, map->models );
+	Pack( packed, &header, MapSection_Nodes, map->nodes );
+	Pack( packed, &header, MapSection_BrushPlanes, map->brush_planes );
+	Pack( packed, &header, MapSection_BrushIndices, map->brush_indices );
+	Pack( packed, &header, MapSection_Brushes, map->brushes );
+
+	PadTo( packed, CDMAP_PAGE_SIZE );
+	Pack( packed, &header, MapSection_Meshes, map->meshes );
+	Pack( packed, &header, MapSection_VertexPositions, map->vertex_positions );
+	Pack( packed, &header, MapSection_VertexNormals, map->vertex_normals );
+	Pack( packed, &header, MapSection_VertexIndices, map->vertex_indices );
+
+	PadTo( packed, CDMAP_PAGE_SIZE );
+	Pack( packed, &header, MapSection_Source, src );
 
 	memcpy( packed.ptr(), &header, sizeof( header ) );
 
@@ -729,27 +1194,26 @@ static void WriteObj( ArenaAllocator * arena, const char * path, const MapData *
 
 	const MapModel * model = &map->models[ 0 ];
 
-	for( size_t i = 0; i < map->vertex_positions.n; i++ ) {
-		Vec3 p = map->vertex_positions[ i ];
-		Vec3 n = map->vertex_normals[ i ];
+	// meshes own contiguous vertex ranges so we can write them in mesh order
+	for( const MapMesh & mesh : map->meshes ) {
+		for( u32 i = 0; i < mesh.num_unique_vertices; i++ ) {
+			Vec3 p = DequantizeMapPosition( mesh, map->vertex_positions[ i + mesh.base_vertex ] );
+			Vec3 n = DecodeMapNormal( map->vertex_normals[ i + mesh.base_vertex ] );
 
-		// note the Z-up to Y-up transform
-		obj.append( "v {} {} {}\n", p.x, -p.z, p.y );
-		obj.append( "vn {} {} {}\n", n.x, -n.z, n.y );
+			// note the Z-up to Y-up transform
+			obj.append( "v {} {} {}\n", p.x, -p.z, p.y );
+			obj.append( "vn {} {} {}\n", n.x, -n.z, n.y );
+		}
 	}
 
 	for( u32 i = 0; i < model->num_meshes; i++ ) {
 		const MapMesh * mesh = &map->meshes[ i + model->first_mesh ];
 
 		for( u32 j = 0; j < mesh->num_vertices; j += 3 ) {
-			obj.append( "f {}//{} {}//{} {}//{}\n",
-				map->vertex_indices[ j + 0 + mesh->first_vertex_index ] + 1,
-				map->vertex_indices[ j + 0 + mesh->first_vertex_index ] + 1,
-				map->vertex_indices[ j + 1 + mesh->first_vertex_index ] + 1,
-				map->vertex_indices[ j + 1 + mesh->first_vertex_index ] + 1,
-				map->vertex_indices[ j + 2 + mesh->first_vertex_index ] + 1,
-				map->vertex_indices[ j + 2 + mesh->first_vertex_index ] + 1
-			);
+			u32 a = map->vertex_indices[ j + 0 + mesh->first_vertex_index ] + mesh->base_vertex + 1;
+			u32 b = map->vertex_indices[ j + 1 + mesh->first_vertex_index ] + mesh->base_vertex + 1;
+			u32 c = map->vertex_indices[ j + 2 + mesh->first_vertex_index ] + mesh->base_vertex + 1;
+			obj.append( "f {}//{} {}//{} {}//{}\n", a, a, b, b, c, c );
 		}
 	}
 
@@ -774,40 +1238,77 @@ static void SetKey( Span< ParsedKeyValue > kvs, const char * key, Span< const ch
 	}
 }
 
-static bool ParseArg( const char * arg, bool * compress, bool * write_obj ) {
+static bool ParseArg( const char * arg, bool * compress, bool * write_obj, bool * kdtree_report ) {
 	*compress = *compress || StrEqual( arg, "--compress" );
 	*write_obj = *write_obj || StrEqual( arg, "--obj" );
-	return StrEqual( arg, "--compress" ) || StrEqual( arg, "--obj" );
+	*kdtree_report = *kdtree_report || StrEqual( arg, "--kdtree-report" );
+	return StrEqual( arg, "--compress" ) || StrEqual( arg, "--obj" ) || StrEqual( arg, "--kdtree-report" );
+}
+
+constexpr u32 MAX_DIESELMAP_THREADS = 64;
+
+static bool ParseThreadsArg( u32 * num_threads, const char * value ) {
+	char * end;
+	unsigned long n = strtoul( value, &end, 10 );
+	if( *end != '\0' || n == 0 || n > MAX_DIESELMAP_THREADS )
+		return false;
+	*num_threads = n;
+	return true;
+}
+
+struct CompileTimings {
+	u64 parse;
+	u64 compile;
+	std::atomic< u64 > render_geometry;
+	std::atomic< u64 > collision_geometry;
+	u64 flatten;
+	u64 write;
+};
+
+static void PrintTimings( const CompileTimings & timings, u32 num_threads ) {
+	printf( "Timings with %u threads:\n", num_threads );
+	printf( "  parse            %.3fs\n", FlicksToSeconds( timings.parse ) );
+	printf( "  compile          %.3fs\n", FlicksToSeconds( timings.compile ) );
+	printf( "    render geometry    %.3fs (summed over threads)\n", FlicksToSeconds( timings.render_geometry ) );
+	printf( "    collision geometry %.3fs (summed over threads)\n", FlicksToSeconds( timings.collision_geometry ) );
+	printf( "  flatten          %.3fs\n", FlicksToSeconds( timings.flatten ) );
+	printf( "  write            %.3fs\n", FlicksToSeconds( timings.write ) );
 }
 
 int main( int argc, char ** argv ) {
 	bool compress = false;
 	bool write_obj = false;
+	bool kdtree_report = false;
+	u32 num_threads = Min2( GetCoreCount(), MAX_DIESELMAP_THREADS );
 	const char * src_path = NULL;
 
 	{
-		bool ok = true;
-
-		if( argc < 2 || argc > 4 ) {
-			ok = false;
-		}
-
-		if( argc == 3 ) {
-			ok = ok && ParseArg( argv[ 1 ], &compress, &write_obj );
-		}
+		bool ok = argc >= 2;
 
-		if( argc == 4 ) {
-			ok = ok && ParseArg( argv[ 2 ], &compress, &write_obj );
+		for( int i = 1; ok && i < argc - 1; i++ ) {
+			if( StrEqual( argv[ i ], "--threads" ) && i + 1 < argc - 1 ) {
+				ok = ParseThreadsArg( &num_threads, argv[ i + 1 ] );
+				i++;
+			}
+			else {
+				ok = ParseArg( argv[ i ], &compress, &write_obj, &kdtree_report );
+			}
 		}
 
 		if( !ok ) {
-			printf( "Usage: %s [--compress] [--obj] <file.map>\n", argv[ 0 ] );
+			printf( "Usage: %s [--compress] [--obj] [--kdtree-report] [--threads N] <file.map>\n", argv[ 0 ] );
 			return 1;
 		}
 
 		src_path = argv[ argc - 1 ];
 	}
 
+	// the output must not depend on this. everything that runs in parallel
+	// writes its results by index and gets concatenated in source order
+	InitThreadPool( num_threads );
+
+	CompileTimings timings = { };
+
 	Span< char > src = ReadFileBinary( sys_allocator, src_path ).cast< char >();
 	if( src.ptr == NULL ) {
 		char * msg = ( *sys_allocator )( "Can't read {}", src_path );
@@ -825,7 +1326,9 @@ int main( int argc, char ** argv ) {
 	ArenaAllocator arena( sys_allocator->allocate( arena_size, 16 ), arena_size );
 
 	// parse the .map
+	u64 parse_start = ggtime();
 	std::vector< ParsedEntity > entities = ParseEntities( src );
+	timings.parse = ggtime() - parse_start;
 
 	// flatten func_groups into entity 0
 	{
@@ -862,20 +1365,35 @@ int main( int argc, char ** argv ) {
 	{
 		TracyZoneScopedN( "Compile entities" );
 
-		for( ParsedEntity & entity : entities ) {
+		u64 compile_start = ggtime();
+
+		std::vector< CompiledEntity > all_compiled_entities( entities.size() );
+		ParallelFor( entities.size(), 1, [&]( size_t i ) {
+			const ParsedEntity & entity = entities[ i ];
 			if( GetKey( entity.kvs.span(), "classname" ) == "func_group" )
-				continue;
+				return;
 
-			CompiledEntity compiled;
+			CompiledEntity & compiled = all_compiled_entities[ i ];
+
+			u64 render_start = ggtime();
 			compiled.render_geometry = GenerateRenderGeometry( entity );
-			compiled.collision_geometry = GenerateCollisionGeometry( entity );
+			u64 collision_start = ggtime();
+			compiled.collision_geometry = GenerateCollisionGeometry( entity, kdtree_report );
+			timings.render_geometry += collision_start - render_start;
+			timings.collision_geometry += ggtime() - collision_start;
 
 			for( ParsedKeyValue kv : entity.kvs ) {
 				compiled.key_values.push_back( kv );
 			}
+		} );
 
-			compiled_entities.push_back( compiled );
+		for( size_t i = 0; i < entities.size(); i++ ) {
+			if( GetKey( entities[ i ].kvs.span(), "classname" ) == "func_group" )
+				continue;
+			compiled_entities.push_back( std::move( all_compiled_entities[ i ] ) );
 		}
+
+		timings.compile = ggtime() - compile_start;
 	}
 
 	// flatten everything into linear arrays
@@ -888,9 +1406,12 @@ int main( int argc, char ** argv ) {
 	DynamicArray< u32 > flat_brush_indices( &arena );
 	DynamicArray< Plane > flat_brush_planes( &arena );
 	DynamicArray< MapMesh > flat_meshes( &arena );
-	DynamicArray< Vec3 > flat_vertex_positions( &arena );
-	DynamicArray< Vec3 > flat_vertex_normals( &arena );
-	DynamicArray< u32 > flat_vertex_indices( &arena );
+	DynamicArray< MapVertexPosition > flat_vertex_positions( &arena );
+	DynamicArray< MapVertexNormal > flat_vertex_normals( &arena );
+	DynamicArray< u16 > flat_vertex_indices( &arena );
+	QuantizationStats quantization_stats = { };
+
+	u64 flatten_start = ggtime();
 
 	{
 		TracyZoneScopedN( "Flatten render/collision geometry" );
@@ -898,21 +1419,18 @@ int main( int argc, char ** argv ) {
 		for( CompiledEntity & entity : compiled_entities ) {
 			u32 first_mesh = checked_cast< u32 >( flat_meshes.size() );
 
-			for( const CompiledMesh & mesh : entity.render_geometry ) {
-				MapMesh map_mesh;
-				map_mesh.material = mesh.material;
+			std::vector< float > quantization_steps = SnapSharedPositions( &entity.render_geometry, &quantization_stats );
+
+			for( size_t i = 0; i < entity.render_geometry.size(); i++ ) {
+				const CompiledMesh & mesh = entity.render_geometry[ i ];
+				MapMesh map_mesh = QuantizeMesh( mesh, quantization_steps[ i ], &flat_vertex_positions, &flat_vertex_normals, &quantization_stats );
 				map_mesh.first_vertex_index = flat_vertex_indices.size();
-				map_mesh.num_vertices = mesh.indices.size();
-				flat_meshes.add( map_mesh );
 
-				size_t base_vertex = flat_vertex_positions.size();
-				for( const InterleavedMapVertex & v : mesh.vertices ) {
-					flat_vertex_positions.add( v.position );
-					flat_vertex_normals.add( v.normal );
-				}
 				for( u32 idx : mesh.indices ) {
-					flat_vertex_indices.add( base_vertex + idx );
+					flat_vertex_indices.add( checked_cast< u16 >( idx ) );
 				}
+
+				flat_meshes.add( map_mesh );
 			}
 
 			size_t base_node = flat_nodes.size();
@@ -979,7 +1497,13 @@ int main( int argc, char ** argv ) {
 		}
 	}
 
+	timings.flatten = ggtime() - flatten_start;
+
+	PrintQuantizationStats( quantization_stats );
+
 	// write to disk
+	u64 write_start = ggtime();
+
 	MapData flattened;
 	flattened.entities = flat_entities.span();
 	flattened.entity_data = flat_entity_data.span();
@@ -1003,6 +1527,9 @@ int main( int argc, char ** argv ) {
 		WriteCDMap( &arena, cdmap_path, immutable_src_copy, &flattened, compress );
 	}
 
+	timings.write = ggtime() - write_start;
+	PrintTimings( timings, num_threads );
+
 	// TODO: generate render geometry
 	// - figure out what postprocessing we need e.g. welding
 	// - extend void render geometry
@@ -1010,5 +1537,7 @@ int main( int argc, char ** argv ) {
 
 	Free( sys_allocator, arena.get_memory() );
 
+	ShutdownThreadPool();
+
 	return 0;
 }
@@ -5,6 +5,8 @@ bin( "dieselmap", {
 		"source/qcommon/base.cpp",
 		"source/qcommon/fs.cpp",
 		"source/qcommon/hash.cpp",
+		"source/qcommon/linear_algebra_kernels.cpp",
+		"source/qcommon/threadpool.cpp",
 		"source/qcommon/platform/*_fs.cpp",
 		"source/qcommon/platform/*_sys.cpp",
 		"source/qcommon/platform/*_threads.cpp",
@@ -12,12 +14,14 @@ bin( "dieselmap", {
 
 		"source/gameshared/q_math.cpp",
 		"source/gameshared/q_shared.cpp",
+		"source/gameshared/cdmap.cpp",
 		"source/gameshared/editor_materials.cpp",
 		"source/qcommon/rng.cpp",
 	},
 
 	libs = {
 		"ggformat",
+		"ggtime",
 		"tracy",
 		"meshoptimizer",
 		"zstd",
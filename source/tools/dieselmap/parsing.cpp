@@ -7,8 +7,10 @@
 #include "gameshared/q_shared.h"
 
 #include "parsing.h"
+#include "qcommon/threadpool.h"
 
 #include <algorithm>
+#include <atomic>
 #include <vector>
 
 static constexpr Span< const char > NullSpan( NULL, 0 );
@@ -444,6 +446,56 @@ static size_t LineNumber( size_t offset, const std::vector< size_t > & new_lines
 	return 1 + std::lower_bound( new_lines.begin(), new_lines.end(), offset ) - new_lines.begin();
 }
 
+/*
+ * entities parse independently, so find the top level {} blocks up front and
+ * hand them out to threads. this returns false for anything that doesn't look
+ * like a list of entities and we let the serial parser deal with it
+ */
+static bool SplitEntities( std::vector< Span< const char > > * spans, Span< const char > map ) {
+	TracyZoneScoped;
+
+	size_t depth = 0;
+	size_t entity_start = 0;
+	bool in_quotes = false;
+
+	for( size_t i = 0; i < map.n; i++ ) {
+		char c = map[ i ];
+
+		if( in_quotes ) {
+			if( c == '\\' ) {
+				i++;
+			}
+			else if( c == '"' ) {
+				in_quotes = false;
+			}
+			continue;
+		}
+
+		if( c == '"' ) {
+			in_quotes = true;
+		}
+		else if( c == '{' ) {
+			if( depth == 0 ) {
+				entity_start = i;
+			}
+			depth++;
+		}
+		else if( c == '}' ) {
+			if( depth == 0 )
+				return false;
+			depth--;
+			if( depth == 0 ) {
+				spans->push_back( map.slice( entity_start, i + 1 ) );
+			}
+		}
+		else if( depth == 0 && ParseSet( map + i, whitespace_chars ).ptr == NULL ) {
+			return false;
+		}
+	}
+
+	return depth == 0 && !in_quotes && spans->size() > 0;
+}
+
 std::vector< ParsedEntity > ParseEntities( Span< char > map ) {
 	TracyZoneScoped;
 
@@ -462,9 +514,27 @@ std::vector< ParsedEntity > ParseEntities( Span< char > map ) {
 
 	StripComments( map );
 
-	Span< const char > cursor = map;
-	cursor = CaptureNOrMore( &entities, cursor, 1, ParseEntity );
-	cursor = SkipWhitespace( cursor );
+	Span< const char > cursor;
+	std::vector< Span< const char > > entity_spans;
+	if( SplitEntities( &entity_spans, map ) ) {
+		TracyZoneScopedN( "Parse entities in parallel" );
+
+		entities.resize( entity_spans.size() );
+		std::atomic< bool > failed = false;
+
+		ParallelFor( entity_spans.size(), 1, [&]( size_t i ) {
+			Span< const char > res = SkipWhitespace( ParseEntity( &entities[ i ], entity_spans[ i ] ) );
+			if( res.ptr == NULL || res.n != 0 ) {
+				failed = true;
+			}
+		} );
+
+		cursor = failed ? Span< const char >() : map + map.n;
+	}
+	else {
+		cursor = CaptureNOrMore( &entities, map, 1, ParseEntity );
+		cursor = SkipWhitespace( cursor );
+	}
 
 	{
 		TracyZoneScopedN( "Assign line numbers" );
@@ -0,0 +1,322 @@
+#include "qcommon/base.h"
+#include "qcommon/dynamic_hashtable.h"
+#include "qcommon/hash.h"
+#include "qcommon/hashtable.h"
+
+#include "gg/ggtime.h"
+
+void ShowErrorMessage( const char * msg, const char * file, int line ) {
+	printf( "%s (%s:%d)\n", msg, file, line );
+}
+
+/*
+ * microbenchmarks for the hashtables at the sizes we actually use them. fills
+ * a table with N keys and times adding them, looking up keys that are there
+ * and keys that aren't, plus the slowest single add since that's what you'd
+ * see as a hitch. at the bigger sizes the slowest add is mostly the OS
+ * faulting in fresh pages for the grown table. Hashtable gets twice as many
+ * slots as keys, which is how the game sizes them.
+ *
+ * then the same for Hash64 against the fnv1a it replaced: throughput from
+ * 4 byte keys up to 1MB buffers, and a few quality checks that would catch
+ * a badly mixing hash
+ */
+
+constexpr int REPEATS = 5;
+constexpr int LOOKUP_PASSES = 16;
+
+static float NanosecondsEach( u64 flicks, size_t n ) {
+	return flicks / float( GGTIME_FLICKS_PER_SECOND ) * 1000000000.0f / n;
+}
+
+template< typename F >
+static u64 Best( const F & f ) {
+	u64 best = U64_MAX;
+	for( int i = 0; i < REPEATS; i++ ) {
+		u64 start = ggtime();
+		f();
+		best = Min2( best, ggtime() - start );
+	}
+	return best;
+}
+
+struct Results {
+	u64 add;
+	u64 worst_add;
+	u64 hit;
+	u64 miss;
+	u64 checksum;
+};
+
+template< typename Table >
+static Results Bench( Table * table, Span< const u64 > keys, Span< const u64 > missing ) {
+	Results results = { };
+	results.worst_add = U64_MAX;
+
+	results.add = Best( [&] {
+		table->clear();
+		for( u64 key : keys ) {
+			table->add( key, key );
+		}
+	} );
+
+	// separate pass because reading the clock costs more than an add
+	for( int i = 0; i < REPEATS; i++ ) {
+		table->clear();
+		u64 worst = 0;
+		for( u64 key : keys ) {
+			u64 start = ggtime();
+			table->add( key, key );
+			worst = Max2( worst, ggtime() - start );
+		}
+		results.worst_add = Min2( results.worst_add, worst );
+	}
+
+	results.hit = Best( [&] {
+		for( int i = 0; i < LOOKUP_PASSES; i++ ) {
+			for( u64 key : keys ) {
+				u64 value = 0;
+				table->get( key, &value );
+				results.checksum += value;
+			}
+		}
+	} );
+
+	results.miss = Best( [&] {
+		for( int i = 0; i < LOOKUP_PASSES; i++ ) {
+			for( u64 key : missing ) {
+				u64 value = 0;
+				results.checksum += table->get( key, &value ) ? 1 : 0;
+			}
+		}
+	} );
+
+	return results;
+}
+
+// clear() keeps the memory around, but we want the add timings to include
+// growing from empty
+struct FreshDynamicHashtable {
+	NonRAIIDynamicHashtable table;
+
+	FreshDynamicHashtable() { table.init( sys_allocator ); }
+	~FreshDynamicHashtable() { table.shutdown(); }
+
+	void clear() {
+		table.shutdown();
+		table.init( sys_allocator );
+	}
+
+	bool add( u64 key, u64 value ) { return table.add( key, value ); }
+	bool get( u64 key, u64 * value ) const { return table.get( key, value ); }
+};
+
+static void Print( const char * name, size_t n, const Results & results ) {
+	printf( "%-18s %6zu %9.1fns %10.1fns %7.1fns %7.1fns\n",
+		name, n,
+		NanosecondsEach( results.add, n ),
+		NanosecondsEach( results.worst_add, 1 ),
+		NanosecondsEach( results.hit, n * LOOKUP_PASSES ),
+		NanosecondsEach( results.miss, n * LOOKUP_PASSES ) );
+}
+
+template< size_t N >
+static bool BenchSize() {
+	Span< u64 > keys = AllocSpan< u64 >( sys_allocator, N );
+	Span< u64 > missing = AllocSpan< u64 >( sys_allocator, N );
+	defer { Free( sys_allocator, keys.ptr ); };
+	defer { Free( sys_allocator, missing.ptr ); };
+
+	// Hashtable can't take 0, but the splitmix finalizer only maps 0 to 0
+	for( size_t i = 0; i < N; i++ ) {
+		keys[ i ] = Hash64( u64( i + 1 ) );
+		missing[ i ] = Hash64( u64( i + 1 + N ) );
+	}
+
+	// too big for the stack at the larger sizes. Bench clears it first thing
+	Hashtable< N * 2 > * fixed = Alloc< Hashtable< N * 2 > >( sys_allocator );
+	defer { Free( sys_allocator, fixed ); };
+	Results fixed_results = Bench( fixed, keys.cast< const u64 >(), missing.cast< const u64 >() );
+
+	FreshDynamicHashtable dynamic;
+	Results dynamic_results = Bench( &dynamic, keys.cast< const u64 >(), missing.cast< const u64 >() );
+
+	Print( "Hashtable", N, fixed_results );
+	Print( "DynamicHashtable", N, dynamic_results );
+
+	return fixed_results.checksum == dynamic_results.checksum;
+}
+
+static u64 Fnv1a64( const void * data, size_t n, u64 seed = 0 ) {
+	const u8 * bytes = ( const u8 * ) data;
+	u64 hash = 14695981039346656037_u64 ^ seed;
+	for( size_t i = 0; i < n; i++ ) {
+		hash = ( hash ^ bytes[ i ] ) * 1099511628211_u64;
+	}
+	return hash;
+}
+
+using HashFunction = u64 ( * )( const void * data, size_t n, u64 seed );
+
+struct NamedHashFunction {
+	const char * name;
+	HashFunction f;
+};
+
+static const NamedHashFunction hash_functions[] = {
+	{ "fnv1a", Fnv1a64 },
+	{ "Hash64", []( const void * data, size_t n, u64 seed ) { return Hash64( data, n, seed ); } },
+};
+
+constexpr size_t THROUGHPUT_BYTES = 16 * 1024 * 1024;
+
+// so the hashing doesn't get optimised out
+static volatile u64 sink;
+
+static void BenchThroughput( Span< const u8 > data ) {
+	constexpr size_t sizes[] = { 4, 8, 12, 16, 32, 64, 256, 4096, 1024 * 1024 };
+
+	printf( "\nhash       bytes     per hash        GB/s\n" );
+	for( size_t size : sizes ) {
+		for( NamedHashFunction hash : hash_functions ) {
+			size_t n = THROUGHPUT_BYTES / size;
+			u64 checksum = 0;
+
+			// feed the previous hash in as the seed so the hashes can't
+			// overlap, which is what a lookup looks like
+			u64 flicks = Best( [&] {
+				for( size_t i = 0; i < n; i++ ) {
+					checksum = hash.f( data.ptr + ( i * size ) % ( data.n - size ), size, checksum );
+				}
+			} );
+
+			sink = checksum;
+
+			float seconds = flicks / float( GGTIME_FLICKS_PER_SECOND );
+			printf( "%-7s %8zu %10.1fns %9.2f\n", hash.name, size, NanosecondsEach( flicks, n ), THROUGHPUT_BYTES / seconds / 1e9f );
+		}
+	}
+}
+
+/*
+ * flip each input bit and count how often each output bit flips, which
+ * should be half the time. prints the worst output bit over all input bits,
+ * so 0.50 is perfect
+ */
+static float WorstAvalancheBias( HashFunction hash, size_t size ) {
+	constexpr size_t TRIALS = 2000;
+	u32 flips[ 16 * 8 ][ 64 ] = { };
+
+	u64 rng = 1;
+	for( size_t t = 0; t < TRIALS; t++ ) {
+		u8 key[ 16 ];
+		for( size_t i = 0; i < size; i++ ) {
+			rng = Hash64( rng );
+			key[ i ] = u8( rng );
+		}
+
+		u64 h = hash( key, size, 0 );
+		for( size_t bit = 0; bit < size * 8; bit++ ) {
+			key[ bit / 8 ] ^= u8( 1 << ( bit % 8 ) );
+			u64 diff = h ^ hash( key, size, 0 );
+			key[ bit / 8 ] ^= u8( 1 << ( bit % 8 ) );
+
+			for( size_t i = 0; i < 64; i++ ) {
+				flips[ bit ][ i ] += ( diff >> i ) & 1;
+			}
+		}
+	}
+
+	float worst = 0.0f;
+	for( size_t bit = 0; bit < size * 8; bit++ ) {
+		for( size_t i = 0; i < 64; i++ ) {
+			float p = flips[ bit ][ i ] / float( TRIALS );
+			worst = Max2( worst, Abs( p - 0.5f ) );
+		}
+	}
+
+	return 0.5f + worst;
+}
+
+/*
+ * put keys in 2^16 buckets using the low bits like our hashtables do, and
+ * compare the chi-squared against what uniformly random hashes would give,
+ * so ~1.00 is good and much bigger means clumping. the keys are the kinds we
+ * actually hash: sequential ints, grid cells and asset paths
+ */
+constexpr size_t NUM_BUCKETS = 1 << 16;
+constexpr size_t NUM_BUCKET_KEYS = 1 << 18;
+
+template< typename F >
+static float BucketChiSquared( HashFunction hash, const F & make_key ) {
+	Span< u32 > buckets = AllocSpan< u32 >( sys_allocator, NUM_BUCKETS );
+	defer { Free( sys_allocator, buckets.ptr ); };
+	memset( buckets.ptr, 0, buckets.num_bytes() );
+
+	for( size_t i = 0; i < NUM_BUCKET_KEYS; i++ ) {
+		char key[ 64 ];
+		size_t n = make_key( key, i );
+		buckets[ hash( key, n, 0 ) % NUM_BUCKETS ]++;
+	}
+
+	double expected = double( NUM_BUCKET_KEYS ) / NUM_BUCKETS;
+	double chi_squared = 0.0;
+	for( u32 count : buckets ) {
+		chi_squared += ( count - expected ) * ( count - expected ) / expected;
+	}
+
+	// the expected chi-squared is the degrees of freedom
+	return float( chi_squared / ( NUM_BUCKETS - 1 ) );
+}
+
+static void BenchDistribution() {
+	printf( "\nhash    avalanche 4B  avalanche 16B  buckets ints  buckets cells  buckets paths\n" );
+
+	for( NamedHashFunction hash : hash_functions ) {
+		float ints = BucketChiSquared( hash.f, []( char * key, size_t i ) {
+			u32 x = u32( i );
+			memcpy( key, &x, sizeof( x ) );
+			return sizeof( x );
+		} );
+
+		float cells = BucketChiSquared( hash.f, []( char * key, size_t i ) {
+			s32 cell[] = { s32( i % 64 ) - 32, s32( i / 64 % 64 ) - 32, s32( i / 4096 ) };
+			memcpy( key, cell, sizeof( cell ) );
+			return sizeof( cell );
+		} );
+
+		float paths = BucketChiSquared( hash.f, []( char * key, size_t i ) {
+			return size_t( snprintf( key, 64, "textures/world/crate_%zu", i ) );
+		} );
+
+		printf( "%-7s %12.2f %14.2f %13.2f %14.2f %14.2f\n", hash.name,
+			WorstAvalancheBias( hash.f, 4 ), WorstAvalancheBias( hash.f, 16 ),
+			ints, cells, paths );
+	}
+}
+
+int main() {
+	printf( "table                   n       add  worst add     hit    miss\n" );
+
+	bool ok = true;
+	ok = ok && BenchSize< 64 >();
+	ok = ok && BenchSize< 512 >();
+	ok = ok && BenchSize< 4096 >();
+	ok = ok && BenchSize< 32768 >();
+
+	if( !ok ) {
+		printf( "Tables disagree\n" );
+		return 1;
+	}
+
+	Span< u8 > data = AllocSpan< u8 >( sys_allocator, THROUGHPUT_BYTES );
+	defer { Free( sys_allocator, data.ptr ); };
+	for( size_t i = 0; i < data.n; i++ ) {
+		data[ i ] = u8( Hash64( u64( i ) ) );
+	}
+
+	BenchThroughput( data );
+	BenchDistribution();
+
+	return 0;
+}
@@ -0,0 +1,121 @@
+#include "qcommon/base.h"
+#include "qcommon/threadpool.h"
+#include "qcommon/threads.h"
+#include "gameshared/q_shared.h"
+
+#include "gg/ggtime.h"
+
+void ShowErrorMessage( const char * msg, const char * file, int line ) {
+	printf( "%s (%s:%d)\n", msg, file, line );
+}
+
+/*
+ * microbenchmarks for the thread pool. measures what an empty job costs to
+ * spawn and run, what ParallelFor costs per element with the smallest grain,
+ * and how a CPU bound ParallelFor scales from 1 thread up to all of them
+ */
+
+constexpr size_t NUM_EMPTY_JOBS = 100000;
+constexpr size_t NUM_PARALLEL_FOR_ELEMENTS = 1000000;
+constexpr size_t NUM_KERNEL_ELEMENTS = 1 << 18;
+constexpr size_t KERNEL_GRAIN = 256;
+constexpr u32 KERNEL_ROUNDS = 256;
+constexpr int REPEATS = 5;
+
+static float FlicksToSeconds( u64 flicks ) {
+	return flicks / float( GGTIME_FLICKS_PER_SECOND );
+}
+
+static float NanosecondsEach( u64 flicks, size_t n ) {
+	return FlicksToSeconds( flicks ) * 1000000000.0f / n;
+}
+
+// take the best of a few runs so the first one paying for page faults and
+// waking everyone up doesn't count
+template< typename F >
+static u64 Best( const F & f ) {
+	u64 best = U64_MAX;
+	for( int i = 0; i < REPEATS; i++ ) {
+		u64 start = ggtime();
+		f();
+		best = Min2( best, ggtime() - start );
+	}
+	return best;
+}
+
+static u64 Kernel( u64 x ) {
+	for( u32 i = 0; i < KERNEL_ROUNDS; i++ ) {
+		x = x * 6364136223846793005_u64 + 1442695040888963407_u64;
+		x ^= x >> 33;
+	}
+	return x;
+}
+
+int main( int argc, char ** argv ) {
+	u32 max_threads = GetCoreCount();
+	if( argc == 3 && StrEqual( argv[ 1 ], "--threads" ) ) {
+		max_threads = Max2( 1_u32, u32( atoi( argv[ 2 ] ) ) );
+	}
+	else if( argc != 1 ) {
+		printf( "Usage: %s [--threads N]\n", argv[ 0 ] );
+		return 1;
+	}
+
+	Span< u64 > results = AllocSpan< u64 >( sys_allocator, NUM_KERNEL_ELEMENTS );
+	defer { Free( sys_allocator, results.ptr ); };
+
+	u64 expected_checksum = 0;
+	float single_threaded_seconds = 0.0f;
+
+	printf( "threads   spawn+run   ParallelFor   kernel    speedup\n" );
+
+	for( u32 num_threads = 1; true; num_threads = Min2( num_threads * 2, max_threads ) ) {
+		InitThreadPool( num_threads );
+
+		u64 spawn = Best( [] {
+			JobCounter counter = { };
+			for( size_t i = 0; i < NUM_EMPTY_JOBS; i++ ) {
+				SpawnJob( &counter, []( TempAllocator * temp, void * data ) { } );
+			}
+			WaitForJobs( &counter );
+		} );
+
+		u64 parallel_for = Best( [] {
+			ParallelFor( NUM_PARALLEL_FOR_ELEMENTS, 1, []( size_t i ) { } );
+		} );
+
+		u64 kernel = Best( [&] {
+			ParallelFor( NUM_KERNEL_ELEMENTS, KERNEL_GRAIN, [&]( size_t i ) {
+				results[ i ] = Kernel( i );
+			} );
+		} );
+
+		ShutdownThreadPool();
+
+		u64 checksum = 0;
+		for( u64 x : results ) {
+			checksum ^= x;
+		}
+
+		if( num_threads == 1 ) {
+			expected_checksum = checksum;
+			single_threaded_seconds = FlicksToSeconds( kernel );
+		}
+		else if( checksum != expected_checksum ) {
+			printf( "Kernel output changed with %u threads\n", num_threads );
+			return 1;
+		}
+
+		printf( "%7u %8.1fns %10.1fns %7.2fms %9.2fx\n",
+			num_threads,
+			NanosecondsEach( spawn, NUM_EMPTY_JOBS ),
+			NanosecondsEach( parallel_for, NUM_PARALLEL_FOR_ELEMENTS ),
+			FlicksToSeconds( kernel ) * 1000.0f,
+			single_threaded_seconds / FlicksToSeconds( kernel ) );
+
+		if( num_threads == max_threads )
+			break;
+	}
+
+	return 0;
+}
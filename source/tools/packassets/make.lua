@@ -0,0 +1,23 @@
+bin( "packassets", {
+	srcs = {
+		"source/tools/packassets/packassets.cpp",
+		"source/qcommon/allocators.cpp",
+		"source/qcommon/base.cpp",
+		"source/qcommon/fs.cpp",
+		"source/qcommon/hash.cpp",
+		"source/qcommon/platform/*_fs.cpp",
+		"source/qcommon/platform/*_sys.cpp",
+		"source/qcommon/platform/*_threads.cpp",
+		"source/qcommon/platform/windows_utf8.cpp",
+		"source/gameshared/q_shared.cpp",
+	},
+
+	libs = {
+		"ggformat",
+		"tracy",
+		"zstd",
+	},
+
+	windows_ldflags = "ole32.lib shell32.lib user32.lib advapi32.lib",
+	linux_ldflags = "-lm -lpthread",
+} )
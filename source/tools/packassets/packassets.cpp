@@ -0,0 +1,177 @@
+#include "qcommon/base.h"
+#include "qcommon/array.h"
+#include "qcommon/fs.h"
+#include "qcommon/hash.h"
+#include "qcommon/string.h"
+#include "gameshared/q_shared.h"
+#include "client/asset_archive.h"
+
+#include "nanosort/nanosort.hpp"
+
+#include "zstd/zstd.h"
+
+void ShowErrorMessage( const char * msg, const char * file, int line ) {
+	printf( "%s (%s:%d)\n", msg, file, line );
+}
+
+struct PackedAsset {
+	Span< const char > path;
+	u64 hash;
+	Span< u8 > data;
+	bool compressed;
+};
+
+static void BuildAssetList( Allocator * a, DynamicArray< const char * > * files, DynamicString * search_path ) {
+	ListDirHandle scan = BeginListDir( a, search_path->c_str() );
+
+	const char * name;
+	bool dir;
+	while( ListDirNext( &scan, &name, &dir ) ) {
+		// skip ., .., .git, etc
+		if( name[ 0 ] == '.' )
+			continue;
+
+		size_t old_len = search_path->length();
+		search_path->append( "/{}", name );
+		if( dir ) {
+			BuildAssetList( a, files, search_path );
+		}
+		else {
+			files->add( CopyString( a, search_path->c_str() ) );
+		}
+		search_path->truncate( old_len );
+	}
+}
+
+static Span< u8 > Compress( Allocator * a, Span< const u8 > data ) {
+	size_t max_size = ZSTD_compressBound( data.n );
+	u8 * compressed = AllocMany< u8 >( a, max_size );
+	size_t compressed_size = ZSTD_compress( compressed, max_size, data.ptr, data.n, ZSTD_maxCLevel() );
+	if( ZSTD_isError( compressed_size ) ) {
+		Fatal( "ZSTD_compress: %s", ZSTD_getErrorName( compressed_size ) );
+	}
+	return Span< u8 >( compressed, compressed_size );
+}
+
+static void PadWithZeroes( DynamicArray< u8 > * buf, size_t alignment ) {
+	size_t padded = AlignPow2( buf->size(), alignment );
+	while( buf->size() < padded ) {
+		buf->add( 0 );
+	}
+}
+
+int main( int argc, char ** argv ) {
+	if( argc != 3 ) {
+		printf( "Usage: %s <base dir> <output.cdpak>\n", argv[ 0 ] );
+		return 1;
+	}
+
+	const char * base_path = argv[ 1 ];
+	const char * output_path = argv[ 2 ];
+
+	constexpr size_t arena_size = 1024 * 1024 * 1024; // 1GB
+	ArenaAllocator arena( sys_allocator->allocate( arena_size, 16 ), arena_size );
+	defer { Free( sys_allocator, arena.get_memory() ); };
+
+	DynamicString base( &arena, "{}", base_path );
+	size_t skip = base.length() + 1;
+
+	DynamicArray< const char * > files( &arena );
+	BuildAssetList( &arena, &files, &base );
+	nanosort( files.begin(), files.end(), SortCStringsComparator );
+
+	DynamicArray< PackedAsset > assets( &arena );
+	size_t uncompressed_bytes = 0;
+
+	for( size_t i = 0; i < files.size(); i++ ) {
+		// same as InitAssets, remove file.zst if file is in the list too
+		if( i > 0 && FileExtension( files[ i ] ) == ".zst" && StrEqual( StripExtension( files[ i ] ), files[ i - 1 ] ) )
+			continue;
+
+		Span< u8 > contents = ReadFileBinary( &arena, files[ i ] );
+		if( contents.ptr == NULL ) {
+			Fatal( "Can't read %s", files[ i ] );
+		}
+
+		PackedAsset asset;
+		asset.path = MakeSpan( files[ i ] + skip );
+
+		if( FileExtension( asset.path ) == ".zst" ) {
+			asset.path = StripExtension( asset.path );
+			asset.data = contents;
+			asset.compressed = true;
+		}
+		else {
+			// everything is page aligned so only bother compressing when it
+			// saves pages, otherwise the client can use the data in place
+			Span< u8 > compressed = Compress( &arena, contents );
+			asset.compressed = AlignPow2( compressed.n, ASSET_ARCHIVE_ALIGNMENT ) < AlignPow2( contents.n, ASSET_ARCHIVE_ALIGNMENT );
+			asset.data = asset.compressed ? compressed : contents;
+		}
+
+		asset.hash = Hash64( asset.path );
+		assets.add( asset );
+
+		uncompressed_bytes += contents.n;
+	}
+
+	nanosort( assets.begin(), assets.end(), []( const PackedAsset & a, const PackedAsset & b ) {
+		return a.hash < b.hash;
+	} );
+
+	for( size_t i = 1; i < assets.size(); i++ ) {
+		if( assets[ i ].hash == assets[ i - 1 ].hash ) {
+			Fatal( "%s", arena( "Asset hash name collision: {} and {}", assets[ i ].path, assets[ i - 1 ].path ) );
+		}
+	}
+
+	DynamicArray< char > paths( &arena );
+	for( const PackedAsset & asset : assets ) {
+		paths.add_many( asset.path );
+	}
+
+	size_t data_offset = AlignPow2( sizeof( AssetArchiveHeader ) + assets.size() * sizeof( AssetArchiveEntry ) + paths.size(), ASSET_ARCHIVE_ALIGNMENT );
+
+	AssetArchiveHeader header = { };
+	memcpy( header.magic, ASSET_ARCHIVE_MAGIC, sizeof( header.magic ) );
+	header.format_version = ASSET_ARCHIVE_FORMAT_VERSION;
+	header.num_entries = checked_cast< u32 >( assets.size() );
+	header.paths_size = checked_cast< u32 >( paths.size() );
+
+	DynamicArray< u8 > archive( sys_allocator );
+	archive.add_many( Span< const u8 >( ( const u8 * ) &header, sizeof( header ) ) );
+
+	{
+		size_t cursor = data_offset;
+		u32 path_offset = 0;
+		for( const PackedAsset & asset : assets ) {
+			AssetArchiveEntry entry = { };
+			entry.hash = asset.hash;
+			entry.offset = cursor;
+			entry.size = asset.data.n;
+			entry.path_offset = path_offset;
+			entry.path_length = checked_cast< u32 >( asset.path.n );
+			entry.flags = asset.compressed ? AssetArchiveEntryFlag_Compressed : AssetArchiveEntryFlags( 0 );
+
+			archive.add_many( Span< const u8 >( ( const u8 * ) &entry, sizeof( entry ) ) );
+
+			cursor = AlignPow2( cursor + asset.data.n, ASSET_ARCHIVE_ALIGNMENT );
+			path_offset += entry.path_length;
+		}
+	}
+
+	archive.add_many( paths.span().cast< const u8 >() );
+
+	for( const PackedAsset & asset : assets ) {
+		PadWithZeroes( &archive, ASSET_ARCHIVE_ALIGNMENT );
+		archive.add_many( asset.data );
+	}
+
+	if( !WriteFile( &arena, output_path, archive.ptr(), archive.num_bytes() ) ) {
+		FatalErrno( "WriteFile" );
+	}
+
+	printf( "Packed %zu assets, %zuMB -> %zuMB\n", assets.size(), uncompressed_bytes / 1024 / 1024, archive.num_bytes() / 1024 / 1024 );
+
+	return 0;
+}
@@ -0,0 +1,25 @@
+#! /usr/bin/env bash
+
+# dieselmap compiles in parallel, make sure the thread count doesn't change the output
+
+set -eoux pipefail
+
+cd "$(dirname "$0")"
+
+mkdir -p test_dieselmap_workdir
+cd test_dieselmap_workdir
+
+# pull the .map back out of the MapSection_Source section of a shipped map
+zstd -d -f ../../base/maps/carfentanil.cdmap.zst -o carfentanil.cdmap
+offset=$(od -An -tu4 -j16 -N4 carfentanil.cdmap | tr -d ' ')
+size=$(od -An -tu4 -j20 -N4 carfentanil.cdmap | tr -d ' ')
+tail -c +$((offset + 1)) carfentanil.cdmap | head -c "$size" > carfentanil.map
+
+../../release/dieselmap --threads 1 carfentanil.map
+mv carfentanil.cdmap single_threaded.cdmap
+
+../../release/dieselmap --threads 8 carfentanil.map
+cmp carfentanil.cdmap single_threaded.cdmap
+
+cd ..
+rm -r test_dieselmap_workdir